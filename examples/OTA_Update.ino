@@ -0,0 +1,37 @@
+#include <NimBLEDevice.h>
+#include <LittleFS.h>
+#include "ATC_MiThermometer.h"
+#include "ATC_OtaUpdater.h"
+
+const char *deviceAddress1 = "A4:C1:38:XX:XX:01";
+const char *deviceAddress2 = "A4:C1:38:XX:XX:02";
+
+ATC_MiThermometer thermometer1(deviceAddress1, Connection_mode::ADVERTISING);
+ATC_MiThermometer thermometer2(deviceAddress2, Connection_mode::ADVERTISING);
+
+ATC_OtaUpdater updater(2); // Update up to 2 devices at the same time
+
+void setup() {
+    Serial.begin(115200);
+    NimBLEDevice::init("");
+    LittleFS.begin();
+
+    // Firmware image uploaded to the filesystem, e.g. ATC_v46.bin from the PVVX releases
+    updater.addJob(thermometer1, LittleFS, "/ATC_v46.bin");
+    updater.addJob(thermometer2, LittleFS, "/ATC_v46.bin");
+
+    size_t done = updater.run();
+    for (size_t i = 0; i < updater.getJobCount(); i++) {
+        const ATC_OtaJob &job = updater.getJob(i);
+        Serial.print(job.address.c_str());
+        Serial.print(job.state == Ota_state::DONE ? " updated in " : " failed after ");
+        Serial.print(job.state == Ota_state::DONE ? job.elapsed_ms : job.attempts);
+        Serial.println(job.state == Ota_state::DONE ? " ms" : " attempts");
+    }
+    Serial.print("Updated devices: ");
+    Serial.println(done);
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,34 @@
+#include <NimBLEDevice.h>
+#include "ATC_MiThermometer.h"
+
+const char *deviceAddress = "A4:C1:38:XX:XX:XX"; // Replace with your device's MAC address
+
+ATC_MiThermometer thermometer(deviceAddress, Connection_mode::CONNECTION);
+
+void setup() {
+    Serial.begin(115200);
+    NimBLEDevice::init("");
+
+    thermometer.init();
+
+    // Download the 50 newest records from the device log (PVVX firmware only)
+    size_t records = thermometer.readHistory(50);
+    Serial.print("Downloaded records: ");
+    Serial.println(records);
+
+    for (const ATC_MiThermometer_Reading &record: thermometer.getHistory()) {
+        Serial.print("Time: ");
+        Serial.print((long) record.time);
+        Serial.print(" Temperature: ");
+        Serial.print(record.temperature / 100.0f);
+        Serial.print(" °C Humidity: ");
+        Serial.print(record.humidity / 100.0f);
+        Serial.print(" % Battery: ");
+        Serial.print(record.battery_mv);
+        Serial.println(" mV");
+    }
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,481 @@
+/**
+ * @file atc_batch_decode.cpp
+ * @brief Host tool decoding archived advertisement captures with the library decoders on all CPU cores, and
+ * writing the readings as per-device columnar time series.
+ *
+ * Build from the repository root on Linux:
+ *
+ *     g++ -std=c++17 -O2 -pthread -Isrc extras/batch_decoder/atc_batch_decode.cpp src/ATC_AdvertisingDecoder.cpp \
+ *         -o atc_batch_decode
+ *
+ * Usage:
+ *
+ *     atc_batch_decode [-j threads] capture.bin output.atcc   Decodes a capture
+ *     atc_batch_decode --scaling capture.bin                  Reports decode throughput from 1 to 32 threads
+ *     atc_batch_decode --generate count capture.bin           Writes a synthetic capture for testing
+ *
+ * Capture format: fixed size records of capture_record_size bytes, so that the file can be split anywhere on a
+ * record boundary. Each record holds, little-endian: uint32 time (UTC seconds), the 6 address bytes in NimBLE
+ * native order, int8 RSSI, uint8 payload length and advertisement_max_length payload bytes padded with zeros.
+ *
+ * Output format: the magic "ATCC", uint32 version and uint32 device count, then for each device in address order:
+ * uint64 packed address, uint32 reading count, and the columns times (uint32), temperatures (int16, 0.01 C),
+ * humidities (uint16, 0.01 %), battery voltages (uint16, mV), battery levels (uint8, %) and fields (uint8,
+ * Reading_Field flags), each holding one value per reading in time order.
+ */
+#include "ATC_AdvertisingDecoder.h"
+#include "ATC_StaticRegistry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief Size in bytes of a capture record. */
+constexpr size_t capture_record_size = 4 + 6 + 1 + 1 + advertisement_max_length;
+/** @brief Number of records per work item. */
+constexpr size_t chunk_records = 16384;
+/** @brief Version of the output format. */
+constexpr uint32_t output_version = 1;
+/** @brief Maximum number of threads measured by --scaling. */
+constexpr size_t scaling_max_threads = 32;
+
+/**
+ * @struct DecodedRow
+ * @brief A decoded reading with the position of its record, used to restore the capture order of equal times.
+ */
+struct DecodedRow {
+    uint64_t address; /**< The packed MAC address. */
+    uint64_t record; /**< Index of the record in the capture. */
+    uint32_t time; /**< The time of the record (UTC seconds). */
+    int16_t temperature; /**< The temperature in 0.01 degrees Celsius. */
+    uint16_t humidity; /**< The humidity in 0.01 percent. */
+    uint16_t battery_mv; /**< The battery voltage in mV. */
+    uint8_t battery_level; /**< The battery level in percent. */
+    uint8_t fields; /**< Bitmask of Reading_Field flags marking the valid fields. */
+};
+
+/**
+ * @struct WorkerResult
+ * @brief The readings and counters of one worker.
+ */
+struct WorkerResult {
+    std::vector<DecodedRow> rows; /**< The decoded readings. */
+    uint64_t undecodable = 0; /**< Number of records in an unknown or invalid format. */
+};
+
+/**
+ * @class WorkStealingPool
+ * @brief Per-worker queues of chunk indexes. A worker takes chunks from the back of its own queue and, once it is
+ *        empty, steals from the front of the other queues, so workers finishing early help the slower ones.
+ */
+class WorkStealingPool {
+public:
+    /**
+     * @brief Constructor for the WorkStealingPool class. Deals the chunks round-robin to the workers.
+     * @param workers The number of workers.
+     * @param chunks The number of chunks.
+     */
+    WorkStealingPool(size_t workers, size_t chunks) {
+        for (size_t i = 0; i < workers; i++) {
+            queues.emplace_back(new Queue());
+        }
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            queues[chunk % workers]->chunks.push_back(chunk);
+        }
+    }
+
+    /**
+     * @brief Takes the next chunk of a worker, stealing one if its queue is empty.
+     * @param worker The worker.
+     * @param chunk Receives the chunk index.
+     * @return True if a chunk was taken, false if all queues are empty.
+     */
+    bool take(size_t worker, size_t &chunk) {
+        {
+            Queue &own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.chunks.empty()) {
+                chunk = own.chunks.back();
+                own.chunks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue &victim = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.chunks.empty()) {
+                chunk = victim.chunks.front();
+                victim.chunks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /**
+     * @struct Queue
+     * @brief The chunk queue of one worker.
+     */
+    struct Queue {
+        std::mutex mutex; /**< Mutex protecting the queue. */
+        std::deque<size_t> chunks; /**< Chunk indexes. */
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; /**< One queue per worker. */
+};
+
+/**
+ * @brief Reads a little-endian 32 bit value.
+ * @param data The 4 bytes.
+ * @return The value.
+ */
+static uint32_t readLe32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+/**
+ * @brief Decodes the records of one chunk with the format detected from each advertisement.
+ * @param capture The capture records.
+ * @param records The number of records in the capture.
+ * @param chunk The chunk index.
+ * @param result Receives the readings and counters.
+ */
+static void decodeChunk(const uint8_t *capture, size_t records, size_t chunk, WorkerResult &result) {
+    size_t first = chunk * chunk_records;
+    size_t last = std::min(records, first + chunk_records);
+    for (size_t i = first; i < last; i++) {
+        const uint8_t *record = capture + i * capture_record_size;
+        const uint8_t *payload = record + 12;
+        size_t length = std::min<size_t>(record[11], advertisement_max_length);
+        Advertising_Type type;
+        ATC_MiThermometer_Reading reading{};
+        if (atcDetectAdvertisingType(payload, length, type) ||
+            (atcDecodeAdvertising(type, payload, length, reading) && reading.fields == 0)) {
+            result.undecodable++;
+            continue;
+        }
+        DecodedRow row{};
+        row.address = atcPackNativeAddress(record + 4);
+        row.record = i;
+        row.time = readLe32(record);
+        row.temperature = reading.temperature;
+        row.humidity = reading.humidity;
+        row.battery_mv = reading.battery_mv;
+        row.battery_level = reading.battery_level;
+        row.fields = reading.fields;
+        result.rows.push_back(row);
+    }
+}
+
+/**
+ * @brief Decodes a capture on several threads.
+ * @param capture The capture records.
+ * @param records The number of records.
+ * @param threads The number of threads.
+ * @param results Receives the result of each thread.
+ * @return The decode time in seconds.
+ */
+static double decodeCapture(const uint8_t *capture, size_t records, size_t threads, std::vector<WorkerResult> &results) {
+    size_t chunks = (records + chunk_records - 1) / chunk_records;
+    WorkStealingPool pool(threads, chunks);
+    results.assign(threads, WorkerResult());
+    for (WorkerResult &result: results) {
+        result.rows.reserve(records / threads + 1);
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < threads; worker++) {
+        workers.emplace_back([&, worker] {
+            size_t chunk;
+            while (pool.take(worker, chunk)) {
+                decodeChunk(capture, records, chunk, results[worker]);
+            }
+        });
+    }
+    for (std::thread &thread: workers) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Writes the readings as per-device columnar time series.
+ * @param path The output path.
+ * @param results The results of the workers.
+ * @return True on success.
+ */
+static bool writeColumnar(const char *path, std::vector<WorkerResult> &results) {
+    std::vector<DecodedRow> rows;
+    for (WorkerResult &result: results) {
+        rows.insert(rows.end(), result.rows.begin(), result.rows.end());
+        std::vector<DecodedRow>().swap(result.rows);
+    }
+    std::sort(rows.begin(), rows.end(), [](const DecodedRow &a, const DecodedRow &b) {
+        if (a.address != b.address) {
+            return a.address < b.address;
+        }
+        return a.time != b.time ? a.time < b.time : a.record < b.record;
+    });
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    uint32_t devices = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+        devices += i == 0 || rows[i].address != rows[i - 1].address;
+    }
+    fwrite("ATCC", 1, 4, file);
+    fwrite(&output_version, sizeof(output_version), 1, file);
+    fwrite(&devices, sizeof(devices), 1, file);
+    std::vector<uint32_t> times;
+    std::vector<int16_t> temperatures;
+    std::vector<uint16_t> humidities;
+    std::vector<uint16_t> voltages;
+    std::vector<uint8_t> levels;
+    std::vector<uint8_t> fields;
+    for (size_t first = 0; first < rows.size();) {
+        size_t last = first;
+        times.clear();
+        temperatures.clear();
+        humidities.clear();
+        voltages.clear();
+        levels.clear();
+        fields.clear();
+        for (; last < rows.size() && rows[last].address == rows[first].address; last++) {
+            times.push_back(rows[last].time);
+            temperatures.push_back(rows[last].temperature);
+            humidities.push_back(rows[last].humidity);
+            voltages.push_back(rows[last].battery_mv);
+            levels.push_back(rows[last].battery_level);
+            fields.push_back(rows[last].fields);
+        }
+        uint32_t count = static_cast<uint32_t>(last - first);
+        fwrite(&rows[first].address, sizeof(uint64_t), 1, file);
+        fwrite(&count, sizeof(count), 1, file);
+        fwrite(times.data(), sizeof(uint32_t), count, file);
+        fwrite(temperatures.data(), sizeof(int16_t), count, file);
+        fwrite(humidities.data(), sizeof(uint16_t), count, file);
+        fwrite(voltages.data(), sizeof(uint16_t), count, file);
+        fwrite(levels.data(), sizeof(uint8_t), count, file);
+        fwrite(fields.data(), sizeof(uint8_t), count, file);
+        first = last;
+    }
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
+
+/**
+ * @brief Builds the payload of a synthetic advertisement.
+ * @param type The advertising format.
+ * @param address The address in native order.
+ * @param temperature The temperature in 0.01 degrees Celsius.
+ * @param humidity The humidity in 0.01 percent.
+ * @param payload Receives the payload.
+ * @return The payload length.
+ */
+static uint8_t buildPayload(Advertising_Type type, const uint8_t *address, int16_t temperature, uint16_t humidity,
+                            uint8_t *payload) {
+    switch (type) {
+        case Advertising_Type::ATC1441: {
+            const uint8_t packet[] = {0x10, 0x16, 0x1A, 0x18, address[5], address[4], address[3], address[2],
+                                      address[1], address[0], static_cast<uint8_t>((temperature / 10) >> 8),
+                                      static_cast<uint8_t>(temperature / 10), static_cast<uint8_t>(humidity / 100),
+                                      90, 0x0B, 0xB8, 0, 0};
+            memcpy(payload, packet, sizeof(packet));
+            return sizeof(packet);
+        }
+        case Advertising_Type::PVVX: {
+            const uint8_t packet[] = {0x12, 0x16, 0x1A, 0x18, address[0], address[1], address[2], address[3],
+                                      address[4], address[5], static_cast<uint8_t>(temperature),
+                                      static_cast<uint8_t>(temperature >> 8), static_cast<uint8_t>(humidity),
+                                      static_cast<uint8_t>(humidity >> 8), 0xB8, 0x0B, 90, 0, 0x04};
+            memcpy(payload, packet, sizeof(packet));
+            return sizeof(packet);
+        }
+        default: {
+            const uint8_t packet[] = {0x02, 0x01, 0x06, 0x0C, 0x16, 0xD2, 0xFC, 0x40, 0x01, 90, 0x02,
+                                      static_cast<uint8_t>(temperature), static_cast<uint8_t>(temperature >> 8),
+                                      0x03, static_cast<uint8_t>(humidity), static_cast<uint8_t>(humidity >> 8)};
+            memcpy(payload, packet, sizeof(packet));
+            return sizeof(packet);
+        }
+    }
+}
+
+/**
+ * @brief Writes a synthetic capture of 1000 devices cycling through the three formats.
+ * @param count The number of records.
+ * @param path The capture path.
+ * @return True on success.
+ */
+static bool generateCapture(size_t count, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    std::mt19937 random(1);
+    const Advertising_Type types[] = {Advertising_Type::ATC1441, Advertising_Type::PVVX, Advertising_Type::BTHOME};
+    uint8_t record[capture_record_size];
+    for (size_t i = 0; i < count; i++) {
+        memset(record, 0, sizeof(record));
+        uint32_t device = random() % 1000;
+        uint32_t time = 1700000000 + static_cast<uint32_t>(i / 100);
+        memcpy(record, &time, sizeof(time));
+        const uint8_t address[6] = {static_cast<uint8_t>(device), static_cast<uint8_t>(device >> 8), 0x00, 0x38,
+                                    0xC1, 0xA4};
+        memcpy(record + 4, address, sizeof(address));
+        record[10] = static_cast<uint8_t>(-40 - static_cast<int>(random() % 50));
+        int16_t temperature = static_cast<int16_t>(1500 + random() % 1500);
+        uint16_t humidity = static_cast<uint16_t>(3000 + random() % 5000);
+        record[11] = buildPayload(types[device % 3], address, temperature, humidity, record + 12);
+        fwrite(record, sizeof(record), 1, file);
+    }
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+/**
+ * @class MappedCapture
+ * @brief A capture file mapped read-only into memory.
+ */
+class MappedCapture {
+public:
+    /**
+     * @brief Maps a capture file. Trailing bytes that do not form a whole record are ignored.
+     * @param path The capture path.
+     */
+    explicit MappedCapture(const char *path) {
+        int fd = open(path, O_RDONLY);
+        struct stat info{};
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            perror(path);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size) {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                perror(path);
+                size = 0;
+            } else {
+                data = static_cast<const uint8_t *>(mapped);
+                madvise(mapped, size, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        valid = size == 0 || data;
+    }
+
+    ~MappedCapture() {
+        if (data) {
+            munmap(const_cast<uint8_t *>(data), size);
+        }
+    }
+
+    /** @brief Checks whether the file could be mapped. */
+    bool ok() const { return valid; }
+    /** @brief Gets the records. */
+    const uint8_t *records() const { return data; }
+    /** @brief Gets the number of whole records. */
+    size_t count() const { return size / capture_record_size; }
+
+private:
+    const uint8_t *data = nullptr; /**< The mapped file. */
+    size_t size = 0; /**< The file size in bytes. */
+    bool valid = false; /**< Flag indicating whether the file could be mapped. */
+};
+
+/**
+ * @brief Measures the decode throughput with 1, 2, 4, ... threads up to the number of cores, at most 32, and
+ * prints the speedup and scaling efficiency relative to one thread.
+ * @param capture The capture.
+ */
+static void reportScaling(const MappedCapture &capture) {
+    size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t maxThreads = std::min(cores, scaling_max_threads);
+    std::vector<WorkerResult> results;
+    decodeCapture(capture.records(), capture.count(), 1, results); // Warm the page cache
+    printf("%8s %10s %12s %8s %11s\n", "threads", "seconds", "Mpackets/s", "speedup", "efficiency");
+    double baseRate = 0;
+    for (size_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        double seconds = decodeCapture(capture.records(), capture.count(), threads, results);
+        double rate = seconds > 0 ? static_cast<double>(capture.count()) / seconds : 0;
+        if (threads == 1) {
+            baseRate = rate;
+        }
+        double speedup = baseRate > 0 ? rate / baseRate : 0;
+        printf("%8zu %10.3f %12.2f %8.2f %10.1f%%\n", threads, seconds, rate / 1e6, speedup,
+               100.0 * speedup / static_cast<double>(threads));
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Prints the usage.
+ */
+static void printUsage() {
+    fprintf(stderr, "Usage: atc_batch_decode [-j threads] capture.bin output.atcc\n"
+                    "       atc_batch_decode --scaling capture.bin\n"
+                    "       atc_batch_decode --generate count capture.bin\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "--generate") == 0) {
+        return generateCapture(strtoull(argv[2], nullptr, 10), argv[3]) ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--scaling") == 0) {
+        MappedCapture capture(argv[2]);
+        if (!capture.ok()) {
+            return 1;
+        }
+        reportScaling(capture);
+        return 0;
+    }
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    int arg = 1;
+    if (argc == 5 && strcmp(argv[1], "-j") == 0) {
+        threads = std::max<size_t>(1, strtoul(argv[2], nullptr, 10));
+        arg = 3;
+    } else if (argc != 3) {
+        printUsage();
+        return 1;
+    }
+    MappedCapture capture(argv[arg]);
+    if (!capture.ok()) {
+        return 1;
+    }
+    std::vector<WorkerResult> results;
+    double seconds = decodeCapture(capture.records(), capture.count(), threads, results);
+    uint64_t undecodable = 0;
+    for (const WorkerResult &result: results) {
+        undecodable += result.undecodable;
+    }
+    fprintf(stderr, "%zu records decoded on %zu threads in %.3f s (%.2f Mpackets/s), %llu undecodable\n",
+            capture.count(), threads, seconds, seconds > 0 ? capture.count() / seconds / 1e6 : 0.0,
+            static_cast<unsigned long long>(undecodable));
+    return writeColumnar(argv[arg + 1], results) ? 0 : 1;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file callback_benchmark.cpp
+ * @brief Host tool measuring the per-notification overhead of the callback plumbing of ATC_MiThermometer before and
+ * after the std::function callbacks were replaced: the time per call and the heap allocations per call of
+ * - a characteristic read passing its value to a std::function built per read (before) or to a callable template
+ *   parameter (after, readCharacteristicValue()),
+ * - a reading delivered to a std::function reading callback (setReadingCallback()) or to an ATC_ReadingObserver
+ *   (setReadingObserver()), with a small and a large user state.
+ * ATC_MiThermometer needs NimBLE, so the tool reproduces the dispatch code of both versions on a stand-in for the
+ * thermometer; the decoding done around it is the same in both versions and is left out.
+ *
+ * Build from the repository root:
+ *
+ *     g++ -std=c++11 -O2 -Isrc extras/callback_benchmark/callback_benchmark.cpp -o callback_benchmark
+ *
+ * A std::function whose lambda captures more than its small-object buffer (16 bytes with a 64 bit libstdc++, 8 bytes
+ * on the 32 bit ESP32) allocates each time it is built. The read lambdas of the library only capture this, so the
+ * old read path did not allocate, and the change saves the std::function construction and indirect call per read.
+ * A reading callback allocates once when registered with a large capture, an observer never allocates; calling
+ * either costs one indirect call per reading.
+ */
+#include "ATC_MiThermometer_structs.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+
+static size_t allocations = 0; /**< Number of calls to operator new. */
+
+/**
+ * @brief Counts the allocations of the benchmarked code.
+ * @param size The size to allocate.
+ * @return The allocated memory.
+ */
+void *operator new(size_t size) {
+    allocations++;
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * @brief Frees memory allocated by operator new.
+ * @param memory The memory.
+ */
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Frees memory allocated by operator new.
+ * @param memory The memory.
+ */
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+class Thermometer;
+
+/**
+ * @class Observer
+ * @brief The reading observer interface, as ATC_ReadingObserver.
+ */
+class Observer {
+public:
+    virtual ~Observer() = default;
+
+    /**
+     * @brief Called for every reading.
+     * @param thermometer The thermometer the reading comes from.
+     * @param reading The reading.
+     * @param historical True if the reading was downloaded from the device log.
+     */
+    virtual void onReading(Thermometer &thermometer, const ATC_MiThermometer_Reading &reading, bool historical) = 0;
+};
+
+/**
+ * @class Thermometer
+ * @brief Stand-in for ATC_MiThermometer holding the state touched by the read callbacks and the reading dispatch.
+ */
+class Thermometer {
+public:
+    float humidity = 0.0f; /**< The humidity set by the read callback. */
+    std::function<void(const ATC_MiThermometer_Reading &, bool)> reading_callback; /**< The reading callback. */
+    Observer *reading_observer = nullptr; /**< The reading observer. */
+
+    /**
+     * @brief Reads the value of a characteristic, as readCharacteristic().
+     * @param value Receives the value.
+     * @return True.
+     */
+    __attribute__((noinline)) bool readCharacteristic(std::string &value) {
+        value.assign("\x1c\x12", 2);
+        return true;
+    }
+
+    /**
+     * @brief The read path before: the callback is wrapped in a std::function for every read.
+     * @param callback The callback.
+     */
+    __attribute__((noinline)) void readCharacteristicValueBefore(std::function<void(const std::string &)> callback) {
+        std::string value;
+        if (readCharacteristic(value)) {
+            callback(value);
+        }
+    }
+
+    /**
+     * @brief The read path after: the callback is a template parameter called directly.
+     * @tparam Callback A callable taking a const std::string &.
+     * @param callback The callback.
+     */
+    template<typename Callback>
+    void readCharacteristicValueAfter(Callback &&callback) {
+        std::string value;
+        if (readCharacteristic(value)) {
+            callback(value);
+        }
+    }
+
+    /**
+     * @brief Reads the humidity with the read path before.
+     */
+    __attribute__((noinline)) void getHumidityBefore() {
+        readCharacteristicValueBefore([this](const std::string &value) {
+            humidity = static_cast<float>(static_cast<uint8_t>(value[1]) << 8 | static_cast<uint8_t>(value[0])) /
+                       100.0f;
+        });
+    }
+
+    /**
+     * @brief Reads the humidity with the read path after.
+     */
+    __attribute__((noinline)) void getHumidityAfter() {
+        readCharacteristicValueAfter([this](const std::string &value) {
+            humidity = static_cast<float>(static_cast<uint8_t>(value[1]) << 8 | static_cast<uint8_t>(value[0])) /
+                       100.0f;
+        });
+    }
+
+    /**
+     * @brief Delivers a reading as processReading() does.
+     * @param reading The reading.
+     */
+    __attribute__((noinline)) void dispatch(const ATC_MiThermometer_Reading &reading) {
+        if (reading_callback || reading_observer) {
+            ATC_MiThermometer_Reading timestamped = reading;
+            if (reading_callback) {
+                reading_callback(timestamped, false);
+            }
+            if (reading_observer) {
+                reading_observer->onReading(*this, timestamped, false);
+            }
+        }
+    }
+};
+
+/**
+ * @struct UserState
+ * @brief State of a user handler larger than the small-object buffer of std::function.
+ */
+struct UserState {
+    uint64_t address = 0; /**< Address of the device. */
+    int32_t threshold = 2500; /**< Alert threshold. */
+    int32_t count = 0; /**< Number of readings above the threshold. */
+    int64_t sum = 0; /**< Sum of the temperatures. */
+};
+
+/**
+ * @class CountingObserver
+ * @brief Observer holding the same state as the lambdas of the callbacks.
+ */
+class CountingObserver : public Observer {
+public:
+    UserState state; /**< The user state. */
+
+    /**
+     * @brief Counts the readings above the threshold.
+     * @param thermometer The thermometer the reading comes from.
+     * @param reading The reading.
+     * @param historical True if the reading was downloaded from the device log.
+     */
+    void onReading(Thermometer &, const ATC_MiThermometer_Reading &reading, bool) override {
+        state.sum += reading.temperature;
+        state.count += reading.temperature > state.threshold;
+    }
+};
+
+/**
+ * @brief Times a benchmark and counts its allocations.
+ * @tparam Body Callable run once per iteration.
+ * @param name The name printed.
+ * @param iterations The number of iterations.
+ * @param body The benchmarked code.
+ */
+template<typename Body>
+static void run(const char *name, int iterations, Body &&body) {
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        body(i);
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-44s %6.1f ns/call %6.2f allocations/call\n", name, elapsed / iterations,
+                static_cast<double>(allocations - before) / iterations);
+}
+
+int main() {
+    const int iterations = 2000000;
+    Thermometer thermometer;
+    ATC_MiThermometer_Reading reading{};
+    reading.fields = READING_TEMPERATURE | READING_HUMIDITY;
+
+    run("read, std::function per read (before)", iterations, [&](int) { thermometer.getHumidityBefore(); });
+    run("read, callable template (after)", iterations, [&](int) { thermometer.getHumidityAfter(); });
+
+    // A read callback capturing more than this, as user code passing its own lambda would
+    UserState state;
+    run("read, std::function, large capture (before)", iterations, [&](int) {
+        thermometer.readCharacteristicValueBefore([&thermometer, state](const std::string &value) {
+            thermometer.humidity = static_cast<float>(value[0] + state.threshold);
+        });
+    });
+    run("read, template, large capture (after)", iterations, [&](int) {
+        thermometer.readCharacteristicValueAfter([&thermometer, state](const std::string &value) {
+            thermometer.humidity = static_cast<float>(value[0] + state.threshold);
+        });
+    });
+
+    UserState *shared = &state;
+    thermometer.reading_callback = [shared](const ATC_MiThermometer_Reading &received, bool) {
+        shared->sum += received.temperature;
+        shared->count += received.temperature > shared->threshold;
+    };
+    run("reading, std::function callback", iterations, [&](int i) {
+        reading.temperature = static_cast<int16_t>(i & 0x1FFF);
+        thermometer.dispatch(reading);
+    });
+
+    size_t registration = allocations;
+    thermometer.reading_callback = [state](const ATC_MiThermometer_Reading &received, bool) mutable {
+        state.sum += received.temperature;
+        state.count += received.temperature > state.threshold;
+    };
+    std::printf("%-44s %zu allocations\n", "registering a large std::function callback", allocations - registration);
+    run("reading, std::function, large capture", iterations, [&](int i) {
+        reading.temperature = static_cast<int16_t>(i & 0x1FFF);
+        thermometer.dispatch(reading);
+    });
+
+    thermometer.reading_callback = nullptr;
+    CountingObserver observer;
+    registration = allocations;
+    thermometer.reading_observer = &observer;
+    std::printf("%-44s %zu allocations\n", "registering an observer", allocations - registration);
+    run("reading, observer", iterations, [&](int i) {
+        reading.temperature = static_cast<int16_t>(i & 0x1FFF);
+        thermometer.dispatch(reading);
+    });
+
+    std::printf("checksum %.1f %lld %lld\n", thermometer.humidity,
+                static_cast<long long>(state.sum + observer.state.sum),
+                static_cast<long long>(shared->count + observer.state.count));
+    return 0;
+}
@@ -0,0 +1,278 @@
+/**
+ * @file allocation_test.cpp
+ * @brief Host test checking that the steady-state reading path does not allocate in static allocation mode: hooks
+ * operator new and runs advertisements through the decoder, the calibration, the validation stage, the filter, the
+ * battery forecast, a reading observer, the fleet store, the zone aggregator and the rule engine, in the order
+ * ATC_MiThermometer::processReading() and BLEAdvertisingReader use them, and compact thermometers the same way.
+ * ATC_MiThermometer and BLEAdvertisingReader themselves need NimBLE and FreeRTOS, so the test drives the library
+ * components they are built from; the glue between them copies readings on the stack.
+ *
+ * Build and run from the repository root:
+ *
+ *     g++ -std=c++11 -Wall -DATC_STATIC_ALLOCATION=1 -Isrc extras/host_tests/allocation_test.cpp \
+ *         src/ATC_AdvertisingDecoder.cpp src/ATC_Calibration.cpp src/ATC_ReadingValidator.cpp \
+ *         src/ATC_ReadingFilter.cpp src/ATC_BatteryForecast.cpp src/ATC_FleetStore.cpp src/ATC_ZoneAggregator.cpp \
+ *         src/ATC_RuleEngine.cpp -o allocation_test
+ *     ./allocation_test
+ *
+ * Exits with status 0 if every check passes.
+ */
+#include "ATC_AdvertisingDecoder.h"
+#include "ATC_BatteryForecast.h"
+#include "ATC_Calibration.h"
+#include "ATC_FleetStore.h"
+#include "ATC_ReadingFilter.h"
+#include "ATC_ReadingValidator.h"
+#include "ATC_RuleEngine.h"
+#include "ATC_ZoneAggregator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if !ATC_STATIC_ALLOCATION
+#error "allocation_test checks the static allocation mode, build with -DATC_STATIC_ALLOCATION=1"
+#endif
+
+static int failures = 0; /**< Number of failed checks. */
+static size_t allocations = 0; /**< Number of calls to operator new. */
+
+/** @brief Reports a failed check with its line, and counts it. */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * @brief Counts the allocations.
+ * @param size The size to allocate.
+ * @return The allocated memory.
+ */
+void *operator new(size_t size) {
+    allocations++;
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * @brief Frees memory allocated by operator new.
+ * @param memory The memory.
+ */
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Frees memory allocated by operator new.
+ * @param memory The memory.
+ */
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @class Observer
+ * @brief A reading observer, called like ATC_ReadingObserver.
+ */
+class Observer {
+public:
+    virtual ~Observer() = default;
+
+    /**
+     * @brief Called for every reading.
+     * @param reading The reading.
+     */
+    virtual void onReading(const ATC_MiThermometer_Reading &reading) = 0;
+};
+
+/**
+ * @class CountingObserver
+ * @brief Counts the readings and sums their temperatures.
+ */
+class CountingObserver : public Observer {
+public:
+    size_t count = 0; /**< Number of readings. */
+    int64_t sum = 0; /**< Sum of the temperatures. */
+
+    /**
+     * @brief Counts a reading.
+     * @param reading The reading.
+     */
+    void onReading(const ATC_MiThermometer_Reading &reading) override {
+        count++;
+        sum += reading.temperature;
+    }
+};
+
+/**
+ * @struct Device
+ * @brief The reading pipeline of one thermometer, as held by ATC_MiThermometer.
+ */
+struct Device {
+    uint64_t address; /**< The packed MAC address. */
+    size_t fleet_index; /**< Index in the fleet store. */
+    ATC_ReadingCalibration calibration; /**< Host-side calibration. */
+    ATC_ReadingValidator validator; /**< Validation stage. */
+    ATC_ReadingFilter filter; /**< Smoothing filter. */
+    ATC_BatteryForecast forecast; /**< Battery forecast. */
+    ATC_MiThermometer_Reading last_reading; /**< The merged latest reading. */
+};
+
+/**
+ * @struct Pipeline
+ * @brief The per-reader components fed by the scan.
+ */
+struct Pipeline {
+    ATC_FleetStore fleet{8}; /**< Fleet store. */
+    ATC_ZoneAggregator zones{600000, 4, 8}; /**< Zone aggregator. */
+    ATC_RuleEngine rules{8}; /**< Rule engine. */
+    CountingObserver observer; /**< Reading observer. */
+    size_t alerts = 0; /**< Number of alert events. */
+};
+
+/**
+ * @brief Builds a PVVX advertisement.
+ * @param temperature The temperature in 0.01 degrees Celsius.
+ * @param humidity The humidity in 0.01 percent.
+ * @param batteryMv The battery voltage in mV.
+ * @param packet Receives the 19 byte advertisement.
+ */
+static void buildPvvx(int16_t temperature, uint16_t humidity, uint16_t batteryMv, uint8_t *packet) {
+    const uint8_t header[] = {0x12, 0x16, 0x1A, 0x18, 0x03, 0x02, 0x01, 0x38, 0xC1, 0xA4};
+    for (size_t i = 0; i < sizeof(header); i++) {
+        packet[i] = header[i];
+    }
+    packet[10] = static_cast<uint8_t>(temperature & 0xFF);
+    packet[11] = static_cast<uint8_t>((temperature >> 8) & 0xFF);
+    packet[12] = static_cast<uint8_t>(humidity & 0xFF);
+    packet[13] = static_cast<uint8_t>(humidity >> 8);
+    packet[14] = static_cast<uint8_t>(batteryMv & 0xFF);
+    packet[15] = static_cast<uint8_t>(batteryMv >> 8);
+    packet[16] = 80;
+    packet[17] = 0;
+    packet[18] = 0x04;
+}
+
+/**
+ * @brief Runs an advertisement through the pipeline of a thermometer, then through the per-reader components.
+ * @param device The thermometer.
+ * @param pipeline The per-reader components.
+ * @param packet The advertisement.
+ * @param length The length of the advertisement.
+ * @param nowMs The current millis() timestamp.
+ */
+static void processAdvertisement(Device &device, Pipeline &pipeline, const uint8_t *packet, size_t length,
+                                 uint32_t nowMs) {
+    ATC_MiThermometer_Reading reading{};
+    if (atcDecodeAdvertising(Advertising_Type::PVVX, packet, length, reading)) {
+        return;
+    }
+    device.calibration.apply(reading);
+    if (device.validator.validate(reading, nowMs) && reading.fields == 0) {
+        return;
+    }
+    device.filter.apply(reading);
+    atcMergeReading(device.last_reading, reading);
+    device.last_reading.time = 1700000000 + nowMs / 1000;
+    if ((reading.fields & READING_BATTERY_MV) && !(reading.anomalies & READING_BATTERY_MV)) {
+        device.forecast.addReading(static_cast<uint32_t>(device.last_reading.time), reading.battery_mv,
+                                   device.last_reading.temperature);
+    }
+    pipeline.observer.onReading(reading);
+    pipeline.fleet.update(device.fleet_index, device.last_reading, -60, nowMs);
+    pipeline.zones.expire(nowMs);
+    pipeline.zones.update(device.address, device.last_reading, nowMs);
+    pipeline.rules.poll(nowMs);
+    pipeline.rules.update(device.address, device.last_reading, nowMs);
+}
+
+/**
+ * @brief Checks that readings of registered thermometers and compact thermometers do not allocate once the first
+ * reading of each device went through.
+ */
+static void testSteadyState() {
+    Pipeline pipeline;
+    size_t room = pipeline.zones.addZone("room");
+    ATC_AlertRule rule;
+    rule.id = 1;
+    rule.field = READING_TEMPERATURE;
+    rule.condition = Rule_condition::ABOVE;
+    rule.threshold = 2500;
+    rule.hysteresis = 50;
+    pipeline.rules.addRule(rule);
+    size_t *alerts = &pipeline.alerts;
+    pipeline.rules.setAlertCallback([alerts](const ATC_AlertEvent &) { (*alerts)++; });
+
+    Device devices[2];
+    for (size_t i = 0; i < 2; i++) {
+        Device &device = devices[i];
+        device.address = 0xA4C138000000ULL + i;
+        device.fleet_index = pipeline.fleet.add(device.address);
+        pipeline.zones.assign(device.address, room);
+        ATC_CalibrationCurve curve;
+        curve.type = Calibration_type::PIECEWISE_LINEAR;
+        curve.point_count = 2;
+        curve.raw[0] = 0;
+        curve.raw[1] = 4000;
+        curve.corrected[0] = 50;
+        curve.corrected[1] = 3950;
+        CHECK(device.calibration.setCurve(READING_TEMPERATURE, curve));
+        device.validator.configure(ATC_ValidationConfig());
+        ATC_FilterConfig filter;
+        filter.type = Filter_type::MEDIAN;
+        device.filter.configure(filter);
+        device.last_reading = ATC_MiThermometer_Reading();
+    }
+    ATC_CompactThermometer compact{};
+    compact.format = static_cast<uint8_t>(Advertising_Type::PVVX);
+    pipeline.fleet.update(compact);
+
+    uint8_t packet[19];
+    uint32_t now = 0;
+    // The first reading of each device builds its rule table
+    for (size_t i = 0; i < 2; i++) {
+        buildPvvx(2000, 5000, 3000, packet);
+        processAdvertisement(devices[i], pipeline, packet, sizeof(packet), now);
+    }
+
+    allocations = 0;
+    for (int round = 0; round < 2000; round++) {
+        now += 1000;
+        // A slow swing across the alert threshold, and an occasional spike for the validation stage
+        int16_t temperature = static_cast<int16_t>(2300 + (round % 400 < 200 ? round % 200 : 200 - round % 200) * 2);
+        if (round % 97 == 0) {
+            temperature = 8000;
+        }
+        uint16_t battery = static_cast<uint16_t>(3000 - round / 100);
+        for (Device &device: devices) {
+            buildPvvx(temperature, static_cast<uint16_t>(5000 + round % 7), battery, packet);
+            processAdvertisement(device, pipeline, packet, sizeof(packet), now);
+        }
+        buildPvvx(temperature, 4000, battery, packet);
+        uint8_t decoded = 0;
+        atcUpdateCompactThermometer(compact, packet, sizeof(packet), -70, now, &decoded);
+        if (decoded) {
+            pipeline.fleet.update(compact);
+        }
+    }
+    CHECK(allocations == 0);
+    CHECK(pipeline.observer.count > 4000);
+    CHECK(pipeline.alerts > 0);
+    CHECK(devices[0].validator.getStats().out_of_range + devices[0].validator.getStats().rate_of_change > 0);
+    CHECK(pipeline.zones.temperatureStats(room).count == 2);
+}
+
+int main() {
+    testSteadyState();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,294 @@
+/**
+ * @file async_task_test.cpp
+ * @brief Host test of ATC_Task and the waiter list of ATC_AsyncLoop: nested tasks, conditions, timeouts, locks, and
+ * coroutines suspending again on the loop while it polls. The loop runs on a fake clock.
+ *
+ * Build and run from the repository root, with a compiler supporting C++20 coroutines:
+ *
+ *     g++ -std=c++20 -Wall -Isrc extras/host_tests/async_task_test.cpp src/ATC_Async.cpp -o async_task_test
+ *     ./async_task_test
+ *
+ * Exits with status 0 if every check passes.
+ */
+#include "ATC_Async.h"
+#include <cstdio>
+#include <mutex>
+
+#ifndef ATC_ASYNC_SUPPORTED
+#error "async_task_test needs C++20 coroutines, build with -std=c++20"
+#endif
+
+static int failures = 0; /**< Number of failed checks. */
+static unsigned long fakeNow = 0; /**< Time of the fake clock in milliseconds. */
+
+/** @brief Reports a failed check with its line, and counts it. */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * @brief The fake clock of the loops under test.
+ * @return fakeNow.
+ */
+static unsigned long fakeClock() {
+    return fakeNow;
+}
+
+/**
+ * @brief Waits on a flag, then counts the resumption.
+ * @param loop The loop.
+ * @param flag The flag, true to end the wait.
+ * @param timeoutMs The timeout of the wait.
+ * @param resumes Incremented when the coroutine resumes.
+ * @return The result of the wait, false on timeout.
+ */
+static ATC_Task<bool> waitFlag(ATC_AsyncLoop &loop, const bool &flag, uint32_t timeoutMs, int &resumes) {
+    bool result = co_await loop.until([&flag] { return flag; }, timeoutMs);
+    resumes++;
+    co_return result;
+}
+
+/**
+ * @brief Sleeps without delay a number of times, suspending again on the loop each time it is resumed.
+ * @param loop The loop.
+ * @param count The number of sleeps.
+ * @param wakeups Incremented after each sleep.
+ * @return The number of sleeps.
+ */
+static ATC_Task<int> sleeper(ATC_AsyncLoop &loop, int count, int &wakeups) {
+    for (int i = 0; i < count; i++) {
+        co_await loop.sleep(0);
+        wakeups++;
+    }
+    co_return count;
+}
+
+/**
+ * @brief Sleeps, then returns a value.
+ * @param loop The loop.
+ * @return 42.
+ */
+static ATC_Task<int> inner(ATC_AsyncLoop &loop) {
+    co_await loop.sleep(10);
+    co_return 42;
+}
+
+/**
+ * @brief Awaits inner() and adds one to its result.
+ * @param loop The loop.
+ * @return 43.
+ */
+static ATC_Task<int> outer(ATC_AsyncLoop &loop) {
+    int value = co_await inner(loop);
+    co_return value + 1;
+}
+
+/**
+ * @brief Checks that a task awaiting another one is resumed with its result when it finishes.
+ */
+static void testNestedTasks() {
+    fakeNow = 0;
+    ATC_AsyncLoop loop(fakeClock);
+    ATC_Task<int> task = outer(loop);
+    CHECK(!task.done());
+    task.start();
+    CHECK(!task.done());
+    CHECK(!loop.empty());
+    fakeNow = 9;
+    CHECK(loop.poll() == 0);
+    fakeNow = 10;
+    CHECK(loop.poll() == 1);
+    CHECK(task.done());
+    CHECK(task.result() == 43);
+    CHECK(loop.empty());
+}
+
+/**
+ * @brief Checks that a poll only resumes the waiters whose condition holds or whose timeout expired, and links the
+ * others back into the list.
+ */
+static void testConditionsAndTimeouts() {
+    fakeNow = 100;
+    ATC_AsyncLoop loop(fakeClock);
+    bool flagA = false;
+    bool flagB = false;
+    bool flagC = false;
+    int resumesA = 0;
+    int resumesB = 0;
+    int resumesC = 0;
+    ATC_Task<bool> taskA = waitFlag(loop, flagA, 1000, resumesA);
+    ATC_Task<bool> taskB = waitFlag(loop, flagB, 1000, resumesB);
+    ATC_Task<bool> taskC = waitFlag(loop, flagC, 50, resumesC);
+    taskA.start();
+    taskB.start();
+    taskC.start();
+    CHECK(loop.poll() == 0);
+
+    flagB = true;
+    CHECK(loop.poll() == 1);
+    CHECK(taskB.done() && taskB.result());
+    CHECK(resumesA == 0 && resumesB == 1 && resumesC == 0);
+
+    fakeNow = 150;
+    CHECK(loop.poll() == 1);
+    CHECK(taskC.done() && !taskC.result());
+    CHECK(!taskA.done());
+    CHECK(!loop.empty());
+
+    flagA = true;
+    CHECK(loop.poll() == 1);
+    CHECK(taskA.done() && taskA.result());
+    CHECK(resumesA == 1 && resumesB == 1 && resumesC == 1);
+    CHECK(loop.empty());
+}
+
+/**
+ * @brief Checks that a wait whose condition already holds does not suspend.
+ */
+static void testReadyWait() {
+    fakeNow = 0;
+    ATC_AsyncLoop loop(fakeClock);
+    bool flag = true;
+    int resumes = 0;
+    ATC_Task<bool> task = waitFlag(loop, flag, 1000, resumes);
+    task.start();
+    CHECK(task.done() && task.result());
+    CHECK(resumes == 1);
+    CHECK(loop.empty());
+}
+
+/**
+ * @brief Checks that a coroutine suspending again on the loop while the loop resumes it waits for the next poll,
+ * instead of being resumed again by the same poll.
+ */
+static void testSuspendDuringPoll() {
+    fakeNow = 0;
+    ATC_AsyncLoop loop(fakeClock);
+    int wakeupsA = 0;
+    int wakeupsB = 0;
+    ATC_Task<int> taskA = sleeper(loop, 3, wakeupsA);
+    ATC_Task<int> taskB = sleeper(loop, 2, wakeupsB);
+    taskA.start();
+    taskB.start();
+    CHECK(loop.poll() == 2);
+    CHECK(wakeupsA == 1 && wakeupsB == 1);
+    CHECK(loop.poll() == 2);
+    CHECK(wakeupsA == 2 && wakeupsB == 2);
+    CHECK(taskB.done() && taskB.result() == 2);
+    CHECK(loop.poll() == 1);
+    CHECK(taskA.done() && taskA.result() == 3);
+    CHECK(loop.empty());
+    CHECK(loop.poll() == 0);
+}
+
+/**
+ * @struct FakeMutex
+ * @brief A mutex held by another task as long as its flag is set.
+ */
+struct FakeMutex {
+    bool heldElsewhere = false; /**< Flag telling that another task holds the mutex. */
+    int holders = 0; /**< Number of locks taken through this mutex. */
+
+    /** @brief Takes the mutex, which must be free. */
+    void lock() { holders++; }
+
+    /**
+     * @brief Takes the mutex if it is free.
+     * @return True if the mutex was taken.
+     */
+    bool try_lock() {
+        if (heldElsewhere) {
+            return false;
+        }
+        holders++;
+        return true;
+    }
+
+    /** @brief Releases the mutex. */
+    void unlock() { holders--; }
+};
+
+/**
+ * @brief Takes a mutex on the loop, then sleeps while holding it.
+ * @param loop The loop.
+ * @param mutex The mutex.
+ * @param timeoutMs The timeout of the wait for the mutex.
+ * @return True if the mutex was taken.
+ */
+static ATC_Task<bool> lockAndSleep(ATC_AsyncLoop &loop, FakeMutex &mutex, uint32_t timeoutMs) {
+    std::unique_lock<FakeMutex> lock(mutex, std::defer_lock);
+    if (!co_await loop.lock(lock, timeoutMs)) {
+        co_return false;
+    }
+    co_await loop.sleep(10);
+    co_return lock.owns_lock();
+}
+
+/**
+ * @brief Checks that a coroutine waits for a mutex held elsewhere without blocking the loop, takes it once, keeps it
+ * across its next suspension and releases it when it finishes, and that the wait for the mutex can time out.
+ */
+static void testLock() {
+    fakeNow = 0;
+    ATC_AsyncLoop loop(fakeClock);
+    FakeMutex mutex;
+    mutex.heldElsewhere = true;
+    ATC_Task<bool> task = lockAndSleep(loop, mutex, 1000);
+    task.start();
+    CHECK(!task.done());
+    CHECK(loop.poll() == 0);
+    mutex.heldElsewhere = false;
+    CHECK(loop.poll() == 1);
+    CHECK(mutex.holders == 1);
+    fakeNow = 10;
+    CHECK(loop.poll() == 1);
+    CHECK(task.done() && task.result());
+    CHECK(mutex.holders == 0);
+
+    ATC_Task<bool> free = lockAndSleep(loop, mutex, 1000);
+    free.start();
+    CHECK(mutex.holders == 1);
+    fakeNow = 20;
+    CHECK(loop.poll() == 1);
+    CHECK(free.done() && free.result());
+
+    mutex.heldElsewhere = true;
+    ATC_Task<bool> timeout = lockAndSleep(loop, mutex, 50);
+    timeout.start();
+    fakeNow = 70;
+    CHECK(loop.poll() == 1);
+    CHECK(timeout.done() && !timeout.result());
+    CHECK(mutex.holders == 0);
+    CHECK(loop.empty());
+}
+
+/**
+ * @brief Checks that run() returns once every coroutine finished, with the default clock.
+ */
+static void testRun() {
+    ATC_AsyncLoop loop;
+    ATC_Task<int> task = outer(loop);
+    task.start();
+    loop.run();
+    CHECK(task.done() && task.result() == 43);
+    CHECK(loop.empty());
+}
+
+int main() {
+    testNestedTasks();
+    testConditionsAndTimeouts();
+    testReadyWait();
+    testSuspendDuringPoll();
+    testLock();
+    testRun();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file decoder_test.cpp
+ * @brief Host test of the advertising decoders and the format detector: decodes ATC1441, PVVX and BTHome packets,
+ * negative BTHome temperatures, truncated objects, detection of each format, and the compact thermometer update.
+ *
+ * Build and run from the repository root:
+ *
+ *     g++ -std=c++11 -Wall -Isrc extras/host_tests/decoder_test.cpp src/ATC_AdvertisingDecoder.cpp -o decoder_test
+ *     ./decoder_test
+ *
+ * Exits with status 0 if every check passes.
+ */
+#include "ATC_AdvertisingDecoder.h"
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0; /**< Number of failed checks. */
+
+/** @brief Reports a failed check with its line, and counts it. */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+/** @brief ATC1441 advertisement: 21.5 degrees, 47 %, 88 %, 2950 mV, followed by a zero byte of padding. */
+static const uint8_t atc1441Packet[] = {0x10, 0x16, 0x1A, 0x18, 0xA4, 0xC1, 0x38, 0x01, 0x02, 0x03,
+                                        0x00, 0xD7, 0x2F, 0x58, 0x0B, 0x86, 0x07, 0x00};
+
+/** @brief PVVX advertisement: -12.34 degrees, 56.78 %, 2987 mV, 91 %. */
+static const uint8_t pvvxPacket[] = {0x12, 0x16, 0x1A, 0x18, 0x03, 0x02, 0x01, 0x38, 0xC1, 0xA4,
+                                     0x2E, 0xFB, 0x2E, 0x16, 0xAB, 0x0B, 0x5B, 0x07, 0x04};
+
+/** @brief BTHome v2 advertisement after a flags element: packet id, 90 %, -5.25 degrees, 43.21 %, 3012 mV. */
+static const uint8_t bthomePacket[] = {0x02, 0x01, 0x06, 0x11, 0x16, 0xD2, 0xFC, 0x40, 0x00, 0x05, 0x01,
+                                       0x5A, 0x02, 0xF3, 0xFD, 0x03, 0xE1, 0x10, 0x0C, 0xC4, 0x0B};
+
+/**
+ * @brief Checks the ATC1441 decoder, which reads the temperature in 0.1 degrees, big endian.
+ */
+static void testATC1441() {
+    ATC_MiThermometer_Reading reading{};
+    CHECK(atcDecodeATC1441(atc1441Packet, sizeof(atc1441Packet), reading) == nullptr);
+    CHECK(reading.temperature == 2150);
+    CHECK(reading.humidity == 4700);
+    CHECK(reading.battery_level == 88);
+    CHECK(reading.battery_mv == 2950);
+    CHECK(reading.fields == (READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV | READING_BATTERY_LEVEL));
+    ATC_MiThermometer_Reading shortReading{};
+    CHECK(atcDecodeATC1441(atc1441Packet, 10, shortReading) != nullptr);
+    CHECK(shortReading.fields == 0);
+}
+
+/**
+ * @brief Checks the PVVX decoder, with a negative temperature, and its rejection of foreign packets.
+ */
+static void testPVVX() {
+    ATC_MiThermometer_Reading reading{};
+    CHECK(atcDecodePVVX(pvvxPacket, sizeof(pvvxPacket), reading) == nullptr);
+    CHECK(reading.temperature == -1234);
+    CHECK(reading.humidity == 5678);
+    CHECK(reading.battery_mv == 2987);
+    CHECK(reading.battery_level == 91);
+    uint8_t foreign[sizeof(pvvxPacket)];
+    memcpy(foreign, pvvxPacket, sizeof(foreign));
+    foreign[2] = 0x1B;
+    ATC_MiThermometer_Reading rejected{};
+    CHECK(atcDecodePVVX(foreign, sizeof(foreign), rejected) != nullptr);
+    CHECK(rejected.fields == 0);
+}
+
+/**
+ * @brief Checks the BTHome decoder: every object, a negative temperature read as signed, and a truncated object
+ * reported as an error while the objects before it are kept.
+ */
+static void testBTHome() {
+    ATC_MiThermometer_Reading reading{};
+    CHECK(atcDecodeBTHome(bthomePacket, sizeof(bthomePacket), reading) == nullptr);
+    CHECK(reading.temperature == -525);
+    CHECK(reading.humidity == 4321);
+    CHECK(reading.battery_level == 90);
+    CHECK(reading.battery_mv == 3012);
+    CHECK(reading.fields == (READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV | READING_BATTERY_LEVEL));
+
+    // Cut the packet in the middle of the temperature object, the element length now exceeds the packet
+    ATC_MiThermometer_Reading cut{};
+    CHECK(atcDecodeBTHome(bthomePacket, 14, cut) != nullptr);
+
+    // Shorten the element instead, so the temperature object itself is truncated
+    uint8_t truncated[14];
+    memcpy(truncated, bthomePacket, sizeof(truncated));
+    truncated[3] = 0x0A;
+    ATC_MiThermometer_Reading partial{};
+    CHECK(atcDecodeBTHome(truncated, sizeof(truncated), partial) != nullptr);
+    CHECK(partial.fields == READING_BATTERY_LEVEL);
+    CHECK(partial.battery_level == 90);
+}
+
+/**
+ * @brief Checks the detection of each format, of encrypted BTHome, and of packets without a known service data.
+ */
+static void testDetector() {
+    Advertising_Type type = Advertising_Type::XIAOMI;
+    CHECK(atcDetectAdvertisingType(atc1441Packet, sizeof(atc1441Packet), type) == nullptr);
+    CHECK(type == Advertising_Type::ATC1441);
+    CHECK(atcDetectAdvertisingType(pvvxPacket, sizeof(pvvxPacket), type) == nullptr);
+    CHECK(type == Advertising_Type::PVVX);
+    CHECK(atcDetectAdvertisingType(bthomePacket, sizeof(bthomePacket), type) == nullptr);
+    CHECK(type == Advertising_Type::BTHOME);
+
+    uint8_t encrypted[sizeof(bthomePacket)];
+    memcpy(encrypted, bthomePacket, sizeof(encrypted));
+    encrypted[7] = 0x41;
+    type = Advertising_Type::XIAOMI;
+    CHECK(atcDetectAdvertisingType(encrypted, sizeof(encrypted), type) != nullptr);
+    CHECK(type == Advertising_Type::XIAOMI);
+
+    const uint8_t flagsOnly[] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x1A, 0x18};
+    CHECK(atcDetectAdvertisingType(flagsOnly, sizeof(flagsOnly), type) != nullptr);
+    // An element running past the end of the packet stops the detection
+    const uint8_t overrun[] = {0x02, 0x01, 0x06, 0x20, 0x16, 0x1A, 0x18};
+    CHECK(atcDetectAdvertisingType(overrun, sizeof(overrun), type) != nullptr);
+    CHECK(type == Advertising_Type::XIAOMI);
+}
+
+/**
+ * @brief Checks the compact thermometer update: a packet without a measurement reports no decoded field and leaves
+ * the entry untouched, and a measurement updates the fields, the RSSI and the time it was seen.
+ */
+static void testCompactUpdate() {
+    ATC_CompactThermometer thermometer{};
+    thermometer.format = static_cast<uint8_t>(Advertising_Type::BTHOME);
+    const uint8_t noMeasurement[] = {0x02, 0x01, 0x06, 0x05, 0x16, 0xD2, 0xFC, 0x40, 0x00, 0x05};
+    uint8_t decoded = 0xFF;
+    CHECK(atcUpdateCompactThermometer(thermometer, noMeasurement, sizeof(noMeasurement), -60, 1000, &decoded) !=
+          nullptr);
+    CHECK(decoded == 0);
+    CHECK(thermometer.fields == 0);
+    CHECK(thermometer.last_seen == 0);
+
+    CHECK(atcUpdateCompactThermometer(thermometer, bthomePacket, sizeof(bthomePacket), -61, 2000, &decoded) ==
+          nullptr);
+    CHECK(decoded == (READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV | READING_BATTERY_LEVEL));
+    CHECK(thermometer.temperature == -525);
+    CHECK(thermometer.humidity == 4321);
+    CHECK(thermometer.rssi == -61);
+    CHECK(thermometer.last_seen == 2000);
+
+    // A timestamp of 0 is stored as 1, since 0 means never seen
+    CHECK(atcUpdateCompactThermometer(thermometer, bthomePacket, sizeof(bthomePacket), -62, 0, &decoded) == nullptr);
+    CHECK(thermometer.last_seen == 1);
+}
+
+/**
+ * @brief Checks that merging a reading copies its fields and replaces the anomaly flags of those fields only.
+ */
+static void testMerge() {
+    ATC_MiThermometer_Reading target{};
+    target.temperature = 2000;
+    target.humidity = 5000;
+    target.fields = READING_TEMPERATURE | READING_HUMIDITY;
+    target.anomalies = READING_TEMPERATURE | READING_HUMIDITY;
+    ATC_MiThermometer_Reading source{};
+    source.temperature = 2100;
+    source.battery_mv = 3000;
+    source.fields = READING_TEMPERATURE | READING_BATTERY_MV;
+    source.anomalies = READING_BATTERY_MV;
+    atcMergeReading(target, source);
+    CHECK(target.temperature == 2100);
+    CHECK(target.humidity == 5000);
+    CHECK(target.battery_mv == 3000);
+    CHECK(target.fields == (READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV));
+    CHECK(target.anomalies == (READING_HUMIDITY | READING_BATTERY_MV));
+}
+
+int main() {
+    testATC1441();
+    testPVVX();
+    testBTHome();
+    testDetector();
+    testCompactUpdate();
+    testMerge();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file ota_packet_test.cpp
+ * @brief Host test of the Telink OTA checksums and packet format: checks the CRCs against their reference check
+ * values, and the layout, padding and CRC of built packets.
+ *
+ * Build and run from the repository root:
+ *
+ *     g++ -std=c++11 -Wall -Isrc extras/host_tests/ota_packet_test.cpp src/ATC_OtaPacket.cpp -o ota_packet_test
+ *     ./ota_packet_test
+ *
+ * Exits with status 0 if every check passes.
+ */
+#include "ATC_OtaPacket.h"
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0; /**< Number of failed checks. */
+
+/** @brief Reports a failed check with its line, and counts it. */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * @brief Checks the CRCs against the check values of their catalogued variants: CRC-16/MODBUS and CRC-32/ISO-HDLC
+ * of "123456789".
+ */
+static void testCrcCheckValues() {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    CHECK(atcOtaCrc16(check, sizeof(check)) == 0x4B37);
+    CHECK(atcOtaCrc32(check, sizeof(check)) == 0xCBF43926);
+    CHECK(atcOtaCrc16(check, 0) == 0xFFFF);
+    CHECK(atcOtaCrc32(check, 0) == 0);
+}
+
+/**
+ * @brief Checks that the CRC32 of an image computed in chunks, as ATC_OtaUpdater reads it, equals the CRC32 of the
+ * whole image.
+ */
+static void testCrc32Chunks() {
+    uint8_t image[1000];
+    for (size_t i = 0; i < sizeof(image); i++) {
+        image[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    uint32_t whole = atcOtaCrc32(image, sizeof(image));
+    uint32_t chunked = 0;
+    for (size_t offset = 0; offset < sizeof(image); offset += 64) {
+        size_t length = sizeof(image) - offset < 64 ? sizeof(image) - offset : 64;
+        chunked = atcOtaCrc32(image + offset, length, chunked);
+    }
+    CHECK(chunked == whole);
+}
+
+/**
+ * @brief Checks a full packet: the little endian index, the data, and a CRC16 over both, after which the CRC of the
+ * whole packet is 0 as for any CRC-16/MODBUS frame.
+ */
+static void testFullPacket() {
+    uint8_t data[ota_packet_data_size];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(0x10 + i);
+    }
+    uint8_t packet[ota_packet_size];
+    atcOtaBuildPacket(0x1234, data, sizeof(data), packet);
+    CHECK(packet[0] == 0x34);
+    CHECK(packet[1] == 0x12);
+    CHECK(memcmp(&packet[2], data, sizeof(data)) == 0);
+    uint16_t crc = atcOtaCrc16(packet, ota_packet_data_size + 2);
+    CHECK(packet[ota_packet_data_size + 2] == (crc & 0xFF));
+    CHECK(packet[ota_packet_data_size + 3] == (crc >> 8));
+    CHECK(atcOtaCrc16(packet, sizeof(packet)) == 0);
+}
+
+/**
+ * @brief Checks the last packet of an image, shorter than ota_packet_data_size, which is padded with 0xFF before the
+ * CRC, and that data longer than a packet is truncated.
+ */
+static void testPaddingAndTruncation() {
+    const uint8_t data[] = {0xAA, 0xBB, 0xCC};
+    uint8_t packet[ota_packet_size];
+    memset(packet, 0, sizeof(packet));
+    atcOtaBuildPacket(7, data, sizeof(data), packet);
+    CHECK(packet[0] == 7 && packet[1] == 0);
+    CHECK(packet[2] == 0xAA && packet[3] == 0xBB && packet[4] == 0xCC);
+    bool padded = true;
+    for (size_t i = 2 + sizeof(data); i < ota_packet_data_size + 2; i++) {
+        padded = padded && packet[i] == 0xFF;
+    }
+    CHECK(padded);
+    CHECK(atcOtaCrc16(packet, sizeof(packet)) == 0);
+
+    uint8_t longData[ota_packet_data_size + 8];
+    memset(longData, 0x55, sizeof(longData));
+    uint8_t truncated[ota_packet_size + 8];
+    memset(truncated, 0, sizeof(truncated));
+    atcOtaBuildPacket(0xFFFF, longData, sizeof(longData), truncated);
+    CHECK(truncated[0] == 0xFF && truncated[1] == 0xFF);
+    CHECK(atcOtaCrc16(truncated, ota_packet_size) == 0);
+    CHECK(truncated[ota_packet_size] == 0);
+}
+
+int main() {
+    testCrcCheckValues();
+    testCrc32Chunks();
+    testFullPacket();
+    testPaddingAndTruncation();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,283 @@
+/**
+ * @file ota_transfer_test.cpp
+ * @brief Host test of the OTA packet stream sent by ATC_OtaUpdater, against a simulated peripheral: bursts and their
+ * writes with response, rewinds after failed writes, the failed burst limit, restarts and the end command.
+ *
+ * Build and run from the repository root:
+ *
+ *     g++ -std=c++11 -Wall -Isrc extras/host_tests/ota_transfer_test.cpp src/ATC_OtaPacket.cpp -o ota_transfer_test
+ *     ./ota_transfer_test
+ *
+ * Exits with status 0 if every check passes.
+ */
+#include "ATC_OtaPacket.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static int failures = 0; /**< Number of failed checks. */
+
+/** @brief Reports a failed check with its line, and counts it. */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * @struct FakeImage
+ * @brief A firmware image read like fs::File.
+ */
+struct FakeImage {
+    std::vector<uint8_t> data; /**< The image. */
+    size_t position = 0; /**< The read position. */
+
+    /**
+     * @brief Reads from the current position.
+     * @param buffer The buffer.
+     * @param length The size of the buffer.
+     * @return The number of bytes read, 0 at the end of the image.
+     */
+    size_t read(uint8_t *buffer, size_t length) {
+        size_t count = position < data.size() ? std::min(length, data.size() - position) : 0;
+        memcpy(buffer, data.data() + position, count);
+        position += count;
+        return count;
+    }
+};
+
+/**
+ * @struct FakePeripheral
+ * @brief A Telink OTA characteristic which checks and stores the packets it receives. Writes can be made to fail.
+ */
+struct FakePeripheral {
+    std::vector<uint8_t> image; /**< The received image, padded to whole packets. */
+    std::vector<uint16_t> indexes; /**< Indexes of the accepted packets, in order. */
+    std::vector<bool> responses; /**< Whether each accepted packet was written with response. */
+    std::vector<uint8_t> end; /**< The end command, empty until received. */
+    size_t writes = 0; /**< Number of writes, failed or not. */
+    std::vector<size_t> failing; /**< Numbers of the writes that fail, counting from 1. */
+    bool failAll = false; /**< Flag making every write fail. */
+    bool badCrc = false; /**< Flag set if a packet had a wrong CRC. */
+
+    /**
+     * @brief Receives a write.
+     * @param data The written value.
+     * @param length The length of the value.
+     * @param withResponse True for a write with response.
+     * @return False if the write fails.
+     */
+    bool write(const uint8_t *data, size_t length, bool withResponse) {
+        writes++;
+        if (failAll || std::find(failing.begin(), failing.end(), writes) != failing.end()) {
+            return false;
+        }
+        if (length == ota_end_command_size) {
+            end.assign(data, data + length);
+            return true;
+        }
+        if (length != ota_packet_size) {
+            return false;
+        }
+        badCrc = badCrc || atcOtaCrc16(data, length) != 0;
+        uint16_t index = static_cast<uint16_t>(data[0] | data[1] << 8);
+        size_t offset = static_cast<size_t>(index) * ota_packet_data_size;
+        if (image.size() < offset + ota_packet_data_size) {
+            image.resize(offset + ota_packet_data_size);
+        }
+        memcpy(&image[offset], data + 2, ota_packet_data_size);
+        indexes.push_back(index);
+        responses.push_back(withResponse);
+        return true;
+    }
+};
+
+/**
+ * @brief Builds an image of a number of bytes.
+ * @param size The size of the image.
+ * @return The image.
+ */
+static FakeImage makeImage(size_t size) {
+    FakeImage image;
+    for (size_t i = 0; i < size; i++) {
+        image.data.push_back(static_cast<uint8_t>(i * 13 + 5));
+    }
+    return image;
+}
+
+/**
+ * @brief Starts a transfer of an image.
+ * @param image The image.
+ * @return The progress of the transfer.
+ */
+static ATC_OtaProgress startTransfer(FakeImage &image) {
+    ATC_OtaProgress progress{};
+    progress.packet_count = static_cast<uint16_t>((image.data.size() + ota_packet_data_size - 1) /
+                                                  ota_packet_data_size);
+    atcOtaRestart(progress);
+    image.position = 0;
+    return progress;
+}
+
+/**
+ * @brief Sends one burst from an image to a peripheral.
+ * @param progress The progress of the transfer.
+ * @param image The image.
+ * @param peripheral The peripheral.
+ * @param syncInterval The number of packets per burst.
+ * @param maxFailedBursts The number of bursts in a row that may fail.
+ * @return The outcome of the burst.
+ */
+static Ota_burst_result burst(ATC_OtaProgress &progress, FakeImage &image, FakePeripheral &peripheral,
+                              uint8_t syncInterval, uint8_t maxFailedBursts = 3) {
+    return atcOtaSendBurst(
+            progress, syncInterval, maxFailedBursts,
+            [&image](uint8_t *data, size_t length) { return image.read(data, length); },
+            [&image](size_t offset) { image.position = offset; },
+            [&peripheral](const uint8_t *data, size_t length, bool withResponse) {
+                return peripheral.write(data, length, withResponse);
+            });
+}
+
+/**
+ * @brief Checks that the peripheral received the image followed by 0xFF padding.
+ * @param peripheral The peripheral.
+ * @param image The image.
+ * @return True if the received image matches.
+ */
+static bool receivedImage(const FakePeripheral &peripheral, const FakeImage &image) {
+    if (peripheral.image.size() < image.data.size() ||
+        memcmp(peripheral.image.data(), image.data.data(), image.data.size()) != 0) {
+        return false;
+    }
+    for (size_t i = image.data.size(); i < peripheral.image.size(); i++) {
+        if (peripheral.image[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks a transfer without errors: the bursts, the packets written with response, and the end command.
+ */
+static void testCleanTransfer() {
+    FakeImage image = makeImage(100);
+    FakePeripheral peripheral;
+    ATC_OtaProgress progress = startTransfer(image);
+    CHECK(progress.packet_count == 7);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::SENT);
+    CHECK(progress.next_packet == 3 && progress.confirmed_packet == 3);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::SENT);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::COMPLETE);
+    CHECK(progress.confirmed_packet == 7);
+
+    const uint16_t expectedIndexes[] = {0, 1, 2, 3, 4, 5, 6};
+    const bool expectedResponses[] = {false, false, true, false, false, true, true};
+    CHECK(peripheral.indexes == std::vector<uint16_t>(expectedIndexes, expectedIndexes + 7));
+    CHECK(peripheral.responses == std::vector<bool>(expectedResponses, expectedResponses + 7));
+    CHECK(!peripheral.badCrc);
+    CHECK(receivedImage(peripheral, image));
+    const uint8_t expectedEnd[] = {0x02, 0xFF, 0x06, 0x00, 0xF9, 0xFF};
+    CHECK(peripheral.end == std::vector<uint8_t>(expectedEnd, expectedEnd + sizeof(expectedEnd)));
+}
+
+/**
+ * @brief Checks that a failed write resends the burst from the last confirmed packet, and that a confirmed burst
+ * clears the count of failed bursts.
+ */
+static void testRewind() {
+    FakeImage image = makeImage(100);
+    FakePeripheral peripheral;
+    peripheral.failing.push_back(5); // Packet 4, in the middle of the second burst
+    ATC_OtaProgress progress = startTransfer(image);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::SENT);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::REWOUND);
+    CHECK(progress.next_packet == 3 && progress.confirmed_packet == 3);
+    CHECK(progress.failed_bursts == 1);
+    CHECK(image.position == 3 * ota_packet_data_size);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::SENT);
+    CHECK(progress.failed_bursts == 0);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::COMPLETE);
+
+    const uint16_t expectedIndexes[] = {0, 1, 2, 3, 3, 4, 5, 6};
+    CHECK(peripheral.indexes == std::vector<uint16_t>(expectedIndexes, expectedIndexes + 8));
+    CHECK(!peripheral.badCrc);
+    CHECK(receivedImage(peripheral, image));
+    CHECK(peripheral.end.size() == ota_end_command_size);
+}
+
+/**
+ * @brief Checks that writes failing burst after burst fail the transfer after maxFailedBursts bursts.
+ */
+static void testFailedBurstLimit() {
+    FakeImage image = makeImage(100);
+    FakePeripheral peripheral;
+    ATC_OtaProgress progress = startTransfer(image);
+    CHECK(burst(progress, image, peripheral, 3) == Ota_burst_result::SENT);
+    peripheral.failAll = true;
+    CHECK(burst(progress, image, peripheral, 3, 3) == Ota_burst_result::REWOUND);
+    CHECK(burst(progress, image, peripheral, 3, 3) == Ota_burst_result::REWOUND);
+    CHECK(burst(progress, image, peripheral, 3, 3) == Ota_burst_result::WRITE_FAILED);
+    CHECK(progress.confirmed_packet == 3);
+    CHECK(peripheral.end.empty());
+}
+
+/**
+ * @brief Checks that a restarted transfer starts again from the first packet.
+ */
+static void testRestart() {
+    FakeImage image = makeImage(64);
+    FakePeripheral peripheral;
+    ATC_OtaProgress progress = startTransfer(image);
+    CHECK(burst(progress, image, peripheral, 2) == Ota_burst_result::SENT);
+    peripheral.failAll = true;
+    CHECK(burst(progress, image, peripheral, 2, 1) == Ota_burst_result::WRITE_FAILED);
+
+    // A new connection, as after failAttempt()
+    FakePeripheral reconnected;
+    atcOtaRestart(progress);
+    image.position = 0;
+    CHECK(progress.next_packet == 0 && progress.confirmed_packet == 0 && progress.failed_bursts == 0);
+    CHECK(burst(progress, image, reconnected, 2) == Ota_burst_result::SENT);
+    CHECK(burst(progress, image, reconnected, 2) == Ota_burst_result::COMPLETE);
+    const uint16_t expectedIndexes[] = {0, 1, 2, 3};
+    CHECK(reconnected.indexes == std::vector<uint16_t>(expectedIndexes, expectedIndexes + 4));
+    CHECK(receivedImage(reconnected, image));
+}
+
+/**
+ * @brief Checks the errors of the image and of the end command.
+ */
+static void testReadAndEndFailures() {
+    FakeImage image = makeImage(100);
+    FakePeripheral peripheral;
+    ATC_OtaProgress progress = startTransfer(image);
+    image.data.resize(40); // The image is shorter than its packet count
+    CHECK(burst(progress, image, peripheral, 8) == Ota_burst_result::READ_FAILED);
+
+    FakeImage shortImage = makeImage(20);
+    FakePeripheral endless;
+    endless.failing.push_back(3); // The end command, after two packets
+    ATC_OtaProgress endProgress = startTransfer(shortImage);
+    CHECK(burst(endProgress, shortImage, endless, 8) == Ota_burst_result::END_FAILED);
+    CHECK(endProgress.confirmed_packet == 2);
+    CHECK(endless.end.empty());
+}
+
+int main() {
+    testCleanTransfer();
+    testRewind();
+    testFailedBurstLimit();
+    testRestart();
+    testReadAndEndFailures();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
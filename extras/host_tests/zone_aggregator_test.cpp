@@ -0,0 +1,133 @@
+/**
+ * @file zone_aggregator_test.cpp
+ * @brief Host test of ATC_ZoneAggregator: aggregates of nested zones, devices moving between zones with their values,
+ * and stale devices leaving the aggregates.
+ *
+ * Build and run from the repository root:
+ *
+ *     g++ -std=c++11 -Wall -Isrc extras/host_tests/zone_aggregator_test.cpp src/ATC_ZoneAggregator.cpp \
+ *         -o zone_aggregator_test
+ *     ./zone_aggregator_test
+ *
+ * Exits with status 0 if every check passes.
+ */
+#include "ATC_ZoneAggregator.h"
+#include <cstdio>
+
+static int failures = 0; /**< Number of failed checks. */
+
+/** @brief Reports a failed check with its line, and counts it. */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * @brief Builds a reading with a temperature and a humidity.
+ * @param temperature The temperature in 0.01 degrees Celsius.
+ * @param humidity The humidity in 0.01 percent.
+ * @return The reading.
+ */
+static ATC_MiThermometer_Reading makeReading(int16_t temperature, uint16_t humidity) {
+    ATC_MiThermometer_Reading reading{};
+    reading.temperature = temperature;
+    reading.humidity = humidity;
+    reading.fields = READING_TEMPERATURE | READING_HUMIDITY;
+    return reading;
+}
+
+/**
+ * @brief Checks that a zone includes the devices of the zones it contains.
+ */
+static void testNestedZones() {
+    ATC_ZoneAggregator aggregator;
+    size_t house = aggregator.addZone("house");
+    size_t kitchen = aggregator.addZone("kitchen", house);
+    size_t bedroom = aggregator.addZone("bedroom", house);
+    CHECK(aggregator.findZone("bedroom") == bedroom);
+    CHECK(aggregator.addZone("attic", 42) == ATC_ZoneAggregator::no_zone);
+    aggregator.assign(1, kitchen);
+    aggregator.assign(2, bedroom);
+    aggregator.update(1, makeReading(2000, 5000), 0);
+    aggregator.update(2, makeReading(2200, 4000), 0);
+    ATC_ZoneStats stats = aggregator.temperatureStats(house);
+    CHECK(stats.count == 2);
+    CHECK(stats.min == 2000 && stats.max == 2200);
+    CHECK(stats.mean == 2100.0f);
+    CHECK(stats.deviation == 100.0f);
+    CHECK(aggregator.humidityStats(kitchen).count == 1);
+    CHECK(aggregator.humidityStats(kitchen).max == 5000);
+}
+
+/**
+ * @brief Checks that moving a device takes all its values from the old zone to the new one, and leaves the zone
+ * containing both unchanged.
+ */
+static void testMoveBetweenZones() {
+    ATC_ZoneAggregator aggregator;
+    size_t house = aggregator.addZone("house");
+    size_t kitchen = aggregator.addZone("kitchen", house);
+    size_t bedroom = aggregator.addZone("bedroom", house);
+    aggregator.assign(1, kitchen);
+    aggregator.assign(2, bedroom);
+    aggregator.update(1, makeReading(2000, 5000), 0);
+    aggregator.update(2, makeReading(2200, 4000), 0);
+
+    CHECK(aggregator.assign(1, bedroom));
+    CHECK(aggregator.temperatureStats(kitchen).count == 0);
+    CHECK(aggregator.humidityStats(kitchen).count == 0);
+    ATC_ZoneStats temperature = aggregator.temperatureStats(bedroom);
+    ATC_ZoneStats humidity = aggregator.humidityStats(bedroom);
+    CHECK(temperature.count == 2);
+    CHECK(temperature.min == 2000 && temperature.max == 2200);
+    CHECK(humidity.count == 2);
+    CHECK(humidity.min == 4000 && humidity.max == 5000);
+    CHECK(aggregator.temperatureStats(house).count == 2);
+    CHECK(aggregator.humidityStats(house).count == 2);
+
+    // Moving to the same zone again changes nothing
+    CHECK(aggregator.assign(1, bedroom));
+    CHECK(aggregator.humidityStats(bedroom).count == 2);
+
+    // The moved device is updated in its new zone
+    aggregator.update(1, makeReading(1800, 4500), 10);
+    CHECK(aggregator.temperatureStats(bedroom).min == 1800);
+    CHECK(aggregator.temperatureStats(kitchen).count == 0);
+    CHECK(!aggregator.assign(1, 42));
+}
+
+/**
+ * @brief Checks that stale devices leave the aggregates, and come back with their next reading.
+ */
+static void testExpire() {
+    ATC_ZoneAggregator aggregator(1000);
+    size_t room = aggregator.addZone("room");
+    aggregator.assign(1, room);
+    aggregator.assign(2, room);
+    aggregator.update(1, makeReading(2000, 5000), 0);
+    aggregator.update(2, makeReading(2400, 5200), 500);
+    CHECK(aggregator.expire(999) == 0);
+    CHECK(aggregator.expire(1000) == 1);
+    ATC_ZoneStats stats = aggregator.temperatureStats(room);
+    CHECK(stats.count == 1);
+    CHECK(stats.min == 2400 && stats.max == 2400);
+    aggregator.update(1, makeReading(2100, 5000), 1200);
+    CHECK(aggregator.temperatureStats(room).count == 2);
+    CHECK(aggregator.expire(2500) == 2);
+    CHECK(aggregator.temperatureStats(room).count == 0);
+}
+
+int main() {
+    testNestedZones();
+    testMoveBetweenZones();
+    testExpire();
+    if (failures) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file psychrometrics_benchmark.cpp
+ * @brief Host tool comparing the table-driven psychrometric functions with the libm versions: reports the largest
+ * error of each metric over the table range and the time per call of both versions.
+ *
+ * Build from the repository root:
+ *
+ *     g++ -std=c++11 -O2 -Isrc extras/psychrometrics_benchmark/psychrometrics_benchmark.cpp \
+ *         src/ATC_Psychrometrics.cpp -o psychrometrics_benchmark
+ *
+ * The timings do not carry over to an ESP32, whose FPU is single precision and has no hardware exp() or log(). On a
+ * host libm is faster than the table, which is why the library uses libm unless ATC_PSYCHROMETRICS_TABLE is set.
+ * Time both versions on the target, for example by running the same loops from a sketch, before enabling it.
+ */
+#include "ATC_Psychrometrics.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/**
+ * @struct Sample
+ * @brief A temperature and relative humidity pair.
+ */
+struct Sample {
+    float temperature; /**< Temperature in degrees Celsius. */
+    float humidity; /**< Relative humidity in percent. */
+};
+
+/**
+ * @brief Times a psychrometric function over the samples.
+ * @param function The function.
+ * @param samples The samples.
+ * @param rounds The number of passes over the samples.
+ * @return The time per call in nanoseconds.
+ */
+static double timeFunction(ATC_Psychrometrics (*function)(float, float), const std::vector<Sample> &samples,
+                           int rounds) {
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const Sample &sample: samples) {
+            ATC_Psychrometrics metrics = function(sample.temperature, sample.humidity);
+            sink = sink + metrics.dew_point + metrics.absolute_humidity + metrics.vapour_pressure_deficit;
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / (static_cast<double>(rounds) * static_cast<double>(samples.size()));
+}
+
+int main() {
+    std::vector<Sample> samples;
+    for (int temperature = psychrometric_table_min * 10; temperature < psychrometric_table_max * 10; temperature += 3) {
+        for (int humidity = 5; humidity <= 1000; humidity += 7) {
+            samples.push_back({static_cast<float>(temperature) / 10.0f, static_cast<float>(humidity) / 10.0f});
+        }
+    }
+
+    float pressureError = 0.0f;
+    float dewPointError = 0.0f;
+    float absoluteError = 0.0f;
+    float deficitError = 0.0f;
+    for (const Sample &sample: samples) {
+        float exact = atcSaturationVapourPressureExact(sample.temperature);
+        float fast = atcSaturationVapourPressure(sample.temperature);
+        pressureError = std::fmax(pressureError, std::fabs(fast - exact) / exact);
+        ATC_Psychrometrics reference = atcPsychrometricsExact(sample.temperature, sample.humidity);
+        ATC_Psychrometrics metrics = atcPsychrometrics(sample.temperature, sample.humidity);
+        dewPointError = std::fmax(dewPointError, std::fabs(metrics.dew_point - reference.dew_point));
+        absoluteError = std::fmax(absoluteError, std::fabs(metrics.absolute_humidity - reference.absolute_humidity) /
+                                                 reference.absolute_humidity);
+        deficitError = std::fmax(deficitError,
+                                 std::fabs(metrics.vapour_pressure_deficit - reference.vapour_pressure_deficit));
+    }
+    std::printf("samples                        %zu\n", samples.size());
+    std::printf("saturation pressure rel. error %.4f %%\n", pressureError * 100.0f);
+    std::printf("dew point abs. error           %.4f C\n", dewPointError);
+    std::printf("absolute humidity rel. error   %.4f %%\n", absoluteError * 100.0f);
+    std::printf("vapour pressure deficit error  %.5f kPa\n", deficitError);
+
+    const int rounds = 20;
+    double exactTime = timeFunction(atcPsychrometricsExact, samples, rounds);
+    double fastTime = timeFunction(atcPsychrometrics, samples, rounds);
+    std::printf("libm                           %.1f ns/call\n", exactTime);
+    std::printf("table                          %.1f ns/call\n", fastTime);
+    return 0;
+}
@@ -0,0 +1,283 @@
+/**
+ * @file ATC_AdvertisingDecoder.cpp
+ * @brief This file contains the implementation of the advertising format decoders.
+ */
+#include "ATC_AdvertisingDecoder.h"
+
+/**
+ * @brief Decodes advertising data in ATC1441 format.
+ * Extracts temperature, humidity, battery level, and battery voltage.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDecodeATC1441(const uint8_t *data, size_t length, ATC_MiThermometer_Reading &reading) {
+    if (length < 18) {
+        return "Packet too short!";
+    }
+    int16_t temperatureRaw = (data[10] << 8) | data[11];
+    reading.temperature = static_cast<int16_t>(temperatureRaw * 10);
+    reading.humidity = data[12] * 100;
+    reading.battery_level = data[13];
+    reading.battery_mv = (data[14] << 8) | data[15];
+    reading.fields = READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV | READING_BATTERY_LEVEL;
+    return nullptr;
+}
+
+/**
+ * @brief Decodes advertising data in PVVX format. Extracts precise temperature, humidity, battery voltage, and battery level.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDecodePVVX(const uint8_t *data, size_t length, ATC_MiThermometer_Reading &reading) {
+    if (length < 19) {
+        return "Packet too short!";
+    }
+    uint8_t size = data[0];
+    if (size != 18) {
+        return "Incorrect packet size!";
+    }
+    uint8_t uid = data[1];
+    if (uid != 0x16) {
+        return "Incorrect UID, not Service Data with 16-bit UUID!";
+    }
+    uint16_t uuid = data[2] | (data[3] << 8);
+    if (uuid != 0x181A) {
+        return "Incorrect UUID, not 0x181A!";
+    }
+    reading.temperature = static_cast<int16_t>(data[10] | (data[11] << 8));
+    reading.humidity = data[12] | (data[13] << 8);
+    reading.battery_mv = data[14] | (data[15] << 8);
+    reading.battery_level = data[16];
+    reading.fields = READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV | READING_BATTERY_LEVEL;
+    return nullptr;
+}
+
+/**
+ * @brief Decodes advertising data in BTHome format. Extracts battery level, temperature, humidity, and voltage.
+ * Fails if the packet is too short, the AD element length exceeds the packet size,
+ * the service data is too short, or the UUID is unknown.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the last error.
+ */
+const char *atcDecodeBTHome(const uint8_t *data, size_t length, ATC_MiThermometer_Reading &reading) {
+    if (length < 6) {
+        return "Packet too short!";
+    }
+    const char *error = nullptr;
+    size_t index = 0;
+    while (index < length) {
+        uint8_t element_length = data[index];
+        if (element_length == 0) {
+            break;
+        }
+        if (index + 1 + element_length > length) {
+            error = "AD element length exceeds packet size!";
+            break;
+        }
+        uint8_t ad_type = data[index + 1];
+        const uint8_t *ad_data = &data[index + 2];
+        uint8_t ad_data_length = element_length - 1;
+        if (ad_type == 0x16) { // Service Data - 16-bit UUID
+            if (ad_data_length < 3) {
+                error = "Service Data too short!";
+                break;
+            }
+            uint16_t uuid = ad_data[0] | (ad_data[1] << 8);
+            if (uuid != 0xFCD2) { // BTHome UUID
+                error = "Unknown UUID for BTHome!";
+                break;
+            }
+            size_t dataIndex = 3;
+            while (dataIndex < ad_data_length) {
+                uint8_t objectId = ad_data[dataIndex++];
+                switch (objectId) {
+                    case 0x00: { // Packet ID
+                        if (dataIndex >= ad_data_length) {
+                            error = "Missing data for Packet ID!";
+                            break;
+                        }
+                        dataIndex++;
+                        break;
+                    }
+                    case 0x01: { // Battery Level
+                        if (dataIndex >= ad_data_length) {
+                            error = "Missing data for Battery Level!";
+                            break;
+                        }
+                        reading.battery_level = ad_data[dataIndex++];
+                        reading.fields |= READING_BATTERY_LEVEL;
+                        break;
+                    }
+                    case 0x02: { // Temperature
+                        if (dataIndex + 1 >= ad_data_length) {
+                            error = "Missing data for Temperature!";
+                            break;
+                        }
+                        // Signed, 0.01 degrees Celsius
+                        reading.temperature = static_cast<int16_t>(
+                                static_cast<uint16_t>(ad_data[dataIndex] | (ad_data[dataIndex + 1] << 8)));
+                        reading.fields |= READING_TEMPERATURE;
+                        dataIndex += 2;
+                        break;
+                    }
+                    case 0x03: { // Humidity
+                        if (dataIndex + 1 >= ad_data_length) {
+                            error = "Missing data for Humidity!";
+                            break;
+                        }
+                        uint16_t humidityRaw = ad_data[dataIndex] | (ad_data[dataIndex + 1] << 8);
+                        reading.humidity = humidityRaw;
+                        reading.fields |= READING_HUMIDITY;
+                        dataIndex += 2;
+                        break;
+                    }
+                    case 0x0C: { // Voltage
+                        if (dataIndex + 1 >= ad_data_length) {
+                            error = "Missing data for Voltage!";
+                            break;
+                        }
+                        uint16_t voltageRaw = ad_data[dataIndex] | (ad_data[dataIndex + 1] << 8);
+                        reading.battery_mv = voltageRaw;
+                        reading.fields |= READING_BATTERY_MV;
+                        dataIndex += 2;
+                        break;
+                    }
+                    default:
+                        dataIndex = ad_data_length; // Skip unknown object IDs
+                        break;
+                }
+            }
+        }
+        index += 1 + element_length;
+    }
+    return error;
+}
+
+/**
+ * @brief Detects the advertising format by walking the AD elements until a service data element of a known format
+ * is found. Encrypted formats are not detected, since they cannot be decoded without the settings and the key.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param type Receives the detected format.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDetectAdvertisingType(const uint8_t *data, size_t length, Advertising_Type &type) {
+    size_t index = 0;
+    while (index + 1 < length) {
+        uint8_t element_length = data[index];
+        if (element_length == 0 || index + 1 + element_length > length) {
+            break;
+        }
+        const uint8_t *ad_data = &data[index + 2];
+        uint8_t ad_data_length = element_length - 1;
+        if (data[index + 1] == 0x16 && ad_data_length >= 3) { // Service Data - 16-bit UUID
+            uint16_t uuid = ad_data[0] | (ad_data[1] << 8);
+            if (uuid == 0x181A && ad_data_length == 15) {
+                type = Advertising_Type::ATC1441;
+                return nullptr;
+            }
+            if (uuid == 0x181A && ad_data_length == 17) {
+                type = Advertising_Type::PVVX;
+                return nullptr;
+            }
+            if (uuid == 0xFCD2) {
+                if (ad_data[2] & 0x01) {
+                    return "Encrypted BTHome advertising cannot be detected";
+                }
+                type = Advertising_Type::BTHOME;
+                return nullptr;
+            }
+        }
+        index += 1 + element_length;
+    }
+    return "Unknown advertising format";
+}
+
+/**
+ * @brief Decodes advertising data in the given format.
+ * @param type The advertising format.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDecodeAdvertising(Advertising_Type type, const uint8_t *data, size_t length,
+                                 ATC_MiThermometer_Reading &reading) {
+    switch (type) {
+        case Advertising_Type::BTHOME:
+            return atcDecodeBTHome(data, length, reading);
+        case Advertising_Type::PVVX:
+            return atcDecodePVVX(data, length, reading);
+        case Advertising_Type::ATC1441:
+            return atcDecodeATC1441(data, length, reading);
+        default:
+            return "Unknown advertising type";
+    }
+}
+
+/**
+ * @brief Copies the valid fields of a reading over another one and marks them valid, with their anomaly flags.
+ * @param target The reading to update, the time is left untouched.
+ * @param source The reading whose valid fields are copied.
+ */
+void atcMergeReading(ATC_MiThermometer_Reading &target, const ATC_MiThermometer_Reading &source) {
+    if (source.fields & READING_TEMPERATURE) {
+        target.temperature = source.temperature;
+    }
+    if (source.fields & READING_HUMIDITY) {
+        target.humidity = source.humidity;
+    }
+    if (source.fields & READING_BATTERY_MV) {
+        target.battery_mv = source.battery_mv;
+    }
+    if (source.fields & READING_BATTERY_LEVEL) {
+        target.battery_level = source.battery_level;
+    }
+    target.fields |= source.fields;
+    target.anomalies = static_cast<uint8_t>((target.anomalies & ~source.fields) | source.anomalies);
+}
+
+/**
+ * @brief Decodes advertising data in the format of a compact thermometer and stores the latest raw reading in it.
+ * Only the fields present in the advertisement are updated.
+ * @param thermometer The compact thermometer to update.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param rssi The RSSI of the advertisement in dBm.
+ * @param now The current millis() timestamp.
+ * @param decoded Set to the Reading_Field flags decoded from the advertisement, if not nullptr.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcUpdateCompactThermometer(ATC_CompactThermometer &thermometer, const uint8_t *data, size_t length,
+                                        int8_t rssi, uint32_t now, uint8_t *decoded) {
+    ATC_MiThermometer_Reading reading{};
+    const char *error = atcDecodeAdvertising(static_cast<Advertising_Type>(thermometer.format), data, length, reading);
+    if (decoded) {
+        *decoded = reading.fields;
+    }
+    if (reading.fields == 0) {
+        return error ? error : "No measurement in packet!";
+    }
+    if (reading.fields & READING_TEMPERATURE) {
+        thermometer.temperature = reading.temperature;
+    }
+    if (reading.fields & READING_HUMIDITY) {
+        thermometer.humidity = reading.humidity;
+    }
+    if (reading.fields & READING_BATTERY_MV) {
+        thermometer.battery_mv = reading.battery_mv;
+    }
+    if (reading.fields & READING_BATTERY_LEVEL) {
+        thermometer.battery_level = reading.battery_level;
+    }
+    thermometer.fields |= reading.fields;
+    thermometer.rssi = rssi;
+    thermometer.last_seen = now ? now : 1;
+    return error;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file ATC_AdvertisingDecoder.h
+ * @brief This file declares the decoders of the ATC1441, PVVX and BTHome advertising formats.
+ * The decoders only depend on the library structures, not on Arduino or NimBLE.
+ */
+#ifndef ATC_ADVERTISING_DECODER_H
+#define ATC_ADVERTISING_DECODER_H
+
+#include <cstdint>
+#include <cstddef>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @brief Decodes advertising data in ATC1441 format.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDecodeATC1441(const uint8_t *data, size_t length, ATC_MiThermometer_Reading &reading);
+
+/**
+ * @brief Decodes advertising data in PVVX format.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDecodePVVX(const uint8_t *data, size_t length, ATC_MiThermometer_Reading &reading);
+
+/**
+ * @brief Decodes advertising data in BTHome format. Objects decoded before an error are kept in the reading.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the last error.
+ */
+const char *atcDecodeBTHome(const uint8_t *data, size_t length, ATC_MiThermometer_Reading &reading);
+
+/**
+ * @brief Detects the advertising format from the service data of an advertisement: UUID 0x181A with 13 bytes of
+ *        data for ATC1441, UUID 0x181A with 15 bytes for PVVX, UUID 0xFCD2 without encryption for BTHome.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param type Receives the detected format.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDetectAdvertisingType(const uint8_t *data, size_t length, Advertising_Type &type);
+
+/**
+ * @brief Decodes advertising data in the given format.
+ * @param type The advertising format.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param reading The reading to fill, the time is left untouched.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcDecodeAdvertising(Advertising_Type type, const uint8_t *data, size_t length,
+                                 ATC_MiThermometer_Reading &reading);
+
+/**
+ * @brief Copies the valid fields of a reading over another one and marks them valid, with their anomaly flags.
+ * @param target The reading to update, the time is left untouched.
+ * @param source The reading whose valid fields are copied.
+ */
+void atcMergeReading(ATC_MiThermometer_Reading &target, const ATC_MiThermometer_Reading &source);
+
+/**
+ * @brief Decodes advertising data in the format of a compact thermometer and stores the latest raw reading in it.
+ * @param thermometer The compact thermometer to update.
+ * @param data The advertising data.
+ * @param length The length of the advertising data.
+ * @param rssi The RSSI of the advertisement in dBm.
+ * @param now The current millis() timestamp.
+ * @param decoded Set to the Reading_Field flags decoded from the advertisement, 0 if it held no measurement, if not
+ *        nullptr.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcUpdateCompactThermometer(ATC_CompactThermometer &thermometer, const uint8_t *data, size_t length,
+                                        int8_t rssi, uint32_t now, uint8_t *decoded = nullptr);
+
+#endif // ATC_ADVERTISING_DECODER_H
@@ -0,0 +1,132 @@
+/**
+ * @file ATC_Async.cpp
+ * @brief This file contains the implementation of the ATC_AsyncLoop event loop.
+ */
+#include "ATC_Async.h"
+
+#ifdef ATC_ASYNC_SUPPORTED
+
+#ifndef ARDUINO
+#include <chrono>
+#include <thread>
+#endif
+
+/**
+ * @brief Gets the default clock of ATC_AsyncLoop: millis() on Arduino, a steady clock elsewhere.
+ * @return The time in milliseconds.
+ */
+unsigned long atcAsyncMillis() {
+#ifdef ARDUINO
+    return millis();
+#else
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+#endif
+}
+
+/**
+ * @brief Sleeps between idle polls of ATC_AsyncLoop::run().
+ * @param delayMs The sleep in milliseconds.
+ */
+static void asyncDelay(uint32_t delayMs) {
+#ifdef ARDUINO
+    delay(delayMs);
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+#endif
+}
+
+/**
+ * @brief Constructor for the ATC_AsyncWaiter class. Records the start of the wait.
+ * @param loop The loop resuming the coroutine.
+ * @param timeoutMs The time in milliseconds after which the coroutine is resumed anyway.
+ */
+ATC_AsyncWaiter::ATC_AsyncWaiter(ATC_AsyncLoop &loop, uint32_t timeoutMs)
+        : loop(loop), start(loop.now()), timeout(timeoutMs), handle(nullptr), next(nullptr) {}
+
+/**
+ * @brief Registers the suspended coroutine at the head of the waiting list of the loop.
+ * @param awaiting The suspended coroutine.
+ */
+void ATC_AsyncWaiter::await_suspend(std::coroutine_handle<> awaiting) {
+    handle = awaiting;
+    next = loop.waiters;
+    loop.waiters = this;
+}
+
+/**
+ * @brief Condition of a sleep, which never holds so that the wait ends on its timeout.
+ * @return Always false.
+ */
+static bool never() {
+    return false;
+}
+
+/**
+ * @brief Constructor for the ATC_AsyncLoop class.
+ * @param clock The millisecond clock used for timeouts.
+ */
+ATC_AsyncLoop::ATC_AsyncLoop(unsigned long (*clock)()) : clock(clock), waiters(nullptr) {}
+
+/**
+ * @brief Creates an awaitable resuming the coroutine after a delay, a wait on a condition that never holds.
+ * @param delayMs The delay in milliseconds.
+ * @return The awaitable.
+ */
+ATC_WaitUntil<bool (*)()> ATC_AsyncLoop::sleep(uint32_t delayMs) {
+    return ATC_WaitUntil<bool (*)()>(*this, never, delayMs);
+}
+
+/**
+ * @brief Resumes the coroutines whose condition holds or whose timeout expired. The list is detached first, because
+ * a resumed coroutine usually suspends again on the loop, and waiters that are not resumed are linked back.
+ * @return The number of coroutines resumed.
+ */
+size_t ATC_AsyncLoop::poll() {
+    ATC_AsyncWaiter *pending = waiters;
+    waiters = nullptr;
+    size_t resumed = 0;
+    while (pending) {
+        ATC_AsyncWaiter *waiter = pending;
+        pending = waiter->next;
+        if (waiter->ready() || now() - waiter->start >= waiter->timeout) {
+            resumed++;
+            waiter->handle.resume();
+        } else {
+            waiter->next = waiters;
+            waiters = waiter;
+        }
+    }
+    return resumed;
+}
+
+/**
+ * @brief Polls until no coroutine is waiting, sleeping between polls that resume nothing.
+ * @param idleDelayMs The sleep in milliseconds between idle polls.
+ */
+void ATC_AsyncLoop::run(uint32_t idleDelayMs) {
+    while (waiters) {
+        if (!poll()) {
+            asyncDelay(idleDelayMs);
+        }
+    }
+}
+
+/**
+ * @brief Checks whether no coroutine is waiting.
+ * @return True if no coroutine is waiting.
+ */
+bool ATC_AsyncLoop::empty() const {
+    return waiters == nullptr;
+}
+
+/**
+ * @brief Gets the current time of the loop clock.
+ * @return The time in milliseconds.
+ */
+uint32_t ATC_AsyncLoop::now() const {
+    return static_cast<uint32_t>(clock());
+}
+
+#endif // ATC_ASYNC_SUPPORTED
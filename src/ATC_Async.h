@@ -0,0 +1,272 @@
+/**
+ * @file ATC_Async.h
+ * @brief This file contains the ATC_Task coroutine type and the ATC_AsyncLoop event loop, used by the awaitable
+ * versions of the ATC_MiThermometer operations. A waiting operation suspends its coroutine instead of blocking the
+ * task, so one task can drive many thermometers, each costing only its coroutine frame.
+ * Requires C++20 coroutines, ATC_ASYNC_SUPPORTED is defined to 1 when they are available. Outside Arduino the loop
+ * uses the standard library clock, so it can also be used on a host.
+ */
+#ifndef ATC_ASYNC_H
+#define ATC_ASYNC_H
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#define ATC_ASYNC_SUPPORTED 1
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <coroutine>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+class ATC_AsyncLoop;
+
+/**
+ * @brief Gets the default clock of ATC_AsyncLoop: millis() on Arduino, a steady clock elsewhere.
+ * @return The time in milliseconds.
+ */
+unsigned long atcAsyncMillis();
+
+/**
+ * @class ATC_Task
+ * @brief A coroutine returning a value. The coroutine starts suspended and runs when it is awaited by another
+ *        coroutine, or when start() is called on a top-level task. The task owns the coroutine frame.
+ * @tparam T The type of the result, must be default constructible.
+ */
+template<typename T>
+class ATC_Task {
+public:
+    /**
+     * @struct promise_type
+     * @brief The promise of the coroutine, holding the result and the coroutine awaiting it.
+     */
+    struct promise_type {
+        T value{}; /**< The result. */
+        std::coroutine_handle<> continuation; /**< The coroutine awaiting the task, resumed when it finishes. */
+
+        /**
+         * @struct FinalAwaiter
+         * @brief Resumes the awaiting coroutine, if any, when the task finishes.
+         */
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                std::coroutine_handle<> continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        ATC_Task get_return_object() {
+            return ATC_Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void return_value(T result) { value = std::move(result); }
+
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    /** @brief Move constructor. */
+    ATC_Task(ATC_Task &&other) noexcept : handle(other.handle) { other.handle = nullptr; }
+
+    ATC_Task(const ATC_Task &) = delete;
+
+    ATC_Task &operator=(const ATC_Task &) = delete;
+
+    /** @brief Destructor. Destroys the coroutine frame, the task must not be suspended in a loop. */
+    ~ATC_Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    /** @brief Starts a top-level task. It runs until its first suspension. */
+    void start() {
+        if (handle && !handle.done()) {
+            handle.resume();
+        }
+    }
+
+    /** @brief Checks whether the task has finished. */
+    bool done() const { return !handle || handle.done(); }
+
+    /** @brief Gets the result of a finished task. */
+    const T &result() const { return handle.promise().value; }
+
+    /** @brief Awaiting a finished task does not suspend. */
+    bool await_ready() const noexcept { return done(); }
+
+    /** @brief Runs the task, resuming the awaiting coroutine when it finishes. */
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    /** @brief Gets the result of the task. */
+    T await_resume() { return std::move(handle.promise().value); }
+
+private:
+    /** @brief Constructor for the ATC_Task class, called by the promise. */
+    explicit ATC_Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle; /**< The coroutine. */
+};
+
+/**
+ * @class ATC_AsyncWaiter
+ * @brief Base of the awaitables of an ATC_AsyncLoop. A suspended coroutine is resumed by the loop when the
+ *        condition of its waiter holds or the timeout expires. The waiter lives in the coroutine frame and is
+ *        linked into the loop, so waiting does not allocate.
+ */
+class ATC_AsyncWaiter {
+public:
+    /** @brief Does not suspend if the condition already holds. */
+    bool await_ready() const { return ready(); }
+
+    /** @brief Registers the suspended coroutine with the loop. */
+    void await_suspend(std::coroutine_handle<> awaiting);
+
+    /**
+     * @brief Gets the outcome of the wait.
+     * @return True if the condition holds, false if the timeout expired.
+     */
+    bool await_resume() const { return ready(); }
+
+protected:
+    /**
+     * @brief Constructor for the ATC_AsyncWaiter class.
+     * @param loop The loop resuming the coroutine.
+     * @param timeoutMs The time in milliseconds after which the coroutine is resumed anyway.
+     */
+    ATC_AsyncWaiter(ATC_AsyncLoop &loop, uint32_t timeoutMs);
+
+    ~ATC_AsyncWaiter() = default;
+
+    /**
+     * @brief Checks the condition of the wait.
+     * @return True if the coroutine can be resumed.
+     */
+    virtual bool ready() const = 0;
+
+private:
+    friend class ATC_AsyncLoop;
+
+    ATC_AsyncLoop &loop; /**< The loop resuming the coroutine. */
+    uint32_t start; /**< Time of the suspension. */
+    uint32_t timeout; /**< The timeout in milliseconds. */
+    std::coroutine_handle<> handle; /**< The suspended coroutine. */
+    ATC_AsyncWaiter *next; /**< Next waiter of the loop. */
+};
+
+/**
+ * @class ATC_WaitUntil
+ * @brief Awaitable resuming the coroutine when a condition holds or a timeout expires.
+ * @tparam Condition A callable returning bool, checked by the loop on every poll.
+ */
+template<typename Condition>
+class ATC_WaitUntil : public ATC_AsyncWaiter {
+public:
+    /**
+     * @brief Constructor for the ATC_WaitUntil class.
+     * @param loop The loop resuming the coroutine.
+     * @param condition The condition.
+     * @param timeoutMs The time in milliseconds after which the coroutine is resumed anyway.
+     */
+    ATC_WaitUntil(ATC_AsyncLoop &loop, Condition condition, uint32_t timeoutMs)
+            : ATC_AsyncWaiter(loop, timeoutMs), condition(std::move(condition)) {}
+
+protected:
+    bool ready() const override { return condition(); }
+
+private:
+    Condition condition; /**< The condition. */
+};
+
+/**
+ * @class ATC_AsyncLoop
+ * @brief A single-threaded event loop resuming the coroutines waiting on it. All coroutines using a loop, and the
+ *        loop itself, must run on the same task.
+ */
+class ATC_AsyncLoop {
+public:
+    /**
+     * @brief Constructor for the ATC_AsyncLoop class.
+     * @param clock The millisecond clock used for timeouts, atcAsyncMillis() by default.
+     */
+    explicit ATC_AsyncLoop(unsigned long (*clock)() = atcAsyncMillis);
+
+    /**
+     * @brief Creates an awaitable resuming the coroutine when a condition holds or a timeout expires.
+     * @param condition A callable returning bool.
+     * @param timeoutMs The timeout in milliseconds.
+     * @return The awaitable, whose co_await result is true if the condition holds.
+     */
+    template<typename Condition>
+    ATC_WaitUntil<Condition> until(Condition condition, uint32_t timeoutMs) {
+        return ATC_WaitUntil<Condition>(*this, std::move(condition), timeoutMs);
+    }
+
+    /**
+     * @brief Creates an awaitable resuming the coroutine after a delay.
+     * @param delayMs The delay in milliseconds.
+     * @return The awaitable.
+     */
+    ATC_WaitUntil<bool (*)()> sleep(uint32_t delayMs);
+
+    /**
+     * @brief Creates an awaitable resuming the coroutine once it holds a lock. A mutex held by another task suspends
+     *        the coroutine instead of blocking the loop. The lock stays held across later suspensions, until it is
+     *        released or destroyed with the coroutine frame.
+     * @tparam Lock A std::unique_lock, usually constructed with std::defer_lock.
+     * @param lock The lock.
+     * @param timeoutMs The timeout in milliseconds.
+     * @return The awaitable, whose co_await result is true if the lock is held.
+     */
+    template<typename Lock>
+    auto lock(Lock &lock, uint32_t timeoutMs) {
+        return until([&lock] { return lock.owns_lock() || lock.try_lock(); }, timeoutMs);
+    }
+
+    /**
+     * @brief Resumes the coroutines whose condition holds or whose timeout expired.
+     * @return The number of coroutines resumed.
+     */
+    size_t poll();
+
+    /**
+     * @brief Polls until no coroutine is waiting, sleeping between polls that resume nothing.
+     * @param idleDelayMs The sleep in milliseconds between idle polls.
+     */
+    void run(uint32_t idleDelayMs = 1);
+
+    /**
+     * @brief Checks whether no coroutine is waiting.
+     * @return True if no coroutine is waiting.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Gets the current time of the loop clock.
+     * @return The time in milliseconds.
+     */
+    uint32_t now() const;
+
+private:
+    friend class ATC_AsyncWaiter;
+
+    unsigned long (*clock)(); /**< The millisecond clock. */
+    ATC_AsyncWaiter *waiters; /**< The waiting coroutines. */
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // ATC_ASYNC_H
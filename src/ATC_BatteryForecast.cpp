@@ -0,0 +1,216 @@
+/**
+ * @file ATC_BatteryForecast.cpp
+ * @brief This file contains the implementation of the ATC_BatteryForecast class.
+ */
+#include "ATC_BatteryForecast.h"
+#include <cmath>
+#include <cstring>
+
+/** @brief Seconds per day, the time unit of the discharge model. */
+static constexpr double seconds_per_day = 86400.0;
+
+/** @brief Regularisation of the temperature coefficient, which keeps it near 0 while the temperature barely varies. */
+static constexpr double temperature_ridge = 1.0;
+
+/**
+ * @brief Constructor for the ATC_BatteryForecast class, with the default configuration.
+ */
+ATC_BatteryForecast::ATC_BatteryForecast() {
+    reset();
+}
+
+/**
+ * @brief Sets the configuration and forgets the history.
+ * @param forecastConfig The configuration.
+ */
+void ATC_BatteryForecast::configure(const ATC_BatteryForecastConfig &forecastConfig) {
+    config = forecastConfig;
+    if (config.sample_interval_s == 0) {
+        config.sample_interval_s = 1;
+    }
+    reset();
+}
+
+/**
+ * @brief Gets the configuration.
+ * @return The configuration.
+ */
+const ATC_BatteryForecastConfig &ATC_BatteryForecast::getConfig() const {
+    return config;
+}
+
+/**
+ * @brief Adds a battery reading to the current interval. A reading past the end of the interval first closes it:
+ * its mean becomes a sample of the history and of the fit, and a new interval starts at the reading.
+ * @param time The time of the reading (UTC).
+ * @param batteryMv The battery voltage in mV.
+ * @param temperature The temperature in 0.01 degrees Celsius.
+ */
+void ATC_BatteryForecast::addReading(uint32_t time, uint16_t batteryMv, int16_t temperature) {
+    if (interval_readings > 0 && time < interval_start) {
+        reset();
+    }
+    if (interval_readings > 0 && time - interval_start >= config.sample_interval_s) {
+        ATC_BatterySample closed{};
+        closed.time = interval_start;
+        closed.battery_mv = static_cast<uint16_t>(interval_mv / interval_readings);
+        closed.temperature = static_cast<int16_t>(interval_temperature / interval_readings);
+        addSample(closed);
+        interval_readings = 0;
+    }
+    if (interval_readings == 0) {
+        interval_start = time;
+        interval_mv = 0;
+        interval_temperature = 0;
+    }
+    interval_mv += batteryMv;
+    interval_temperature += temperature;
+    interval_readings++;
+}
+
+/**
+ * @brief Forecasts the days until the battery reaches the cutoff voltage. The fitted voltage at the time and
+ * temperature of the latest sample is extrapolated with the discharge rate.
+ * @return The days left, 0 if the cutoff is already reached, INFINITY if the voltage does not decline, or NAN if
+ *         fewer than min_samples samples were collected.
+ */
+float ATC_BatteryForecast::getDaysLeft() const {
+    if (!fitted || fit_samples < config.min_samples || count == 0) {
+        return NAN;
+    }
+    const ATC_BatterySample &latest = sample(count - 1);
+    double days = (latest.time - fit_origin) / seconds_per_day;
+    double voltage = coefficients[0] + coefficients[1] * days +
+                     coefficients[2] * (latest.temperature / 100.0 - 25.0);
+    if (voltage <= config.cutoff_mv) {
+        return 0.0f;
+    }
+    if (coefficients[1] >= 0.0) {
+        return INFINITY;
+    }
+    return static_cast<float>((voltage - config.cutoff_mv) / -coefficients[1]);
+}
+
+/**
+ * @brief Gets the fitted discharge rate at constant temperature.
+ * @return The voltage change in mV per day, or NAN without a fit.
+ */
+float ATC_BatteryForecast::getDischargeRate() const {
+    return fitted ? static_cast<float>(coefficients[1]) : NAN;
+}
+
+/**
+ * @brief Gets the fitted voltage change per degree Celsius.
+ * @return The temperature coefficient in mV per degree, or NAN without a fit.
+ */
+float ATC_BatteryForecast::getTemperatureCoefficient() const {
+    return fitted ? static_cast<float>(coefficients[2]) : NAN;
+}
+
+/**
+ * @brief Gets the number of samples in the history.
+ * @return The number of samples.
+ */
+size_t ATC_BatteryForecast::size() const {
+    return count;
+}
+
+/**
+ * @brief Gets a sample of the history.
+ * @param index The index of the sample, 0 for the oldest.
+ * @return The sample.
+ */
+const ATC_BatterySample &ATC_BatteryForecast::sample(size_t index) const {
+    size_t oldest = count < battery_history_size ? 0 : head;
+    return history[(oldest + index) % battery_history_size];
+}
+
+/**
+ * @brief Forgets the history and the fit.
+ */
+void ATC_BatteryForecast::reset() {
+    count = 0;
+    head = 0;
+    interval_start = 0;
+    interval_mv = 0;
+    interval_temperature = 0;
+    interval_readings = 0;
+    fit_origin = 0;
+    fit_samples = 0;
+    std::memset(normal, 0, sizeof(normal));
+    std::memset(moment, 0, sizeof(moment));
+    std::memset(coefficients, 0, sizeof(coefficients));
+    fitted = false;
+}
+
+/**
+ * @brief Adds a closed interval to the history and updates the fit: the sums of the normal equations are decayed
+ * by the forgetting factor before the sample is added, and the equations are solved again.
+ * @param closed The sample.
+ */
+void ATC_BatteryForecast::addSample(const ATC_BatterySample &closed) {
+    history[head] = closed;
+    head = static_cast<uint8_t>((head + 1) % battery_history_size);
+    if (count < battery_history_size) {
+        count++;
+    }
+    if (fit_samples == 0) {
+        fit_origin = closed.time;
+    }
+    const double x[3] = {1.0, (closed.time - fit_origin) / seconds_per_day, closed.temperature / 100.0 - 25.0};
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            normal[row][column] = normal[row][column] * config.forgetting + x[row] * x[column];
+        }
+        moment[row] = moment[row] * config.forgetting + x[row] * closed.battery_mv;
+    }
+    fit_samples++;
+    fitted = solve();
+}
+
+/**
+ * @brief Solves the regularised normal equations by Gaussian elimination with partial pivoting.
+ * @return True if the system is well conditioned and the coefficients were updated.
+ */
+bool ATC_BatteryForecast::solve() {
+    double matrix[3][4];
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            matrix[row][column] = normal[row][column];
+        }
+        matrix[row][3] = moment[row];
+    }
+    matrix[2][2] += temperature_ridge;
+    for (int pivot = 0; pivot < 3; pivot++) {
+        int best = pivot;
+        for (int row = pivot + 1; row < 3; row++) {
+            if (std::fabs(matrix[row][pivot]) > std::fabs(matrix[best][pivot])) {
+                best = row;
+            }
+        }
+        if (std::fabs(matrix[best][pivot]) < 1e-9) {
+            return false;
+        }
+        for (int column = 0; column < 4; column++) {
+            double swapped = matrix[pivot][column];
+            matrix[pivot][column] = matrix[best][column];
+            matrix[best][column] = swapped;
+        }
+        for (int row = pivot + 1; row < 3; row++) {
+            double factor = matrix[row][pivot] / matrix[pivot][pivot];
+            for (int column = pivot; column < 4; column++) {
+                matrix[row][column] -= factor * matrix[pivot][column];
+            }
+        }
+    }
+    double solution[3];
+    for (int row = 2; row >= 0; row--) {
+        double value = matrix[row][3];
+        for (int column = row + 1; column < 3; column++) {
+            value -= matrix[row][column] * solution[column];
+        }
+        solution[row] = value / matrix[row][row];
+    }
+    std::memcpy(coefficients, solution, sizeof(coefficients));
+    return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file ATC_BatteryForecast.h
+ * @brief This file contains the declaration of the ATC_BatteryForecast class, which keeps a downsampled battery
+ * voltage history of a thermometer and forecasts when the battery must be replaced.
+ * The class only depends on the standard library, so it can also be used on a host.
+ */
+#ifndef ATC_BATTERY_FORECAST_H
+#define ATC_BATTERY_FORECAST_H
+
+#include <cstdint>
+#include <cstddef>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @class ATC_BatteryForecast
+ * @brief Averages the battery readings into one sample per interval and fits the discharge model
+ *        V = a + b * days + c * (T - 25 C) to the samples by recursive least squares with exponential forgetting.
+ *        The temperature term removes the voltage sag of a cold coin cell from the trend, so that winter nights do
+ *        not read as depletion. Each sample updates the fit in constant time and memory.
+ */
+class ATC_BatteryForecast {
+public:
+    /**
+     * @brief Constructor for the ATC_BatteryForecast class, with the default configuration.
+     */
+    ATC_BatteryForecast();
+
+    /**
+     * @brief Sets the configuration and forgets the history.
+     * @param config The configuration.
+     */
+    void configure(const ATC_BatteryForecastConfig &config);
+
+    /**
+     * @brief Gets the configuration.
+     * @return The configuration.
+     */
+    const ATC_BatteryForecastConfig &getConfig() const;
+
+    /**
+     * @brief Adds a battery reading. Closes the current interval, adding its sample to the history and the fit,
+     *        when the reading belongs to a later interval.
+     * @param time The time of the reading (UTC), readings older than the current interval restart the history.
+     * @param batteryMv The battery voltage in mV.
+     * @param temperature The temperature in 0.01 degrees Celsius.
+     */
+    void addReading(uint32_t time, uint16_t batteryMv, int16_t temperature);
+
+    /**
+     * @brief Forecasts the days until the battery reaches the cutoff voltage, at the temperature of the latest sample.
+     * @return The days left, 0 if the cutoff is already reached, INFINITY if the voltage does not decline, or NAN
+     *         if fewer than min_samples samples were collected.
+     */
+    float getDaysLeft() const;
+
+    /**
+     * @brief Gets the fitted discharge rate at constant temperature.
+     * @return The voltage change in mV per day, negative while discharging, or NAN without a fit.
+     */
+    float getDischargeRate() const;
+
+    /**
+     * @brief Gets the fitted voltage change per degree Celsius.
+     * @return The temperature coefficient in mV per degree, or NAN without a fit.
+     */
+    float getTemperatureCoefficient() const;
+
+    /**
+     * @brief Gets the number of samples in the history.
+     * @return The number of samples, at most battery_history_size.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Gets a sample of the history.
+     * @param index The index of the sample, 0 for the oldest.
+     * @return The sample.
+     */
+    const ATC_BatterySample &sample(size_t index) const;
+
+    /**
+     * @brief Forgets the history and the fit.
+     */
+    void reset();
+
+private:
+    void addSample(const ATC_BatterySample &sample);
+
+    bool solve();
+
+    ATC_BatteryForecastConfig config; /**< The configuration. */
+    ATC_BatterySample history[battery_history_size]; /**< Downsampled samples, a ring buffer. */
+    uint8_t count; /**< Number of samples in the history. */
+    uint8_t head; /**< Position of the next sample in the ring buffer. */
+    uint32_t interval_start; /**< Start of the current interval, 0 before the first reading. */
+    uint32_t interval_mv; /**< Sum of the voltages of the current interval. */
+    int32_t interval_temperature; /**< Sum of the temperatures of the current interval. */
+    uint16_t interval_readings; /**< Number of readings in the current interval. */
+    uint32_t fit_origin; /**< Time of the first sample of the fit, the origin of the day axis. */
+    uint32_t fit_samples; /**< Number of samples added to the fit. */
+    double normal[3][3]; /**< Weighted sums of x * x^T of the fit, with x = (1, days, T - 25). */
+    double moment[3]; /**< Weighted sums of x * V of the fit. */
+    double coefficients[3]; /**< Fitted a, b and c. */
+    bool fitted; /**< Flag indicating whether the coefficients are valid. */
+};
+
+#endif // ATC_BATTERY_FORECAST_H
@@ -0,0 +1,331 @@
+/**
+ * @file ATC_Calibration.cpp
+ * @brief This file contains the implementation of the ATC_ScalarCalibration and ATC_ReadingCalibration classes and
+ * of the calibration text format.
+ */
+#include "ATC_Calibration.h"
+#include "ATC_FleetStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @brief Computes the slope of a segment in 1/65536.
+ * @param x0 The raw value of the start of the segment.
+ * @param y0 The corrected value of the start of the segment.
+ * @param x1 The raw value of the end of the segment, greater than x0.
+ * @param y1 The corrected value of the end of the segment.
+ * @param slope The slope.
+ * @return True if the slope fits in 32 bits, false for a segment steeper than 32768.
+ */
+static bool segmentSlope(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t &slope) {
+    int64_t scaled = (static_cast<int64_t>(y1) - y0) * 65536 / (static_cast<int64_t>(x1) - x0);
+    if (scaled < INT32_MIN || scaled > INT32_MAX) {
+        return false;
+    }
+    slope = static_cast<int32_t>(scaled);
+    return true;
+}
+
+/**
+ * @brief Evaluates a polynomial curve.
+ * @param curve The curve.
+ * @param raw The raw value in 0.01 units.
+ * @return The corrected value in 0.01 units.
+ */
+static int32_t evaluatePolynomial(const ATC_CalibrationCurve &curve, int32_t raw) {
+    double x = raw / 100.0;
+    double y = 0.0;
+    for (int degree = calibration_max_degree; degree >= 0; degree--) {
+        y = y * x + curve.coefficients[degree];
+    }
+    y = std::round(y * 100.0);
+    if (!(y > INT32_MIN && y < INT32_MAX)) {
+        return y > 0 ? INT32_MAX : INT32_MIN;
+    }
+    return static_cast<int32_t>(y);
+}
+
+/**
+ * @brief Sets the curve and compiles it into knots. A piecewise-linear curve needs 1 to calibration_max_points
+ * points with strictly ascending raw values, a polynomial a range with range_min below range_max. Curves with a
+ * segment steeper than 32768, whose slope does not fit in 32 bits, are rejected.
+ * @param newCurve The curve.
+ * @return True if the curve is valid, otherwise the correction is removed.
+ */
+bool ATC_ScalarCalibration::configure(const ATC_CalibrationCurve &newCurve) {
+    curve = ATC_CalibrationCurve();
+    knot_count = 0;
+    if (newCurve.type == Calibration_type::PIECEWISE_LINEAR) {
+        if (newCurve.point_count == 0 || newCurve.point_count > calibration_max_points) {
+            return false;
+        }
+        for (uint8_t i = 1; i < newCurve.point_count; i++) {
+            if (newCurve.raw[i] <= newCurve.raw[i - 1]) {
+                return false;
+            }
+        }
+        for (uint8_t i = 0; i < newCurve.point_count; i++) {
+            knots[i] = newCurve.raw[i];
+            values[i] = newCurve.corrected[i];
+        }
+        knot_count = newCurve.point_count;
+    } else if (newCurve.type == Calibration_type::POLYNOMIAL) {
+        if (newCurve.range_min >= newCurve.range_max) {
+            return false;
+        }
+        int64_t span = static_cast<int64_t>(newCurve.range_max) - newCurve.range_min;
+        knot_count = static_cast<uint8_t>(std::min<int64_t>(calibration_knots, span + 1));
+        for (uint8_t i = 0; i < knot_count; i++) {
+            knots[i] = static_cast<int32_t>(newCurve.range_min + span * i / (knot_count - 1));
+            values[i] = evaluatePolynomial(newCurve, knots[i]);
+        }
+    } else {
+        return newCurve.type == Calibration_type::NONE;
+    }
+    if (knot_count == 1) {
+        slopes[0] = 65536;
+    }
+    for (uint8_t i = 0; i + 1 < knot_count; i++) {
+        if (!segmentSlope(knots[i], values[i], knots[i + 1], values[i + 1], slopes[i])) {
+            knot_count = 0;
+            return false;
+        }
+    }
+    if (knot_count > 1) {
+        slopes[knot_count - 1] = slopes[knot_count - 2];
+    }
+    curve = newCurve;
+    return true;
+}
+
+/**
+ * @brief Gets the curve.
+ * @return The curve.
+ */
+const ATC_CalibrationCurve &ATC_ScalarCalibration::getCurve() const {
+    return curve;
+}
+
+/**
+ * @brief Corrects a raw value by interpolating the segment containing it. Values below the first knot use the
+ * first segment, values above the last knot the last one.
+ * @param raw The raw value in 0.01 units.
+ * @return The corrected value in 0.01 units, limited to the range of int32_t.
+ */
+int32_t ATC_ScalarCalibration::apply(int32_t raw) const {
+    if (knot_count == 0) {
+        return raw;
+    }
+    const int32_t *end = knots + knot_count;
+    auto segment = static_cast<uint8_t>(std::upper_bound(knots, end, raw) - knots);
+    segment = segment == 0 ? 0 : static_cast<uint8_t>(segment - 1);
+    if (segment == knot_count - 1 && knot_count > 1 && raw < knots[segment]) {
+        segment--;
+    }
+    int64_t delta = (static_cast<int64_t>(raw) - knots[segment]) * slopes[segment];
+    int64_t corrected = values[segment] + ((delta + 32768) >> 16);
+    return static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(corrected, INT32_MIN), INT32_MAX));
+}
+
+/**
+ * @brief Sets the curve of a field. The curve is compiled aside and swapped in under the mutex, so a reading being
+ * corrected meanwhile sees either the old or the new curve in whole.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @param curve The curve.
+ * @return True if the field and the curve are valid.
+ */
+bool ATC_ReadingCalibration::setCurve(Reading_Field field, const ATC_CalibrationCurve &curve) {
+    if (field != READING_TEMPERATURE && field != READING_HUMIDITY) {
+        return false;
+    }
+    ATC_ScalarCalibration compiled;
+    bool valid = compiled.configure(curve);
+    std::lock_guard<std::mutex> lock(mutex);
+    (field == READING_TEMPERATURE ? temperature : humidity) = compiled;
+    return valid;
+}
+
+/**
+ * @brief Gets the curve of a field.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @return The curve.
+ */
+const ATC_CalibrationCurve &ATC_ReadingCalibration::getCurve(Reading_Field field) const {
+    return field == READING_HUMIDITY ? humidity.getCurve() : temperature.getCurve();
+}
+
+/**
+ * @brief Corrects the temperature and the humidity of a reading.
+ * @param reading The reading to correct.
+ */
+void ATC_ReadingCalibration::apply(ATC_MiThermometer_Reading &reading) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (reading.fields & READING_TEMPERATURE) {
+        int32_t corrected = temperature.apply(reading.temperature);
+        reading.temperature = static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(corrected, INT16_MIN),
+                                                                     INT16_MAX));
+    }
+    if (reading.fields & READING_HUMIDITY) {
+        int32_t corrected = humidity.apply(reading.humidity);
+        reading.humidity = static_cast<uint16_t>(std::min<int32_t>(std::max<int32_t>(corrected, 0), 10000));
+    }
+}
+
+/**
+ * @brief Parses a value in degrees or percent into 0.01 units.
+ * @param text The text, advanced past the value.
+ * @param value The value in 0.01 units.
+ * @return True if a number was found.
+ */
+static bool parseHundredths(const char *&text, int32_t &value) {
+    char *end = nullptr;
+    double number = std::strtod(text, &end);
+    if (end == text || !(std::fabs(number) < 2e7)) {
+        return false;
+    }
+    value = static_cast<int32_t>(std::lround(number * 100.0));
+    text = end;
+    return true;
+}
+
+/**
+ * @brief Reads the next token separated by spaces or tabs.
+ * @param text The text, advanced past the token.
+ * @param token The buffer receiving the token.
+ * @param size The size of the buffer.
+ * @return True if a token fitting in the buffer was found.
+ */
+static bool nextToken(const char *&text, char *token, size_t size) {
+    while (*text == ' ' || *text == '\t') {
+        text++;
+    }
+    size_t length = std::strcspn(text, " \t\r\n");
+    if (length == 0 || length >= size) {
+        return false;
+    }
+    std::memcpy(token, text, length);
+    token[length] = '\0';
+    text += length;
+    return true;
+}
+
+/**
+ * @brief Parses a line of the calibration text format.
+ * @param line The line, without the line break.
+ * @param address The packed MAC address of the thermometer.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @param curve The curve.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcParseCalibration(const char *line, uint64_t &address, Reading_Field &field,
+                                ATC_CalibrationCurve &curve) {
+    char token[24];
+    if (!nextToken(line, token, sizeof(token)) || (address = ATC_FleetStore::packAddress(token)) == 0) {
+        return "Invalid calibration address";
+    }
+    if (!nextToken(line, token, sizeof(token))) {
+        return "Missing calibration field";
+    }
+    if (std::strcmp(token, "temperature") == 0) {
+        field = READING_TEMPERATURE;
+    } else if (std::strcmp(token, "humidity") == 0) {
+        field = READING_HUMIDITY;
+    } else {
+        return "Unknown calibration field";
+    }
+    if (!nextToken(line, token, sizeof(token))) {
+        return "Missing calibration type";
+    }
+    curve = ATC_CalibrationCurve();
+    if (std::strcmp(token, "linear") == 0) {
+        curve.type = Calibration_type::PIECEWISE_LINEAR;
+        while (*line && *line != '\r' && *line != '\n') {
+            while (*line == ' ' || *line == '\t') {
+                line++;
+            }
+            if (!*line || *line == '\r' || *line == '\n') {
+                break;
+            }
+            if (curve.point_count == calibration_max_points) {
+                return "Too many calibration points";
+            }
+            if (!parseHundredths(line, curve.raw[curve.point_count]) || *line++ != ':' ||
+                !parseHundredths(line, curve.corrected[curve.point_count])) {
+                return "Invalid calibration point";
+            }
+            curve.point_count++;
+        }
+        if (curve.point_count == 0) {
+            return "Missing calibration points";
+        }
+    } else if (std::strcmp(token, "poly") == 0) {
+        curve.type = Calibration_type::POLYNOMIAL;
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+        if (!parseHundredths(line, curve.range_min) || *line++ != ':' || !parseHundredths(line, curve.range_max)) {
+            return "Invalid calibration range";
+        }
+        uint8_t degree = 0;
+        char *end = nullptr;
+        for (double coefficient = std::strtod(line, &end); end != line; coefficient = std::strtod(line, &end)) {
+            if (degree > calibration_max_degree) {
+                return "Calibration polynomial degree too high";
+            }
+            curve.coefficients[degree++] = static_cast<float>(coefficient);
+            line = end;
+        }
+        if (degree == 0) {
+            return "Missing calibration coefficients";
+        }
+    } else {
+        return "Unknown calibration type";
+    }
+    ATC_ScalarCalibration check;
+    if (!check.configure(curve)) {
+        return "Invalid calibration curve";
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Formats a curve as a line of the calibration text format.
+ * @param buffer The buffer.
+ * @param size The size of the buffer.
+ * @param address The packed MAC address of the thermometer.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @param curve The curve.
+ * @return The length of the line, 0 if the curve has no correction or the buffer is too small.
+ */
+size_t atcFormatCalibration(char *buffer, size_t size, uint64_t address, Reading_Field field,
+                            const ATC_CalibrationCurve &curve) {
+    if (curve.type == Calibration_type::NONE || size == 0) {
+        return 0;
+    }
+    size_t length = 0;
+    auto append = [&](int written) {
+        length = written < 0 ? size : length + static_cast<size_t>(written);
+    };
+    append(std::snprintf(buffer, size, "%02X:%02X:%02X:%02X:%02X:%02X %s",
+                         static_cast<unsigned>(address >> 40) & 0xFF, static_cast<unsigned>(address >> 32) & 0xFF,
+                         static_cast<unsigned>(address >> 24) & 0xFF, static_cast<unsigned>(address >> 16) & 0xFF,
+                         static_cast<unsigned>(address >> 8) & 0xFF, static_cast<unsigned>(address) & 0xFF,
+                         field == READING_HUMIDITY ? "humidity" : "temperature"));
+    if (curve.type == Calibration_type::PIECEWISE_LINEAR) {
+        append(length < size ? std::snprintf(buffer + length, size - length, " linear") : -1);
+        for (uint8_t i = 0; i < curve.point_count && length < size; i++) {
+            append(std::snprintf(buffer + length, size - length, " %.2f:%.2f", curve.raw[i] / 100.0,
+                                 curve.corrected[i] / 100.0));
+        }
+    } else {
+        append(length < size ? std::snprintf(buffer + length, size - length, " poly %.2f:%.2f",
+                                             curve.range_min / 100.0, curve.range_max / 100.0) : -1);
+        for (uint8_t degree = 0; degree <= calibration_max_degree && length < size; degree++) {
+            append(std::snprintf(buffer + length, size - length, " %.7g", curve.coefficients[degree]));
+        }
+    }
+    return length < size ? length : 0;
+}
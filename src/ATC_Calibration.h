@@ -0,0 +1,122 @@
+/**
+ * @file ATC_Calibration.h
+ * @brief This file contains the declaration of the host-side calibration of the thermometers: per-device
+ * piecewise-linear or polynomial corrections of the temperature and the humidity, applied in integer arithmetic to
+ * the raw readings, and the text format used to import and export sets of calibrations.
+ * The classes only depend on the standard library, so they can also be used on a host.
+ */
+#ifndef ATC_CALIBRATION_H
+#define ATC_CALIBRATION_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include "ATC_MiThermometer_structs.h"
+
+/** @brief Number of knots a polynomial curve is sampled at, the maximum number of knots of a compiled curve. */
+constexpr uint8_t calibration_knots = 17;
+
+/**
+ * @class ATC_ScalarCalibration
+ * @brief Corrects one series of raw values. Every curve is compiled into knots with a slope in 1/65536 per segment:
+ *        piecewise-linear curves use their points, polynomials are sampled at calibration_knots points over their
+ *        range. A correction is a binary search over the knots, one multiplication and one shift. Values outside
+ *        the knots are extrapolated with the slope of the nearest segment.
+ */
+class ATC_ScalarCalibration {
+public:
+    /**
+     * @brief Sets the curve and compiles it.
+     * @param curve The curve.
+     * @return True if the curve is valid and no segment is steeper than 32768, otherwise the correction is removed.
+     */
+    bool configure(const ATC_CalibrationCurve &curve);
+
+    /**
+     * @brief Gets the curve.
+     * @return The curve, of type Calibration_type::NONE if there is no correction.
+     */
+    const ATC_CalibrationCurve &getCurve() const;
+
+    /**
+     * @brief Corrects a raw value.
+     * @param raw The raw value in 0.01 units.
+     * @return The corrected value in 0.01 units.
+     */
+    int32_t apply(int32_t raw) const;
+
+private:
+    ATC_CalibrationCurve curve; /**< The curve. */
+    int32_t knots[calibration_knots] = {}; /**< Raw values of the knots, ascending. */
+    int32_t values[calibration_knots] = {}; /**< Corrected values at the knots. */
+    int32_t slopes[calibration_knots] = {}; /**< Slope in 1/65536 of the segment starting at each knot. */
+    uint8_t knot_count = 0; /**< Number of knots, 0 without correction. */
+};
+
+/**
+ * @class ATC_ReadingCalibration
+ * @brief Corrects the temperature and the humidity of the readings of a thermometer. Curves can be changed while
+ *        readings are corrected from another task.
+ */
+class ATC_ReadingCalibration {
+public:
+    /**
+     * @brief Sets the curve of a field.
+     * @param field READING_TEMPERATURE or READING_HUMIDITY.
+     * @param curve The curve.
+     * @return True if the field and the curve are valid.
+     */
+    bool setCurve(Reading_Field field, const ATC_CalibrationCurve &curve);
+
+    /**
+     * @brief Gets the curve of a field.
+     * @param field READING_TEMPERATURE or READING_HUMIDITY.
+     * @return The curve, of type Calibration_type::NONE if the field is not corrected.
+     */
+    const ATC_CalibrationCurve &getCurve(Reading_Field field) const;
+
+    /**
+     * @brief Corrects the temperature and the humidity of a reading. The humidity is limited to 0 to 100 %.
+     * @param reading The reading to correct.
+     */
+    void apply(ATC_MiThermometer_Reading &reading) const;
+
+private:
+    ATC_ScalarCalibration temperature; /**< Correction of the temperature. */
+    ATC_ScalarCalibration humidity; /**< Correction of the humidity. */
+    mutable std::mutex mutex; /**< Mutex protecting the corrections while a curve is swapped in. */
+};
+
+/** @brief Maximum length of a line of the calibration text format, including the terminating zero. */
+constexpr size_t calibration_line_length = 256;
+
+/**
+ * @brief Parses a line of the calibration text format. Values are in degrees Celsius or percent:
+ *
+ *     A4:C1:38:01:02:03 temperature linear -10.00:-9.70 20.00:20.15 40.00:40.30
+ *     A4:C1:38:01:02:03 humidity poly 0.00:100.00 1.5 0.98 0.0001
+ *
+ * A linear curve lists up to calibration_max_points measured:reference pairs in ascending order. A polynomial gives
+ * its range and up to 4 coefficients, lowest degree first.
+ * @param line The line, without the line break.
+ * @param address The packed MAC address of the thermometer.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @param curve The curve.
+ * @return nullptr on success, otherwise a description of the error.
+ */
+const char *atcParseCalibration(const char *line, uint64_t &address, Reading_Field &field,
+                                ATC_CalibrationCurve &curve);
+
+/**
+ * @brief Formats a curve as a line of the calibration text format, without the line break.
+ * @param buffer The buffer, calibration_line_length bytes are always enough.
+ * @param size The size of the buffer.
+ * @param address The packed MAC address of the thermometer.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @param curve The curve.
+ * @return The length of the line, 0 if the curve has no correction or the buffer is too small.
+ */
+size_t atcFormatCalibration(char *buffer, size_t size, uint64_t address, Reading_Field field,
+                            const ATC_CalibrationCurve &curve);
+
+#endif // ATC_CALIBRATION_H
@@ -0,0 +1,102 @@
+/**
+ * @file ATC_FixedVector.h
+ * @brief This file contains the ATC_FixedVector template, a vector with fixed capacity stored inline.
+ */
+#ifndef ATC_FIXED_VECTOR_H
+#define ATC_FIXED_VECTOR_H
+
+#include <cstddef>
+
+/**
+ * @class ATC_FixedVector
+ * @brief A vector of at most N elements stored inline, which never allocates. Provides the subset of the
+ *        std::vector interface used by the library. Elements past size() are kept default constructed.
+ * @tparam T The element type, must be default constructible and copyable.
+ * @tparam N The capacity.
+ */
+template<typename T, size_t N>
+class ATC_FixedVector {
+public:
+    using value_type = T; /**< The element type. */
+    using iterator = T *; /**< Iterator type. */
+    using const_iterator = const T *; /**< Constant iterator type. */
+
+    /**
+     * @brief Appends an element.
+     * @param value The element to append.
+     * @return True if the element was appended, false if the vector is full.
+     */
+    bool push_back(const T &value) {
+        if (count >= N) {
+            return false;
+        }
+        items[count++] = value;
+        return true;
+    }
+
+    /**
+     * @brief Removes the elements in [first, last), moving the following elements down.
+     * @param first The first element to remove.
+     * @param last One past the last element to remove.
+     * @return Iterator to the element following the removed ones.
+     */
+    iterator erase(const_iterator first, const_iterator last) {
+        T *target = items + (first - items);
+        T *source = items + (last - items);
+        T *end = items + count;
+        while (source != end) {
+            *target++ = *source++;
+        }
+        size_t removed = static_cast<size_t>(last - first);
+        count -= removed;
+        for (size_t i = count; i < count + removed; i++) {
+            items[i] = T();
+        }
+        return items + (first - items);
+    }
+
+    /**
+     * @brief Removes one element.
+     * @param position The element to remove.
+     * @return Iterator to the element following the removed one.
+     */
+    iterator erase(const_iterator position) {
+        return erase(position, position + 1);
+    }
+
+    /** @brief Removes all elements. */
+    void clear() {
+        erase(begin(), end());
+    }
+
+    /** @brief Gets the number of elements. */
+    size_t size() const { return count; }
+    /** @brief Gets the capacity. */
+    static constexpr size_t capacity() { return N; }
+    /** @brief Checks whether the vector is empty. */
+    bool empty() const { return count == 0; }
+    /** @brief Checks whether the vector is full. */
+    bool full() const { return count == N; }
+    /** @brief Gets a pointer to the elements. */
+    T *data() { return items; }
+    /** @brief Gets a pointer to the elements. */
+    const T *data() const { return items; }
+    /** @brief Gets an iterator to the first element. */
+    iterator begin() { return items; }
+    /** @brief Gets an iterator past the last element. */
+    iterator end() { return items + count; }
+    /** @brief Gets an iterator to the first element. */
+    const_iterator begin() const { return items; }
+    /** @brief Gets an iterator past the last element. */
+    const_iterator end() const { return items + count; }
+    /** @brief Accesses an element without bounds checking. */
+    T &operator[](size_t index) { return items[index]; }
+    /** @brief Accesses an element without bounds checking. */
+    const T &operator[](size_t index) const { return items[index]; }
+
+private:
+    T items[N] = {}; /**< The element storage. */
+    size_t count = 0; /**< The number of elements. */
+};
+
+#endif // ATC_FIXED_VECTOR_H
@@ -0,0 +1,234 @@
+/**
+ * @file ATC_FleetStore.cpp
+ * @brief This file contains the implementation of the ATC_FleetStore class.
+ */
+#include "ATC_FleetStore.h"
+#include <algorithm>
+#include <climits>
+
+/**
+ * @brief Constructor for the ATC_FleetStore class. Reserves space in every array.
+ * @param capacity The number of devices to reserve space for.
+ */
+ATC_FleetStore::ATC_FleetStore(size_t capacity) {
+    address_data.reserve(capacity);
+    temperature_data.reserve(capacity);
+    humidity_data.reserve(capacity);
+    battery_mv_data.reserve(capacity);
+    battery_level_data.reserve(capacity);
+    rssi_data.reserve(capacity);
+    timestamp_data.reserve(capacity);
+}
+
+/**
+ * @brief Packs a MAC address string into an integer. Accepts ':' or '-' separators.
+ * @param address The MAC address string.
+ * @return The packed address, most significant byte first, or 0 if the string is invalid.
+ */
+uint64_t ATC_FleetStore::packAddress(const char *address) {
+    if (!address) {
+        return 0;
+    }
+    uint64_t packed = 0;
+    int digits = 0;
+    for (const char *c = address; *c; c++) {
+        uint8_t nibble;
+        if (*c >= '0' && *c <= '9') {
+            nibble = *c - '0';
+        } else if (*c >= 'a' && *c <= 'f') {
+            nibble = *c - 'a' + 10;
+        } else if (*c >= 'A' && *c <= 'F') {
+            nibble = *c - 'A' + 10;
+        } else if (*c == ':' || *c == '-') {
+            continue;
+        } else {
+            return 0;
+        }
+        packed = (packed << 4) | nibble;
+        digits++;
+    }
+    return digits == 12 ? packed : 0;
+}
+
+/**
+ * @brief Packs a MAC address in NimBLE native order into an integer.
+ * @param nativeAddress The 6 address bytes, least significant byte first.
+ * @return The packed address.
+ */
+uint64_t ATC_FleetStore::packAddress(const uint8_t *nativeAddress) {
+    uint64_t packed = 0;
+    for (int i = 5; i >= 0; i--) {
+        packed = (packed << 8) | nativeAddress[i];
+    }
+    return packed;
+}
+
+/**
+ * @brief Adds a device with an empty reading, or finds it if it is already present.
+ * @param address The packed MAC address.
+ * @return The index of the device.
+ */
+size_t ATC_FleetStore::add(uint64_t address) {
+    long index = find(address);
+    if (index >= 0) {
+        return static_cast<size_t>(index);
+    }
+    address_data.push_back(address);
+    temperature_data.push_back(0);
+    humidity_data.push_back(0);
+    battery_mv_data.push_back(0);
+    battery_level_data.push_back(0);
+    rssi_data.push_back(0);
+    timestamp_data.push_back(0);
+    return address_data.size() - 1;
+}
+
+/**
+ * @brief Finds a device with a linear scan of the contiguous address array.
+ * @param address The packed MAC address.
+ * @return The index of the device, or -1 if not found.
+ */
+long ATC_FleetStore::find(uint64_t address) const {
+    const uint64_t *addresses = address_data.data();
+    const size_t count = address_data.size();
+    for (size_t i = 0; i < count; i++) {
+        if (addresses[i] == address) {
+            return static_cast<long>(i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Stores a reading of a device. Only the fields flagged in the reading are updated.
+ * @param index The index of the device.
+ * @param reading The reading to store.
+ * @param rssi The RSSI of the advertisement in dBm.
+ * @param timestamp The time the reading was received, a timestamp of 0 is stored as 1.
+ */
+void ATC_FleetStore::update(size_t index, const ATC_MiThermometer_Reading &reading, int8_t rssi, uint32_t timestamp) {
+    if (index >= address_data.size()) {
+        return;
+    }
+    if (reading.fields & READING_TEMPERATURE) {
+        temperature_data[index] = reading.temperature;
+    }
+    if (reading.fields & READING_HUMIDITY) {
+        humidity_data[index] = reading.humidity;
+    }
+    if (reading.fields & READING_BATTERY_MV) {
+        battery_mv_data[index] = reading.battery_mv;
+    }
+    if (reading.fields & READING_BATTERY_LEVEL) {
+        battery_level_data[index] = reading.battery_level;
+    }
+    rssi_data[index] = rssi;
+    timestamp_data[index] = timestamp ? timestamp : 1;
+}
+
+/**
+ * @brief Stores the latest reading of a compact thermometer, adding it if needed.
+ * @param thermometer The compact thermometer.
+ * @return The index of the device.
+ */
+size_t ATC_FleetStore::update(const ATC_CompactThermometer &thermometer) {
+    size_t index = add(packAddress(thermometer.address));
+    ATC_MiThermometer_Reading reading{};
+    reading.temperature = thermometer.temperature;
+    reading.humidity = thermometer.humidity;
+    reading.battery_mv = thermometer.battery_mv;
+    reading.battery_level = thermometer.battery_level;
+    reading.fields = thermometer.fields;
+    update(index, reading, thermometer.rssi, thermometer.last_seen);
+    return index;
+}
+
+/**
+ * @brief Gets the number of devices.
+ * @return The number of devices.
+ */
+size_t ATC_FleetStore::size() const {
+    return address_data.size();
+}
+
+/**
+ * @brief Computes min, max and mean of a field over the devices seen since a given time.
+ * The loop uses masks instead of branches so it can be vectorised.
+ * @tparam T The type of the field.
+ * @param values The field array.
+ * @param since Only devices with a non zero timestamp greater than or equal to this are included.
+ * @return The statistics.
+ */
+template<typename T>
+ATC_FleetStats ATC_FleetStore::stats(const std::vector<T> &values, uint32_t since) const {
+    const T *data = values.data();
+    const uint32_t *times = timestamp_data.data();
+    const size_t count = values.size();
+    // Devices never seen have a timestamp of 0, so they are excluded by starting at 1.
+    const uint32_t first = since ? since : 1;
+    int32_t minValue = INT32_MAX;
+    int32_t maxValue = INT32_MIN;
+    int64_t sum = 0;
+    uint32_t included = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t mask = -static_cast<int32_t>(times[i] >= first);
+        int32_t value = data[i];
+        minValue = std::min(minValue, (value & mask) | (INT32_MAX & ~mask));
+        maxValue = std::max(maxValue, (value & mask) | (INT32_MIN & ~mask));
+        sum += value & mask;
+        included -= mask;
+    }
+    ATC_FleetStats result{};
+    if (included) {
+        result.count = included;
+        result.min = minValue;
+        result.max = maxValue;
+        result.mean = static_cast<float>(sum) / static_cast<float>(included);
+    }
+    return result;
+}
+
+/**
+ * @brief Computes the temperature statistics of the devices seen since a given time.
+ * @param since Only devices with a timestamp greater than or equal to this are included.
+ * @return The statistics in 0.01 degrees Celsius.
+ */
+ATC_FleetStats ATC_FleetStore::temperatureStats(uint32_t since) const {
+    return stats(temperature_data, since);
+}
+
+/**
+ * @brief Computes the humidity statistics of the devices seen since a given time.
+ * @param since Only devices with a timestamp greater than or equal to this are included.
+ * @return The statistics in 0.01 percent.
+ */
+ATC_FleetStats ATC_FleetStore::humidityStats(uint32_t since) const {
+    return stats(humidity_data, since);
+}
+
+/**
+ * @brief Computes the battery voltage statistics of the devices seen since a given time.
+ * @param since Only devices with a timestamp greater than or equal to this are included.
+ * @return The statistics in mV.
+ */
+ATC_FleetStats ATC_FleetStore::batteryStats(uint32_t since) const {
+    return stats(battery_mv_data, since);
+}
+
+/**
+ * @brief Finds the devices not seen since a given time, including devices never seen.
+ * @param since The time before which a device is stale.
+ * @param indexes Receives the indexes of the stale devices, previous content is cleared.
+ * @return The number of stale devices.
+ */
+size_t ATC_FleetStore::staleSince(uint32_t since, std::vector<size_t> &indexes) const {
+    indexes.clear();
+    const uint32_t *times = timestamp_data.data();
+    const size_t count = timestamp_data.size();
+    for (size_t i = 0; i < count; i++) {
+        if (times[i] < since) {
+            indexes.push_back(i);
+        }
+    }
+    return indexes.size();
+}
@@ -0,0 +1,155 @@
+/**
+ * @file ATC_FleetStore.h
+ * @brief This file contains the declaration of the ATC_FleetStore class, which stores the latest readings of
+ * many thermometers in parallel contiguous arrays for fast bulk queries.
+ * The class only depends on the standard library, so it can also be used on a host aggregating readings.
+ */
+#ifndef ATC_FLEET_STORE_H
+#define ATC_FLEET_STORE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @struct ATC_FleetStats
+ * @brief This structure holds the result of an aggregate query over the fleet.
+ */
+struct ATC_FleetStats {
+    size_t count; /**< Number of devices included, the other fields are 0 if it is 0. */
+    int32_t min; /**< The minimum value in the raw unit of the field. */
+    int32_t max; /**< The maximum value in the raw unit of the field. */
+    float mean; /**< The mean value in the raw unit of the field. */
+};
+
+/**
+ * @class ATC_FleetStore
+ * @brief This class stores the hot fields of a fleet of thermometers in a structure of arrays: one contiguous
+ *        array per field, indexed by device. Aggregate queries run as simple loops over one or two arrays,
+ *        which the compiler can vectorise, instead of chasing pointers to scattered thermometer objects.
+ *        Devices are never removed, so indexes stay valid. The store is not thread safe.
+ */
+class ATC_FleetStore {
+public:
+    /**
+     * @brief Constructor for the ATC_FleetStore class.
+     * @param capacity The number of devices to reserve space for.
+     */
+    explicit ATC_FleetStore(size_t capacity = 0);
+
+    /**
+     * @brief Packs a MAC address string such as "A4:C1:38:01:02:03" into an integer.
+     * @param address The MAC address string.
+     * @return The packed address, most significant byte first, or 0 if the string is invalid.
+     */
+    static uint64_t packAddress(const char *address);
+
+    /**
+     * @brief Packs a MAC address in NimBLE native order (least significant byte first) into an integer.
+     * @param nativeAddress The 6 address bytes.
+     * @return The packed address.
+     */
+    static uint64_t packAddress(const uint8_t *nativeAddress);
+
+    /**
+     * @brief Adds a device, or finds it if it is already present.
+     * @param address The packed MAC address.
+     * @return The index of the device.
+     */
+    size_t add(uint64_t address);
+
+    /**
+     * @brief Finds a device.
+     * @param address The packed MAC address.
+     * @return The index of the device, or -1 if not found.
+     */
+    long find(uint64_t address) const;
+
+    /**
+     * @brief Stores a reading of a device. Only the fields flagged in the reading are updated.
+     * @param index The index of the device.
+     * @param reading The reading to store.
+     * @param rssi The RSSI of the advertisement in dBm.
+     * @param timestamp The time the reading was received, in the caller's time base (millis() on the ESP32).
+     */
+    void update(size_t index, const ATC_MiThermometer_Reading &reading, int8_t rssi, uint32_t timestamp);
+
+    /**
+     * @brief Stores the latest reading of a compact thermometer, adding it if needed.
+     * @param thermometer The compact thermometer.
+     * @return The index of the device.
+     */
+    size_t update(const ATC_CompactThermometer &thermometer);
+
+    /**
+     * @brief Gets the number of devices.
+     * @return The number of devices.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Computes the temperature statistics of the devices seen since a given time.
+     * @param since Only devices with a timestamp greater than or equal to this are included.
+     * @return The statistics in 0.01 degrees Celsius.
+     */
+    ATC_FleetStats temperatureStats(uint32_t since = 1) const;
+
+    /**
+     * @brief Computes the humidity statistics of the devices seen since a given time.
+     * @param since Only devices with a timestamp greater than or equal to this are included.
+     * @return The statistics in 0.01 percent.
+     */
+    ATC_FleetStats humidityStats(uint32_t since = 1) const;
+
+    /**
+     * @brief Computes the battery voltage statistics of the devices seen since a given time.
+     * @param since Only devices with a timestamp greater than or equal to this are included.
+     * @return The statistics in mV.
+     */
+    ATC_FleetStats batteryStats(uint32_t since = 1) const;
+
+    /**
+     * @brief Finds the devices not seen since a given time, including devices never seen.
+     * @param since The time before which a device is stale.
+     * @param indexes Receives the indexes of the stale devices.
+     * @return The number of stale devices.
+     */
+    size_t staleSince(uint32_t since, std::vector<size_t> &indexes) const;
+
+    /** @brief Gets the packed addresses array. */
+    const uint64_t *addresses() const { return address_data.data(); }
+    /** @brief Gets the temperatures array in 0.01 degrees Celsius. */
+    const int16_t *temperatures() const { return temperature_data.data(); }
+    /** @brief Gets the humidities array in 0.01 percent. */
+    const uint16_t *humidities() const { return humidity_data.data(); }
+    /** @brief Gets the battery voltages array in mV. */
+    const uint16_t *batteryVoltages() const { return battery_mv_data.data(); }
+    /** @brief Gets the battery levels array in percent. */
+    const uint8_t *batteryLevels() const { return battery_level_data.data(); }
+    /** @brief Gets the RSSI array in dBm. */
+    const int8_t *rssis() const { return rssi_data.data(); }
+    /** @brief Gets the timestamps array, 0 for devices never seen. */
+    const uint32_t *timestamps() const { return timestamp_data.data(); }
+
+private:
+    std::vector<uint64_t> address_data; /**< Packed MAC addresses. */
+    std::vector<int16_t> temperature_data; /**< Temperatures in 0.01 degrees Celsius. */
+    std::vector<uint16_t> humidity_data; /**< Humidities in 0.01 percent. */
+    std::vector<uint16_t> battery_mv_data; /**< Battery voltages in mV. */
+    std::vector<uint8_t> battery_level_data; /**< Battery levels in percent. */
+    std::vector<int8_t> rssi_data; /**< RSSI of the latest advertisements in dBm. */
+    std::vector<uint32_t> timestamp_data; /**< Times of the latest readings, 0 if never seen. */
+
+    /**
+     * @brief Computes min, max and mean of a field over the devices seen since a given time.
+     * @tparam T The type of the field.
+     * @param values The field array.
+     * @param since Only devices with a timestamp greater than or equal to this are included.
+     * @return The statistics.
+     */
+    template<typename T>
+    ATC_FleetStats stats(const std::vector<T> &values, uint32_t since) const;
+};
+
+#endif // ATC_FLEET_STORE_H
@@ -3,25 +3,109 @@
  * @brief This file contains the implementation of the ATC_MiThermometer class.
  */
 #include "ATC_MiThermometer.h"
+#include "ATC_AdvertisingDecoder.h"
 #include <cmath>
 #include <algorithm>
 #include <mutex>
 #include <map>
+#include <cctype>
+#include <cstring>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+static std::mutex clientMutex; /**< Mutex serializing the creation of BLE clients and connection establishment. */
+static std::mutex gattPoolMutex; /**< Mutex protecting the GATT state pool. */
+static ATC_MiThermometer_GattState gattPool[gatt_state_pool_size]; /**< GATT states of the active connections. */
+static bool gattPoolUsed[gatt_state_pool_size]; /**< Flags marking the GATT states in use. */
+
+/**
+ * @brief Takes a GATT state from the pool.
+ * @return The GATT state, cleared, or nullptr if all are in use.
+ */
+static ATC_MiThermometer_GattState *acquireGattState() {
+    std::lock_guard<std::mutex> lock(gattPoolMutex);
+    for (size_t i = 0; i < gatt_state_pool_size; i++) {
+        if (!gattPoolUsed[i]) {
+            gattPoolUsed[i] = true;
+            gattPool[i] = ATC_MiThermometer_GattState();
+            return &gattPool[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Returns a GATT state to the pool.
+ * @param state The GATT state to release.
+ */
+static void releaseGattState(ATC_MiThermometer_GattState *state) {
+    std::lock_guard<std::mutex> lock(gattPoolMutex);
+    size_t index = static_cast<size_t>(state - gattPool);
+    if (index < gatt_state_pool_size) {
+        gattPoolUsed[index] = false;
+    }
+}
+
+/**
+ * @brief Builds the flash key for the history watermark of a device: the MAC address in lower case without separators.
+ * Preferences keys are limited to 15 characters, longer keys are truncated.
+ * @param address The MAC address of the device.
+ * @param key Buffer receiving the key, 12 characters long for a well formed address.
+ */
+static void watermarkKey(const std::string &address, char (&key)[16]) {
+    size_t length = 0;
+    for (char c: address) {
+        if (c != ':' && length < sizeof(key) - 1) {
+            key[length++] = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    key[length] = '\0';
+}
+
+/**
+ * @class ScopedOperationTimer
+ * @brief Adds the time between its construction and destruction to the statistics of an operation type.
+ */
+class ScopedOperationTimer {
+public:
+    explicit ScopedOperationTimer(ATC_MiThermometer_OperationStats &stats) : stats(stats), start(millis()) {}
+
+    ~ScopedOperationTimer() {
+        uint32_t elapsed = millis() - start;
+        stats.count++;
+        stats.total_ms += elapsed;
+        if (elapsed > stats.max_ms) {
+            stats.max_ms = elapsed;
+        }
+    }
 
-static std::mutex bleMutex; /**< Mutex for thread safety during BLE operations. */
+private:
+    ATC_MiThermometer_OperationStats &stats; /**< The statistics to update. */
+    uint32_t start; /**< millis() at construction. */
+};
 /**
  * @brief Constructor for the ATC_MiThermometer class.
  * @param address The MAC address of the thermometer.
  * @param connection_mode The connection mode to use (ADVERTISING, NOTIFICATION, or CONNECTION). Defaults to ADVERTISING.
  */
 ATC_MiThermometer::ATC_MiThermometer(const char *address, Connection_mode connection_mode)
-        : address(address), pClient(nullptr), environmentService(nullptr), connection_mode(connection_mode),
-          batteryService(nullptr), commandService(nullptr), temperatureCharacteristic(nullptr),
-          temperaturePreciseCharacteristic(nullptr), humidityCharacteristic(nullptr), batteryCharacteristic(nullptr),
-          commandCharacteristic(nullptr), received_settings(false), read_settings(false), started_notify_temp(false),
-          started_notify_temp_precise(false), started_notify_humidity(false), started_notify_battery(false),
-          temperature(0), temperature_precise(0), humidity(0), battery_mv(0), battery_level(0), time_tracking(false),
-          last_read_time(0) {
+        : address(address), gatt(nullptr), connection_mode(connection_mode), received_settings(false),
+          read_settings(false), temperature(0), temperature_precise(0), humidity(0), battery_mv(0), battery_level(0), time_tracking(false),
+          last_read_time(0), received_history_end(false), history_last_notify_time(0), history_reached_since(false),
+          history_full(false), history_received(0), history_requested(0), history_since(0), history_until(0),
+          history_backfill(false), backfill_pending(false), backfill_offset(0), backfill_newest(0), backfill_oldest(0),
+          backfill_gap_ms(0),
+          last_advertising_time(0), history_watermark(0), command_queue(),
+          command_queue_count(0), commands_acknowledged(0), commands_sent(0), command_stats(),
+          connection_profile(Connection_profile::STANDARD), operation_stats(), reading_observer(nullptr),
+          last_reading(), notification_timer(nullptr), last_rssi(0), lazy_init(false), init_pending(false),
+          format_detected(false), operation_deadline(0), async_read_state(Async_read_state::IDLE) {
+    NimBLEAddress bleAddress{this->address};
+    memcpy(native_address, bleAddress.getNative(), sizeof(native_address));
+#if ATC_STATIC_ALLOCATION
+    history.reserve(ATC_HISTORY_CAPACITY);
+#endif
 }
 
 /**
@@ -29,29 +113,119 @@ ATC_MiThermometer::ATC_MiThermometer(const char *address, Connection_mode connec
  */
 ATC_MiThermometer::~ATC_MiThermometer() {
     disconnect();
+    deleteNotificationTimer();
 }
 
 /**
- * @brief Connects to the thermometer.  Attempts to connect up to 5 times.
+ * @brief Connects to the thermometer.  Attempts to connect up to 5 times, stopping early when the deadline set by
+ * init(uint32_t) has passed. Thermometers connect in parallel from several tasks, but the NimBLE host establishes one
+ * connection at a time, so each attempt holds clientMutex.
  */
 void ATC_MiThermometer::connect() {
-    std::lock_guard<std::mutex> lock(bleMutex);
-    if (pClient && pClient->isConnected()) {
-        pClient->disconnect();
-    }
-    pClient = NimBLEDevice::createClient();
-    if (!pClient) {
-        Serial.println("Failed to create BLE client");
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::CONNECT)]);
+    if (!createClient()) {
         return;
     }
-    NimBLEAddress bleAddress(address);
-    for (int i = 0; i < 5; i++) {
-        if (pClient->connect(bleAddress)) {
+    for (int i = 0; i < 5 && !deadlinePassed(); i++) {
+        if (tryConnect()) {
             return;
         }
         delay(1000);
     }
-    Serial.printf("Failed to connect to %s after 5 attempts\n", address.c_str());
+    Serial.printf("Failed to connect to %s\n", address.c_str());
+}
+
+/**
+ * @brief Takes a GATT state from the pool, or clears the current one, and creates a new BLE client with the
+ * parameters of the connection profile.
+ * @return True if the client was created, false otherwise.
+ */
+bool ATC_MiThermometer::createClient() {
+    std::lock_guard<std::mutex> clientLock(clientMutex);
+    if (gatt) {
+        if (gatt->pClient) {
+            NimBLEDevice::deleteClient(gatt->pClient);
+        }
+        *gatt = ATC_MiThermometer_GattState();
+    } else {
+        gatt = acquireGattState();
+        if (!gatt) {
+            Serial.println("No free GATT state, too many connections");
+            return false;
+        }
+    }
+    gatt->pClient = NimBLEDevice::createClient();
+    if (!gatt->pClient) {
+        Serial.println("Failed to create BLE client");
+        return false;
+    }
+    if (connection_profile != Connection_profile::STANDARD) {
+        ATC_MiThermometer_ConnectionParams params = getConnectionProfileParams(connection_profile);
+        gatt->pClient->setConnectionParams(params.min_interval, params.max_interval, params.latency,
+                                           params.supervision_timeout);
+    }
+    return true;
+}
+
+/**
+ * @brief Connects a BLE client, requesting an MTU for this connection only. NimBLE only has a global preferred MTU,
+ * used by the MTU exchange it starts on connection, so it is set for the attempt and the previous one restored
+ * afterwards. The caller holds clientMutex, which keeps the other connections from starting their exchange in between.
+ * @param client The client to connect.
+ * @param address The MAC address of the device.
+ * @param mtu The MTU to request, 0 for the preferred MTU.
+ * @return True if connected, false otherwise.
+ */
+static bool connectClientLocked(NimBLEClient *client, const std::string &address, uint16_t mtu) {
+    if (!mtu) {
+        return client->connect(NimBLEAddress(address));
+    }
+    uint16_t previousMtu = NimBLEDevice::getMTU();
+    NimBLEDevice::setMTU(mtu);
+    bool connected = client->connect(NimBLEAddress(address));
+    NimBLEDevice::setMTU(previousMtu);
+    return connected;
+}
+
+/**
+ * @brief Makes one connection attempt with the client created by createClient(). The attempt is shortened to the
+ * time left before the deadline set by init(uint32_t), and requests the MTU of the connection profile. Fails at once
+ * if the deadline has passed, also while waiting for clientMutex.
+ * @return True if connected, false otherwise.
+ */
+bool ATC_MiThermometer::tryConnect() {
+    if (!gatt || !gatt->pClient) {
+        return false;
+    }
+    std::lock_guard<std::mutex> clientLock(clientMutex);
+    if (operation_deadline) {
+        // Signed, so that a deadline already passed gives a negative time instead of wrapping around
+        auto remaining = static_cast<int32_t>(operation_deadline - millis());
+        if (remaining <= 0) {
+            return false;
+        }
+        // Shorten the attempt to the remaining time, in whole seconds from 1 to 255 as NimBLE expects
+        gatt->pClient->setConnectTimeout(static_cast<uint8_t>(std::min<int32_t>(std::max<int32_t>(remaining / 1000, 1),
+                                                                                 255)));
+    }
+    return connectClientLocked(gatt->pClient, address, getConnectionProfileParams(connection_profile).mtu);
+}
+
+/**
+ * @brief Connects a BLE client, requesting an MTU for this connection only. Holds clientMutex, so the connections
+ * of all thermometers and of ATC_OtaUpdater are established one at a time and never see each other's MTU.
+ * @param client The client to connect.
+ * @param address The MAC address of the device.
+ * @param mtu The MTU to request, 0 for the preferred MTU.
+ * @return True if connected, false otherwise.
+ */
+bool ATC_MiThermometer::connectClient(NimBLEClient *client, const std::string &address, uint16_t mtu) {
+    if (!client) {
+        return false;
+    }
+    std::lock_guard<std::mutex> clientLock(clientMutex);
+    return connectClientLocked(client, address, mtu);
 }
 
 /**
@@ -59,15 +233,18 @@ void ATC_MiThermometer::connect() {
  * @return True if connected, false otherwise.
  */
 bool ATC_MiThermometer::isConnected() const {
-    return pClient && pClient->isConnected();
+    return gatt && gatt->pClient && gatt->pClient->isConnected();
 }
 
 /**
  * @brief Connects to the environment service.  Prints an error message if the service is not found.
  */
 void ATC_MiThermometer::connectToEnvironmentService() {
-    environmentService = pClient->getService("181A"); // Environmental Sensing Service
-    if (!environmentService) {
+    if (!gatt || !gatt->pClient) {
+        return;
+    }
+    gatt->environmentService = gatt->pClient->getService("181A"); // Environmental Sensing Service
+    if (!gatt || !gatt->environmentService) {
         Serial.printf("Failed to find service %s\n", "181A");
     }
 }
@@ -76,14 +253,14 @@ void ATC_MiThermometer::connectToEnvironmentService() {
  * @brief Connects to the temperature characteristic.  Prints an error message if the characteristic is not found.
  */
 void ATC_MiThermometer::connectToTemperatureCharacteristic() {
-    if (!environmentService) {
+    if (!gatt || !gatt->environmentService) {
         connectToEnvironmentService();
-        if (!environmentService) {
+        if (!gatt || !gatt->environmentService) {
             return;
         }
     }
-    temperatureCharacteristic = environmentService->getCharacteristic("2A1F"); // Temperature characteristic UUID
-    if (!temperatureCharacteristic) {
+    gatt->temperatureCharacteristic = gatt->environmentService->getCharacteristic("2A1F"); // Temperature characteristic UUID
+    if (!gatt || !gatt->temperatureCharacteristic) {
         Serial.printf("Failed to find characteristic %s\n", "2A1F");
     }
 }
@@ -93,18 +270,18 @@ void ATC_MiThermometer::connectToTemperatureCharacteristic() {
  *        Prints an error message if the characteristic is not found or cannot notify.
  */
 void ATC_MiThermometer::beginNotifyTemp() {
-    if (!temperatureCharacteristic) {
+    if (!gatt || !gatt->temperatureCharacteristic) {
         connectToTemperatureCharacteristic();
-        if (!temperatureCharacteristic) {
+        if (!gatt || !gatt->temperatureCharacteristic) {
             return;
         }
     }
-    if (temperatureCharacteristic->canNotify()) {
-        temperatureCharacteristic->subscribe(true, [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
+    if (gatt->temperatureCharacteristic->canNotify()) {
+        gatt->temperatureCharacteristic->subscribe(true, [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
                                                           const uint8_t *pData, size_t length, bool isNotify) {
             this->notifyTempCallback(pBLERemoteCharacteristic, pData, length, isNotify);
         });
-        started_notify_temp = true;
+        gatt->started_notify_temp = true;
     } else {
         Serial.println("Temperature characteristic cannot notify");
 
@@ -112,7 +289,7 @@ void ATC_MiThermometer::beginNotifyTemp() {
 }
 
 /**
- * @brief Callback function for temperature notifications.  Updates the internal temperature value.
+ * @brief Callback function for temperature notifications.  Adds the temperature to the current measurement cycle.
  *        Prints an error message if invalid data is received.
  * @param pBLERemoteCharacteristic Pointer to the characteristic that triggered the notification.
  * @param pData Pointer to the notification data.
@@ -122,11 +299,10 @@ void ATC_MiThermometer::beginNotifyTemp() {
 void ATC_MiThermometer::notifyTempCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData,
                                            size_t length, bool isNotify) {
     if (length >= 2) {
-        uint16_t temp = (pData[1] << 8) | pData[0];
-        temperature = static_cast<float>(temp) / 10.0f;
-        if (time_tracking) {
-            last_read_time = time(nullptr);
-        }
+        ATC_MiThermometer_Reading partial{};
+        partial.temperature = static_cast<int16_t>(static_cast<int16_t>((pData[1] << 8) | pData[0]) * 10);
+        partial.fields = READING_TEMPERATURE;
+        coalesceNotification(NOTIFY_TEMPERATURE, partial);
     } else {
         Serial.println("Received invalid temperature data");
     }
@@ -136,15 +312,15 @@ void ATC_MiThermometer::notifyTempCallback(NimBLERemoteCharacteristic *pBLERemot
  * @brief Connects to the precise temperature characteristic.
  */
 void ATC_MiThermometer::connectToTemperaturePreciseCharacteristic() {
-    if (!environmentService) {
+    if (!gatt || !gatt->environmentService) {
         connectToEnvironmentService();
-        if (!environmentService) {
+        if (!gatt || !gatt->environmentService) {
             return;
         }
     }
-    temperaturePreciseCharacteristic = environmentService->getCharacteristic(
+    gatt->temperaturePreciseCharacteristic = gatt->environmentService->getCharacteristic(
             "2A6E"); // Precise Temperature characteristic UUID
-    if (!temperaturePreciseCharacteristic) {
+    if (!gatt || !gatt->temperaturePreciseCharacteristic) {
         Serial.printf("Failed to find characteristic %s\n", "2A6E");
         return;
     }
@@ -154,25 +330,26 @@ void ATC_MiThermometer::connectToTemperaturePreciseCharacteristic() {
  * @brief Begins notifications for precise temperature. Subscribes to the precise temperature characteristic's notifications.
  */
 void ATC_MiThermometer::beginNotifyTempPrecise() {
-    if (!temperaturePreciseCharacteristic) {
+    if (!gatt || !gatt->temperaturePreciseCharacteristic) {
         connectToTemperaturePreciseCharacteristic();
-        if (!temperaturePreciseCharacteristic) {
+        if (!gatt || !gatt->temperaturePreciseCharacteristic) {
             return;
         }
     }
-    if (temperaturePreciseCharacteristic->canNotify()) {
-        temperaturePreciseCharacteristic->subscribe(true, [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
+    if (gatt->temperaturePreciseCharacteristic->canNotify()) {
+        gatt->temperaturePreciseCharacteristic->subscribe(true, [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
                                                                  const uint8_t *pData, size_t length, bool isNotify) {
             this->notifyTempPreciseCallback(pBLERemoteCharacteristic, pData, length, isNotify);
         });
-        started_notify_temp_precise = true;
+        gatt->started_notify_temp_precise = true;
     } else {
         Serial.println("Precise Temperature characteristic cannot notify");
     }
 }
 
 /**
- * @brief Callback function for precise temperature notifications.  Updates the internal precise temperature value.
+ * @brief Callback function for precise temperature notifications.  Adds the precise temperature to the current
+ *        measurement cycle.
  *        Prints an error message if invalid data is received.
  * @param pBLERemoteCharacteristic Pointer to the characteristic that triggered the notification.
  * @param pData Pointer to the notification data.
@@ -183,11 +360,10 @@ void
 ATC_MiThermometer::notifyTempPreciseCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData,
                                              size_t length, bool isNotify) {
     if (length >= 2) {
-        uint16_t temp = (pData[1] << 8) | pData[0];
-        temperature_precise = static_cast<float>(temp) / 100.0f;
-        if (time_tracking) {
-            last_read_time = time(nullptr);
-        }
+        ATC_MiThermometer_Reading partial{};
+        partial.temperature = static_cast<int16_t>((pData[1] << 8) | pData[0]);
+        partial.fields = READING_TEMPERATURE;
+        coalesceNotification(NOTIFY_TEMPERATURE_PRECISE, partial);
     } else {
         Serial.println("Received invalid precise temperature data");
     }
@@ -197,14 +373,14 @@ ATC_MiThermometer::notifyTempPreciseCallback(NimBLERemoteCharacteristic *pBLERem
 * @brief Connects to the humidity characteristic. Prints an error message if the characteristic is not found.
 */
 void ATC_MiThermometer::connectToHumidityCharacteristic() {
-    if (!environmentService) {
+    if (!gatt || !gatt->environmentService) {
         connectToEnvironmentService();
-        if (!environmentService) {
+        if (!gatt || !gatt->environmentService) {
             return;
         }
     }
-    humidityCharacteristic = environmentService->getCharacteristic("2A6F"); // Humidity characteristic UUID
-    if (!humidityCharacteristic) {
+    gatt->humidityCharacteristic = gatt->environmentService->getCharacteristic("2A6F"); // Humidity characteristic UUID
+    if (!gatt || !gatt->humidityCharacteristic) {
         Serial.printf("Failed to find characteristic %s\n", "2A6F");
     }
 }
@@ -214,27 +390,27 @@ void ATC_MiThermometer::connectToHumidityCharacteristic() {
  *        Prints an error message if the characteristic is not found or cannot notify.
  */
 void ATC_MiThermometer::beginNotifyHumidity() {
-    if (!humidityCharacteristic) {
+    if (!gatt || !gatt->humidityCharacteristic) {
         connectToHumidityCharacteristic();
-        if (!humidityCharacteristic) {
+        if (!gatt || !gatt->humidityCharacteristic) {
             return;
         }
     }
-    if (humidityCharacteristic->canNotify()) {
-        humidityCharacteristic->subscribe(true,
+    if (gatt->humidityCharacteristic->canNotify()) {
+        gatt->humidityCharacteristic->subscribe(true,
                                           [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
                                                  const uint8_t *pData, size_t length, bool isNotify) {
                                               this->notifyHumidityCallback(pBLERemoteCharacteristic, pData, length,
                                                                            isNotify);
                                           });
-        started_notify_humidity = true;
+        gatt->started_notify_humidity = true;
     } else {
         Serial.println("Humidity characteristic cannot notify");
     }
 }
 
 /**
- * @brief Callback function for humidity notifications.  Updates the internal humidity value.
+ * @brief Callback function for humidity notifications.  Adds the humidity to the current measurement cycle.
  *      Prints an error message if invalid data is received.
  * @param pBLERemoteCharacteristic Pointer to the characteristic that triggered the notification.
  * @param pData Pointer to the notification data.
@@ -245,11 +421,10 @@ void
 ATC_MiThermometer::notifyHumidityCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData,
                                           size_t length, bool isNotify) {
     if (length >= 2) {
-        uint16_t hum = (pData[1] << 8) | pData[0];
-        humidity = static_cast<float>(hum) / 100.0f;
-        if (time_tracking) {
-            last_read_time = time(nullptr);
-        }
+        ATC_MiThermometer_Reading partial{};
+        partial.humidity = static_cast<uint16_t>((pData[1] << 8) | pData[0]);
+        partial.fields = READING_HUMIDITY;
+        coalesceNotification(NOTIFY_HUMIDITY, partial);
     } else {
         Serial.println("Received invalid humidity data");
     }
@@ -259,8 +434,11 @@ ATC_MiThermometer::notifyHumidityCallback(NimBLERemoteCharacteristic *pBLERemote
  * @brief  Connects to the battery service.
  */
 void ATC_MiThermometer::connectToBatteryService() {
-    batteryService = pClient->getService("180F"); // Battery Service UUID
-    if (!batteryService) {
+    if (!gatt || !gatt->pClient) {
+        return;
+    }
+    gatt->batteryService = gatt->pClient->getService("180F"); // Battery Service UUID
+    if (!gatt || !gatt->batteryService) {
         Serial.printf("Failed to find service %s\n", "180F");
 
         return;
@@ -271,14 +449,14 @@ void ATC_MiThermometer::connectToBatteryService() {
  * @brief Connects to the battery characteristic.  Prints an error message if the characteristic is not found.
  */
 void ATC_MiThermometer::connectToBatteryCharacteristic() {
-    if (!batteryService) {
+    if (!gatt || !gatt->batteryService) {
         connectToBatteryService();
-        if (!batteryService) {
+        if (!gatt || !gatt->batteryService) {
             return;
         }
     }
-    batteryCharacteristic = batteryService->getCharacteristic("2A19"); // Battery Level characteristic UUID
-    if (!batteryCharacteristic) {
+    gatt->batteryCharacteristic = gatt->batteryService->getCharacteristic("2A19"); // Battery Level characteristic UUID
+    if (!gatt || !gatt->batteryCharacteristic) {
         Serial.printf("Failed to find characteristic %s\n", "2A19");
     }
 }
@@ -288,20 +466,20 @@ void ATC_MiThermometer::connectToBatteryCharacteristic() {
  *         Prints an error message if the characteristic is not found or cannot notify.
  */
 void ATC_MiThermometer::beginNotifyBattery() {
-    if (!batteryCharacteristic) {
+    if (!gatt || !gatt->batteryCharacteristic) {
         connectToBatteryCharacteristic();
-        if (!batteryCharacteristic) {
+        if (!gatt || !gatt->batteryCharacteristic) {
             return;
         }
     }
-    if (batteryCharacteristic->canNotify()) {
-        batteryCharacteristic->subscribe(true,
+    if (gatt->batteryCharacteristic->canNotify()) {
+        gatt->batteryCharacteristic->subscribe(true,
                                          [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
                                                 const uint8_t *pData, size_t length, bool isNotify) {
                                              this->notifyBatteryCallback(pBLERemoteCharacteristic, pData, length,
                                                                          isNotify);
                                          });
-        started_notify_battery = true;
+        gatt->started_notify_battery = true;
     } else {
         Serial.println("Battery characteristic cannot notify");
 
@@ -309,7 +487,8 @@ void ATC_MiThermometer::beginNotifyBattery() {
 }
 
 /**
- * @brief Callback function for battery level notifications.  Updates the internal battery level value.
+ * @brief Callback function for battery level notifications.  Adds the battery level to the current measurement
+ *        cycle.
  *        Prints an error message if invalid data is received.
  * @param pBLERemoteCharacteristic  Pointer to the characteristic that triggered the notification.
  * @param pData Pointer to the notification data.
@@ -320,10 +499,10 @@ void
 ATC_MiThermometer::notifyBatteryCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData,
                                          size_t length, bool isNotify) {
     if (length >= 1) {
-        battery_level = pData[0];
-        if (time_tracking) {
-            last_read_time = time(nullptr);
-        }
+        ATC_MiThermometer_Reading partial{};
+        partial.battery_level = pData[0];
+        partial.fields = READING_BATTERY_LEVEL;
+        coalesceNotification(NOTIFY_BATTERY_LEVEL, partial);
     } else {
         Serial.println("Received invalid battery level data");
     }
@@ -333,8 +512,11 @@ ATC_MiThermometer::notifyBatteryCallback(NimBLERemoteCharacteristic *pBLERemoteC
  * @brief Connects to the command service. Prints an error message if the service is not found.
  */
 void ATC_MiThermometer::connectToCommandService() {
-    commandService = pClient->getService("1F10"); // Command Service UUID
-    if (!commandService) {
+    if (!gatt || !gatt->pClient) {
+        return;
+    }
+    gatt->commandService = gatt->pClient->getService("1F10"); // Command Service UUID
+    if (!gatt || !gatt->commandService) {
         Serial.printf("Failed to find service %s\n", "1F10");
     }
 }
@@ -343,25 +525,60 @@ void ATC_MiThermometer::connectToCommandService() {
  * @brief Connects to the command characteristic.  Prints an error message if the characteristic is not found.
  */
 void ATC_MiThermometer::connectToCommandCharacteristic() {
-    if (!commandService) {
+    if (!gatt || !gatt->commandService) {
         connectToCommandService();
-        if (!commandService) {
+        if (!gatt || !gatt->commandService) {
             return;
         }
     }
-    commandCharacteristic = commandService->getCharacteristic("1F1F"); // Command characteristic UUID
-    if (!commandCharacteristic) {
+    gatt->commandCharacteristic = gatt->commandService->getCharacteristic("1F1F"); // Command characteristic UUID
+    if (!gatt || !gatt->commandCharacteristic) {
         Serial.printf("Failed to find characteristic %s\n", "1F1F");
     }
 }
 
+/**
+ * @brief Finds the command characteristic and subscribes to its notifications with the settings callback.
+ * Clears the received settings flag. Prints error messages if the service or characteristic is missing.
+ * @return True if subscribed, false otherwise.
+ */
+bool ATC_MiThermometer::subscribeSettings() {
+    if (!gatt || !gatt->commandService) {
+        connectToCommandService();
+        if (!gatt || !gatt->commandService) {
+            Serial.println("Command service not found");
+            return false;
+        }
+    }
+    if (!gatt || !gatt->commandCharacteristic) {
+        connectToCommandCharacteristic();
+        if (!gatt || !gatt->commandCharacteristic) {
+            Serial.println("Command characteristic not found");
+            return false;
+        }
+    }
+    received_settings = false;
+    if (!gatt->commandCharacteristic->canNotify()) {
+        Serial.println("Command characteristic cannot notify");
+        return false;
+    }
+    gatt->commandCharacteristic->subscribe(true,
+                                     [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
+                                            const uint8_t *pData, size_t length, bool isNotify) {
+                                         this->notifySettingsCallback(pBLERemoteCharacteristic, pData, length,
+                                                                      isNotify);
+                                     });
+    return true;
+}
+
 /**
  * @brief Reads the settings from the thermometer.  Connects to the device, subscribes to notifications
  * from the command characteristic, sends a read settings command (0x55), waits for the settings data,
  * then unsubscribes from notifications.  Prints error messages if connection or reading settings fails.
  */
 void ATC_MiThermometer::readSettings() {
-    std::lock_guard<std::mutex> lock(bleMutex);
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::SETTINGS)]);
     int attempts = 0;
     while (!isConnected() && attempts < 5) {
         connect();
@@ -372,44 +589,21 @@ void ATC_MiThermometer::readSettings() {
         Serial.println("Failed to connect to device");
         return;
     }
-    if (!commandService) {
-        connectToCommandService();
-        if (!commandService) {
-            Serial.println("Command service not found");
-            return;
-        }
-    }
-    if (!commandCharacteristic) {
-        connectToCommandCharacteristic();
-        if (!commandCharacteristic) {
-            Serial.println("Command characteristic not found");
-            return;
-        }
-    }
-    received_settings = false;
-    if (commandCharacteristic->canNotify()) {
-        commandCharacteristic->subscribe(true,
-                                         [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
-                                                const uint8_t *pData, size_t length, bool isNotify) {
-                                             this->notifySettingsCallback(pBLERemoteCharacteristic, pData, length,
-                                                                          isNotify);
-                                         });
-    } else {
-        Serial.println("Command characteristic cannot notify");
+    if (!subscribeSettings()) {
         return;
     }
     delay(1000); // Delay to ensure connection is stable.
-    std::vector<uint8_t> data = {0x55}; // Read settings command
-    sendCommand(data);
+    const uint8_t data[] = {0x55}; // Read settings command
+    sendCommand(data, sizeof(data));
     uint32_t start = millis();
-    while (!received_settings && millis() - start < 5000) { // Timeout after 5 seconds
+    while (!received_settings && millis() - start < 5000 && !deadlinePassed()) { // Timeout after 5 seconds
         delay(100);
         yield(); // Allow other tasks to run
     }
     if (!received_settings) {
         Serial.println("Failed to read settings");
     }
-    commandCharacteristic->unsubscribe();
+    gatt->commandCharacteristic->unsubscribe();
 }
 
 /**
@@ -464,36 +658,49 @@ ATC_MiThermometer::notifySettingsCallback(NimBLERemoteCharacteristic *pBLERemote
  * @param data  The command data to send.
  */
 void ATC_MiThermometer::sendCommand(const std::vector<uint8_t> &data) {
-    if (!commandCharacteristic) {
+    sendCommand(data.data(), data.size(), true);
+}
+
+/**
+ * @brief Sends a command to the thermometer.  Prints an error message if sending the command fails.
+ * @param data Pointer to the command data.
+ * @param length Length of the command data.
+ * @param withResponse True to wait for the ATT write response, false to write without response.
+ * @return True if the command was written, false otherwise.
+ */
+bool ATC_MiThermometer::sendCommand(const uint8_t *data, size_t length, bool withResponse) {
+    if (!gatt || !gatt->commandCharacteristic) {
         connectToCommandCharacteristic();
-        if (!commandCharacteristic) {
+        if (!gatt || !gatt->commandCharacteristic) {
             Serial.println("Command characteristic not found, cannot send command");
-            return;
+            return false;
         }
     }
-    bool success = commandCharacteristic->writeValue(data.data(), data.size(), true); // Write value with response.
+    bool success = gatt->commandCharacteristic->writeValue(data, length, withResponse);
     if (!success) {
         Serial.println("Failed to send command");
     }
+    return success;
 }
 
 /**
- * @brief Disconnects from the thermometer and resets all service and characteristic pointers.
+ * @brief Disconnects from the thermometer, deletes the BLE client and returns the GATT state to the pool.
  */
 void ATC_MiThermometer::disconnect() {
-    std::lock_guard<std::mutex> lock(bleMutex);
-    if (pClient && pClient->isConnected()) {
-        pClient->disconnect();
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    if (!gatt) {
+        return;
     }
-    pClient = nullptr;
-    environmentService = nullptr;
-    batteryService = nullptr;
-    commandService = nullptr;
-    temperatureCharacteristic = nullptr;
-    temperaturePreciseCharacteristic = nullptr;
-    humidityCharacteristic = nullptr;
-    batteryCharacteristic = nullptr;
-    commandCharacteristic = nullptr;
+    flushNotifications();
+    if (gatt->pClient) {
+        std::lock_guard<std::mutex> clientLock(clientMutex);
+        if (gatt->pClient->isConnected()) {
+            gatt->pClient->disconnect();
+        }
+        NimBLEDevice::deleteClient(gatt->pClient);
+    }
+    releaseGattState(gatt);
+    gatt = nullptr;
 }
 
 /**
@@ -540,7 +747,7 @@ float ATC_MiThermometer::getTemperature() {
             return round(temperature_precise * 10.f) / 10.0f; // Round to one decimal place
         }
     } else {
-        if (!started_notify_temp) {
+        if (!gatt || !gatt->started_notify_temp) {
             readTemperature();
         }
         return temperature;
@@ -552,16 +759,17 @@ float ATC_MiThermometer::getTemperature() {
  *       Prints an error message if reading fails or insufficient data is received.
  */
 void ATC_MiThermometer::readTemperature() {
-    if (!temperatureCharacteristic) {
+    if (!gatt || !gatt->temperatureCharacteristic) {
         connectToTemperatureCharacteristic();
-        if (!temperatureCharacteristic) {
+        if (!gatt || !gatt->temperatureCharacteristic) {
             Serial.println("Temperature characteristic not found, cannot read temperature");
             return;
         }
     }
-    readCharacteristicValue(temperatureCharacteristic, [this](const std::string &value) {
+    readCharacteristicValue(gatt->temperatureCharacteristic, [this](const std::string &value) {
         if (value.length() >= 2) {
-            uint16_t temp = (value[1] << 8) | value[0];
+            auto temp = static_cast<int16_t>((static_cast<uint8_t>(value[1]) << 8) |
+                                             static_cast<uint8_t>(value[0]));
             temperature = static_cast<float>(temp) / 10.0f;
             if (time_tracking) {
                 last_read_time = time(nullptr);
@@ -586,7 +794,7 @@ float ATC_MiThermometer::getTemperaturePrecise() {
             return temperature_precise;
         }
     } else {
-        if (!started_notify_temp_precise) {
+        if (!gatt || !gatt->started_notify_temp_precise) {
             readTemperaturePrecise();
         }
         return temperature_precise;
@@ -598,24 +806,32 @@ float ATC_MiThermometer::getTemperaturePrecise() {
  *        Prints an error message if reading fails or insufficient data is received.
  */
 void ATC_MiThermometer::readTemperaturePrecise() {
-    if (!temperaturePreciseCharacteristic) {
+    if (!gatt || !gatt->temperaturePreciseCharacteristic) {
         connectToTemperaturePreciseCharacteristic();
-        if (!temperaturePreciseCharacteristic) {
+        if (!gatt || !gatt->temperaturePreciseCharacteristic) {
             Serial.println("Precise temperature characteristic not found, cannot read precise temperature");
             return;
         }
     }
-    readCharacteristicValue(temperaturePreciseCharacteristic, [this](const std::string &value) {
-        if (value.length() >= 2) {
-            uint16_t temp = (value[1] << 8) | value[0];
-            temperature_precise = static_cast<float>(temp) / 100.0f;
-            if (time_tracking) {
-                last_read_time = time(nullptr);
-            }
-        } else {
-            Serial.println("Failed to read precise temperature, insufficient data");
+    readCharacteristicValue(gatt->temperaturePreciseCharacteristic,
+                            [this](const std::string &value) { storeTemperaturePrecise(value); });
+}
+
+/**
+ * @brief Stores a value read from the precise temperature characteristic. Prints an error message if the value is
+ *        too short.
+ * @param value The value, the temperature in 0.01 degrees Celsius as a little endian int16.
+ */
+void ATC_MiThermometer::storeTemperaturePrecise(const std::string &value) {
+    if (value.length() >= 2) {
+        auto temp = static_cast<int16_t>((static_cast<uint8_t>(value[1]) << 8) | static_cast<uint8_t>(value[0]));
+        temperature_precise = static_cast<float>(temp) / 100.0f;
+        if (time_tracking) {
+            last_read_time = time(nullptr);
         }
-    });
+    } else {
+        Serial.println("Failed to read precise temperature, insufficient data");
+    }
 }
 
 /**
@@ -627,36 +843,84 @@ float ATC_MiThermometer::getHumidity() {
     if (connection_mode == Connection_mode::ADVERTISING) {
         return humidity;
     } else {
-        if (!started_notify_humidity) {
+        if (!gatt || !gatt->started_notify_humidity) {
             readHumidity();
         }
         return humidity;
     }
 }
 
+/**
+ * @brief Gets the psychrometric metrics of the latest reading. Only uses the cached reading, never reads from the
+ * device, and the cache is keyed by its raw values, so repeated calls between readings do not recompute anything.
+ * @return The metrics, all NAN until a reading with the temperature and the humidity was received.
+ */
+const ATC_Psychrometrics &ATC_MiThermometer::getPsychrometrics() {
+    ATC_MiThermometer_Reading reading = last_reading;
+    return psychrometrics_cache.get(reading);
+}
+
+/**
+ * @brief Gets the dew point.
+ * @return The dew point in degrees Celsius.
+ */
+float ATC_MiThermometer::getDewPoint() {
+    return getPsychrometrics().dew_point;
+}
+
+/**
+ * @brief Gets the absolute humidity.
+ * @return The absolute humidity in g/m3.
+ */
+float ATC_MiThermometer::getAbsoluteHumidity() {
+    return getPsychrometrics().absolute_humidity;
+}
+
+/**
+ * @brief Gets the vapour pressure deficit.
+ * @return The vapour pressure deficit in kPa.
+ */
+float ATC_MiThermometer::getVapourPressureDeficit() {
+    return getPsychrometrics().vapour_pressure_deficit;
+}
+
+/**
+ * @brief Gets the heat index.
+ * @return The heat index in degrees Celsius.
+ */
+float ATC_MiThermometer::getHeatIndex() {
+    return getPsychrometrics().heat_index;
+}
+
 /**
  * @brief Reads the humidity from the humidity characteristic. Uses a connection if necessary.
  *       Prints an error message if reading fails or insufficient data is received.
  */
 void ATC_MiThermometer::readHumidity() {
-    if (!humidityCharacteristic) {
+    if (!gatt || !gatt->humidityCharacteristic) {
         connectToHumidityCharacteristic();
-        if (!humidityCharacteristic) {
+        if (!gatt || !gatt->humidityCharacteristic) {
             Serial.println("Humidity characteristic not found, cannot read humidity");
             return;
         }
     }
-    readCharacteristicValue(humidityCharacteristic, [this](const std::string &value) {
-        if (value.length() >= 2) {
-            uint16_t hum = (value[1] << 8) | value[0];
-            humidity = static_cast<float>(hum) / 100.0f;
-            if (time_tracking) {
-                last_read_time = time(nullptr);
-            }
-        } else {
-            Serial.println("Failed to read humidity, insufficient data");
+    readCharacteristicValue(gatt->humidityCharacteristic, [this](const std::string &value) { storeHumidity(value); });
+}
+
+/**
+ * @brief Stores a value read from the humidity characteristic. Prints an error message if the value is too short.
+ * @param value The value, the humidity in 0.01 percent as a little endian uint16.
+ */
+void ATC_MiThermometer::storeHumidity(const std::string &value) {
+    if (value.length() >= 2) {
+        uint16_t hum = (static_cast<uint8_t>(value[1]) << 8) | static_cast<uint8_t>(value[0]);
+        humidity = static_cast<float>(hum) / 100.0f;
+        if (time_tracking) {
+            last_read_time = time(nullptr);
         }
-    });
+    } else {
+        Serial.println("Failed to read humidity, insufficient data");
+    }
 }
 
 /**
@@ -668,7 +932,7 @@ uint8_t ATC_MiThermometer::getBatteryLevel() {
     if (connection_mode == Connection_mode::ADVERTISING) {
         return battery_level;
     } else {
-        if (!started_notify_battery) {
+        if (!gatt || !gatt->started_notify_battery) {
             readBatteryLevel();
         }
         return battery_level;
@@ -680,31 +944,39 @@ uint8_t ATC_MiThermometer::getBatteryLevel() {
  *       Prints an error message if reading fails or insufficient data is received.
  */
 void ATC_MiThermometer::readBatteryLevel() {
-    if (!batteryCharacteristic) {
+    if (!gatt || !gatt->batteryCharacteristic) {
         connectToBatteryCharacteristic();
-        if (!batteryCharacteristic) {
+        if (!gatt || !gatt->batteryCharacteristic) {
             Serial.println("Battery characteristic not found, cannot read battery level");
             return;
         }
     }
-    readCharacteristicValue(batteryCharacteristic, [this](const std::string &value) {
-        if (!value.empty()) {
-            battery_level = static_cast<uint8_t>(value[0]);
-            if (time_tracking) {
-                last_read_time = time(nullptr);
-            }
-        } else {
-            Serial.println("Failed to read battery level, insufficient data");
+    readCharacteristicValue(gatt->batteryCharacteristic,
+                            [this](const std::string &value) { storeBatteryLevel(value); });
+}
+
+/**
+ * @brief Stores a value read from the battery characteristic. Prints an error message if the value is empty.
+ * @param value The value, the battery level in percent.
+ */
+void ATC_MiThermometer::storeBatteryLevel(const std::string &value) {
+    if (!value.empty()) {
+        battery_level = static_cast<uint8_t>(value[0]);
+        if (time_tracking) {
+            last_read_time = time(nullptr);
         }
-    });
+    } else {
+        Serial.println("Failed to read battery level, insufficient data");
+    }
 }
 
 /**
- * @brief Gets the advertising type. Reads settings if they haven't been read yet.
+ * @brief Gets the advertising type. Returns the type detected from an advertisement if there is one, otherwise reads
+ * settings if they haven't been read yet.
  * @return The advertising type.
  */
 Advertising_Type ATC_MiThermometer::getAdvertisingType() {
-    if (!read_settings) {
+    if (!read_settings && !format_detected) {
         readSettings();
     }
     return settings.advertising_type;
@@ -721,53 +993,86 @@ const char *ATC_MiThermometer::getAddress() const {
 /**
  * @brief Parses the advertising data based on the advertising type.
  * Reads settings if they haven't been read yet. Disconnects if in ADVERTISING mode after reading settings.
+ * With lazy initialization, marks the thermometer for init() instead and decodes the detected format.
  * @param data The advertising data.
  * @param length The length of the advertising data.
+ * @param rssi The RSSI of the advertisement in dBm, or 0 if unknown.
+ * @return True if a reading was decoded and kept a field through the validation stage, false otherwise.
  */
-void ATC_MiThermometer::parseAdvertisingData(const uint8_t *data, size_t length) {
-    if (!read_settings) {
+bool ATC_MiThermometer::parseAdvertisingData(const uint8_t *data, size_t length, int8_t rssi) {
+    if (rssi) {
+        last_rssi = rssi;
+    }
+    if (history_backfill) {
+        uint32_t now = millis();
+        if (last_advertising_time == 0 ? history_watermark != 0 : now - last_advertising_time > backfill_gap_ms) {
+            backfill_pending = true;
+        }
+        last_advertising_time = now ? now : 1;
+    }
+    if (!read_settings && lazy_init) {
+        // Defer the connection to a later init(), the advertisement shows the device is in range and awake
+        if (!format_detected && !atcDetectAdvertisingType(data, length, settings.advertising_type)) {
+            format_detected = true;
+        }
+        if (!format_detected || connection_mode != Connection_mode::ADVERTISING) {
+            init_pending = true;
+        }
+        if (!format_detected) {
+            return false;
+        }
+    } else if (!read_settings) {
         readSettings();
         if (connection_mode == Connection_mode::ADVERTISING) {
             disconnect();
         }
-        return;
+        return false;
     }
     switch (settings.advertising_type) {
         case Advertising_Type::BTHOME:
-            parseAdvertisingDataBTHOME(data, length);
-            break;
+            return parseAdvertisingDataBTHOME(data, length);
         case Advertising_Type::PVVX:
-            parseAdvertisingDataPVVX(data, length);
-            break;
+            return parseAdvertisingDataPVVX(data, length);
         case Advertising_Type::ATC1441:
-            parseAdvertisingDataATC1441(data, length);
-            break;
+            return parseAdvertisingDataATC1441(data, length);
         default:
             Serial.println("Unknown advertising type");
-            break;
+            return false;
     }
 }
 
+/**
+ * @brief Gets the latest live reading, merged over the advertisements received so far.
+ * @return The reading, with fields set to 0 if nothing was received yet.
+ */
+const ATC_MiThermometer_Reading &ATC_MiThermometer::getLastReading() const {
+    return last_reading;
+}
+
+/**
+ * @brief Gets the RSSI of the latest advertisement passed to parseAdvertisingData().
+ * @return The RSSI in dBm, or 0 if no RSSI was received.
+ */
+int8_t ATC_MiThermometer::getLastRssi() const {
+    return last_rssi;
+}
+
 /**
  * @brief Parses advertising data in ATC1441 format.
  * Extracts temperature, humidity, battery level, and battery voltage.
  * Prints an error message if the packet is too short.
  * @param data The advertising data.
  * @param length The length of the advertising data.
+ * @return True if a reading was decoded and kept a field through the validation stage, false otherwise.
  */
-void ATC_MiThermometer::parseAdvertisingDataATC1441(const uint8_t *data, size_t length) {
-    if (length < 18) {
-        Serial.println("Packet too short!");
-        return;
-    }
-    int16_t temperatureRaw = (data[10] << 8) | data[11];
-    temperature = static_cast<float>(temperatureRaw) * 0.1f;
-    humidity = data[12];
-    battery_level = data[13];
-    battery_mv = (data[14] << 8) | data[15];
-    if (time_tracking) {
-        last_read_time = time(nullptr);
+bool ATC_MiThermometer::parseAdvertisingDataATC1441(const uint8_t *data, size_t length) {
+    ATC_MiThermometer_Reading reading{};
+    const char *error = atcDecodeATC1441(data, length, reading);
+    if (error) {
+        Serial.println(error);
+        return false;
     }
+    return processReading(reading, false);
 }
 
 /**
@@ -775,137 +1080,36 @@ void ATC_MiThermometer::parseAdvertisingDataATC1441(const uint8_t *data, size_t
  * Prints error messages if the packet is too short, has an incorrect size, or an incorrect UUID.
  * @param data The advertising data.
  * @param length The length of the advertising data.
+ * @return True if a reading was decoded and kept a field through the validation stage, false otherwise.
  */
-void ATC_MiThermometer::parseAdvertisingDataPVVX(const uint8_t *data, size_t length) {
-    if (length < 19) {
-        Serial.println("Packet too short!");
-        return;
-    }
-    uint8_t size = data[0];
-    if (size != 18) {
-        Serial.println("Incorrect packet size!");
-        return;
-    }
-    uint8_t uid = data[1];
-    if (uid != 0x16) {
-        Serial.println("Incorrect UID, not Service Data with 16-bit UUID!");
-        return;
-    }
-    uint16_t uuid = data[2] | (data[3] << 8);
-    if (uuid != 0x181A) {
-        Serial.println("Incorrect UUID, not 0x181A!");
-        return;
-    }
-    int16_t temperatureRaw = data[10] | (data[11] << 8);
-    temperature_precise = static_cast<float>(temperatureRaw) * 0.01f;
-    uint16_t humidityRaw = data[12] | (data[13] << 8);
-    humidity = static_cast<float>(humidityRaw) * 0.01f;
-    battery_mv = data[14] | (data[15] << 8);
-    battery_level = data[16];
-    if (time_tracking) {
-        last_read_time = time(nullptr);
+bool ATC_MiThermometer::parseAdvertisingDataPVVX(const uint8_t *data, size_t length) {
+    ATC_MiThermometer_Reading reading{};
+    const char *error = atcDecodePVVX(data, length, reading);
+    if (error) {
+        Serial.println(error);
+        return false;
     }
+    return processReading(reading, false);
 }
 
 /**
  * @brief Parses advertising data in BTHome format.  Extracts battery level, temperature, humidity, and voltage.
  * Prints error messages if the packet is too short, the AD element length exceeds the packet size,
- * the service data is too short, or the UUID is unknown.
+ * the service data is too short, or the UUID is unknown. Objects decoded before an error are still used.
  * @param data The advertising data.
  * @param length The length of the advertising data.
- */
-void ATC_MiThermometer::parseAdvertisingDataBTHOME(const uint8_t *data, size_t length) {
-    if (length < 6) {
-        Serial.println("Packet too short!");
-        return;
-    }
-    size_t index = 0;
-    while (index < length) {
-        uint8_t element_length = data[index];
-        if (element_length == 0) {
-            break;
-        }
-        if (index + 1 + element_length > length) {
-            Serial.println("AD element length exceeds packet size!");
-            break;
-        }
-        uint8_t ad_type = data[index + 1];
-        const uint8_t *ad_data = &data[index + 2];
-        uint8_t ad_data_length = element_length - 1;
-        if (ad_type == 0x16) { // Service Data - 16-bit UUID
-            if (ad_data_length < 3) {
-                Serial.println("Service Data too short!");
-                break;
-            }
-            uint16_t uuid = ad_data[0] | (ad_data[1] << 8);
-            if (uuid != 0xFCD2) { // BTHome UUID
-                Serial.println("Unknown UUID for BTHome!");
-                break;
-            }
-            size_t dataIndex = 3;
-            while (dataIndex < ad_data_length) {
-                if (dataIndex >= ad_data_length) {
-                    break;
-                }
-                uint8_t objectId = ad_data[dataIndex++];
-                switch (objectId) {
-                    case 0x00: { // Packet ID
-                        if (dataIndex >= ad_data_length) {
-                            Serial.println("Missing data for Packet ID!");
-                            break;
-                        }
-                        uint8_t packetId = ad_data[dataIndex++];
-                        break;
-                    }
-                    case 0x01: { // Battery Level
-                        if (dataIndex >= ad_data_length) {
-                            Serial.println("Missing data for Battery Level!");
-                            break;
-                        }
-                        battery_level = ad_data[dataIndex++];
-                        break;
-                    }
-                    case 0x02: { // Temperature
-                        if (dataIndex + 1 >= ad_data_length) {
-                            Serial.println("Missing data for Temperature!");
-                            break;
-                        }
-                        uint16_t temperatureRaw = ad_data[dataIndex] | (ad_data[dataIndex + 1] << 8);
-                        temperature_precise = static_cast<float>(temperatureRaw) * 0.01f;
-                        dataIndex += 2;
-                        break;
-                    }
-                    case 0x03: { // Humidity
-                        if (dataIndex + 1 >= ad_data_length) {
-                            Serial.println("Missing data for Humidity!");
-                            break;
-                        }
-                        uint16_t humidityRaw = ad_data[dataIndex] | (ad_data[dataIndex + 1] << 8);
-                        humidity = static_cast<float>(humidityRaw) * 0.01f;
-                        dataIndex += 2;
-                        break;
-                    }
-                    case 0x0C: { // Voltage
-                        if (dataIndex + 1 >= ad_data_length) {
-                            Serial.println("Missing data for Voltage!");
-                            break;
-                        }
-                        uint16_t voltageRaw = ad_data[dataIndex] | (ad_data[dataIndex + 1] << 8);
-                        battery_mv = voltageRaw;
-                        dataIndex += 2;
-                        break;
-                    }
-                    default:
-                        dataIndex = ad_data_length; // Skip unknown object IDs
-                        break;
-                }
-            }
+ * @return True if a reading was decoded and kept a field through the validation stage, false otherwise.
+ */
+bool ATC_MiThermometer::parseAdvertisingDataBTHOME(const uint8_t *data, size_t length) {
+    ATC_MiThermometer_Reading reading{};
+    const char *error = atcDecodeBTHome(data, length, reading);
+    if (error) {
+        Serial.println(error);
+        if (length < 6) {
+            return false;
         }
-        index += 1 + element_length;
-    }
-    if (time_tracking) {
-        last_read_time = time(nullptr);
     }
+    return processReading(reading, false);
 }
 
 /**
@@ -915,8 +1119,10 @@ void ATC_MiThermometer::parseAdvertisingDataBTHOME(const uint8_t *data, size_t l
  * Prints error messages if connection or settings reading fails.
  */
 void ATC_MiThermometer::init() {
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    init_pending = false;
     int attempts = 0;
-    while (!isConnected() && attempts < 5) {
+    while (!isConnected() && attempts < 5 && !deadlinePassed()) {
         connect();
         attempts++;
         yield();
@@ -926,20 +1132,12 @@ void ATC_MiThermometer::init() {
         return;
     }
     attempts = 0;
-    while (!read_settings && attempts < 5) {
+    while (!read_settings && attempts < 5 && !deadlinePassed()) {
         readSettings();
         attempts++;
         yield();
         if (!read_settings) {
             disconnect();
-            environmentService = nullptr;
-            batteryService = nullptr;
-            commandService = nullptr;
-            temperatureCharacteristic = nullptr;
-            temperaturePreciseCharacteristic = nullptr;
-            humidityCharacteristic = nullptr;
-            batteryCharacteristic = nullptr;
-            commandCharacteristic = nullptr;
         }
     }
     if (!read_settings) {
@@ -961,6 +1159,49 @@ void ATC_MiThermometer::init() {
     }
 }
 
+/**
+ * @brief Initializes the thermometer within a time budget. The deadline is checked by the retry loops of init(),
+ * connect() and readSettings().
+ * @param timeoutMs The time budget in milliseconds.
+ * @return True if the settings were read, false otherwise.
+ */
+bool ATC_MiThermometer::init(uint32_t timeoutMs) {
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    uint32_t deadline = millis() + timeoutMs;
+    operation_deadline = deadline ? deadline : 1;
+    init();
+    operation_deadline = 0;
+    return read_settings;
+}
+
+/**
+ * @brief Enables or disables lazy initialization.
+ * @param enabled True to enable lazy initialization, false to read the settings on the first advertisement.
+ */
+void ATC_MiThermometer::setLazyInit(bool enabled) {
+    lazy_init = enabled;
+    if (!enabled) {
+        init_pending = false;
+    }
+}
+
+/**
+ * @brief Checks if an advertisement was received from a lazy thermometer that still needs init().
+ * @return True if an initialization is pending, false otherwise.
+ */
+bool ATC_MiThermometer::isInitPending() const {
+    return init_pending;
+}
+
+/**
+ * @brief Checks whether the deadline set by init(uint32_t) has passed. Uses a signed difference so that the
+ * check stays correct when millis() wraps around.
+ * @return True if a deadline is set and has passed, false otherwise.
+ */
+bool ATC_MiThermometer::deadlinePassed() const {
+    return operation_deadline && static_cast<int32_t>(millis() - operation_deadline) >= 0;
+}
+
 /**
  * @brief Returns whether the settings have been successfully read from the device.
  * @return True if settings have been read, false otherwise.
@@ -970,15 +1211,16 @@ bool ATC_MiThermometer::getReadSettings() const {
 }
 
 /**
- * @brief  Gets the battery voltage. If in ADVERTISING mode, returns the parsed battery voltage.
- *          If in CONNECTION or NOTIFICATION mode, estimates the voltage based on the battery level.
+ * @brief  Gets the battery voltage. Returns the measured voltage if one was received, from an advertisement or a
+ *          history record. Otherwise, in CONNECTION or NOTIFICATION mode, estimates the voltage based on the battery
+ *          level, since the battery service only reports a percentage.
  * @return The battery voltage in millivolts.
  */
 uint16_t ATC_MiThermometer::getBatteryVoltage() {
-    if (connection_mode == Connection_mode::ADVERTISING) {
+    if (connection_mode == Connection_mode::ADVERTISING || battery_mv != 0) {
         return battery_mv;
     } else {
-        if (!started_notify_battery) {
+        if (!gatt || !gatt->started_notify_battery) {
             readBatteryLevel();
         }
         // Estimate voltage based on battery percentage (assuming a linear relationship between 2000mV and 3000mV)
@@ -986,6 +1228,30 @@ uint16_t ATC_MiThermometer::getBatteryVoltage() {
     }
 }
 
+/**
+ * @brief Sets the configuration of the battery depletion forecast, and forgets its history.
+ * @param config The sampling interval, cutoff voltage and fit parameters.
+ */
+void ATC_MiThermometer::setBatteryForecastConfig(const ATC_BatteryForecastConfig &config) {
+    battery_forecast.configure(config);
+}
+
+/**
+ * @brief Gets the battery depletion forecast.
+ * @return The forecast.
+ */
+const ATC_BatteryForecast &ATC_MiThermometer::getBatteryForecast() const {
+    return battery_forecast;
+}
+
+/**
+ * @brief Forecasts the days until the battery must be replaced.
+ * @return The days left, INFINITY if the voltage does not decline, or NAN if too few samples were collected.
+ */
+float ATC_MiThermometer::getBatteryDaysLeft() const {
+    return battery_forecast.getDaysLeft();
+}
+
 /**
  * @brief Gets the RF TX Power setting from the device. Reads the settings if they haven't been read already.
  * @return The RF TX Power as an RF_TX_Power enum.
@@ -1359,7 +1625,17 @@ uint16_t ATC_MiThermometer::getAveragingMeasurementsSec() {
  * @return A byte vector representing the settings, ready to be sent to the device.
  */
 std::vector<uint8_t> ATC_MiThermometer::parseSettings(const ATC_MiThermometer_Settings &settingsToParse) {
-    std::vector<uint8_t> data(12);
+    std::vector<uint8_t> data(settings_command_length);
+    parseSettings(settingsToParse, data.data());
+    return data;
+}
+
+/**
+ * @brief  Parses the provided settings struct into a caller provided buffer that can be sent to the device as a command.
+ * @param settingsToParse The settings struct to parse.
+ * @param data The buffer receiving settings_command_length bytes.
+ */
+void ATC_MiThermometer::parseSettings(const ATC_MiThermometer_Settings &settingsToParse, uint8_t *data) {
     data[0] = 0x55; // Command header
     data[1] = 0x0A; // Command length
     data[2] = (settingsToParse.lp_measures << 7) | (settingsToParse.tx_measures << 6) |
@@ -1378,7 +1654,6 @@ std::vector<uint8_t> ATC_MiThermometer::parseSettings(const ATC_MiThermometer_Se
     data[9] = settingsToParse.connect_latency;
     data[10] = settingsToParse.lcd_update_interval;
     data[11] = settingsToParse.averaging_measurements;
-    return data;
 }
 
 /**
@@ -1388,7 +1663,8 @@ std::vector<uint8_t> ATC_MiThermometer::parseSettings(const ATC_MiThermometer_Se
  * @param newSettings The new settings to apply to the thermometer.
  */
 void ATC_MiThermometer::sendSettings(const ATC_MiThermometer_Settings &newSettings) {
-    std::lock_guard<std::mutex> lock(bleMutex);
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::SETTINGS)]);
     int attempts = 0;
     while (!isConnected() && attempts < 5) {
         connect();
@@ -1399,34 +1675,12 @@ void ATC_MiThermometer::sendSettings(const ATC_MiThermometer_Settings &newSettin
         Serial.println("Failed to connect to device");
         return;
     }
-    if (!commandService) {
-        connectToCommandService();
-        if (!commandService) {
-            Serial.println("Command service not found");
-            return;
-        }
-    }
-    if (!commandCharacteristic) {
-        connectToCommandCharacteristic();
-        if (!commandCharacteristic) {
-            Serial.println("Command characteristic not found");
-            return;
-        }
-    }
-    received_settings = false;
-    if (commandCharacteristic->canNotify()) {
-        commandCharacteristic->subscribe(true,
-                                         [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
-                                                const uint8_t *pData, size_t length, bool isNotify) {
-                                             this->notifySettingsCallback(pBLERemoteCharacteristic, pData, length,
-                                                                          isNotify);
-                                         });
-    } else {
-        Serial.println("Command characteristic cannot notify");
+    if (!subscribeSettings()) {
         return;
     }
-    std::vector<uint8_t> data = parseSettings(newSettings);
-    sendCommand(data);
+    uint8_t data[settings_command_length];
+    parseSettings(newSettings, data);
+    sendCommand(data, sizeof(data));
     uint32_t start = millis();
     while (!received_settings && millis() - start < 5000) {
         delay(100);
@@ -1435,7 +1689,226 @@ void ATC_MiThermometer::sendSettings(const ATC_MiThermometer_Settings &newSettin
     if (!received_settings) {
         Serial.println("Failed to send settings");
     }
-    commandCharacteristic->unsubscribe();
+    gatt->commandCharacteristic->unsubscribe();
+}
+
+#ifdef ATC_ASYNC_SUPPORTED
+/**
+ * @brief Awaitable version of connect(). Attempts to connect up to 5 times, suspending between attempts.
+ * @param loop The loop resuming the coroutine.
+ * @return A task whose result is true if connected.
+ */
+ATC_Task<bool> ATC_MiThermometer::connectAsync(ATC_AsyncLoop &loop) {
+    std::unique_lock<std::recursive_mutex> lock(ble_mutex, std::defer_lock);
+    if (!co_await loop.lock(lock, ATC_ASYNC_LOCK_TIMEOUT_MS)) {
+        Serial.println("Thermometer busy, cannot connect");
+        co_return false;
+    }
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::CONNECT)]);
+    if (!createClient()) {
+        co_return false;
+    }
+    for (int i = 0; i < 5; i++) {
+        if (tryConnect()) {
+            co_return true;
+        }
+        co_await loop.sleep(1000);
+    }
+    Serial.printf("Failed to connect to %s\n", address.c_str());
+    co_return false;
+}
+
+/**
+ * @brief Awaitable version of readSettings(). Suspends while the connection settles and while waiting for the
+ * settings notification.
+ * @param loop The loop resuming the coroutine.
+ * @return A task whose result is true if the settings were read.
+ */
+ATC_Task<bool> ATC_MiThermometer::readSettingsAsync(ATC_AsyncLoop &loop) {
+    std::unique_lock<std::recursive_mutex> lock(ble_mutex, std::defer_lock);
+    if (!co_await loop.lock(lock, ATC_ASYNC_LOCK_TIMEOUT_MS)) {
+        Serial.println("Thermometer busy, cannot read settings");
+        co_return false;
+    }
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::SETTINGS)]);
+    for (int attempts = 0; !isConnected() && attempts < 5; attempts++) {
+        co_await connectAsync(loop);
+    }
+    if (!isConnected()) {
+        Serial.println("Failed to connect to device");
+        co_return false;
+    }
+    if (!subscribeSettings()) {
+        co_return false;
+    }
+    co_await loop.sleep(1000); // Delay to ensure connection is stable.
+    const uint8_t data[] = {0x55}; // Read settings command
+    sendCommand(data, sizeof(data));
+    bool received = co_await loop.until([this] { return received_settings; }, 5000);
+    if (!received) {
+        Serial.println("Failed to read settings");
+    }
+    if (gatt && gatt->commandCharacteristic) {
+        gatt->commandCharacteristic->unsubscribe();
+    }
+    co_return received;
+}
+
+/**
+ * @brief Awaitable version of sendSettings(). Suspends while waiting for the confirmation.
+ * @param loop The loop resuming the coroutine.
+ * @param newSettings The settings to send.
+ * @return A task whose result is true if the device confirmed the settings.
+ */
+ATC_Task<bool> ATC_MiThermometer::sendSettingsAsync(ATC_AsyncLoop &loop, ATC_MiThermometer_Settings newSettings) {
+    std::unique_lock<std::recursive_mutex> lock(ble_mutex, std::defer_lock);
+    if (!co_await loop.lock(lock, ATC_ASYNC_LOCK_TIMEOUT_MS)) {
+        Serial.println("Thermometer busy, cannot send settings");
+        co_return false;
+    }
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::SETTINGS)]);
+    for (int attempts = 0; !isConnected() && attempts < 5; attempts++) {
+        co_await connectAsync(loop);
+    }
+    if (!isConnected()) {
+        Serial.println("Failed to connect to device");
+        co_return false;
+    }
+    if (!subscribeSettings()) {
+        co_return false;
+    }
+    uint8_t data[settings_command_length];
+    parseSettings(newSettings, data);
+    sendCommand(data, sizeof(data));
+    bool received = co_await loop.until([this] { return received_settings; }, 5000);
+    if (!received) {
+        Serial.println("Failed to send settings");
+    }
+    if (gatt && gatt->commandCharacteristic) {
+        gatt->commandCharacteristic->unsubscribe();
+    }
+    co_return received;
+}
+
+/**
+ * @brief Awaitable version of readTemperaturePrecise(), readHumidity() and readBatteryLevel(). Finds the
+ * characteristic like the blocking reads, then reads it without blocking and stores the value.
+ * @param loop The loop resuming the coroutine.
+ * @param field READING_TEMPERATURE for the precise temperature, READING_HUMIDITY or READING_BATTERY_LEVEL.
+ * @return A task whose result is true if the value was read and stored.
+ */
+ATC_Task<bool> ATC_MiThermometer::readAsync(ATC_AsyncLoop &loop, Reading_Field field) {
+    std::unique_lock<std::recursive_mutex> lock(ble_mutex, std::defer_lock);
+    if (!co_await loop.lock(lock, ATC_ASYNC_LOCK_TIMEOUT_MS)) {
+        Serial.println("Thermometer busy, cannot read");
+        co_return false;
+    }
+    NimBLERemoteCharacteristic *characteristic = nullptr;
+    if (field == READING_TEMPERATURE) {
+        if (!gatt || !gatt->temperaturePreciseCharacteristic) {
+            connectToTemperaturePreciseCharacteristic();
+        }
+        characteristic = gatt ? gatt->temperaturePreciseCharacteristic : nullptr;
+    } else if (field == READING_HUMIDITY) {
+        if (!gatt || !gatt->humidityCharacteristic) {
+            connectToHumidityCharacteristic();
+        }
+        characteristic = gatt ? gatt->humidityCharacteristic : nullptr;
+    } else if (field == READING_BATTERY_LEVEL) {
+        if (!gatt || !gatt->batteryCharacteristic) {
+            connectToBatteryCharacteristic();
+        }
+        characteristic = gatt ? gatt->batteryCharacteristic : nullptr;
+    } else {
+        Serial.println("Field cannot be read from a characteristic");
+        co_return false;
+    }
+    if (!characteristic) {
+        Serial.println("Characteristic not found, cannot read");
+        co_return false;
+    }
+    std::string value;
+    if (!co_await readCharacteristicAsync(loop, characteristic, value)) {
+        co_return false;
+    }
+    if (field == READING_TEMPERATURE) {
+        storeTemperaturePrecise(value);
+    } else if (field == READING_HUMIDITY) {
+        storeHumidity(value);
+    } else {
+        storeBatteryLevel(value);
+    }
+    co_return true;
+}
+
+/**
+ * @brief Awaitable version of readCharacteristic(). The read is started with ble_gattc_read() and completed by
+ * asyncReadCallback() on the NimBLE host task. A read abandoned on timeout stays pending until NimBLE completes or
+ * times it out: reads started before then fail, so its callback never writes into a newer read, and later reads
+ * discard its outcome.
+ * @param loop The loop resuming the coroutine.
+ * @param characteristic A pointer to the characteristic to read.
+ * @param value Receives the read value.
+ * @return A task whose result is true if the value was read.
+ */
+ATC_Task<bool> ATC_MiThermometer::readCharacteristicAsync(ATC_AsyncLoop &loop,
+                                                          NimBLERemoteCharacteristic *characteristic,
+                                                          std::string &value) {
+    if (!characteristic) {
+        Serial.println("Characteristic is null, cannot read value");
+        co_return false;
+    }
+    // ble_mutex is held, so only the callback of an abandoned read can still change the state
+    if (async_read_state == Async_read_state::PENDING) {
+        Serial.println("Previous read still pending, cannot read value");
+        co_return false;
+    }
+    async_read_state = Async_read_state::PENDING;
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::READ)]);
+    uint16_t connection = characteristic->getRemoteService()->getClient()->getConnId();
+    if (ble_gattc_read(connection, characteristic->getHandle(), asyncReadCallback, this) != 0) {
+        async_read_state = Async_read_state::IDLE;
+        Serial.println("Failed to start read");
+        co_return false;
+    }
+    co_await loop.until([this] { return async_read_state != Async_read_state::PENDING; }, ATC_ASYNC_READ_TIMEOUT_MS);
+    Async_read_state state = async_read_state;
+    if (state == Async_read_state::PENDING) {
+        Serial.println("Read timed out");
+        co_return false;
+    }
+    bool read = state == Async_read_state::DONE;
+    if (read) {
+        value.swap(async_read_value);
+    } else {
+        Serial.println("Failed to read value");
+    }
+    async_read_state = Async_read_state::IDLE;
+    co_return read;
+}
+#endif
+
+/**
+ * @brief Completes the asynchronous read: copies the value and publishes the outcome, which resumes the coroutine
+ * on its next poll.
+ * @param connHandle The connection handle.
+ * @param error The status of the read, 0 on success.
+ * @param attr The attribute read, with its value.
+ * @param arg The thermometer.
+ * @return 0.
+ */
+int ATC_MiThermometer::asyncReadCallback(uint16_t connHandle, const ble_gatt_error *error, ble_gatt_attr *attr,
+                                         void *arg) {
+    (void) connHandle;
+    auto *thermometer = static_cast<ATC_MiThermometer *>(arg);
+    bool read = error && error->status == 0 && attr && attr->om;
+    if (read) {
+        uint16_t length = OS_MBUF_PKTLEN(attr->om);
+        thermometer->async_read_value.resize(length);
+        read = length == 0 || os_mbuf_copydata(attr->om, 0, length, &thermometer->async_read_value[0]) == 0;
+    }
+    thermometer->async_read_state = read ? Async_read_state::DONE : Async_read_state::FAILED;
+    return 0;
 }
 
 /**
@@ -1790,8 +2263,8 @@ void ATC_MiThermometer::setAveragingMeasurementsSec(uint16_t averagingMeasuremen
  *        Resets the internal flags for read_settings and received_settings and then reads the settings again.
  */
 void ATC_MiThermometer::resetSettings() {
-    std::vector<uint8_t> data = {0x56}; // Reset settings command.
-    sendCommand(data);
+    const uint8_t data[] = {0x56}; // Reset settings command.
+    sendCommand(data, sizeof(data));
     read_settings = false;
     received_settings = false;
     readSettings();
@@ -1803,7 +2276,8 @@ void ATC_MiThermometer::resetSettings() {
  * @param time  The time to set, as a time_t value.
  */
 void ATC_MiThermometer::setClock(time_t time) {
-    std::lock_guard<std::mutex> lock(bleMutex);
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::COMMAND)]);
     int attempts = 0;
     while (!isConnected() && attempts < 5) {
         connect();
@@ -1814,27 +2288,27 @@ void ATC_MiThermometer::setClock(time_t time) {
         Serial.println("Failed to connect to device");
         return;
     }
-    if (!commandService) {
+    if (!gatt || !gatt->commandService) {
         connectToCommandService();
-        if (!commandService) {
+        if (!gatt || !gatt->commandService) {
             Serial.println("Command service not found");
             return;
         }
     }
-    if (!commandCharacteristic) {
+    if (!gatt || !gatt->commandCharacteristic) {
         connectToCommandCharacteristic();
-        if (!commandCharacteristic) {
+        if (!gatt || !gatt->commandCharacteristic) {
             Serial.println("Command characteristic not found");
             return;
         }
     }
-    std::vector<uint8_t> data(5);
+    uint8_t data[5];
     data[0] = 0x23; // Set clock command
     data[1] = static_cast<uint8_t>(time & 0xFF);
     data[2] = static_cast<uint8_t>((time >> 8) & 0xFF);
     data[3] = static_cast<uint8_t>((time >> 16) & 0xFF);
     data[4] = static_cast<uint8_t>((time >> 24) & 0xFF);
-    sendCommand(data);
+    sendCommand(data, sizeof(data));
 }
 
 /**
@@ -1911,9 +2385,9 @@ void ATC_MiThermometer::setConnectionMode(Connection_mode new_connection_mode) {
  * @brief Stops temperature notifications. Unsubscribes from the temperature characteristic's notifications.
  */
 void ATC_MiThermometer::stopNotifyTemp() {
-    if (temperatureCharacteristic) {
-        temperatureCharacteristic->unsubscribe();
-        started_notify_temp = false;
+    if (gatt && gatt->temperatureCharacteristic) {
+        gatt->temperatureCharacteristic->unsubscribe();
+        gatt->started_notify_temp = false;
     }
 }
 
@@ -1921,9 +2395,9 @@ void ATC_MiThermometer::stopNotifyTemp() {
  * @brief Stops precise temperature notifications. Unsubscribes from the precise temperature characteristic's notifications.
  */
 void ATC_MiThermometer::stopNotifyTempPrecise() {
-    if (temperaturePreciseCharacteristic) {
-        temperaturePreciseCharacteristic->unsubscribe();
-        started_notify_temp_precise = false;
+    if (gatt && gatt->temperaturePreciseCharacteristic) {
+        gatt->temperaturePreciseCharacteristic->unsubscribe();
+        gatt->started_notify_temp_precise = false;
     }
 }
 
@@ -1931,9 +2405,9 @@ void ATC_MiThermometer::stopNotifyTempPrecise() {
  * @brief  Stops humidity notifications. Unsubscribes from the humidity characteristic's notifications.
  */
 void ATC_MiThermometer::stopNotifyHumidity() {
-    if (humidityCharacteristic) {
-        humidityCharacteristic->unsubscribe();
-        started_notify_humidity = false;
+    if (gatt && gatt->humidityCharacteristic) {
+        gatt->humidityCharacteristic->unsubscribe();
+        gatt->started_notify_humidity = false;
     }
 }
 
@@ -1941,9 +2415,9 @@ void ATC_MiThermometer::stopNotifyHumidity() {
  * @brief Stops battery level notifications.  Unsubscribes from the battery level characteristic's notifications.
  */
 void ATC_MiThermometer::stopNotifyBattery() {
-    if (batteryCharacteristic) {
-        batteryCharacteristic->unsubscribe();
-        started_notify_battery = false;
+    if (gatt && gatt->batteryCharacteristic) {
+        gatt->batteryCharacteristic->unsubscribe();
+        gatt->started_notify_battery = false;
     }
 }
 
@@ -1958,19 +2432,20 @@ void ATC_MiThermometer::stopNotify() {
 }
 
 /**
- * @brief Reads the value of the specified characteristic and passes it to the callback function.
+ * @brief Reads the value of the specified characteristic and records the time taken.
  * Prints an error if the characteristic is null.
  * @param characteristic A pointer to the characteristic to read.
- * @param callback The function to call with the read value (as a string).
+ * @param value Receives the read value.
+ * @return True if the value was read, false if the characteristic is null.
  */
-void ATC_MiThermometer::readCharacteristicValue(NimBLERemoteCharacteristic *characteristic,
-                                                std::function<void(const std::string &)> callback) {
+bool ATC_MiThermometer::readCharacteristic(NimBLERemoteCharacteristic *characteristic, std::string &value) {
     if (!characteristic) {
         Serial.println("Characteristic is null, cannot read value");
-        return;
+        return false;
     }
-    std::string value = characteristic->readValue();
-    callback(value);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::READ)]);
+    value = characteristic->readValue();
+    return true;
 }
 
 bool ATC_MiThermometer::getTimeTracking() const {
@@ -1989,6 +2464,808 @@ ATC_MiThermometer::ATC_MiThermometer(std::string address, Connection_mode connec
         address.c_str(), connection_mode) {
 }
 
+/**
+ * @brief Gets the MAC address of the thermometer in NimBLE native order (least significant byte first).
+ * @return Pointer to the 6 address bytes.
+ */
+const uint8_t *ATC_MiThermometer::getNativeAddress() const {
+    return native_address;
+}
+
 std::string ATC_MiThermometer::getAddressString() const {
     return (std::string) address;
 }
+
+/**
+ * @brief Downloads measurement records from the flash log of the device (PVVX firmware only).
+ * @param count The maximum number of records to download.
+ * @param offset The number of newest records to skip.
+ * @return The number of records downloaded.
+ */
+size_t ATC_MiThermometer::readHistory(uint16_t count, uint16_t offset) {
+    return downloadHistory(count, offset, 0, 0);
+}
+
+/**
+ * @brief Downloads the records of the device log newer than the given time (PVVX firmware only).
+ * The log is streamed newest first, so the transfer is stopped at the first record that is not newer than since.
+ * @param since Only records newer than this time (UTC) are downloaded.
+ * @param maxRecords The maximum number of records to download.
+ * @return The number of records downloaded.
+ */
+size_t ATC_MiThermometer::readHistorySince(time_t since, uint16_t maxRecords) {
+    return downloadHistory(maxRecords, 0, since, 0);
+}
+
+/**
+ * @brief Downloads records from the device log. Sends the read log command (0x35) with the record count and offset,
+ * then collects the records streamed as notifications on the command characteristic into a buffer allocated
+ * up front, so no allocation happens per record. The download ends when the device sends the end marker,
+ * a record not newer than since arrives, the buffer is full, or no record arrives for history_idle_timeout_ms; in all
+ * but the first case the transfer is stopped with a zero count. The records are then passed through the reading
+ * pipeline.
+ * @param count The maximum number of records to download.
+ * @param offset The number of newest records to skip.
+ * @param since Records older than or equal to this time end the download, 0 to download all.
+ * @param until Records newer than or equal to this time are skipped, 0 to keep all.
+ * @return The number of records downloaded.
+ */
+size_t ATC_MiThermometer::downloadHistory(uint16_t count, uint16_t offset, time_t since, time_t until) {
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::HISTORY)]);
+    int attempts = 0;
+    while (!isConnected() && attempts < 5) {
+        connect();
+        attempts++;
+        yield();
+    }
+    if (!isConnected()) {
+        Serial.println("Failed to connect to device");
+        return 0;
+    }
+    if (!gatt || !gatt->commandCharacteristic) {
+        connectToCommandCharacteristic();
+        if (!gatt || !gatt->commandCharacteristic) {
+            Serial.println("Command characteristic not found");
+            return 0;
+        }
+    }
+    history.clear();
+#if ATC_STATIC_ALLOCATION
+    if (count > history.capacity()) {
+        count = static_cast<uint16_t>(history.capacity());
+    }
+#else
+    history.reserve(count);
+#endif
+    received_history_end = false;
+    history_reached_since = false;
+    history_full = false;
+    history_received = 0;
+    history_requested = count;
+    history_since = since;
+    history_until = until;
+    history_last_notify_time = millis();
+    if (connection_profile != Connection_profile::BULK_TRANSFER) {
+        applyConnectionProfile(Connection_profile::BULK_TRANSFER);
+    }
+    if (gatt->commandCharacteristic->canNotify()) {
+        gatt->commandCharacteristic->subscribe(true,
+                                         [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
+                                                const uint8_t *pData, size_t length, bool isNotify) {
+                                             this->notifyHistoryCallback(pBLERemoteCharacteristic, pData, length,
+                                                                         isNotify);
+                                         });
+    } else {
+        Serial.println("Command characteristic cannot notify");
+        return 0;
+    }
+    uint8_t data[5];
+    data[0] = 0x35; // Read log command
+    data[1] = static_cast<uint8_t>(count & 0xFF);
+    data[2] = static_cast<uint8_t>(count >> 8);
+    data[3] = static_cast<uint8_t>(offset & 0xFF);
+    data[4] = static_cast<uint8_t>(offset >> 8);
+    sendCommand(data, sizeof(data));
+    while (!received_history_end && !history_reached_since && !history_full &&
+           millis() - history_last_notify_time < history_idle_timeout_ms) {
+        delay(10);
+        yield();
+    }
+    if (!received_history_end) {
+        const uint8_t stop[] = {0x35, 0x00, 0x00}; // Zero count stops the log transfer
+        sendCommand(stop, sizeof(stop));
+    }
+    gatt->commandCharacteristic->unsubscribe();
+    if (connection_profile != Connection_profile::BULK_TRANSFER) {
+        applyConnectionProfile(connection_profile);
+    }
+    for (const ATC_MiThermometer_Reading &record: history) {
+        processReading(record, true);
+    }
+    return history.size();
+}
+
+/**
+ * @brief Callback function for history notifications. Each record is 13 bytes: the command (0x35), the record
+ * index (uint16), the UTC time (uint32), the temperature in 0.01 degrees (int16), the humidity in 0.01 percent
+ * (uint16) and the battery voltage in mV (uint16), all little endian. A 3 byte notification with a zero index
+ * marks the end of the log. A record past the reserved capacity ends the download, which then stops the transfer.
+ * Records are calibrated, and fields outside the bounds of the validation stage are dropped or flagged, without
+ * counting them in the stats updated by the scan.
+ * @param pBLERemoteCharacteristic  Pointer to the characteristic that triggered the notification.
+ * @param pData  Pointer to the notification data.
+ * @param length Length of the notification data.
+ * @param isNotify  True if this is a notification, false otherwise.
+ */
+void
+ATC_MiThermometer::notifyHistoryCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData,
+                                         size_t length, bool isNotify) {
+    if (!pData || length < 3 || pData[0] != 0x35) {
+        return;
+    }
+    history_last_notify_time = millis();
+    if (length < history_record_size) {
+        received_history_end = true;
+        return;
+    }
+    if (history.size() >= history.capacity()) {
+        history_full = true;
+        return;
+    }
+    ATC_MiThermometer_Reading record{};
+    record.time = static_cast<time_t>(static_cast<uint32_t>(pData[3]) | (static_cast<uint32_t>(pData[4]) << 8) |
+                                      (static_cast<uint32_t>(pData[5]) << 16) |
+                                      (static_cast<uint32_t>(pData[6]) << 24));
+    record.temperature = static_cast<int16_t>(pData[7] | (pData[8] << 8));
+    record.humidity = pData[9] | (pData[10] << 8);
+    record.battery_mv = pData[11] | (pData[12] << 8);
+    record.fields = READING_TEMPERATURE | READING_HUMIDITY | READING_BATTERY_MV;
+    if (history_since != 0 && record.time <= history_since) {
+        history_reached_since = true;
+        return;
+    }
+    history_received = history_received + 1;
+    if (history_until != 0 && record.time >= history_until) {
+        return; // Ingested by the previous part of a backfill
+    }
+    calibration.apply(record);
+    if (reading_validator.validateBounds(record) && record.fields == 0) {
+        return;
+    }
+    history.push_back(record);
+}
+
+/**
+ * @brief Gets the records downloaded by the last call to readHistory().
+ * @return The downloaded records, newest first.
+ */
+const std::vector<ATC_MiThermometer_Reading> &ATC_MiThermometer::getHistory() const {
+    return history;
+}
+
+/**
+ * @brief Sets the callback called for every reading that passes through the reading pipeline.
+ * @param callback The function to call with the reading and a flag that is true for history records.
+ */
+void ATC_MiThermometer::setReadingCallback(std::function<void(const ATC_MiThermometer_Reading &, bool)> callback) {
+    reading_callback = std::move(callback);
+}
+
+/**
+ * @brief Sets the observer called for every reading that passes through the reading pipeline.
+ * @param observer Pointer to the observer, or nullptr to remove it.
+ */
+void ATC_MiThermometer::setReadingObserver(ATC_ReadingObserver *observer) {
+    reading_observer = observer;
+}
+
+/**
+ * @brief Sets the window in which the notifications of a measurement cycle are merged into one reading.
+ * @param windowMs The window in milliseconds, 0 to process every notification as its own reading.
+ */
+void ATC_MiThermometer::setNotificationWindow(uint32_t windowMs) {
+    std::lock_guard<std::mutex> lock(notification_mutex);
+    notification_coalescer.setWindow(windowMs);
+}
+
+/**
+ * @brief Gets the window in which the notifications of a measurement cycle are merged into one reading.
+ * @return The window in milliseconds.
+ */
+uint32_t ATC_MiThermometer::getNotificationWindow() const {
+    return notification_coalescer.getWindow();
+}
+
+/**
+ * @brief Adds a decoded notification to the current measurement cycle. The subscribed characteristics complete a
+ * cycle, whose reading is then processed at once. A cycle left open starts the notification timer, which ends it
+ * after the window.
+ * @param source The Notification_source of the notification.
+ * @param partial The reading decoded from the notification.
+ */
+void ATC_MiThermometer::coalesceNotification(uint8_t source, const ATC_MiThermometer_Reading &partial) {
+    std::lock_guard<std::mutex> lock(notification_mutex);
+    ATC_MiThermometer_GattState *state = gatt;
+    if (state) {
+        notification_coalescer.setExpected(static_cast<uint8_t>(
+                (state->started_notify_temp ? NOTIFY_TEMPERATURE : 0) |
+                (state->started_notify_temp_precise ? NOTIFY_TEMPERATURE_PRECISE : 0) |
+                (state->started_notify_humidity ? NOTIFY_HUMIDITY : 0) |
+                (state->started_notify_battery ? NOTIFY_BATTERY_LEVEL : 0)));
+    }
+    bool wasPending = notification_coalescer.isPending();
+    ATC_MiThermometer_Reading cycle;
+    bool ended = notification_coalescer.add(source, partial, millis(), cycle);
+    if (ended) {
+        processReading(cycle, false);
+    }
+    if (!notification_coalescer.isPending()) {
+        if (wasPending && notification_timer) {
+            esp_timer_stop(notification_timer);
+        }
+        return;
+    }
+    if (wasPending && !ended) {
+        return;
+    }
+    if (!notification_timer) {
+        esp_timer_create_args_t args{};
+        args.callback = &ATC_MiThermometer::notificationTimerCallback;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "atc_notify";
+        if (esp_timer_create(&args, &notification_timer) != ESP_OK) {
+            Serial.println("Failed to create the notification timer");
+            notification_timer = nullptr;
+            return;
+        }
+    }
+    esp_timer_stop(notification_timer);
+    esp_timer_start_once(notification_timer, static_cast<uint64_t>(notification_coalescer.getWindow()) * 1000);
+}
+
+/**
+ * @brief Ends the current measurement cycle and passes its reading through the reading pipeline.
+ */
+void ATC_MiThermometer::flushNotifications() {
+    std::lock_guard<std::mutex> lock(notification_mutex);
+    ATC_MiThermometer_Reading cycle;
+    if (notification_coalescer.flush(cycle)) {
+        processReading(cycle, false);
+    }
+}
+
+/**
+ * @brief Ends the current measurement cycle if its window has elapsed. A callback already running when the timer was
+ * stopped and started again for a new cycle finds that cycle not due yet, and starts the timer for the rest of its
+ * window, which fails harmlessly if the timer is already running.
+ */
+void ATC_MiThermometer::flushDueNotifications() {
+    std::lock_guard<std::mutex> lock(notification_mutex);
+    ATC_MiThermometer_Reading cycle;
+    uint32_t now = millis();
+    if (notification_coalescer.flushDue(now, cycle)) {
+        processReading(cycle, false);
+    } else if (notification_coalescer.isPending() && notification_timer) {
+        uint32_t elapsed = now - notification_coalescer.getFirstTime();
+        uint32_t window = notification_coalescer.getWindow();
+        esp_timer_start_once(notification_timer, static_cast<uint64_t>(window > elapsed ? window - elapsed : 1) * 1000);
+    }
+}
+
+/**
+ * @brief Stops and deletes the notification timer. esp_timer_stop() does not wait for a callback the esp_timer task is
+ * already running, but that task runs the callbacks one at a time in order of expiry, so a fence timer expiring right
+ * away is only called once that callback has returned.
+ */
+void ATC_MiThermometer::deleteNotificationTimer() {
+    if (!notification_timer) {
+        return;
+    }
+    esp_timer_stop(notification_timer);
+    SemaphoreHandle_t fenceDone = xSemaphoreCreateBinary();
+    esp_timer_handle_t fence = nullptr;
+    esp_timer_create_args_t args{};
+    args.callback = [](void *arg) { xSemaphoreGive(static_cast<SemaphoreHandle_t>(arg)); };
+    args.arg = fenceDone;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "atc_fence";
+    if (fenceDone && esp_timer_create(&args, &fence) == ESP_OK) {
+        if (esp_timer_start_once(fence, 1) == ESP_OK) {
+            xSemaphoreTake(fenceDone, portMAX_DELAY);
+        }
+        esp_timer_delete(fence);
+    } else {
+        Serial.println("Failed to create the notification fence timer");
+        // Without the fence, the running callback is waited for through the mutex it holds
+        std::lock_guard<std::mutex> lock(notification_mutex);
+    }
+    if (fenceDone) {
+        vSemaphoreDelete(fenceDone);
+    }
+    esp_timer_delete(notification_timer);
+    notification_timer = nullptr;
+}
+
+/**
+ * @brief Callback of the notification timer, ends the cycle of the thermometer passed as argument if it is due.
+ * @param arg Pointer to the ATC_MiThermometer.
+ */
+void ATC_MiThermometer::notificationTimerCallback(void *arg) {
+    static_cast<ATC_MiThermometer *>(arg)->flushDueNotifications();
+}
+
+/**
+ * @brief Sets the smoothing filter of the live readings, and resets it.
+ * @param config The filter and its parameters.
+ */
+void ATC_MiThermometer::setFilter(const ATC_FilterConfig &config) {
+    reading_filter.configure(config);
+}
+
+/**
+ * @brief Gets the smoothing filter of the live readings.
+ * @return The filter and its parameters.
+ */
+const ATC_FilterConfig &ATC_MiThermometer::getFilter() const {
+    return reading_filter.getConfig();
+}
+
+/**
+ * @brief Forgets the samples of the smoothing filter.
+ */
+void ATC_MiThermometer::resetFilter() {
+    reading_filter.reset();
+}
+
+/**
+ * @brief Sets the validation stage of the readings, and forgets its recent values.
+ * @param config The checks and the action.
+ */
+void ATC_MiThermometer::setValidation(const ATC_ValidationConfig &config) {
+    reading_validator.configure(config);
+}
+
+/**
+ * @brief Gets the configuration of the validation stage.
+ * @return The checks and the action.
+ */
+const ATC_ValidationConfig &ATC_MiThermometer::getValidation() const {
+    return reading_validator.getConfig();
+}
+
+/**
+ * @brief Gets the counters of the validation stage.
+ * @return The counters.
+ */
+const ATC_ValidationStats &ATC_MiThermometer::getValidationStats() const {
+    return reading_validator.getStats();
+}
+
+/**
+ * @brief Forgets the recent values of the validation stage and clears its counters.
+ */
+void ATC_MiThermometer::resetValidation() {
+    reading_validator.reset();
+}
+
+/**
+ * @brief Sets the host-side calibration curve of the temperature or the humidity.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @param curve The curve.
+ * @return True if the field and the curve are valid.
+ */
+bool ATC_MiThermometer::setCalibration(Reading_Field field, const ATC_CalibrationCurve &curve) {
+    return calibration.setCurve(field, curve);
+}
+
+/**
+ * @brief Gets the host-side calibration curve of the temperature or the humidity.
+ * @param field READING_TEMPERATURE or READING_HUMIDITY.
+ * @return The curve.
+ */
+const ATC_CalibrationCurve &ATC_MiThermometer::getCalibration(Reading_Field field) const {
+    return calibration.getCurve(field);
+}
+
+/**
+ * @brief Passes a reading through the reading pipeline. Live readings are calibrated, validated, smoothed by the
+ * filter and update the current values and the last read time, a live reading whose fields were all dropped by the
+ * validation stage is discarded. Historical readings, calibrated and validated when they were received, are only
+ * passed on to the reading callback.
+ * @param received The reading to process.
+ * @param historical True if the reading was downloaded from the device log.
+ * @return True if the reading holds at least one field, false if it was discarded or empty.
+ */
+bool ATC_MiThermometer::processReading(const ATC_MiThermometer_Reading &received, bool historical) {
+    ATC_MiThermometer_Reading reading = received;
+    if (!historical) {
+        calibration.apply(reading);
+        if (reading_validator.validate(reading, millis()) && reading.fields == 0) {
+            return false;
+        }
+        reading_filter.apply(reading);
+        if (reading.fields & READING_TEMPERATURE) {
+            temperature_precise = static_cast<float>(reading.temperature) * 0.01f;
+            temperature = round(temperature_precise * 10.f) / 10.0f;
+        }
+        if (reading.fields & READING_HUMIDITY) {
+            humidity = static_cast<float>(reading.humidity) * 0.01f;
+        }
+        if (reading.fields & READING_BATTERY_MV) {
+            battery_mv = reading.battery_mv;
+        }
+        if (reading.fields & READING_BATTERY_LEVEL) {
+            battery_level = reading.battery_level;
+        }
+        atcMergeReading(last_reading, reading);
+        last_reading.time = time(nullptr);
+        // The forecast needs the wall clock, and the temperature to compensate the voltage sag of a cold battery
+        if ((reading.fields & READING_BATTERY_MV) && !(reading.anomalies & READING_BATTERY_MV) &&
+            last_reading.time > history_min_valid_time) {
+            battery_forecast.addReading(static_cast<uint32_t>(last_reading.time), reading.battery_mv,
+                                        last_reading.temperature);
+        }
+        if (time_tracking) {
+            last_read_time = time(nullptr);
+        }
+    }
+    if (reading_callback || reading_observer) {
+        ATC_MiThermometer_Reading timestamped = reading;
+        if (!historical) {
+            timestamped.time = time(nullptr);
+        }
+        if (reading_callback) {
+            reading_callback(timestamped, historical);
+        }
+        if (reading_observer) {
+            reading_observer->onReading(*this, timestamped, historical);
+        }
+    }
+    return reading.fields != 0;
+}
+
+/**
+ * @brief Enables or disables automatic history backfill. Loads the persisted watermark when enabled.
+ * @param enabled True to enable backfill, false to disable.
+ * @param gapMs The time in milliseconds without advertisements that counts as a gap.
+ */
+void ATC_MiThermometer::setHistoryBackfill(bool enabled, uint32_t gapMs) {
+    history_backfill = enabled;
+    backfill_gap_ms = gapMs;
+    backfill_offset = 0;
+    backfill_newest = 0;
+    backfill_oldest = 0;
+    if (enabled) {
+        loadHistoryWatermark();
+    } else {
+        backfill_pending = false;
+    }
+}
+
+/**
+ * @brief Checks if a gap was detected and the missing history has not been downloaded yet.
+ * @return True if a backfill is pending, false otherwise.
+ */
+bool ATC_MiThermometer::isBackfillPending() const {
+    return backfill_pending;
+}
+
+/**
+ * @brief Downloads the records newer than the watermark. Without a watermark only the newest record is fetched, to
+ * establish one. The log is streamed newest first, so a download cut short by maxRecords or the buffer capacity
+ * leaves the oldest part of the gap: the backfill then stays pending, and the next call continues past the records
+ * received so far, skipping those logged meanwhile. Once the download reaches the watermark or the end of the log,
+ * the watermark advances to the newest record of the backfill and is persisted.
+ * Disconnects afterwards if the connection mode is ADVERTISING.
+ * @param maxRecords The maximum number of records to download.
+ * @return The number of records downloaded.
+ */
+size_t ATC_MiThermometer::backfillHistory(uint16_t maxRecords) {
+    size_t records;
+    bool complete;
+    if (history_watermark == 0) {
+        records = readHistory(1);
+        complete = received_history_end || records > 0;
+    } else {
+        records = downloadHistory(maxRecords, backfill_offset, history_watermark, backfill_oldest);
+        // The device ends the log after the requested count too, only a shorter stream reached its end
+        complete = history_reached_since ||
+                   (received_history_end && !history_full && history_received < history_requested);
+    }
+    if (!history.empty()) {
+        backfill_newest = std::max(backfill_newest, history.front().time);
+    }
+    if (complete) {
+        if (backfill_newest > history_watermark) {
+            history_watermark = backfill_newest;
+            saveHistoryWatermark();
+        }
+        backfill_pending = false;
+        backfill_offset = 0;
+        backfill_newest = 0;
+        backfill_oldest = 0;
+    } else if (history_received > 0) {
+        backfill_offset = static_cast<uint16_t>(std::min<uint32_t>(UINT16_MAX, backfill_offset + history_received));
+        if (!history.empty() && (backfill_oldest == 0 || history.back().time < backfill_oldest)) {
+            backfill_oldest = history.back().time;
+        }
+    }
+    if (connection_mode == Connection_mode::ADVERTISING) {
+        disconnect();
+    }
+    return records;
+}
+
+/**
+ * @brief Gets the history watermark, the time of the newest history record ingested by a backfill.
+ * @return The watermark (UTC), 0 if none.
+ */
+time_t ATC_MiThermometer::getHistoryWatermark() const {
+    return history_watermark;
+}
+
+/**
+ * @brief Sets the history watermark and persists it in flash.
+ * @param watermark The new watermark (UTC).
+ */
+void ATC_MiThermometer::setHistoryWatermark(time_t watermark) {
+    history_watermark = watermark;
+    saveHistoryWatermark();
+}
+
+/**
+ * @brief Loads the history watermark from flash. The watermark is stored in the "atc_history" namespace
+ * under the MAC address without separators.
+ */
+void ATC_MiThermometer::loadHistoryWatermark() {
+    char key[16];
+    watermarkKey(address, key);
+    Preferences preferences;
+    if (!preferences.begin("atc_history", true)) {
+        return;
+    }
+    history_watermark = static_cast<time_t>(preferences.getULong64(key, 0));
+    preferences.end();
+}
+
+/**
+ * @brief Writes the history watermark to flash. Prints an error message if the write fails.
+ */
+void ATC_MiThermometer::saveHistoryWatermark() {
+    char key[16];
+    watermarkKey(address, key);
+    Preferences preferences;
+    if (!preferences.begin("atc_history", false)) {
+        Serial.println("Failed to open history watermark storage");
+        return;
+    }
+    if (preferences.putULong64(key, static_cast<uint64_t>(history_watermark)) == 0) {
+        Serial.println("Failed to save history watermark");
+    }
+    preferences.end();
+}
+
+/**
+ * @brief Adds a command to the pipelined command queue.
+ * @param data Pointer to the command data, at most command_max_length bytes.
+ * @param length Length of the command data.
+ * @return True if the command was queued, false if it is too long or the queue is full.
+ */
+bool ATC_MiThermometer::queueCommand(const uint8_t *data, size_t length) {
+    if (!data || length == 0 || length > command_max_length) {
+        Serial.println("Invalid command length");
+        return false;
+    }
+    if (command_queue_count >= command_queue.size()) {
+        Serial.println("Command queue full");
+        return false;
+    }
+    ATC_MiThermometer_Command &command = command_queue[command_queue_count++];
+    memcpy(command.data, data, length);
+    command.length = static_cast<uint8_t>(length);
+    return true;
+}
+
+/**
+ * @brief Sends all queued commands, then clears the queue. Commands are written without response when the
+ * characteristic supports it, so several commands go out per connection interval instead of one per ATT round trip.
+ * Flow control comes from the notifications the firmware sends back for each command: at most window commands
+ * are unacknowledged at a time, and a command not acknowledged within command_ack_timeout_ms is counted as a
+ * timeout so the queue keeps moving.
+ * @param window The maximum number of unacknowledged commands.
+ * @return The number of acknowledged commands.
+ */
+size_t ATC_MiThermometer::flushCommands(uint8_t window) {
+    std::lock_guard<std::recursive_mutex> lock(ble_mutex);
+    ScopedOperationTimer timer(operation_stats[static_cast<size_t>(Operation_type::COMMAND)]);
+    int attempts = 0;
+    while (!isConnected() && attempts < 5) {
+        connect();
+        attempts++;
+        yield();
+    }
+    command_stats = ATC_MiThermometer_CommandStats();
+    if (!isConnected()) {
+        Serial.println("Failed to connect to device");
+        return 0;
+    }
+    if (!gatt || !gatt->commandCharacteristic) {
+        connectToCommandCharacteristic();
+        if (!gatt || !gatt->commandCharacteristic) {
+            Serial.println("Command characteristic not found");
+            return 0;
+        }
+    }
+    if (!gatt->commandCharacteristic->canNotify()) {
+        Serial.println("Command characteristic cannot notify");
+        return 0;
+    }
+    gatt->commandCharacteristic->subscribe(true,
+                                     [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
+                                            const uint8_t *pData, size_t length, bool isNotify) {
+                                         this->notifyCommandAckCallback(pBLERemoteCharacteristic, pData, length,
+                                                                        isNotify);
+                                     });
+    bool withResponse = !gatt->commandCharacteristic->canWriteNoResponse();
+    if (window == 0) {
+        window = 1;
+    }
+    commands_sent = 0;
+    commands_acknowledged = 0;
+    uint32_t start = millis();
+    uint32_t last_progress = start;
+    size_t acknowledged = 0;
+    while (acknowledged < command_queue_count) {
+        while (commands_sent < command_queue_count && commands_sent - acknowledged < window) {
+            const ATC_MiThermometer_Command &command = command_queue[commands_sent];
+            if (!sendCommand(command.data, command.length, withResponse)) {
+                break;
+            }
+            commands_sent++;
+            command_stats.sent++;
+            last_progress = millis();
+        }
+        size_t current = commands_acknowledged.load();
+        if (current != acknowledged) {
+            acknowledged = current;
+            last_progress = millis();
+        } else if (millis() - last_progress > command_ack_timeout_ms) {
+            if (commands_sent == acknowledged) {
+                break; // Nothing in flight and sending failed.
+            }
+            if (commands_acknowledged.compare_exchange_strong(current, current + 1)) {
+                command_stats.timeouts++;
+            }
+            acknowledged = commands_acknowledged.load();
+            last_progress = millis();
+        } else {
+            delay(1);
+        }
+    }
+    gatt->commandCharacteristic->unsubscribe();
+    command_stats.acknowledged = command_stats.sent - command_stats.timeouts;
+    command_stats.elapsed_ms = millis() - start;
+    command_queue_count = 0;
+    return command_stats.acknowledged;
+}
+
+/**
+ * @brief Callback function for command acknowledgements during a pipelined flush. A notification acknowledges the
+ * oldest unacknowledged command if it starts with the same command ID. Settings notifications are also parsed.
+ * @param pBLERemoteCharacteristic  Pointer to the characteristic that triggered the notification.
+ * @param pData  Pointer to the notification data.
+ * @param length Length of the notification data.
+ * @param isNotify  True if this is a notification, false otherwise.
+ */
+void ATC_MiThermometer::notifyCommandAckCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
+                                                 const uint8_t *pData, size_t length, bool isNotify) {
+    if (!pData || length == 0) {
+        return;
+    }
+    if (pData[0] == 0x55) { // Settings
+        notifySettingsCallback(pBLERemoteCharacteristic, pData, length, isNotify);
+    }
+    size_t current = commands_acknowledged.load();
+    if (current < commands_sent && command_queue[current].data[0] == pData[0]) {
+        commands_acknowledged.compare_exchange_strong(current, current + 1);
+    }
+}
+
+/**
+ * @brief Gets the statistics of the last flushCommands() call.
+ * @return The command statistics.
+ */
+ATC_MiThermometer_CommandStats ATC_MiThermometer::getCommandStats() const {
+    return command_stats;
+}
+
+/**
+ * @brief Gets the command throughput of the last flushCommands() call.
+ * @return The number of acknowledged commands per second, 0 if nothing was sent.
+ */
+float ATC_MiThermometer::getCommandThroughput() const {
+    if (command_stats.elapsed_ms == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(command_stats.acknowledged) * 1000.0f / static_cast<float>(command_stats.elapsed_ms);
+}
+
+/**
+ * @brief Gets the connection profile.
+ * @return The connection profile applied when connecting.
+ */
+Connection_profile ATC_MiThermometer::getConnectionProfile() const {
+    return connection_profile;
+}
+
+/**
+ * @brief Sets the connection profile. If connected, requests the new connection parameters right away.
+ * @param profile The connection profile to use.
+ */
+void ATC_MiThermometer::setConnectionProfile(Connection_profile profile) {
+    connection_profile = profile;
+    if (isConnected()) {
+        applyConnectionProfile(profile);
+    }
+}
+
+/**
+ * @brief Gets the connection parameters of a connection profile. The supervision timeouts leave room for
+ * (1 + latency) * max_interval * 2 as required by the Bluetooth specification.
+ * @param profile The connection profile.
+ * @return The connection parameters.
+ */
+ATC_MiThermometer_ConnectionParams ATC_MiThermometer::getConnectionProfileParams(Connection_profile profile) {
+    switch (profile) {
+        case Connection_profile::FAST_POLL:
+            return {6, 12, 0, 200, 0}; // 7.5-15 ms, 2 s timeout
+        case Connection_profile::BULK_TRANSFER:
+            return {6, 12, 0, 400, 247}; // 7.5-15 ms, 4 s timeout, 247 byte MTU
+        case Connection_profile::LOW_POWER_HOLD:
+            return {80, 160, 4, 600, 0}; // 100-200 ms, 4 skipped events, 6 s timeout
+        case Connection_profile::STANDARD:
+        default:
+            return {24, 40, 0, 400, 0}; // 30-50 ms, 4 s timeout
+    }
+}
+
+/**
+ * @brief Requests the connection parameters of a profile on the current connection. The MTU is left unchanged.
+ * @param profile The connection profile to apply.
+ */
+void ATC_MiThermometer::applyConnectionProfile(Connection_profile profile) {
+    if (!gatt || !gatt->pClient || !gatt->pClient->isConnected()) {
+        return;
+    }
+    ATC_MiThermometer_ConnectionParams params = getConnectionProfileParams(profile);
+    gatt->pClient->updateConnParams(params.min_interval, params.max_interval, params.latency, params.supervision_timeout);
+}
+
+/**
+ * @brief Gets the negotiated ATT MTU of the current connection.
+ * @return The MTU, 0 if not connected.
+ */
+uint16_t ATC_MiThermometer::getMTU() const {
+    if (!isConnected()) {
+        return 0;
+    }
+    return gatt->pClient->getMTU();
+}
+
+/**
+ * @brief Gets the timing statistics of a type of GATT operation.
+ * @param type The operation type.
+ * @return The timing statistics.
+ */
+ATC_MiThermometer_OperationStats ATC_MiThermometer::getOperationStats(Operation_type type) const {
+    return operation_stats[static_cast<size_t>(type)];
+}
+
+/**
+ * @brief Resets the timing statistics of all operation types.
+ */
+void ATC_MiThermometer::resetOperationStats() {
+    operation_stats.fill(ATC_MiThermometer_OperationStats());
+}
@@ -7,12 +7,25 @@
 
 #include <NimBLEDevice.h>
 #include <Arduino.h>
+#include <esp_timer.h>
 #include <cstdint>
+#include "ATC_MiThermometer_config.h"
 #include "ATC_MiThermometer_structs.h"
 #include "ATC_MiThermometer_enums.h"
+#include "ATC_Async.h"
+#include "ATC_Psychrometrics.h"
+#include "ATC_ReadingFilter.h"
+#include "ATC_ReadingValidator.h"
+#include "ATC_BatteryForecast.h"
+#include "ATC_Calibration.h"
+#include "ATC_NotificationCoalescer.h"
 #include <ctime>
 #include <vector>
 #include <map>
+#include <functional>
+#include <array>
+#include <atomic>
+#include <mutex>
 
 /** @brief  Advertising interval step time in milliseconds. */
 constexpr float advertising_interval_step_time_ms = 62.5f;
@@ -20,6 +33,65 @@ constexpr float advertising_interval_step_time_ms = 62.5f;
 constexpr uint8_t connect_latency_step_time_ms = 20;
 /** @brief LCD update interval step time in milliseconds. */
 constexpr uint8_t lcd_update_interval_step_time_ms = 50;
+/** @brief Size in bytes of a history record notification (command, index, time, temperature, humidity, voltage). */
+constexpr size_t history_record_size = 13;
+/** @brief Time in milliseconds without a history notification after which a download is considered finished. */
+constexpr uint32_t history_idle_timeout_ms = 3000;
+/** @brief Times before this value (2020-01-01) mean the clock has not been set. */
+constexpr time_t history_min_valid_time = 1577836800;
+/** @brief Maximum number of commands in the pipelined command queue. */
+constexpr size_t command_queue_capacity = 16;
+/** @brief Time in milliseconds to wait for the acknowledgement of a pipelined command. */
+constexpr uint32_t command_ack_timeout_ms = 1000;
+/** @brief Number of Operation_type values. */
+constexpr size_t operation_type_count = 5;
+/** @brief Length in bytes of the settings command built by parseSettings(). */
+constexpr size_t settings_command_length = 12;
+
+/** @brief Number of GATT states in the pool. */
+constexpr size_t gatt_state_pool_size = ATC_GATT_STATE_POOL_SIZE;
+
+/**
+ * @struct ATC_MiThermometer_GattState
+ * @brief This structure holds the connection state of a thermometer. It is taken from a fixed pool on connect()
+ *        and returned on disconnect(), so thermometers that are not connected do not carry it.
+ */
+struct ATC_MiThermometer_GattState {
+    NimBLEClient *pClient = nullptr; /**< Pointer to the BLE client. */
+    NimBLERemoteService *environmentService = nullptr; /**< Pointer to the environment service. */
+    NimBLERemoteService *batteryService = nullptr; /**< Pointer to the battery service. */
+    NimBLERemoteService *commandService = nullptr; /**< Pointer to the command service. */
+    NimBLERemoteCharacteristic *temperatureCharacteristic = nullptr; /**< Pointer to the temperature characteristic. */
+    NimBLERemoteCharacteristic *temperaturePreciseCharacteristic = nullptr; /**< Pointer to the precise temperature characteristic. */
+    NimBLERemoteCharacteristic *humidityCharacteristic = nullptr; /**< Pointer to the humidity characteristic. */
+    NimBLERemoteCharacteristic *batteryCharacteristic = nullptr; /**< Pointer to the battery characteristic. */
+    NimBLERemoteCharacteristic *commandCharacteristic = nullptr; /**< Pointer to the command characteristic. */
+    bool started_notify_temp = false; /**< Flag indicating whether temperature notifications have been started. */
+    bool started_notify_temp_precise = false; /**< Flag indicating whether precise temperature notifications have been started. */
+    bool started_notify_humidity = false; /**< Flag indicating whether humidity notifications have been started. */
+    bool started_notify_battery = false; /**< Flag indicating whether battery notifications have been started. */
+};
+
+class ATC_MiThermometer;
+
+/**
+ * @class ATC_ReadingObserver
+ * @brief Interface for objects receiving the readings of a thermometer. Registering an observer does not allocate,
+ *        unlike a std::function callback capturing state.
+ */
+class ATC_ReadingObserver {
+public:
+    virtual ~ATC_ReadingObserver() = default;
+
+    /**
+     * @brief Called for every reading, live or downloaded from the device log.
+     * @param thermometer The thermometer the reading comes from.
+     * @param reading The reading.
+     * @param historical True if the reading was downloaded from the device log.
+     */
+    virtual void onReading(ATC_MiThermometer &thermometer, const ATC_MiThermometer_Reading &reading,
+                           bool historical) = 0;
+};
 
 /**
  * @class ATC_MiThermometer
@@ -37,7 +109,8 @@ public:
     ATC_MiThermometer(std::string address, Connection_mode connection_mode = Connection_mode::ADVERTISING);
 
     /**
-     * @brief Destructor for the ATC_MiThermometer class.
+     * @brief Destructor for the ATC_MiThermometer class. Waits for a running notification timer callback, so it must
+     *        not be called from the reading callback, the observer, the filter or the validator of the thermometer.
      */
     ~ATC_MiThermometer();
 
@@ -61,6 +134,30 @@ public:
      */
     void init();
 
+    /**
+     * @brief Initializes the thermometer within a time budget. Connection attempts are shortened to the remaining
+     *        time and no new attempt starts once the budget is spent.
+     * @param timeoutMs The time budget in milliseconds.
+     * @return True if the settings were read, false otherwise.
+     */
+    bool init(uint32_t timeoutMs);
+
+    /**
+     * @brief Enables or disables lazy initialization. A lazy thermometer does not need init() at startup: its first
+     *        advertisement proves it is in range, and marks it for initialization instead of connecting from the
+     *        scan callback. Unencrypted ATC1441, PVVX and BTHome advertisements are decoded right away, using the
+     *        format detected from the advertisement. In ADVERTISING mode with a detected format, the device is never
+     *        connected unless the settings are requested.
+     * @param enabled True to enable lazy initialization, false to read the settings on the first advertisement.
+     */
+    void setLazyInit(bool enabled);
+
+    /**
+     * @brief Checks if an advertisement was received from a lazy thermometer that still needs init().
+     * @return True if an initialization is pending, false otherwise.
+     */
+    bool isInitPending() const;
+
     /**
      * @brief Connects to the thermometer.
      */
@@ -160,6 +257,38 @@ public:
      */
     float getHumidity();
 
+    /**
+     * @brief Gets the dew point, absolute humidity, vapour pressure deficit and heat index of the latest reading
+     *        (getLastReading()), without reading from the device. The metrics are computed once and cached until the
+     *        raw temperature or humidity changes. Use atcReadingPsychrometrics() for the metrics of any reading.
+     * @return The metrics, all NAN until a reading with the temperature and the humidity was received.
+     */
+    const ATC_Psychrometrics &getPsychrometrics();
+
+    /**
+     * @brief Gets the dew point.
+     * @return The dew point in degrees Celsius.
+     */
+    float getDewPoint();
+
+    /**
+     * @brief Gets the absolute humidity.
+     * @return The absolute humidity in g/m3.
+     */
+    float getAbsoluteHumidity();
+
+    /**
+     * @brief Gets the vapour pressure deficit.
+     * @return The vapour pressure deficit in kPa.
+     */
+    float getVapourPressureDeficit();
+
+    /**
+     * @brief Gets the heat index.
+     * @return The heat index in degrees Celsius.
+     */
+    float getHeatIndex();
+
     /**
      * @brief Reads the temperature from the thermometer, using a connection if necessary.
      */
@@ -193,7 +322,92 @@ public:
     void sendCommand(const std::vector<uint8_t> &data);
 
     /**
-     * @brief Gets the advertising type of the thermometer.
+     * @brief Sends a command to the thermometer.
+     * @param data Pointer to the command data.
+     * @param length Length of the command data.
+     * @param withResponse True to wait for the ATT write response, false to write without response.
+     * @return True if the command was written, false otherwise.
+     */
+    bool sendCommand(const uint8_t *data, size_t length, bool withResponse = true);
+
+    /**
+     * @brief Adds a command to the pipelined command queue. The queue is sent by flushCommands().
+     * @param data Pointer to the command data, at most command_max_length bytes.
+     * @param length Length of the command data.
+     * @return True if the command was queued, false if it is too long or the queue is full.
+     */
+    bool queueCommand(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Sends all queued commands using write without response, keeping at most window commands in flight.
+     *        A command is acknowledged by the notification the firmware sends back with the same command ID.
+     * @param window The maximum number of unacknowledged commands.
+     * @return The number of acknowledged commands.
+     */
+    size_t flushCommands(uint8_t window = 4);
+
+    /**
+     * @brief Gets the statistics of the last flushCommands() call.
+     * @return The command statistics.
+     */
+    ATC_MiThermometer_CommandStats getCommandStats() const;
+
+    /**
+     * @brief Gets the command throughput of the last flushCommands() call.
+     * @return The number of acknowledged commands per second.
+     */
+    float getCommandThroughput() const;
+
+    /**
+     * @brief Gets the connection profile.
+     * @return The connection profile applied when connecting.
+     */
+    Connection_profile getConnectionProfile() const;
+
+    /**
+     * @brief Sets the connection profile. Applied by connect(), and immediately if connected.
+     *        The MTU is only negotiated when connecting and is not changed on an active connection.
+     * @param profile The connection profile to use.
+     */
+    void setConnectionProfile(Connection_profile profile);
+
+    /**
+     * @brief Gets the connection parameters of a connection profile.
+     * @param profile The connection profile.
+     * @return The connection parameters.
+     */
+    static ATC_MiThermometer_ConnectionParams getConnectionProfileParams(Connection_profile profile);
+
+    /**
+     * @brief Connects a BLE client, requesting an MTU for this connection only. Connections are established one at
+     *        a time with the thermometers, since NimBLE only has a global preferred MTU.
+     * @param client The client to connect.
+     * @param address The MAC address of the device.
+     * @param mtu The MTU to request, 0 for the preferred MTU.
+     * @return True if connected, false otherwise.
+     */
+    static bool connectClient(NimBLEClient *client, const std::string &address, uint16_t mtu);
+
+    /**
+     * @brief Gets the negotiated ATT MTU of the current connection.
+     * @return The MTU, 0 if not connected.
+     */
+    uint16_t getMTU() const;
+
+    /**
+     * @brief Gets the timing statistics of a type of GATT operation.
+     * @param type The operation type.
+     * @return The timing statistics.
+     */
+    ATC_MiThermometer_OperationStats getOperationStats(Operation_type type) const;
+
+    /**
+     * @brief Resets the timing statistics of all operation types.
+     */
+    void resetOperationStats();
+
+    /**
+     * @brief Gets the advertising type of the thermometer, detected from its advertisements or read from its settings.
      * @return The advertising type.
      */
     Advertising_Type getAdvertisingType();
@@ -202,8 +416,22 @@ public:
      * @brief Parses the advertising data from the thermometer.
      * @param data The advertising data.
      * @param length The length of the advertising data.
+     * @param rssi The RSSI of the advertisement in dBm, or 0 if unknown.
+     * @return True if a reading was decoded and kept a field through the validation stage, false otherwise.
      */
-    void parseAdvertisingData(const uint8_t *data, size_t length);
+    bool parseAdvertisingData(const uint8_t *data, size_t length, int8_t rssi = 0);
+
+    /**
+     * @brief Gets the RSSI of the latest advertisement passed to parseAdvertisingData().
+     * @return The RSSI in dBm, or 0 if no RSSI was received.
+     */
+    int8_t getLastRssi() const;
+
+    /**
+     * @brief Gets the latest live reading, merged over the advertisements received so far.
+     * @return The reading, with fields set to 0 if nothing was received yet.
+     */
+    const ATC_MiThermometer_Reading &getLastReading() const;
 
     /**
      * @brief Gets the MAC address of the thermometer.
@@ -211,6 +439,12 @@ public:
      */
     const char *getAddress() const;
 
+    /**
+     * @brief Gets the MAC address of the thermometer in NimBLE native order (least significant byte first).
+     * @return Pointer to the 6 address bytes.
+     */
+    const uint8_t *getNativeAddress() const;
+
     std::string getAddressString() const;
 
     /**
@@ -220,11 +454,30 @@ public:
     bool getReadSettings() const;
 
     /**
-     * @brief Gets the battery voltage from the thermometer.
+     * @brief Gets the battery voltage from the thermometer. Returns the measured voltage once an advertisement or a
+     *        history record provided one, otherwise an estimate from the battery level.
      * @return The battery voltage in millivolts.
      */
     uint16_t getBatteryVoltage();
 
+    /**
+     * @brief Sets the configuration of the battery depletion forecast, and forgets its history.
+     * @param config The sampling interval, cutoff voltage and fit parameters.
+     */
+    void setBatteryForecastConfig(const ATC_BatteryForecastConfig &config);
+
+    /**
+     * @brief Gets the battery depletion forecast, fed with the measured voltage of the live readings.
+     * @return The forecast, with its downsampled voltage history.
+     */
+    const ATC_BatteryForecast &getBatteryForecast() const;
+
+    /**
+     * @brief Forecasts the days until the battery must be replaced.
+     * @return The days left, INFINITY if the voltage does not decline, or NAN if too few samples were collected.
+     */
+    float getBatteryDaysLeft() const;
+
     /**
      * @brief  Gets the RF TX Power.
      * @return RF TX Power as RF_TX_Power enum.
@@ -586,12 +839,56 @@ public:
      */
     std::vector<uint8_t> parseSettings(const ATC_MiThermometer_Settings &settingsToParse);
 
+    /**
+     * @brief Parses the given settings into a caller provided buffer, without allocating.
+     * @param settingsToParse The settings to parse.
+     * @param data The buffer receiving settings_command_length bytes.
+     */
+    void parseSettings(const ATC_MiThermometer_Settings &settingsToParse, uint8_t *data);
+
     /**
      * @brief Sends the given settings to the thermometer.
      * @param settings The settings to send.
      */
     void sendSettings(const ATC_MiThermometer_Settings &settings);
 
+#ifdef ATC_ASYNC_SUPPORTED
+    /**
+     * @brief Awaitable version of connect(). The delays between attempts suspend the coroutine instead of blocking;
+     *        each attempt still blocks while NimBLE establishes the connection.
+     * @param loop The loop resuming the coroutine.
+     * @return A task whose result is true if connected.
+     */
+    ATC_Task<bool> connectAsync(ATC_AsyncLoop &loop);
+
+    /**
+     * @brief Awaitable version of readSettings(). The wait for the settings notification suspends the coroutine,
+     *        so the settings of many thermometers are read concurrently from one task. The async operations hold
+     *        ble_mutex like the blocking ones, waiting on the loop while another task holds it.
+     * @param loop The loop resuming the coroutine.
+     * @return A task whose result is true if the settings were read.
+     */
+    ATC_Task<bool> readSettingsAsync(ATC_AsyncLoop &loop);
+
+    /**
+     * @brief Awaitable version of sendSettings().
+     * @param loop The loop resuming the coroutine.
+     * @param newSettings The settings to send.
+     * @return A task whose result is true if the device confirmed the settings.
+     */
+    ATC_Task<bool> sendSettingsAsync(ATC_AsyncLoop &loop, ATC_MiThermometer_Settings newSettings);
+
+    /**
+     * @brief Awaitable version of readTemperaturePrecise(), readHumidity() and readBatteryLevel(). The coroutine is
+     *        suspended while the NimBLE host reads the characteristic; finding the characteristic on the first read
+     *        still blocks. The thermometer must stay connected, and must not be destroyed while a read is pending.
+     * @param loop The loop resuming the coroutine.
+     * @param field READING_TEMPERATURE for the precise temperature, READING_HUMIDITY or READING_BATTERY_LEVEL.
+     * @return A task whose result is true if the value was read and stored.
+     */
+    ATC_Task<bool> readAsync(ATC_AsyncLoop &loop, Reading_Field field);
+#endif
+
     /**
      * @brief Gets the current settings of the thermometer.
      * @return The current settings.
@@ -626,23 +923,162 @@ public:
 
     time_t getLastReadTime() const;
 
+    /**
+     * @brief Downloads measurement records from the flash log of the device (PVVX firmware only).
+     *        The records are streamed as notifications on the command characteristic, newest first,
+     *        stored in a buffer allocated before the download and then passed to the reading callback.
+     * @param count The maximum number of records to download.
+     * @param offset The number of newest records to skip.
+     * @return The number of records downloaded.
+     */
+    size_t readHistory(uint16_t count, uint16_t offset = 0);
+
+    /**
+     * @brief Downloads the records of the device log newer than the given time (PVVX firmware only).
+     *        The transfer is stopped as soon as an older record arrives.
+     * @param since Only records newer than this time (UTC) are downloaded.
+     * @param maxRecords The maximum number of records to download.
+     * @return The number of records downloaded.
+     */
+    size_t readHistorySince(time_t since, uint16_t maxRecords);
+
+    /**
+     * @brief Enables or disables automatic history backfill. When enabled, the time of the newest history record
+     *        ingested is kept as a watermark persisted in flash, and a gap in advertisements (or a reboot) marks the
+     *        device for a backfill of the records after it. Requires the device clock to be set.
+     * @param enabled True to enable backfill, false to disable.
+     * @param gapMs The time in milliseconds without advertisements that counts as a gap.
+     */
+    void setHistoryBackfill(bool enabled, uint32_t gapMs = 300000);
+
+    /**
+     * @brief Checks if a gap was detected and the missing history has not been downloaded yet.
+     * @return True if a backfill is pending, false otherwise.
+     */
+    bool isBackfillPending() const;
+
+    /**
+     * @brief Downloads the records newer than the watermark, then advances and persists the watermark. A gap larger
+     *        than maxRecords or the history buffer is downloaded over several calls, the backfill staying pending
+     *        until the watermark is reached. Disconnects afterwards if the connection mode is ADVERTISING.
+     * @param maxRecords The maximum number of records to download.
+     * @return The number of records downloaded.
+     */
+    size_t backfillHistory(uint16_t maxRecords = 1000);
+
+    /**
+     * @brief Gets the history watermark, the time of the newest history record ingested by a backfill.
+     * @return The watermark (UTC), 0 if none.
+     */
+    time_t getHistoryWatermark() const;
+
+    /**
+     * @brief Sets the history watermark and persists it in flash.
+     * @param watermark The new watermark (UTC).
+     */
+    void setHistoryWatermark(time_t watermark);
+
+    /**
+     * @brief Gets the records downloaded by the last call to readHistory(), newest first.
+     * @return The downloaded records.
+     */
+    const std::vector<ATC_MiThermometer_Reading> &getHistory() const;
+
+    /**
+     * @brief Sets the callback called for every reading, live or downloaded from the device log.
+     * @param callback The function to call with the reading and a flag that is true for history records.
+     */
+    void setReadingCallback(std::function<void(const ATC_MiThermometer_Reading &, bool)> callback);
+
+    /**
+     * @brief Sets the observer called for every reading, in addition to the reading callback.
+     * @param observer Pointer to the observer, which must outlive the thermometer, or nullptr to remove it.
+     */
+    void setReadingObserver(ATC_ReadingObserver *observer);
+
+    /**
+     * @brief Sets the window in which the temperature, humidity and battery notifications of a measurement cycle are
+     *        merged into one reading, passed once through the reading pipeline. A cycle ends as soon as every
+     *        subscribed characteristic has notified, so the window only delays the cycles missing a notification.
+     *        A cycle ended by the window goes through the calibration, the validator, the filter, the reading
+     *        callback and the observer from the esp_timer task, which these must allow for.
+     * @param windowMs The window in milliseconds, 0 to process every notification as its own reading.
+     */
+    void setNotificationWindow(uint32_t windowMs);
+
+    /**
+     * @brief Gets the window in which the notifications of a measurement cycle are merged into one reading.
+     * @return The window in milliseconds.
+     */
+    uint32_t getNotificationWindow() const;
+
+    /**
+     * @brief Sets the smoothing filter of the live readings. The temperature and the humidity of every decoded
+     *        advertisement are filtered before they update the current values and reach the callback and observer.
+     *        History records are not filtered. Setting a filter resets it.
+     * @param config The filter and its parameters.
+     */
+    void setFilter(const ATC_FilterConfig &config);
+
+    /**
+     * @brief Gets the smoothing filter of the live readings.
+     * @return The filter and its parameters.
+     */
+    const ATC_FilterConfig &getFilter() const;
+
+    /**
+     * @brief Forgets the samples of the smoothing filter, for example after the thermometer was moved.
+     */
+    void resetFilter();
+
+    /**
+     * @brief Sets the validation stage of the readings. Live readings are checked against physical bounds, a maximum
+     *        rate of change and a robust z-score before the smoothing filter, history records against the bounds
+     *        only. Failing fields are dropped or flagged in ATC_MiThermometer_Reading::anomalies.
+     * @param config The checks and the action, Validation_action::OFF disables the stage.
+     */
+    void setValidation(const ATC_ValidationConfig &config);
+
+    /**
+     * @brief Gets the configuration of the validation stage.
+     * @return The checks and the action.
+     */
+    const ATC_ValidationConfig &getValidation() const;
+
+    /**
+     * @brief Gets the counters of the validation stage per rejection reason.
+     * @return The counters.
+     */
+    const ATC_ValidationStats &getValidationStats() const;
+
+    /**
+     * @brief Forgets the recent values of the validation stage and clears its counters.
+     */
+    void resetValidation();
+
+    /**
+     * @brief Sets the host-side calibration curve of the temperature or the humidity. The curve corrects the raw
+     *        values of the live readings and history records as they are decoded, before the validation stage, on
+     *        top of the offsets stored on the device.
+     * @param field READING_TEMPERATURE or READING_HUMIDITY.
+     * @param curve The curve, of type Calibration_type::NONE to remove the correction.
+     * @return True if the field and the curve are valid.
+     */
+    bool setCalibration(Reading_Field field, const ATC_CalibrationCurve &curve);
+
+    /**
+     * @brief Gets the host-side calibration curve of the temperature or the humidity.
+     * @param field READING_TEMPERATURE or READING_HUMIDITY.
+     * @return The curve, of type Calibration_type::NONE if the field is not corrected.
+     */
+    const ATC_CalibrationCurve &getCalibration(Reading_Field field) const;
+
 private:
     std::string address; /**< The MAC address of the thermometer. */
-    NimBLEClient *pClient; /**< Pointer to the BLE client. */
-    NimBLERemoteService *environmentService; /**< Pointer to the environment service. */
-    NimBLERemoteService *batteryService; /**< Pointer to the battery service. */
-    NimBLERemoteService *commandService; /**< Pointer to the command service. */
-    NimBLERemoteCharacteristic *temperatureCharacteristic; /**< Pointer to the temperature characteristic. */
-    NimBLERemoteCharacteristic *temperaturePreciseCharacteristic; /**< Pointer to the precise temperature characteristic. */
-    NimBLERemoteCharacteristic *humidityCharacteristic; /**< Pointer to the humidity characteristic. */
-    NimBLERemoteCharacteristic *batteryCharacteristic; /**< Pointer to the battery characteristic. */
-    NimBLERemoteCharacteristic *commandCharacteristic; /**< Pointer to the command characteristic. */
+    uint8_t native_address[6]; /**< The MAC address in NimBLE native order, compared without allocating. */
+    ATC_MiThermometer_GattState *gatt; /**< GATT state taken from the pool while connected, nullptr otherwise. */
     bool received_settings; /**< Flag indicating whether settings have been received. */
     bool read_settings; /**< Flag indicating whether settings have been read. */
-    bool started_notify_temp; /**< Flag indicating whether temperature notifications have been started. */
-    bool started_notify_temp_precise; /**< Flag indicating whether precise temperature notifications have been started. */
-    bool started_notify_humidity; /**< Flag indicating whether humidity notifications have been started. */
-    bool started_notify_battery; /**< Flag indicating whether battery notifications have been started. */
     float temperature; /**< The current temperature. */
     float temperature_precise; /**< The current precise temperature. */
     float humidity; /**< The current humidity. */
@@ -652,6 +1088,55 @@ private:
     Connection_mode connection_mode; /**< The connection mode being used. */
     time_t last_read_time; /**< The last time the thermometer was read. */
     bool time_tracking; /**< Flag indicating whether time tracking is enabled. */
+    std::vector<ATC_MiThermometer_Reading> history; /**< Records downloaded from the device log, newest first. */
+    volatile bool received_history_end; /**< Flag indicating whether the end of the history stream has been received. */
+    volatile uint32_t history_last_notify_time; /**< millis() of the last history notification. */
+    volatile bool history_reached_since; /**< Flag indicating whether a record older than history_since arrived. */
+    volatile bool history_full; /**< Flag indicating whether a record arrived with the history buffer full. */
+    volatile uint16_t history_received; /**< Number of records received by the download, kept or not. */
+    uint16_t history_requested; /**< Number of records requested by the download. */
+    time_t history_since; /**< Records older than or equal to this time end the download. */
+    time_t history_until; /**< Records newer than or equal to this time are skipped, 0 to keep all. */
+    bool history_backfill; /**< Flag indicating whether automatic history backfill is enabled. */
+    bool backfill_pending; /**< Flag indicating whether a gap was detected and a backfill is needed. */
+    uint16_t backfill_offset; /**< Number of newest records already received by the pending backfill. */
+    time_t backfill_newest; /**< Time of the newest record of the pending backfill, 0 if none. */
+    time_t backfill_oldest; /**< Time of the oldest record of the pending backfill, 0 if none. */
+    uint32_t backfill_gap_ms; /**< Time without advertisements that counts as a gap. */
+    uint32_t last_advertising_time; /**< millis() of the last advertisement, 0 if none since boot. */
+    time_t history_watermark; /**< Time of the newest ingested history record (UTC), by the device clock. */
+    std::array<ATC_MiThermometer_Command, command_queue_capacity> command_queue; /**< Pipelined command queue. */
+    size_t command_queue_count; /**< Number of commands in the command queue. */
+    std::atomic<size_t> commands_acknowledged; /**< Number of queued commands acknowledged during a flush. */
+    std::atomic<size_t> commands_sent; /**< Number of queued commands written during a flush. */
+    ATC_MiThermometer_CommandStats command_stats; /**< Statistics of the last flush. */
+    Connection_profile connection_profile; /**< The connection profile applied when connecting. */
+    std::array<ATC_MiThermometer_OperationStats, operation_type_count> operation_stats; /**< Timing per operation. */
+    std::function<void(const ATC_MiThermometer_Reading &, bool)> reading_callback; /**< Callback for new readings. */
+    ATC_ReadingObserver *reading_observer; /**< Observer for new readings, or nullptr. */
+    ATC_MiThermometer_Reading last_reading; /**< Latest live reading, merged over partial advertisements. */
+    ATC_ReadingCalibration calibration; /**< Host-side calibration of the readings. */
+    ATC_BatteryForecast battery_forecast; /**< Battery depletion forecast. */
+    ATC_ReadingValidator reading_validator; /**< Validation stage of the readings. */
+    ATC_ReadingFilter reading_filter; /**< Smoothing filter of the live readings. */
+    ATC_PsychrometricCache psychrometrics_cache; /**< Metrics derived from the latest temperature and humidity. */
+    ATC_NotificationCoalescer notification_coalescer; /**< Merges the notifications of a measurement cycle. */
+    esp_timer_handle_t notification_timer; /**< Timer ending the cycles missing a notification, created on use. */
+    std::mutex notification_mutex; /**< Mutex protecting notification_coalescer. */
+    int8_t last_rssi; /**< RSSI of the latest advertisement in dBm, 0 if unknown. */
+    bool lazy_init; /**< Flag indicating whether the thermometer is initialized on its first advertisement. */
+    bool init_pending; /**< Flag indicating whether an advertisement was received and init() is needed. */
+    bool format_detected; /**< Flag indicating whether the advertising type was detected before reading settings. */
+    uint32_t operation_deadline; /**< millis() at which connection attempts stop, 0 for no deadline. */
+    std::recursive_mutex ble_mutex; /**< Mutex serializing the BLE operations of this thermometer. */
+    std::atomic<Async_read_state> async_read_state; /**< State of the asynchronous characteristic read. */
+    std::string async_read_value; /**< Value of the asynchronous read, written by the NimBLE host task. */
+
+    /**
+     * @brief Checks whether the deadline set by init(uint32_t) has passed.
+     * @return True if a deadline is set and has passed, false otherwise.
+     */
+    bool deadlinePassed() const;
     /**
      * @brief Callback function for precise temperature notifications.
      * @param pBLERemoteCharacteristic Pointer to the characteristic that triggered the notification.
@@ -706,26 +1191,135 @@ private:
     notifySettingsCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData, size_t length,
                            bool isNotify);
 
+    /**
+     * @brief Callback function for history notifications. Stores one record of the device log.
+     * @param pBLERemoteCharacteristic  Pointer to the characteristic that triggered the notification.
+     * @param pData  Pointer to the notification data.
+     * @param length  Length of the notification data.
+     * @param isNotify True if this is a notification, false otherwise.
+     */
+    void
+    notifyHistoryCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData, size_t length,
+                          bool isNotify);
+
+    /**
+     * @brief Callback function for command acknowledgements during a pipelined flush. Matches the command ID of
+     *        the notification against the oldest unacknowledged command and forwards settings notifications.
+     * @param pBLERemoteCharacteristic  Pointer to the characteristic that triggered the notification.
+     * @param pData  Pointer to the notification data.
+     * @param length  Length of the notification data.
+     * @param isNotify True if this is a notification, false otherwise.
+     */
+    void
+    notifyCommandAckCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, const uint8_t *pData,
+                             size_t length, bool isNotify);
+
+    /**
+     * @brief Passes a reading through the reading pipeline. Live readings are calibrated, validated, filtered and
+     *        update the current values.
+     * @param received The reading to process.
+     * @param historical True if the reading was downloaded from the device log.
+     * @return True if the reading holds at least one field, false if it was discarded or empty.
+     */
+    bool processReading(const ATC_MiThermometer_Reading &received, bool historical);
+
+    /**
+     * @brief Adds a decoded notification to the current measurement cycle, and passes the reading of the cycle
+     *        through the reading pipeline when it ends.
+     * @param source The Notification_source of the notification.
+     * @param partial The reading decoded from the notification.
+     */
+    void coalesceNotification(uint8_t source, const ATC_MiThermometer_Reading &partial);
+
+    /**
+     * @brief Ends the current measurement cycle and passes its reading through the reading pipeline.
+     */
+    void flushNotifications();
+
+    /**
+     * @brief Ends the current measurement cycle if its window has elapsed, otherwise starts the notification timer
+     *        again for the rest of the window.
+     */
+    void flushDueNotifications();
+
+    /**
+     * @brief Stops and deletes the notification timer once a callback of it that is already running has returned.
+     */
+    void deleteNotificationTimer();
+
+    /**
+     * @brief Callback of the notification timer, ends the cycle of the thermometer passed as argument if due.
+     * @param arg Pointer to the ATC_MiThermometer.
+     */
+    static void notificationTimerCallback(void *arg);
+
+    /**
+     * @brief Downloads records from the device log. Shared implementation of readHistory() and readHistorySince().
+     * @param count The maximum number of records to download.
+     * @param offset The number of newest records to skip.
+     * @param since Records older than or equal to this time end the download, 0 to download all.
+     * @param until Records newer than or equal to this time are skipped, 0 to keep all.
+     * @return The number of records downloaded.
+     */
+    size_t downloadHistory(uint16_t count, uint16_t offset, time_t since, time_t until);
+
+    /**
+     * @brief Takes a GATT state and creates a BLE client with the parameters of the connection profile.
+     * @return True if the client was created, false otherwise.
+     */
+    bool createClient();
+
+    /**
+     * @brief Makes one connection attempt with the client created by createClient().
+     * @return True if connected, false otherwise.
+     */
+    bool tryConnect();
+
+    /**
+     * @brief Finds the command characteristic and subscribes to its notifications with the settings callback.
+     * @return True if subscribed, false otherwise.
+     */
+    bool subscribeSettings();
+
+    /**
+     * @brief Applies the connection parameters of a profile to the current connection.
+     * @param profile The connection profile to apply.
+     */
+    void applyConnectionProfile(Connection_profile profile);
+
+    /**
+     * @brief Loads the history watermark from flash.
+     */
+    void loadHistoryWatermark();
+
+    /**
+     * @brief Writes the history watermark to flash.
+     */
+    void saveHistoryWatermark();
+
     /**
      * @brief Parses advertising data specifically for ATC1441 format.
      * @param data  Pointer to the advertising data.
      * @param length Length of the advertising data.
+     * @return True if a reading was decoded and accepted by processReading(), false otherwise.
      */
-    void parseAdvertisingDataATC1441(const uint8_t *data, size_t length);
+    bool parseAdvertisingDataATC1441(const uint8_t *data, size_t length);
 
     /**
      * @brief Parses advertising data specifically for PVVX format.
      * @param data Pointer to the advertising data.
      * @param length  Length of the advertising data.
+     * @return True if a reading was decoded and accepted by processReading(), false otherwise.
      */
-    void parseAdvertisingDataPVVX(const uint8_t *data, size_t length);
+    bool parseAdvertisingDataPVVX(const uint8_t *data, size_t length);
 
     /**
      * @brief  Parses advertising data specifically for BTHome format.
      * @param data Pointer to the advertising data.
      * @param length Length of the advertising data.
+     * @return True if a reading was decoded and accepted by processReading(), false otherwise.
      */
-    void parseAdvertisingDataBTHOME(const uint8_t *data, size_t length);
+    bool parseAdvertisingDataBTHOME(const uint8_t *data, size_t length);
 
     /**
      * @brief  Connects to the environment service.
@@ -769,12 +1363,68 @@ private:
 
     /**
      * @brief Reads the value of a characteristic and calls the provided callback with the result.
+     *        The callable is invoked directly, without being wrapped in a std::function.
      *
+     * @tparam Callback A callable taking a const std::string &.
      * @param characteristic A pointer to the NimBLERemoteCharacteristic to read.
      * @param callback A function to call with the read value. The value is passed as a std::string.
      */
-    void readCharacteristicValue(NimBLERemoteCharacteristic *characteristic,
-                                 std::function<void(const std::string &)> callback);
+    template<typename Callback>
+    void readCharacteristicValue(NimBLERemoteCharacteristic *characteristic, Callback &&callback) {
+        std::string value;
+        if (readCharacteristic(characteristic, value)) {
+            callback(value);
+        }
+    }
+
+    /**
+     * @brief Reads the value of a characteristic and records the time taken.
+     * @param characteristic A pointer to the NimBLERemoteCharacteristic to read.
+     * @param value Receives the read value.
+     * @return True if the value was read, false if the characteristic is null.
+     */
+    bool readCharacteristic(NimBLERemoteCharacteristic *characteristic, std::string &value);
+
+    /**
+     * @brief Stores a value read from the precise temperature characteristic.
+     * @param value The value.
+     */
+    void storeTemperaturePrecise(const std::string &value);
+
+    /**
+     * @brief Stores a value read from the humidity characteristic.
+     * @param value The value.
+     */
+    void storeHumidity(const std::string &value);
+
+    /**
+     * @brief Stores a value read from the battery characteristic.
+     * @param value The value.
+     */
+    void storeBatteryLevel(const std::string &value);
+
+    /**
+     * @brief Completes the asynchronous read of a thermometer. Called by the NimBLE host task.
+     * @param connHandle The connection handle.
+     * @param error The status of the read.
+     * @param attr The attribute read, with its value.
+     * @param arg The thermometer.
+     * @return 0.
+     */
+    static int asyncReadCallback(uint16_t connHandle, const ble_gatt_error *error, ble_gatt_attr *attr, void *arg);
+
+#ifdef ATC_ASYNC_SUPPORTED
+    /**
+     * @brief Awaitable version of readCharacteristic(). Starts the read on the NimBLE host and suspends the coroutine
+     *        until its callback completes it, and records the time taken.
+     * @param loop The loop resuming the coroutine.
+     * @param characteristic A pointer to the NimBLERemoteCharacteristic to read.
+     * @param value Receives the read value, must outlive the task.
+     * @return A task whose result is true if the value was read.
+     */
+    ATC_Task<bool> readCharacteristicAsync(ATC_AsyncLoop &loop, NimBLERemoteCharacteristic *characteristic,
+                                           std::string &value);
+#endif
 };
 
 #endif
\ No newline at end of file
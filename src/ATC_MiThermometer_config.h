@@ -0,0 +1,79 @@
+/**
+ * @file ATC_MiThermometer_config.h
+ * @brief This file contains the compile-time configuration of the ATC_MiThermometer library.
+ * Every value can be overridden by defining it before including the library, e.g. with build flags.
+ */
+#ifndef ATC_MI_THERMOMETER_CONFIG_H
+#define ATC_MI_THERMOMETER_CONFIG_H
+
+/**
+ * @brief Set to 1 to use fixed-capacity containers sized below instead of growing ones, so scanning and the
+ *        reading pipeline do not allocate from the heap once the thermometers are registered. Connections still
+ *        allocate in NimBLE and for the notification callbacks.
+ */
+#ifndef ATC_STATIC_ALLOCATION
+#define ATC_STATIC_ALLOCATION 0
+#endif
+
+/** @brief Maximum number of ATC_MiThermometer instances per BLEAdvertisingReader in static allocation mode. */
+#ifndef ATC_MAX_DEVICES
+#define ATC_MAX_DEVICES 32
+#endif
+
+/** @brief Maximum number of compact thermometers per BLEAdvertisingReader in static allocation mode. */
+#ifndef ATC_MAX_COMPACT_DEVICES
+#define ATC_MAX_COMPACT_DEVICES 256
+#endif
+
+/**
+ * @brief Number of history records reserved per thermometer in static allocation mode.
+ *        Larger downloads are truncated to this count.
+ */
+#ifndef ATC_HISTORY_CAPACITY
+#define ATC_HISTORY_CAPACITY 128
+#endif
+
+/**
+ * @brief Default stack size in bytes of the tasks of a parallel init. Each task connects and reads the settings of a
+ *        thermometer, with the NimBLE client calls and the reading pipeline on its stack.
+ */
+#ifndef ATC_INIT_TASK_STACK_SIZE
+#define ATC_INIT_TASK_STACK_SIZE 8192
+#endif
+
+/**
+ * @brief Time in milliseconds an awaitable operation waits for a blocking operation of the same thermometer, running
+ *        on another task, to finish before it gives up.
+ */
+#ifndef ATC_ASYNC_LOCK_TIMEOUT_MS
+#define ATC_ASYNC_LOCK_TIMEOUT_MS 60000
+#endif
+
+/**
+ * @brief Time in milliseconds an awaitable characteristic read waits for its value.
+ */
+#ifndef ATC_ASYNC_READ_TIMEOUT_MS
+#define ATC_ASYNC_READ_TIMEOUT_MS 5000
+#endif
+
+/**
+ * @brief Set to 1 to compute the cached psychrometric metrics with the interpolated table instead of libm. The table
+ *        only avoids exp() and log(), measure on the target before enabling it: on a host libm is faster.
+ */
+#ifndef ATC_PSYCHROMETRICS_TABLE
+#define ATC_PSYCHROMETRICS_TABLE 0
+#endif
+
+/**
+ * @brief Number of GATT states in the pool, the maximum number of thermometers connected at the same time.
+ *        Defaults to the NimBLE connection limit.
+ */
+#ifndef ATC_GATT_STATE_POOL_SIZE
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#define ATC_GATT_STATE_POOL_SIZE CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#else
+#define ATC_GATT_STATE_POOL_SIZE 3
+#endif
+#endif
+
+#endif // ATC_MI_THERMOMETER_CONFIG_H
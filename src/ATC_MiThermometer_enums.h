@@ -6,6 +6,8 @@
 #ifndef ATC_MI_THERMOMETER_ENUMS_H
 #define ATC_MI_THERMOMETER_ENUMS_H
 
+#include <cstdint>
+
 /**
  * @enum Advertising_Type
  * @brief This enum represents the different advertising types used by the thermometer.
@@ -27,6 +29,149 @@ enum class Connection_mode {
     CONNECTION = 2, /**<  Maintains a connection to the device and reads data on demand. */
 };
 
+/**
+ * @enum Connection_profile
+ * @brief This enum represents the named sets of connection parameters applied when connecting.
+ */
+enum class Connection_profile {
+    STANDARD = 0, /**< NimBLE default connection parameters. */
+    FAST_POLL = 1, /**< Short connection interval for quick one-shot reads. */
+    BULK_TRANSFER = 2, /**< Short connection interval and large MTU for history downloads and OTA. */
+    LOW_POWER_HOLD = 3, /**< Long connection interval with slave latency for long lived, mostly idle connections. */
+};
+
+/**
+ * @enum Operation_type
+ * @brief This enum represents the types of GATT operations whose duration is recorded.
+ */
+enum class Operation_type {
+    CONNECT = 0, /**< Connection establishment. */
+    READ = 1, /**< Characteristic read. */
+    SETTINGS = 2, /**< Settings read or write. */
+    HISTORY = 3, /**< History download. */
+    COMMAND = 4, /**< Command sequence. */
+};
+
+/**
+ * @enum Async_read_state
+ * @brief This enum represents the state of the asynchronous characteristic read of a thermometer.
+ */
+enum class Async_read_state : uint8_t {
+    IDLE = 0, /**< No read started, or the result was taken. */
+    PENDING = 1, /**< Waiting for the NimBLE host to complete the read. */
+    DONE = 2, /**< The value was received. */
+    FAILED = 3, /**< The read failed. */
+};
+
+/**
+ * @enum Ota_state
+ * @brief This enum represents the states of an over-the-air firmware update job.
+ */
+enum class Ota_state {
+    PENDING = 0, /**< Waiting for a connection slot, or for a reconnect after a disconnect. */
+    TRANSFERRING = 1, /**< Connected and sending the firmware image. */
+    DONE = 2, /**< The whole image was sent and the end command acknowledged. */
+    FAILED = 3, /**< The image is invalid or the transfer failed too many times. */
+};
+
+/**
+ * @enum Ota_burst_result
+ * @brief This enum represents the outcome of sending one burst of OTA packets.
+ */
+enum class Ota_burst_result {
+    SENT = 0, /**< The burst was sent and confirmed, packets remain. */
+    REWOUND = 1, /**< A write failed, the transfer goes back to the last confirmed packet. */
+    COMPLETE = 2, /**< The last packet and the end command were sent. */
+    READ_FAILED = 3, /**< The firmware image could not be read. */
+    WRITE_FAILED = 4, /**< Too many bursts in a row failed. */
+    END_FAILED = 5, /**< The end command could not be sent. */
+};
+
+/**
+ * @enum Init_result
+ * @brief This enum represents the outcome of the initialization of one thermometer by a parallel init.
+ */
+enum class Init_result {
+    PENDING = 0, /**< Not started yet. */
+    DONE = 1, /**< The settings were read. */
+    FAILED = 2, /**< The connection or the settings read failed within the time budget. */
+    TIMED_OUT = 3, /**< The time budget ran out during the initialization. */
+    SKIPPED = 4, /**< The time budget ran out before the initialization started. */
+};
+
+/**
+ * @enum Filter_type
+ * @brief This enum represents the smoothing filter applied to the live readings of a thermometer.
+ */
+enum class Filter_type {
+    NONE = 0, /**< The readings are not filtered. */
+    EWMA = 1, /**< Exponentially weighted moving average. */
+    MEDIAN = 2, /**< Median of the last 3, 5 or 7 samples. */
+    KALMAN = 3, /**< Scalar Kalman filter with a constant value model. */
+};
+
+/**
+ * @enum Validation_action
+ * @brief This enum represents what the validation stage does with a field that fails a check.
+ */
+enum class Validation_action {
+    OFF = 0, /**< The readings are not validated. */
+    FLAG = 1, /**< The field is kept and marked in the anomalies of the reading. */
+    DROP = 2, /**< The field is removed from the reading, a reading without fields is discarded. */
+};
+
+/**
+ * @enum Calibration_type
+ * @brief This enum represents the kind of a host-side calibration curve.
+ */
+enum class Calibration_type {
+    NONE = 0, /**< The values are not corrected. */
+    PIECEWISE_LINEAR = 1, /**< Linear interpolation between calibration points. */
+    POLYNOMIAL = 2, /**< Polynomial of degree up to 3. */
+};
+
+/**
+ * @enum Rule_condition
+ * @brief This enum represents the condition of an alert rule.
+ */
+enum class Rule_condition {
+    ABOVE = 0, /**< The value is above the threshold. */
+    BELOW = 1, /**< The value is below the threshold. */
+    RISING = 2, /**< The value rises by at least the threshold per minute. */
+    FALLING = 3, /**< The value falls by at least the threshold per minute. */
+};
+
+/**
+ * @enum Reading_Field
+ * @brief This enum holds the bit flags marking which fields of an ATC_MiThermometer_Reading are valid.
+ */
+enum Reading_Field : uint8_t {
+    READING_TEMPERATURE = 0x01, /**< Temperature is valid. */
+    READING_HUMIDITY = 0x02, /**< Humidity is valid. */
+    READING_BATTERY_MV = 0x04, /**< Battery voltage is valid. */
+    READING_BATTERY_LEVEL = 0x08, /**< Battery level is valid. */
+};
+
+/**
+ * @enum Reading_Event_Flag
+ * @brief This enum holds the bit flags describing an ATC_ReadingEvent.
+ */
+enum Reading_Event_Flag : uint8_t {
+    EVENT_FIRST = 0x01, /**< First reading received from the device. */
+    EVENT_COMPACT = 0x02, /**< The device is a compact thermometer. */
+};
+
+/**
+ * @enum Notification_source
+ * @brief This enum holds the bit flags of the characteristics whose notifications are coalesced into one reading.
+ */
+enum Notification_source : uint8_t {
+    NOTIFY_TEMPERATURE = 0x01, /**< Temperature characteristic (2A1F), in 0.1 degrees Celsius. */
+    NOTIFY_TEMPERATURE_PRECISE = 0x02, /**< Precise temperature characteristic (2A6E), in 0.01 degrees Celsius. */
+    NOTIFY_HUMIDITY = 0x04, /**< Humidity characteristic (2A6F). */
+    NOTIFY_BATTERY_LEVEL = 0x08, /**< Battery level characteristic (2A19). */
+};
+
 /**
  * @enum Smiley
  * @brief This enum represents the different smiley states that can be displayed on the thermometer.
@@ -6,6 +6,9 @@
 #define ATC_MI_THERMOMETER_STRUCTS_H
 
 #include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include "ATC_MiThermometer_config.h"
 #include "ATC_MiThermometer_enums.h"
 
 /**
@@ -38,4 +41,313 @@ struct ATC_MiThermometer_Settings {
     HW_VERSION_ID hw_version; /**< The hardware version ID. */
     uint8_t averaging_measurements; /**< Number of measurements for averaging. */
 };
+
+/**
+ * @struct ATC_MiThermometer_Reading
+ * @brief This structure holds a single timestamped measurement, either received live or downloaded from the device log.
+ */
+struct ATC_MiThermometer_Reading {
+    time_t time; /**< The time of the measurement (UTC). */
+    int16_t temperature; /**< The temperature in 0.01 degrees Celsius. */
+    uint16_t humidity; /**< The humidity in 0.01 percent. */
+    uint16_t battery_mv; /**< The battery voltage in mV. */
+    uint8_t battery_level; /**< The battery level in percent. */
+    uint8_t fields; /**< Bitmask of Reading_Field flags marking the valid fields. */
+    uint8_t anomalies; /**< Bitmask of Reading_Field flags whose value was flagged by the validation stage. */
+};
+
+/**
+ * @struct ATC_ReadingEvent
+ * @brief This structure holds a reading event delivered by BLEAdvertisingReader.
+ */
+struct ATC_ReadingEvent {
+    uint64_t address; /**< The packed MAC address of the device, most significant byte first. */
+    ATC_MiThermometer_Reading reading; /**< The full latest reading of the device. */
+    uint8_t changed; /**< Bitmask of Reading_Field flags whose value changed with this reading. */
+    uint8_t flags; /**< Bitmask of Reading_Event_Flag values. */
+};
+
+/** @brief Maximum length in bytes of a queued command, the ATT payload of the default MTU. */
+constexpr size_t command_max_length = 20;
+
+/**
+ * @struct ATC_MiThermometer_Command
+ * @brief This structure holds a command queued for pipelined sending.
+ */
+struct ATC_MiThermometer_Command {
+    uint8_t data[command_max_length]; /**< The command bytes, the first byte is the command ID. */
+    uint8_t length; /**< The number of valid bytes in data. */
+};
+
+/**
+ * @struct ATC_MiThermometer_CommandStats
+ * @brief This structure holds the statistics of the last pipelined command flush.
+ */
+struct ATC_MiThermometer_CommandStats {
+    uint32_t sent; /**< Number of commands written. */
+    uint32_t acknowledged; /**< Number of commands acknowledged by a notification. */
+    uint32_t timeouts; /**< Number of commands not acknowledged in time. */
+    uint32_t elapsed_ms; /**< Time taken by the flush in milliseconds. */
+};
+
+/**
+ * @struct ATC_MiThermometer_ConnectionParams
+ * @brief This structure holds the connection parameters of a connection profile.
+ */
+struct ATC_MiThermometer_ConnectionParams {
+    uint16_t min_interval; /**< Minimum connection interval in 1.25 ms units. */
+    uint16_t max_interval; /**< Maximum connection interval in 1.25 ms units. */
+    uint16_t latency; /**< Slave latency in connection events. */
+    uint16_t supervision_timeout; /**< Supervision timeout in 10 ms units. */
+    uint16_t mtu; /**< Preferred ATT MTU of the connection, 0 for the global preferred MTU. */
+};
+
+/**
+ * @struct ATC_MiThermometer_OperationStats
+ * @brief This structure holds the timing statistics of one type of GATT operation.
+ */
+struct ATC_MiThermometer_OperationStats {
+    uint32_t count; /**< Number of operations. */
+    uint32_t total_ms; /**< Total time spent in milliseconds. */
+    uint32_t max_ms; /**< Longest operation in milliseconds. */
+};
+/**
+ * @struct ATC_CompactThermometer
+ * @brief This structure holds an advertising-only thermometer: its address, format, key and latest raw reading.
+ *        It has no settings and no GATT state, so large fleets can be tracked in a contiguous array.
+ */
+struct ATC_CompactThermometer {
+    uint8_t address[6]; /**< The MAC address in NimBLE native order (least significant byte first). */
+    uint8_t format; /**< The advertising format, an Advertising_Type value. */
+    uint8_t fields; /**< Bitmask of Reading_Field flags marking the valid reading fields. */
+    uint8_t key[16]; /**< The advertising bind key, all zero when the advertising is not encrypted. */
+    int16_t temperature; /**< The latest temperature in 0.01 degrees Celsius. */
+    uint16_t humidity; /**< The latest humidity in 0.01 percent. */
+    uint16_t battery_mv; /**< The latest battery voltage in mV. */
+    uint8_t battery_level; /**< The latest battery level in percent. */
+    int8_t rssi; /**< The RSSI of the latest advertisement in dBm. */
+    uint32_t last_seen; /**< The millis() timestamp of the latest advertisement, 0 if never seen. */
+};
+
+static_assert(sizeof(ATC_CompactThermometer) <= 64, "ATC_CompactThermometer must stay below 64 bytes");
+
+/** @brief Maximum length in bytes of a raw advertisement, advertising data followed by the scan response. */
+constexpr size_t advertisement_max_length = 62;
+
+/**
+ * @struct ATC_RawAdvertisement
+ * @brief This structure holds a copy of a received advertisement, queued for the processing task.
+ */
+struct ATC_RawAdvertisement {
+    uint8_t address[6]; /**< The MAC address in NimBLE native order (least significant byte first). */
+    int8_t rssi; /**< The RSSI in dBm. */
+    uint8_t length; /**< The number of valid bytes in payload. */
+    uint8_t payload[advertisement_max_length]; /**< The advertising payload. */
+};
+
+/**
+ * @struct ATC_WorkerConfig
+ * @brief This structure holds the configuration of the advertisement processing task.
+ */
+struct ATC_WorkerConfig {
+    int core = -1; /**< The core the task is pinned to, -1 for no affinity. */
+    uint8_t priority = 5; /**< The FreeRTOS priority of the task. */
+    uint32_t stack_size = 4096; /**< The stack size of the task in bytes. */
+    uint16_t queue_length = 32; /**< The number of advertisements the queue can hold. */
+};
+
+/**
+ * @struct ATC_WorkerStats
+ * @brief This structure holds the statistics of the advertisement processing task.
+ */
+struct ATC_WorkerStats {
+    uint32_t received; /**< Number of advertisements received from the scanner. */
+    uint32_t processed; /**< Number of advertisements dispatched to thermometers, by the task or inline. */
+    uint32_t dropped; /**< Number of advertisements dropped because the queue was full. */
+    uint32_t queue_high_watermark; /**< Highest number of advertisements waiting in the queue. */
+};
+
+/**
+ * @struct ATC_InitConfig
+ * @brief This structure holds the configuration of a parallel initialization of thermometers.
+ */
+struct ATC_InitConfig {
+    uint8_t max_concurrent = 3; /**< The maximum number of thermometers initialized at the same time. */
+    uint32_t time_budget_ms = 60000; /**< The time after which running attempts are cut short and no new one starts. */
+    int core = -1; /**< The core the init tasks are pinned to, -1 for no affinity. */
+    uint8_t priority = 5; /**< The FreeRTOS priority of the init tasks. */
+    uint32_t stack_size = ATC_INIT_TASK_STACK_SIZE; /**< The stack size of each init task in bytes. */
+};
+
+/**
+ * @struct ATC_InitTimelineEntry
+ * @brief This structure holds the initialization of one thermometer in the timeline of a parallel init.
+ */
+struct ATC_InitTimelineEntry {
+    uint64_t address; /**< The packed MAC address of the thermometer. */
+    int8_t rssi; /**< The RSSI used to order the thermometers in dBm, 0 if none was received. */
+    Init_result result; /**< The outcome of the initialization. */
+    uint32_t start_ms; /**< Start of the initialization in milliseconds since the start of the parallel init. */
+    uint32_t end_ms; /**< End of the initialization in milliseconds since the start of the parallel init. */
+};
+
+/** @brief Largest window of the median filter. */
+constexpr uint8_t filter_median_max_window = 7;
+
+/**
+ * @struct ATC_FilterConfig
+ * @brief This structure holds the configuration of the smoothing filter of a thermometer. The temperature and the
+ *        humidity are filtered separately with the same parameters, in their raw units of 0.01 degree and 0.01 %.
+ */
+struct ATC_FilterConfig {
+    Filter_type type = Filter_type::NONE; /**< The filter. */
+    uint16_t ewma_alpha = 13107; /**< EWMA weight of a new sample in 1/65536, 0.2 by default. */
+    uint8_t median_window = 5; /**< Median window of 3, 5 or 7 samples. */
+    uint32_t kalman_process_noise = 4; /**< Kalman process noise variance per sample in raw units squared. */
+    uint32_t kalman_measurement_noise = 400; /**< Kalman measurement noise variance in raw units squared. */
+};
+
+/** @brief Largest window of recent values used by the robust z-score of the validation stage. */
+constexpr uint8_t validation_max_window = 16;
+
+/**
+ * @struct ATC_ValidationConfig
+ * @brief This structure holds the configuration of the validation stage of the live readings. The limits are in
+ *        the raw units of the reading, a rate or threshold of 0 disables its check.
+ */
+struct ATC_ValidationConfig {
+    Validation_action action = Validation_action::DROP; /**< What to do with a field failing a check. */
+    int16_t temperature_min = -4000; /**< Lowest valid temperature in 0.01 degrees Celsius. */
+    int16_t temperature_max = 8500; /**< Highest valid temperature in 0.01 degrees Celsius. */
+    uint16_t humidity_min = 1; /**< Lowest valid humidity in 0.01 %, exactly 0 is a decoding artefact. */
+    uint16_t humidity_max = 10000; /**< Highest valid humidity in 0.01 %. */
+    uint16_t battery_mv_min = 1500; /**< Lowest valid battery voltage in mV. */
+    uint16_t battery_mv_max = 3700; /**< Highest valid battery voltage in mV. */
+    uint16_t temperature_max_rate = 100; /**< Largest temperature change in 0.01 degrees per second. */
+    uint16_t humidity_max_rate = 500; /**< Largest humidity change in 0.01 % per second. */
+    uint8_t zscore_window = validation_max_window; /**< Number of recent accepted values for the z-score. */
+    uint8_t zscore_min_samples = 8; /**< Values needed in the window before the z-score is checked. */
+    float zscore_threshold = 6.0f; /**< Largest robust z-score, computed with the median absolute deviation. */
+    uint16_t temperature_mad_floor = 10; /**< Smallest deviation used for the temperature z-score. */
+    uint16_t humidity_mad_floor = 50; /**< Smallest deviation used for the humidity z-score. */
+    uint8_t rebaseline_after = 5; /**< Consecutive rate or z-score failures accepted as a real change. */
+};
+
+/**
+ * @struct ATC_ValidationStats
+ * @brief This structure holds the counters of the validation stage, per rejection reason. Each failing field
+ *        counts once, for the first check it failed. Only live readings are counted, not history records.
+ */
+struct ATC_ValidationStats {
+    uint32_t checked; /**< Fields checked. */
+    uint32_t out_of_range; /**< Fields outside their physical bounds. */
+    uint32_t rate_of_change; /**< Fields changing faster than the maximum rate. */
+    uint32_t outlier; /**< Fields whose robust z-score exceeded the threshold. */
+    uint32_t rebaselined; /**< Changes accepted after rebaseline_after consecutive failures. */
+};
+
+/** @brief Number of downsampled battery samples kept per thermometer. */
+constexpr uint8_t battery_history_size = 32;
+
+/**
+ * @struct ATC_BatteryForecastConfig
+ * @brief This structure holds the configuration of the battery depletion forecast of a thermometer.
+ */
+struct ATC_BatteryForecastConfig {
+    uint32_t sample_interval_s = 21600; /**< Readings are averaged into one sample per interval, 6 hours by default. */
+    uint16_t cutoff_mv = 2200; /**< Voltage at which the battery must be replaced. */
+    float forgetting = 0.99f; /**< Weight kept by the older samples at each new sample, below 1 to follow changes. */
+    uint8_t min_samples = 8; /**< Samples needed before a forecast is made. */
+};
+
+/**
+ * @struct ATC_BatterySample
+ * @brief This structure holds one downsampled battery sample, the mean of the readings of one interval.
+ */
+struct ATC_BatterySample {
+    uint32_t time; /**< Start of the interval (UTC). */
+    uint16_t battery_mv; /**< Mean battery voltage in mV. */
+    int16_t temperature; /**< Mean temperature in 0.01 degrees Celsius. */
+};
+
+/**
+ * @struct ATC_BatteryReplacement
+ * @brief This structure holds a thermometer whose battery is forecast to reach the cutoff voltage soon.
+ */
+struct ATC_BatteryReplacement {
+    uint64_t address; /**< The packed MAC address of the thermometer. */
+    float days_left; /**< Forecast days until the cutoff voltage is reached. */
+    uint16_t battery_mv; /**< The latest battery voltage in mV. */
+};
+
+/** @brief Maximum number of points of a piecewise-linear calibration curve. */
+constexpr uint8_t calibration_max_points = 8;
+/** @brief Maximum degree of a polynomial calibration curve. */
+constexpr uint8_t calibration_max_degree = 3;
+
+/**
+ * @struct ATC_CalibrationCurve
+ * @brief This structure defines a host-side correction of the temperature or the humidity of a thermometer, applied
+ *        on top of the offsets stored on the device.
+ */
+struct ATC_CalibrationCurve {
+    Calibration_type type = Calibration_type::NONE; /**< The kind of curve. */
+    uint8_t point_count = 0; /**< Number of points of a piecewise-linear curve, one point is a constant offset. */
+    int32_t raw[calibration_max_points] = {}; /**< Measured values of the points in ascending order, in 0.01 units. */
+    int32_t corrected[calibration_max_points] = {}; /**< Reference values of the points in 0.01 units. */
+    float coefficients[calibration_max_degree + 1] = {}; /**< y = c0 + c1*x + c2*x^2 + c3*x^3 in degrees or %. */
+    int32_t range_min = 0; /**< Lowest value in 0.01 units where the polynomial is evaluated exactly. */
+    int32_t range_max = 0; /**< Highest value in 0.01 units where the polynomial is evaluated exactly. */
+};
+
+/**
+ * @struct ATC_ZoneStats
+ * @brief This structure holds the live aggregate of one field over the devices of a zone.
+ */
+struct ATC_ZoneStats {
+    uint32_t count; /**< Number of fresh devices included, the other fields are 0 if it is 0. */
+    int32_t min; /**< The minimum value in the raw unit of the field. */
+    int32_t max; /**< The maximum value in the raw unit of the field. */
+    float mean; /**< The mean value in the raw unit of the field. */
+    float deviation; /**< The population standard deviation in the raw unit of the field. */
+};
+
+/**
+ * @struct ATC_AlertRule
+ * @brief This structure defines an alert rule on one field of the readings, in the raw unit of the field.
+ */
+struct ATC_AlertRule {
+    uint16_t id = 0; /**< Identifier reported in the alert events. */
+    uint64_t address = 0; /**< Packed MAC address of the device, 0 for every device. */
+    Reading_Field field = READING_TEMPERATURE; /**< The field checked by the rule. */
+    Rule_condition condition = Rule_condition::ABOVE; /**< The condition raising the alert. */
+    int32_t threshold = 0; /**< The threshold, per minute for RISING and FALLING. */
+    int32_t hysteresis = 0; /**< Distance back past the threshold needed to clear the alert. */
+    uint32_t duration_ms = 0; /**< Time the condition must hold before the alert is raised, for ABOVE and BELOW,
+                                   or the time over which the rate is measured, for RISING and FALLING. */
+};
+
+/**
+ * @struct ATC_AlertEvent
+ * @brief This structure holds an alert raised or cleared by a rule.
+ */
+struct ATC_AlertEvent {
+    uint64_t address; /**< The packed MAC address of the device. */
+    uint16_t rule_id; /**< The identifier of the rule. */
+    bool raised; /**< True if the alert was raised, false if it was cleared. */
+    int32_t value; /**< The value, or the rate per minute, that raised or cleared the alert. */
+    time_t time; /**< The time of the event (UTC). */
+    uint32_t timestamp_ms; /**< The millis() timestamp of the event. */
+};
+
+/**
+ * @struct ATC_OtaProgress
+ * @brief This structure holds the position of an OTA transfer in the packets of a firmware image.
+ */
+struct ATC_OtaProgress {
+    uint16_t packet_count; /**< The number of OTA packets of the image. */
+    uint16_t next_packet; /**< Index of the next packet to send. */
+    uint16_t confirmed_packet; /**< Number of packets confirmed by a write with response. */
+    uint8_t failed_bursts; /**< Number of bursts in a row that failed since the last confirmed one. */
+};
 #endif // ATC_MI_THERMOMETER_STRUCTS_H
\ No newline at end of file
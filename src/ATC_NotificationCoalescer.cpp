@@ -0,0 +1,125 @@
+/**
+ * @file ATC_NotificationCoalescer.cpp
+ * @brief This file contains the implementation of the ATC_NotificationCoalescer class.
+ */
+#include "ATC_NotificationCoalescer.h"
+
+/**
+ * @brief Constructor for the ATC_NotificationCoalescer class.
+ * @param windowMs The time in milliseconds after the first notification of a cycle at which it ends.
+ */
+ATC_NotificationCoalescer::ATC_NotificationCoalescer(uint32_t windowMs)
+        : pending(), received(0), expected(0), first_ms(0), window_ms(windowMs) {
+}
+
+/**
+ * @brief Sets the time after the first notification of a cycle at which it ends.
+ * @param windowMs The window in milliseconds, 0 to end the cycle with every notification.
+ */
+void ATC_NotificationCoalescer::setWindow(uint32_t windowMs) {
+    window_ms = windowMs;
+}
+
+/**
+ * @brief Gets the time after the first notification of a cycle at which it ends.
+ * @return The window in milliseconds.
+ */
+uint32_t ATC_NotificationCoalescer::getWindow() const {
+    return window_ms;
+}
+
+/**
+ * @brief Gets the time of the first notification of the open cycle.
+ * @return The millis() timestamp, meaningless if no cycle is open.
+ */
+uint32_t ATC_NotificationCoalescer::getFirstTime() const {
+    return first_ms;
+}
+
+/**
+ * @brief Sets the sources notifying in every cycle.
+ * @param sources Bitmask of Notification_source values.
+ */
+void ATC_NotificationCoalescer::setExpected(uint8_t sources) {
+    expected = sources;
+}
+
+/**
+ * @brief Adds a notification to the current cycle. A source already received in the cycle ends it and opens the next
+ * one with this notification. The cycle also ends once every expected source has notified, or at once without a
+ * window.
+ * @param source The Notification_source of the notification.
+ * @param partial The reading decoded from the notification.
+ * @param nowMs The current millis() timestamp.
+ * @param cycle Set to the reading of the cycle that ended, if any.
+ * @return True if a cycle ended and cycle holds its reading.
+ */
+bool ATC_NotificationCoalescer::add(uint8_t source, const ATC_MiThermometer_Reading &partial, uint32_t nowMs,
+                                    ATC_MiThermometer_Reading &cycle) {
+    bool ended = false;
+    if (received & source) {
+        ended = flush(cycle);
+    }
+    if (!received) {
+        pending = ATC_MiThermometer_Reading();
+        first_ms = nowMs;
+    }
+    received |= source;
+    // The 0.1 degree temperature only fills in when the precise one is not part of the cycle
+    uint8_t fields = partial.fields;
+    if ((fields & READING_TEMPERATURE) && source == NOTIFY_TEMPERATURE && (received & NOTIFY_TEMPERATURE_PRECISE)) {
+        fields &= static_cast<uint8_t>(~READING_TEMPERATURE);
+    }
+    if (fields & READING_TEMPERATURE) {
+        pending.temperature = partial.temperature;
+    }
+    if (fields & READING_HUMIDITY) {
+        pending.humidity = partial.humidity;
+    }
+    if (fields & READING_BATTERY_MV) {
+        pending.battery_mv = partial.battery_mv;
+    }
+    if (fields & READING_BATTERY_LEVEL) {
+        pending.battery_level = partial.battery_level;
+    }
+    pending.fields |= fields;
+    if (!ended && (window_ms == 0 || (expected && (received & expected) == expected))) {
+        ended = flush(cycle);
+    }
+    return ended;
+}
+
+/**
+ * @brief Ends the current cycle if its window has elapsed.
+ * @param nowMs The current millis() timestamp.
+ * @param cycle Set to the reading of the cycle, if it ended.
+ * @return True if the cycle ended and cycle holds its reading.
+ */
+bool ATC_NotificationCoalescer::flushDue(uint32_t nowMs, ATC_MiThermometer_Reading &cycle) {
+    if (!received || nowMs - first_ms < window_ms) {
+        return false;
+    }
+    return flush(cycle);
+}
+
+/**
+ * @brief Ends the current cycle.
+ * @param cycle Set to the reading of the cycle, if one was open.
+ * @return True if a cycle was open and cycle holds its reading.
+ */
+bool ATC_NotificationCoalescer::flush(ATC_MiThermometer_Reading &cycle) {
+    if (!received) {
+        return false;
+    }
+    cycle = pending;
+    received = 0;
+    return true;
+}
+
+/**
+ * @brief Checks if a cycle is open.
+ * @return True if notifications are waiting to be merged with the rest of their cycle.
+ */
+bool ATC_NotificationCoalescer::isPending() const {
+    return received != 0;
+}
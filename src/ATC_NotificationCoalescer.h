@@ -0,0 +1,96 @@
+/**
+ * @file ATC_NotificationCoalescer.h
+ * @brief This file contains the declaration of the ATC_NotificationCoalescer class, which groups the temperature,
+ * humidity and battery notifications of one measurement cycle into a single reading.
+ * The class only depends on the standard library, so it can also be used on a host.
+ */
+#ifndef ATC_NOTIFICATION_COALESCER_H
+#define ATC_NOTIFICATION_COALESCER_H
+
+#include <cstdint>
+#include "ATC_MiThermometer_structs.h"
+
+/** @brief Default time in milliseconds to wait for the other notifications of a measurement cycle. */
+constexpr uint32_t notification_window_ms = 500;
+
+/**
+ * @class ATC_NotificationCoalescer
+ * @brief Merges the notifications of a measurement cycle into one reading. A cycle ends as soon as every expected
+ *        source has notified, when a source notifies a second time, which starts the next cycle, or when the window
+ *        has elapsed since its first notification, for devices that skip a characteristic. The precise temperature
+ *        takes precedence over the temperature in 0.1 degrees Celsius. A window of 0 ends the cycle with every
+ *        notification. The class is not thread safe.
+ */
+class ATC_NotificationCoalescer {
+public:
+    /**
+     * @brief Constructor for the ATC_NotificationCoalescer class.
+     * @param windowMs The time in milliseconds after the first notification of a cycle at which it ends.
+     */
+    explicit ATC_NotificationCoalescer(uint32_t windowMs = notification_window_ms);
+
+    /**
+     * @brief Sets the time after the first notification of a cycle at which it ends.
+     * @param windowMs The window in milliseconds, 0 to end the cycle with every notification.
+     */
+    void setWindow(uint32_t windowMs);
+
+    /**
+     * @brief Gets the time after the first notification of a cycle at which it ends.
+     * @return The window in milliseconds.
+     */
+    uint32_t getWindow() const;
+
+    /**
+     * @brief Gets the time of the first notification of the open cycle.
+     * @return The millis() timestamp, meaningless if no cycle is open.
+     */
+    uint32_t getFirstTime() const;
+
+    /**
+     * @brief Sets the sources notifying in every cycle, whose notifications complete it.
+     * @param sources Bitmask of Notification_source values, 0 to only end cycles on repeats and the window.
+     */
+    void setExpected(uint8_t sources);
+
+    /**
+     * @brief Adds a notification to the current cycle.
+     * @param source The Notification_source of the notification.
+     * @param partial The reading decoded from the notification, with the fields it holds.
+     * @param nowMs The current millis() timestamp.
+     * @param cycle Set to the reading of the cycle that ended, if any.
+     * @return True if a cycle ended and cycle holds its reading.
+     */
+    bool add(uint8_t source, const ATC_MiThermometer_Reading &partial, uint32_t nowMs,
+             ATC_MiThermometer_Reading &cycle);
+
+    /**
+     * @brief Ends the current cycle if its window has elapsed.
+     * @param nowMs The current millis() timestamp.
+     * @param cycle Set to the reading of the cycle, if it ended.
+     * @return True if the cycle ended and cycle holds its reading.
+     */
+    bool flushDue(uint32_t nowMs, ATC_MiThermometer_Reading &cycle);
+
+    /**
+     * @brief Ends the current cycle.
+     * @param cycle Set to the reading of the cycle, if one was open.
+     * @return True if a cycle was open and cycle holds its reading.
+     */
+    bool flush(ATC_MiThermometer_Reading &cycle);
+
+    /**
+     * @brief Checks if a cycle is open.
+     * @return True if notifications are waiting to be merged with the rest of their cycle.
+     */
+    bool isPending() const;
+
+private:
+    ATC_MiThermometer_Reading pending; /**< The reading of the open cycle. */
+    uint8_t received; /**< Sources that notified in the open cycle, 0 if no cycle is open. */
+    uint8_t expected; /**< Sources completing a cycle. */
+    uint32_t first_ms; /**< millis() of the first notification of the open cycle. */
+    uint32_t window_ms; /**< Time after the first notification at which a cycle ends. */
+};
+
+#endif // ATC_NOTIFICATION_COALESCER_H
@@ -0,0 +1,87 @@
+/**
+ * @file ATC_OtaPacket.cpp
+ * @brief This file contains the implementation of the Telink OTA checksums and packet format.
+ */
+#include "ATC_OtaPacket.h"
+#include <cstring>
+
+/**
+ * @brief Computes the Telink OTA CRC16 (polynomial 0xA001, initial value 0xFFFF, no final XOR).
+ * @param data Pointer to the data.
+ * @param length Length of the data.
+ * @return The CRC16.
+ */
+uint16_t atcOtaCrc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Computes the CRC32 (polynomial 0xEDB88320, as used by zlib) used to verify firmware images.
+ * @param data Pointer to the data.
+ * @param length Length of the data.
+ * @param crc The CRC of the preceding data, 0 to start.
+ * @return The CRC32.
+ */
+uint32_t atcOtaCrc32(const uint8_t *data, size_t length, uint32_t crc) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Builds an OTA packet: the index (uint16, little endian), the data padded with 0xFF to
+ * ota_packet_data_size bytes, and the CRC16 of both (little endian).
+ * @param index The packet index.
+ * @param data Pointer to the firmware data.
+ * @param length Length of the firmware data, at most ota_packet_data_size.
+ * @param packet The buffer receiving ota_packet_size bytes.
+ */
+void atcOtaBuildPacket(uint16_t index, const uint8_t *data, size_t length, uint8_t *packet) {
+    packet[0] = static_cast<uint8_t>(index & 0xFF);
+    packet[1] = static_cast<uint8_t>(index >> 8);
+    if (length > ota_packet_data_size) {
+        length = ota_packet_data_size;
+    }
+    memcpy(&packet[2], data, length);
+    memset(&packet[2 + length], 0xFF, ota_packet_data_size - length);
+    uint16_t crc = atcOtaCrc16(packet, ota_packet_data_size + 2);
+    packet[ota_packet_data_size + 2] = static_cast<uint8_t>(crc & 0xFF);
+    packet[ota_packet_data_size + 3] = static_cast<uint8_t>(crc >> 8);
+}
+
+/**
+ * @brief Builds the OTA end command: 0x02 0xFF, the index of the last packet and its inverse (little endian).
+ * @param lastIndex The index of the last packet.
+ * @param command The buffer receiving ota_end_command_size bytes.
+ */
+void atcOtaBuildEndCommand(uint16_t lastIndex, uint8_t *command) {
+    uint16_t inverse = static_cast<uint16_t>(~lastIndex);
+    command[0] = 0x02;
+    command[1] = 0xFF;
+    command[2] = static_cast<uint8_t>(lastIndex & 0xFF);
+    command[3] = static_cast<uint8_t>(lastIndex >> 8);
+    command[4] = static_cast<uint8_t>(inverse & 0xFF);
+    command[5] = static_cast<uint8_t>(inverse >> 8);
+}
+
+/**
+ * @brief Sets an OTA transfer back to the first packet.
+ * @param progress The progress of the transfer.
+ */
+void atcOtaRestart(ATC_OtaProgress &progress) {
+    progress.next_packet = 0;
+    progress.confirmed_packet = 0;
+    progress.failed_bursts = 0;
+}
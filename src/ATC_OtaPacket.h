@@ -0,0 +1,115 @@
+/**
+ * @file ATC_OtaPacket.h
+ * @brief This file declares the checksums, the packet format and the packet stream of the Telink OTA transfer used by
+ * ATC_OtaUpdater. The functions only depend on the standard library, so they can also be used on a host.
+ */
+#ifndef ATC_OTA_PACKET_H
+#define ATC_OTA_PACKET_H
+
+#include <cstdint>
+#include <cstddef>
+#include "ATC_MiThermometer_structs.h"
+
+/** @brief Number of firmware bytes carried by one OTA packet. */
+constexpr size_t ota_packet_data_size = 16;
+/** @brief Size in bytes of one OTA packet (index, data, CRC16). */
+constexpr size_t ota_packet_size = ota_packet_data_size + 4;
+/** @brief Maximum size in bytes of a firmware image, limited by the 16 bit packet index. */
+constexpr size_t ota_max_image_size = 0x10000 * ota_packet_data_size;
+/** @brief Size in bytes of the OTA end command. */
+constexpr size_t ota_end_command_size = 6;
+
+/**
+ * @brief Computes the Telink OTA CRC16 (polynomial 0xA001, initial value 0xFFFF).
+ * @param data Pointer to the data.
+ * @param length Length of the data.
+ * @return The CRC16.
+ */
+uint16_t atcOtaCrc16(const uint8_t *data, size_t length);
+
+/**
+ * @brief Computes the CRC32 (polynomial 0xEDB88320) used to verify firmware images.
+ * @param data Pointer to the data.
+ * @param length Length of the data.
+ * @param crc The CRC of the preceding data, 0 to start.
+ * @return The CRC32.
+ */
+uint32_t atcOtaCrc32(const uint8_t *data, size_t length, uint32_t crc = 0);
+
+/**
+ * @brief Builds an OTA packet: the index (uint16, little endian), the data padded with 0xFF to ota_packet_data_size
+ *        bytes, and the CRC16 of both (little endian).
+ * @param index The packet index.
+ * @param data Pointer to the firmware data.
+ * @param length Length of the firmware data, at most ota_packet_data_size.
+ * @param packet The buffer receiving ota_packet_size bytes.
+ */
+void atcOtaBuildPacket(uint16_t index, const uint8_t *data, size_t length, uint8_t *packet);
+
+/**
+ * @brief Builds the OTA end command: 0x02 0xFF, the index of the last packet and its inverse (little endian).
+ * @param lastIndex The index of the last packet.
+ * @param command The buffer receiving ota_end_command_size bytes.
+ */
+void atcOtaBuildEndCommand(uint16_t lastIndex, uint8_t *command);
+
+/**
+ * @brief Sets an OTA transfer back to the first packet, as the Telink bootloader discards a partially received
+ *        image when the connection drops.
+ * @param progress The progress of the transfer.
+ */
+void atcOtaRestart(ATC_OtaProgress &progress);
+
+/**
+ * @brief Sends the next burst of up to syncInterval packets of a firmware image. All packets but the last of the
+ *        burst are written without response; the write with response of the last one confirms the whole burst. If a
+ *        write fails, the transfer goes back to the last confirmed packet, and fails after maxFailedBursts bursts in
+ *        a row. After the last packet, sends the end command.
+ * @tparam Read Callable size_t(uint8_t *data, size_t length) reading the image at the current position.
+ * @tparam Seek Callable void(size_t offset) moving the current position in the image.
+ * @tparam Write Callable bool(const uint8_t *data, size_t length, bool withResponse) writing the OTA characteristic.
+ * @param progress The progress of the transfer, updated.
+ * @param syncInterval The number of packets per burst, at least 1.
+ * @param maxFailedBursts The number of bursts in a row that may fail.
+ * @param read Reads the image.
+ * @param seek Moves in the image.
+ * @param write Writes the OTA characteristic.
+ * @return The outcome of the burst.
+ */
+template<typename Read, typename Seek, typename Write>
+Ota_burst_result atcOtaSendBurst(ATC_OtaProgress &progress, uint8_t syncInterval, uint8_t maxFailedBursts,
+                                 Read &&read, Seek &&seek, Write &&write) {
+    uint8_t data[ota_packet_data_size];
+    uint8_t packet[ota_packet_size];
+    for (uint8_t i = 0; i < syncInterval && progress.next_packet < progress.packet_count; i++) {
+        size_t length = read(data, sizeof(data));
+        if (length == 0) {
+            return Ota_burst_result::READ_FAILED;
+        }
+        atcOtaBuildPacket(progress.next_packet, data, length, packet);
+        bool sync = i == syncInterval - 1 || progress.next_packet + 1 == progress.packet_count;
+        if (!write(static_cast<const uint8_t *>(packet), sizeof(packet), sync)) {
+            progress.next_packet = progress.confirmed_packet;
+            seek(static_cast<size_t>(progress.confirmed_packet) * ota_packet_data_size);
+            progress.failed_bursts++;
+            return progress.failed_bursts >= maxFailedBursts ? Ota_burst_result::WRITE_FAILED
+                                                             : Ota_burst_result::REWOUND;
+        }
+        progress.next_packet++;
+        if (sync) {
+            progress.confirmed_packet = progress.next_packet;
+            progress.failed_bursts = 0;
+        }
+    }
+    if (progress.next_packet < progress.packet_count) {
+        return Ota_burst_result::SENT;
+    }
+    uint8_t end[ota_end_command_size];
+    atcOtaBuildEndCommand(static_cast<uint16_t>(progress.packet_count - 1), end);
+    if (!write(static_cast<const uint8_t *>(end), sizeof(end), true)) {
+        return Ota_burst_result::END_FAILED;
+    }
+    return Ota_burst_result::COMPLETE;
+}
+
+#endif // ATC_OTA_PACKET_H
@@ -0,0 +1,321 @@
+/**
+ * @file ATC_OtaUpdater.cpp
+ * @brief This file contains the implementation of the ATC_OtaUpdater class.
+ */
+#include "ATC_OtaUpdater.h"
+#include <Arduino.h>
+
+/**
+ * @brief Constructor for the ATC_OtaUpdater class.
+ * @param maxConcurrent The maximum number of devices updated at the same time.
+ * @param syncInterval The number of packets sent per burst; the last packet of a burst is written with response.
+ * @param maxAttempts The number of failed attempts after which a job fails.
+ */
+ATC_OtaUpdater::ATC_OtaUpdater(uint8_t maxConcurrent, uint8_t syncInterval, uint8_t maxAttempts)
+        : max_concurrent(maxConcurrent ? maxConcurrent : 1), sync_interval(syncInterval ? syncInterval : 1),
+          max_attempts(maxAttempts ? maxAttempts : 1) {
+}
+
+/**
+ * @brief Destructor for the ATC_OtaUpdater class. Disconnects all jobs.
+ */
+ATC_OtaUpdater::~ATC_OtaUpdater() {
+    clearJobs();
+}
+
+/**
+ * @brief Adds a firmware update job. Checks that the image exists, fits the 16 bit packet index and carries the
+ * Telink firmware signature ("KNLT" at offset 8), and compares its CRC32 with the expected value if one is given.
+ * Prints an error message if a check fails.
+ * @param thermometer The thermometer to update.
+ * @param fs The filesystem holding the firmware image.
+ * @param path The path of the firmware image.
+ * @param expectedCrc32 The CRC32 of the image, 0 to skip the check.
+ * @return True if the job was added, false otherwise.
+ */
+bool ATC_OtaUpdater::addJob(ATC_MiThermometer &thermometer, fs::FS &fs, const char *path, uint32_t expectedCrc32) {
+    fs::File file = fs.open(path, "r");
+    if (!file) {
+        Serial.printf("Failed to open firmware image %s\n", path);
+        return false;
+    }
+    size_t size = file.size();
+    if (size < 12 || size > ota_max_image_size) {
+        Serial.println("Invalid firmware image size");
+        file.close();
+        return false;
+    }
+    uint8_t buffer[64];
+    size_t read = file.read(buffer, 12);
+    if (read != 12 || buffer[8] != 'K' || buffer[9] != 'N' || buffer[10] != 'L' || buffer[11] != 'T') {
+        Serial.println("Not a Telink firmware image");
+        file.close();
+        return false;
+    }
+    if (expectedCrc32 != 0) {
+        uint32_t crc = crc32(buffer, read);
+        while ((read = file.read(buffer, sizeof(buffer))) > 0) {
+            crc = crc32(buffer, read, crc);
+        }
+        if (crc != expectedCrc32) {
+            Serial.printf("Firmware image CRC mismatch: %08x\n", static_cast<unsigned int>(crc));
+            file.close();
+            return false;
+        }
+    }
+    file.seek(0);
+    thermometer.disconnect();
+    ATC_OtaJob job{};
+    job.address = thermometer.getAddressString();
+    job.file = file;
+    job.image_size = size;
+    job.packet_count = static_cast<uint16_t>((size + ota_packet_data_size - 1) / ota_packet_data_size);
+    job.state = Ota_state::PENDING;
+    jobs.push_back(job);
+    return true;
+}
+
+/**
+ * @brief Runs all jobs until they are done or failed. Pending jobs are started while fewer than max_concurrent
+ * jobs are transferring, and the transferring jobs take turns sending one burst each, so several devices share the
+ * radio within the connection budget. A job whose connection drops is restarted from the first packet on the next
+ * connection, because the Telink bootloader discards a partially received image.
+ * @return The number of jobs done.
+ */
+size_t ATC_OtaUpdater::run() {
+    while (true) {
+        size_t active = 0;
+        bool unfinished = false;
+        for (ATC_OtaJob &job: jobs) {
+            if (job.state == Ota_state::TRANSFERRING) {
+                active++;
+            }
+        }
+        for (ATC_OtaJob &job: jobs) {
+            if (job.state == Ota_state::PENDING && active < max_concurrent) {
+                if (startJob(job)) {
+                    active++;
+                } else {
+                    failAttempt(job);
+                }
+            }
+        }
+        for (ATC_OtaJob &job: jobs) {
+            if (job.state == Ota_state::TRANSFERRING) {
+                if (!job.client || !job.client->isConnected()) {
+                    Serial.printf("OTA connection to %s lost\n", job.address.c_str());
+                    failAttempt(job);
+                } else {
+                    sendBurst(job);
+                }
+            }
+            if (job.state == Ota_state::PENDING || job.state == Ota_state::TRANSFERRING) {
+                unfinished = true;
+            }
+        }
+        if (!unfinished) {
+            break;
+        }
+        yield();
+    }
+    size_t done = 0;
+    for (const ATC_OtaJob &job: jobs) {
+        if (job.state == Ota_state::DONE) {
+            done++;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief Connects to the device of a job with bulk-transfer connection parameters, finds the OTA characteristic and
+ * sends the OTA start command (0x01 0xFF). Prints an error message if a step fails.
+ * @param job The job to start.
+ * @return True if the transfer started, false otherwise.
+ */
+bool ATC_OtaUpdater::startJob(ATC_OtaJob &job) {
+    job.client = NimBLEDevice::createClient();
+    if (!job.client) {
+        Serial.println("Failed to create BLE client");
+        return false;
+    }
+    ATC_MiThermometer_ConnectionParams params =
+            ATC_MiThermometer::getConnectionProfileParams(Connection_profile::BULK_TRANSFER);
+    job.client->setConnectionParams(params.min_interval, params.max_interval, params.latency,
+                                    params.supervision_timeout);
+    if (!ATC_MiThermometer::connectClient(job.client, job.address, params.mtu)) {
+        Serial.printf("Failed to connect to %s\n", job.address.c_str());
+        return false;
+    }
+    NimBLERemoteService *service = job.client->getService(ota_service_uuid);
+    if (!service) {
+        Serial.printf("Failed to find service %s\n", ota_service_uuid);
+        return false;
+    }
+    job.characteristic = service->getCharacteristic(ota_characteristic_uuid);
+    if (!job.characteristic) {
+        Serial.printf("Failed to find characteristic %s\n", ota_characteristic_uuid);
+        return false;
+    }
+    const uint8_t start[] = {0x01, 0xFF}; // OTA start command
+    if (!job.characteristic->writeValue(start, sizeof(start), true)) {
+        Serial.println("Failed to send OTA start command");
+        return false;
+    }
+    job.file.seek(0);
+    atcOtaRestart(job);
+    job.start_time = millis();
+    job.state = Ota_state::TRANSFERRING;
+    return true;
+}
+
+/**
+ * @brief Sends the next burst of up to sync_interval packets with atcOtaSendBurst(), and completes the job after the
+ * end command. A failed write resends the burst from the last confirmed packet on the next turn, and
+ * ota_max_failed_bursts failed bursts in a row count as a failed attempt, as do read errors and a failed end command.
+ * @param job The job to continue.
+ */
+void ATC_OtaUpdater::sendBurst(ATC_OtaJob &job) {
+    NimBLERemoteCharacteristic *characteristic = job.characteristic;
+    fs::File &file = job.file;
+    Ota_burst_result result = atcOtaSendBurst(
+            job, sync_interval, ota_max_failed_bursts,
+            [&file](uint8_t *data, size_t length) { return file.read(data, length); },
+            [&file](size_t offset) { file.seek(static_cast<uint32_t>(offset)); },
+            [characteristic](const uint8_t *data, size_t length, bool withResponse) {
+                return characteristic->writeValue(data, length, withResponse);
+            });
+    switch (result) {
+        case Ota_burst_result::SENT:
+        case Ota_burst_result::REWOUND:
+            return;
+        case Ota_burst_result::COMPLETE:
+            break;
+        case Ota_burst_result::READ_FAILED:
+            Serial.println("Failed to read firmware image");
+            failAttempt(job);
+            return;
+        case Ota_burst_result::WRITE_FAILED:
+            Serial.printf("Failed to write OTA packets to %s\n", job.address.c_str());
+            failAttempt(job);
+            return;
+        case Ota_burst_result::END_FAILED:
+            Serial.println("Failed to send OTA end command");
+            failAttempt(job);
+            return;
+    }
+    job.elapsed_ms = millis() - job.start_time;
+    job.state = Ota_state::DONE;
+    job.file.close();
+    disconnectJob(job);
+}
+
+/**
+ * @brief Counts a failed attempt and disconnects. The job goes back to PENDING to be restarted on a new connection,
+ * or to FAILED after max_attempts.
+ * @param job The job that failed.
+ */
+void ATC_OtaUpdater::failAttempt(ATC_OtaJob &job) {
+    disconnectJob(job);
+    job.attempts++;
+    if (job.attempts >= max_attempts) {
+        Serial.printf("OTA update of %s failed after %u attempts\n", job.address.c_str(), job.attempts);
+        job.state = Ota_state::FAILED;
+        job.file.close();
+    } else {
+        job.state = Ota_state::PENDING;
+    }
+}
+
+/**
+ * @brief Disconnects the device of a job and deletes its client.
+ * @param job The job to disconnect.
+ */
+void ATC_OtaUpdater::disconnectJob(ATC_OtaJob &job) {
+    if (job.client) {
+        if (job.client->isConnected()) {
+            job.client->disconnect();
+        }
+        NimBLEDevice::deleteClient(job.client);
+    }
+    job.client = nullptr;
+    job.characteristic = nullptr;
+}
+
+/**
+ * @brief Gets the number of jobs.
+ * @return The number of jobs.
+ */
+size_t ATC_OtaUpdater::getJobCount() const {
+    return jobs.size();
+}
+
+/**
+ * @brief Gets a job.
+ * @param index The index of the job, in the order they were added.
+ * @return The job.
+ */
+const ATC_OtaJob &ATC_OtaUpdater::getJob(size_t index) const {
+    return jobs.at(index);
+}
+
+/**
+ * @brief Gets the progress of a job, counting only packets confirmed by a write with response.
+ * @param index The index of the job.
+ * @return The progress in percent.
+ */
+uint8_t ATC_OtaUpdater::getProgress(size_t index) const {
+    const ATC_OtaJob &job = jobs.at(index);
+    if (job.state == Ota_state::DONE) {
+        return 100;
+    }
+    if (job.packet_count == 0) {
+        return 0;
+    }
+    return static_cast<uint8_t>(static_cast<uint32_t>(job.confirmed_packet) * 100 / job.packet_count);
+}
+
+/**
+ * @brief Removes all jobs, disconnecting the active ones.
+ */
+void ATC_OtaUpdater::clearJobs() {
+    for (ATC_OtaJob &job: jobs) {
+        disconnectJob(job);
+        if (job.file) {
+            job.file.close();
+        }
+    }
+    jobs.clear();
+}
+
+/**
+ * @brief Computes the Telink OTA CRC16, see atcOtaCrc16().
+ * @param data Pointer to the data.
+ * @param length Length of the data.
+ * @return The CRC16.
+ */
+uint16_t ATC_OtaUpdater::crc16(const uint8_t *data, size_t length) {
+    return atcOtaCrc16(data, length);
+}
+
+/**
+ * @brief Computes the CRC32 used to verify firmware images, see atcOtaCrc32().
+ * @param data Pointer to the data.
+ * @param length Length of the data.
+ * @param crc The CRC of the preceding data, 0 to start.
+ * @return The CRC32.
+ */
+uint32_t ATC_OtaUpdater::crc32(const uint8_t *data, size_t length, uint32_t crc) {
+    return atcOtaCrc32(data, length, crc);
+}
+
+/**
+ * @brief Builds an OTA packet, see atcOtaBuildPacket().
+ * @param index The packet index.
+ * @param data Pointer to the firmware data.
+ * @param length Length of the firmware data, at most ota_packet_data_size.
+ * @param packet The buffer receiving ota_packet_size bytes.
+ */
+void ATC_OtaUpdater::buildPacket(uint16_t index, const uint8_t *data, size_t length, uint8_t *packet) {
+    atcOtaBuildPacket(index, data, length, packet);
+}
@@ -0,0 +1,162 @@
+/**
+ * @file ATC_OtaUpdater.h
+ * @brief This file contains the declaration of the ATC_OtaUpdater class, which streams firmware images from the
+ * filesystem to the Telink OTA characteristic of one or more thermometers.
+ */
+#ifndef ATC_OTA_UPDATER_H
+#define ATC_OTA_UPDATER_H
+
+#include "ATC_MiThermometer.h"
+#include "ATC_OtaPacket.h"
+#include <FS.h>
+#include <vector>
+
+/** @brief UUID of the Telink OTA service. */
+constexpr const char *ota_service_uuid = "00010203-0405-0607-0809-0a0b0c0d1912";
+/** @brief UUID of the Telink OTA characteristic. */
+constexpr const char *ota_characteristic_uuid = "00010203-0405-0607-0809-0a0b0c0d2b12";
+/** @brief Number of bursts in a row whose write may fail before the attempt is counted as failed. */
+constexpr uint8_t ota_max_failed_bursts = 3;
+
+/**
+ * @struct ATC_OtaJob
+ * @brief This structure holds the state of the firmware update of one thermometer, and its progress in the image.
+ */
+struct ATC_OtaJob : ATC_OtaProgress {
+    std::string address; /**< The MAC address of the thermometer. */
+    fs::File file; /**< The firmware image. */
+    size_t image_size; /**< The size of the firmware image in bytes. */
+    uint8_t attempts; /**< Number of failed connections or transfers. */
+    Ota_state state; /**< The state of the job. */
+    NimBLEClient *client; /**< The BLE client while connected. */
+    NimBLERemoteCharacteristic *characteristic; /**< The OTA characteristic while connected. */
+    uint32_t start_time; /**< millis() when the last transfer attempt started. */
+    uint32_t elapsed_ms; /**< Duration of the successful transfer in milliseconds. */
+};
+
+/**
+ * @class ATC_OtaUpdater
+ * @brief This class updates the firmware of thermometers using the Telink OTA protocol.
+ *
+ * Packets are written without response, with every sync_interval-th packet written with response as flow control.
+ * A burst whose write fails is resent from the last confirmed packet, and ota_max_failed_bursts failed bursts in a row
+ * count as a failed attempt. Several devices are updated concurrently by interleaving bursts of packets between their
+ * connections.
+ */
+class ATC_OtaUpdater {
+public:
+    /**
+     * @brief Constructor for the ATC_OtaUpdater class.
+     * @param maxConcurrent The maximum number of devices updated at the same time.
+     * @param syncInterval The number of packets sent per burst; the last packet of a burst is written with response.
+     * @param maxAttempts The number of failed attempts after which a job fails.
+     */
+    explicit ATC_OtaUpdater(uint8_t maxConcurrent = 2, uint8_t syncInterval = 8, uint8_t maxAttempts = 3);
+
+    /**
+     * @brief Destructor for the ATC_OtaUpdater class. Disconnects all jobs.
+     */
+    ~ATC_OtaUpdater();
+
+    /**
+     * @brief Adds a firmware update job. The thermometer is disconnected so the updater can connect to it.
+     *        The image is checked for the Telink firmware signature and, if given, the expected CRC32.
+     * @param thermometer The thermometer to update.
+     * @param fs The filesystem holding the firmware image.
+     * @param path The path of the firmware image.
+     * @param expectedCrc32 The CRC32 of the image, 0 to skip the check.
+     * @return True if the job was added, false if the image is missing or invalid.
+     */
+    bool addJob(ATC_MiThermometer &thermometer, fs::FS &fs, const char *path, uint32_t expectedCrc32 = 0);
+
+    /**
+     * @brief Runs all jobs until they are done or failed.
+     * @return The number of jobs done.
+     */
+    size_t run();
+
+    /**
+     * @brief Gets the number of jobs.
+     * @return The number of jobs.
+     */
+    size_t getJobCount() const;
+
+    /**
+     * @brief Gets a job.
+     * @param index The index of the job, in the order they were added.
+     * @return The job.
+     */
+    const ATC_OtaJob &getJob(size_t index) const;
+
+    /**
+     * @brief Gets the progress of a job.
+     * @param index The index of the job.
+     * @return The confirmed progress in percent.
+     */
+    uint8_t getProgress(size_t index) const;
+
+    /**
+     * @brief Removes all jobs, disconnecting the active ones.
+     */
+    void clearJobs();
+
+    /**
+     * @brief Computes the Telink OTA CRC16 (polynomial 0xA001, initial value 0xFFFF).
+     * @param data Pointer to the data.
+     * @param length Length of the data.
+     * @return The CRC16.
+     */
+    static uint16_t crc16(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Computes the CRC32 (polynomial 0xEDB88320) used to verify firmware images.
+     * @param data Pointer to the data.
+     * @param length Length of the data.
+     * @param crc The CRC of the preceding data, 0 to start.
+     * @return The CRC32.
+     */
+    static uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0);
+
+    /**
+     * @brief Builds an OTA packet: the index (uint16, little endian), the data padded with 0xFF to
+     *        ota_packet_data_size bytes, and the CRC16 of both (little endian).
+     * @param index The packet index.
+     * @param data Pointer to the firmware data.
+     * @param length Length of the firmware data, at most ota_packet_data_size.
+     * @param packet The buffer receiving ota_packet_size bytes.
+     */
+    static void buildPacket(uint16_t index, const uint8_t *data, size_t length, uint8_t *packet);
+
+private:
+    std::vector<ATC_OtaJob> jobs; /**< The update jobs. */
+    uint8_t max_concurrent; /**< The maximum number of devices updated at the same time. */
+    uint8_t sync_interval; /**< The number of packets per burst. */
+    uint8_t max_attempts; /**< The number of failed attempts after which a job fails. */
+
+    /**
+     * @brief Connects to the device of a job and sends the OTA start command.
+     * @param job The job to start.
+     * @return True if the transfer started, false otherwise.
+     */
+    bool startJob(ATC_OtaJob &job);
+
+    /**
+     * @brief Sends the next burst of packets of a job, and the end command after the last packet.
+     * @param job The job to continue.
+     */
+    void sendBurst(ATC_OtaJob &job);
+
+    /**
+     * @brief Counts a failed attempt. The job waits for a reconnect, or fails after max_attempts.
+     * @param job The job that failed.
+     */
+    void failAttempt(ATC_OtaJob &job);
+
+    /**
+     * @brief Disconnects the device of a job and deletes its client.
+     * @param job The job to disconnect.
+     */
+    static void disconnectJob(ATC_OtaJob &job);
+};
+
+#endif // ATC_OTA_UPDATER_H
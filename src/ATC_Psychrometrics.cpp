@@ -0,0 +1,240 @@
+/**
+ * @file ATC_Psychrometrics.cpp
+ * @brief This file contains the implementation of the psychrometric functions and of ATC_PsychrometricCache.
+ */
+#include "ATC_Psychrometrics.h"
+#include <cmath>
+
+/** @brief Magnus coefficients of Alduchov and Eskridge: e_s = a * exp(b * T / (c + T)), in hPa. */
+static constexpr float magnus_a = 6.1094f;
+static constexpr float magnus_b = 17.625f;
+static constexpr float magnus_c = 243.04f;
+
+/** @brief Saturation vapour pressure in hPa for every degree from psychrometric_table_min to psychrometric_table_max. */
+static const float saturation_table[psychrometric_table_max - psychrometric_table_min + 1] = {
+        0.189684f, 0.210347f, 0.233026f, 0.257893f, 0.285134f, 0.314948f,
+        0.34755f, 0.383166f, 0.422042f, 0.464439f, 0.510635f, 0.56093f,
+        0.61564f, 0.675104f, 0.739683f, 0.809761f, 0.885746f, 0.968071f,
+        1.0572f, 1.15361f, 1.25784f, 1.37042f, 1.49194f, 1.62302f,
+        1.7643f, 1.91648f, 2.08029f, 2.25648f, 2.44587f, 2.64932f,
+        2.86773f, 3.10204f, 3.35325f, 3.62242f, 3.91064f, 4.21908f,
+        4.54896f, 4.90156f, 5.27821f, 5.68033f, 6.1094f, 6.56696f,
+        7.05462f, 7.57409f, 8.12713f, 8.7156f, 9.34143f, 10.0066f,
+        10.7134f, 11.4638f, 12.2602f, 13.105f, 14.0007f, 14.95f,
+        15.9554f, 17.0198f, 18.1462f, 19.3377f, 20.5973f, 21.9284f,
+        23.3344f, 24.8189f, 26.3855f, 28.0381f, 29.7807f, 31.6174f,
+        33.5523f, 35.5901f, 37.7352f, 39.9924f, 42.3665f, 44.8627f,
+        47.4862f, 50.2424f, 53.137f, 56.1757f, 59.3645f, 62.7096f,
+        66.2173f, 69.8942f, 73.7472f, 77.7831f, 82.0093f, 86.4331f,
+        91.0622f, 95.9045f, 100.968f, 106.261f, 111.793f, 117.571f,
+        123.606f, 129.906f, 136.481f, 143.341f, 150.497f, 157.958f,
+        165.735f, 173.839f, 182.282f, 191.075f, 200.23f, 209.759f,
+        219.674f, 229.989f, 240.716f, 251.869f, 263.461f, 275.507f,
+        288.02f, 301.017f, 314.511f, 328.518f, 343.054f, 358.135f,
+        373.778f, 389.999f, 406.816f, 424.246f, 442.307f, 461.018f,
+        480.397f,
+};
+
+/**
+ * @brief Computes the saturation vapour pressure over water with the Magnus formula, using libm.
+ * @param temperature The temperature in degrees Celsius.
+ * @return The saturation vapour pressure in hPa.
+ */
+float atcSaturationVapourPressureExact(float temperature) {
+    return magnus_a * std::exp(magnus_b * temperature / (magnus_c + temperature));
+}
+
+/**
+ * @brief Computes the saturation vapour pressure by linear interpolation of the table.
+ * @param temperature The temperature in degrees Celsius.
+ * @return The saturation vapour pressure in hPa.
+ */
+float atcSaturationVapourPressure(float temperature) {
+    if (!(temperature >= psychrometric_table_min && temperature < psychrometric_table_max)) {
+        return atcSaturationVapourPressureExact(temperature);
+    }
+    float position = temperature - psychrometric_table_min;
+    int index = static_cast<int>(position);
+    float fraction = position - static_cast<float>(index);
+    return saturation_table[index] + (saturation_table[index + 1] - saturation_table[index]) * fraction;
+}
+
+/**
+ * @brief Computes the dew point of a vapour pressure by inverting the table: a binary search finds the segment,
+ * which is then interpolated linearly.
+ * @param vapourPressure The vapour pressure in hPa.
+ * @return The dew point in degrees Celsius, or NAN outside the table.
+ */
+static float dewPointFromTable(float vapourPressure) {
+    const int last = psychrometric_table_max - psychrometric_table_min;
+    if (!(vapourPressure >= saturation_table[0] && vapourPressure <= saturation_table[last])) {
+        return NAN;
+    }
+    int low = 0;
+    int high = last;
+    while (high - low > 1) {
+        int middle = (low + high) / 2;
+        if (saturation_table[middle] <= vapourPressure) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    float fraction = (vapourPressure - saturation_table[low]) / (saturation_table[high] - saturation_table[low]);
+    return static_cast<float>(low + psychrometric_table_min) + fraction;
+}
+
+/**
+ * @brief Computes the dew point of a vapour pressure by inverting the Magnus formula with libm.
+ * @param vapourPressure The vapour pressure in hPa.
+ * @return The dew point in degrees Celsius.
+ */
+static float dewPointExact(float vapourPressure) {
+    float gamma = std::log(vapourPressure / magnus_a);
+    return magnus_c * gamma / (magnus_b - gamma);
+}
+
+/**
+ * @brief Computes the heat index with the regression of Rothfusz used by the US National Weather Service,
+ * including its adjustments for low and high humidity. Below about 27 degrees Celsius the simpler formula of
+ * Steadman is used. Only needs arithmetic and, for dry air, a square root.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percent.
+ * @return The heat index in degrees Celsius.
+ */
+static float heatIndex(float temperature, float humidity) {
+    float t = temperature * 1.8f + 32.0f;
+    float index = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + humidity * 0.094f);
+    if ((index + t) / 2.0f >= 80.0f) {
+        index = -42.379f + 2.04901523f * t + 10.14333127f * humidity - 0.22475541f * t * humidity -
+                0.00683783f * t * t - 0.05481717f * humidity * humidity + 0.00122874f * t * t * humidity +
+                0.00085282f * t * humidity * humidity - 0.00000199f * t * t * humidity * humidity;
+        if (humidity < 13.0f && t >= 80.0f && t <= 112.0f) {
+            index -= (13.0f - humidity) / 4.0f * std::sqrt((17.0f - std::fabs(t - 95.0f)) / 17.0f);
+        } else if (humidity > 85.0f && t >= 80.0f && t <= 87.0f) {
+            index += (humidity - 85.0f) / 10.0f * (87.0f - t) / 5.0f;
+        }
+    }
+    return (index - 32.0f) / 1.8f;
+}
+
+/**
+ * @brief Derives the metrics from the saturation and actual vapour pressures.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percent.
+ * @param saturation The saturation vapour pressure in hPa.
+ * @param dewPoint The dew point in degrees Celsius.
+ * @return The metrics.
+ */
+static ATC_Psychrometrics derive(float temperature, float humidity, float saturation, float dewPoint) {
+    float vapourPressure = saturation * humidity / 100.0f;
+    ATC_Psychrometrics metrics{};
+    metrics.dew_point = dewPoint;
+    metrics.absolute_humidity = 216.7f * vapourPressure / (273.15f + temperature);
+    metrics.vapour_pressure_deficit = (saturation - vapourPressure) / 10.0f;
+    metrics.heat_index = heatIndex(temperature, humidity);
+    return metrics;
+}
+
+/**
+ * @brief Computes the psychrometric metrics with libm.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percent.
+ * @return The metrics.
+ */
+ATC_Psychrometrics atcPsychrometricsExact(float temperature, float humidity) {
+    float saturation = atcSaturationVapourPressureExact(temperature);
+    return derive(temperature, humidity, saturation, dewPointExact(saturation * humidity / 100.0f));
+}
+
+/**
+ * @brief Computes the psychrometric metrics with the table. Falls back to libm for a dew point outside the table.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percent.
+ * @return The metrics.
+ */
+ATC_Psychrometrics atcPsychrometrics(float temperature, float humidity) {
+    float saturation = atcSaturationVapourPressure(temperature);
+    float vapourPressure = saturation * humidity / 100.0f;
+    float dewPoint = dewPointFromTable(vapourPressure);
+    if (std::isnan(dewPoint)) {
+        dewPoint = dewPointExact(vapourPressure);
+    }
+    return derive(temperature, humidity, saturation, dewPoint);
+}
+
+/**
+ * @brief Computes the metrics of a raw temperature and humidity, with libm, or with the table when
+ * ATC_PSYCHROMETRICS_TABLE is set.
+ * @param temperature The temperature in 0.01 degrees Celsius.
+ * @param humidity The relative humidity in 0.01 percent.
+ * @return The metrics.
+ */
+static ATC_Psychrometrics computeRaw(int16_t temperature, uint16_t humidity) {
+    float celsius = static_cast<float>(temperature) * 0.01f;
+    float percent = static_cast<float>(humidity) * 0.01f;
+#if ATC_PSYCHROMETRICS_TABLE
+    return atcPsychrometrics(celsius, percent);
+#else
+    return atcPsychrometricsExact(celsius, percent);
+#endif
+}
+
+/**
+ * @brief Checks whether a reading holds both the temperature and the humidity.
+ * @param reading The reading.
+ * @return True if both fields are valid.
+ */
+static bool hasTemperatureAndHumidity(const ATC_MiThermometer_Reading &reading) {
+    return (reading.fields & (READING_TEMPERATURE | READING_HUMIDITY)) == (READING_TEMPERATURE | READING_HUMIDITY);
+}
+
+/** @brief Metrics of a reading lacking the temperature or the humidity. */
+static const ATC_Psychrometrics unavailable_metrics = {NAN, NAN, NAN, NAN};
+
+/**
+ * @brief Computes the psychrometric metrics of a reading.
+ * @param reading The reading.
+ * @return The metrics, all NAN if the reading lacks the temperature or the humidity.
+ */
+ATC_Psychrometrics atcReadingPsychrometrics(const ATC_MiThermometer_Reading &reading) {
+    if (!hasTemperatureAndHumidity(reading)) {
+        return unavailable_metrics;
+    }
+    return computeRaw(reading.temperature, reading.humidity);
+}
+
+/**
+ * @brief Gets the metrics of a raw temperature and humidity, computing them if the values changed.
+ * @param temperature The temperature in 0.01 degrees Celsius.
+ * @param humidity The relative humidity in 0.01 percent.
+ * @return The metrics, valid until the next call.
+ */
+const ATC_Psychrometrics &ATC_PsychrometricCache::get(int16_t temperature, uint16_t humidity) {
+    if (!valid || temperature != cached_temperature || humidity != cached_humidity) {
+        values = computeRaw(temperature, humidity);
+        cached_temperature = temperature;
+        cached_humidity = humidity;
+        valid = true;
+    }
+    return values;
+}
+
+/**
+ * @brief Gets the metrics of a reading, computing them if its temperature or humidity changed.
+ * @param reading The reading.
+ * @return The metrics, valid until the next call, all NAN if the reading lacks the temperature or the humidity.
+ */
+const ATC_Psychrometrics &ATC_PsychrometricCache::get(const ATC_MiThermometer_Reading &reading) {
+    if (!hasTemperatureAndHumidity(reading)) {
+        return unavailable_metrics;
+    }
+    return get(reading.temperature, reading.humidity);
+}
+
+/**
+ * @brief Forgets the cached metrics.
+ */
+void ATC_PsychrometricCache::invalidate() {
+    valid = false;
+}
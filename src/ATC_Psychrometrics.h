@@ -0,0 +1,105 @@
+/**
+ * @file ATC_Psychrometrics.h
+ * @brief This file declares the psychrometric functions deriving dew point, absolute humidity, vapour pressure
+ * deficit and heat index from temperature and relative humidity, and a cache memoising them.
+ * The fast versions interpolate a table of the Magnus formula instead of calling exp() and log(); the exact
+ * versions use libm. The functions only depend on the standard library, so they can also be used on a host.
+ */
+#ifndef ATC_PSYCHROMETRICS_H
+#define ATC_PSYCHROMETRICS_H
+
+#include <cstdint>
+#include "ATC_MiThermometer_config.h"
+#include "ATC_MiThermometer_structs.h"
+
+/** @brief Lowest temperature of the saturation vapour pressure table in degrees Celsius. */
+constexpr int psychrometric_table_min = -40;
+/** @brief Highest temperature of the saturation vapour pressure table in degrees Celsius. */
+constexpr int psychrometric_table_max = 80;
+
+/**
+ * @struct ATC_Psychrometrics
+ * @brief This structure holds the metrics derived from a temperature and relative humidity.
+ */
+struct ATC_Psychrometrics {
+    float dew_point; /**< The dew point in degrees Celsius. */
+    float absolute_humidity; /**< The absolute humidity in g/m3. */
+    float vapour_pressure_deficit; /**< The vapour pressure deficit in kPa. */
+    float heat_index; /**< The heat index (apparent temperature) in degrees Celsius. */
+};
+
+/**
+ * @brief Computes the saturation vapour pressure over water with the Magnus formula, using libm.
+ * @param temperature The temperature in degrees Celsius.
+ * @return The saturation vapour pressure in hPa.
+ */
+float atcSaturationVapourPressureExact(float temperature);
+
+/**
+ * @brief Computes the saturation vapour pressure by linear interpolation of a table of the Magnus formula with a
+ *        step of 1 degree. The relative error is below 0.15 % from -40 to 80 degrees Celsius, outside this range
+ *        the exact formula is used.
+ * @param temperature The temperature in degrees Celsius.
+ * @return The saturation vapour pressure in hPa.
+ */
+float atcSaturationVapourPressure(float temperature);
+
+/**
+ * @brief Computes the psychrometric metrics with libm.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percent.
+ * @return The metrics.
+ */
+ATC_Psychrometrics atcPsychrometricsExact(float temperature, float humidity);
+
+/**
+ * @brief Computes the psychrometric metrics with the table-driven Magnus formula. The dew point is found by
+ *        inverting the table, with an error below 0.02 degrees from -40 to 80 degrees Celsius.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percent.
+ * @return The metrics.
+ */
+ATC_Psychrometrics atcPsychrometrics(float temperature, float humidity);
+
+/**
+ * @brief Computes the psychrometric metrics of a reading, with libm unless ATC_PSYCHROMETRICS_TABLE is set.
+ * @param reading The reading.
+ * @return The metrics, all NAN if the reading lacks the temperature or the humidity.
+ */
+ATC_Psychrometrics atcReadingPsychrometrics(const ATC_MiThermometer_Reading &reading);
+
+/**
+ * @class ATC_PsychrometricCache
+ * @brief Memoises the psychrometric metrics of the latest raw temperature and humidity. The metrics are only
+ *        computed again when one of the raw values changes, with libm unless ATC_PSYCHROMETRICS_TABLE is set.
+ */
+class ATC_PsychrometricCache {
+public:
+    /**
+     * @brief Gets the metrics of a raw temperature and humidity, computing them if the values changed.
+     * @param temperature The temperature in 0.01 degrees Celsius.
+     * @param humidity The relative humidity in 0.01 percent.
+     * @return The metrics, valid until the next call.
+     */
+    const ATC_Psychrometrics &get(int16_t temperature, uint16_t humidity);
+
+    /**
+     * @brief Gets the metrics of a reading, computing them if its temperature or humidity changed.
+     * @param reading The reading.
+     * @return The metrics, valid until the next call, all NAN if the reading lacks the temperature or the humidity.
+     */
+    const ATC_Psychrometrics &get(const ATC_MiThermometer_Reading &reading);
+
+    /**
+     * @brief Forgets the cached metrics.
+     */
+    void invalidate();
+
+private:
+    ATC_Psychrometrics values{}; /**< The cached metrics. */
+    int16_t cached_temperature = 0; /**< The temperature the metrics were computed for. */
+    uint16_t cached_humidity = 0; /**< The humidity the metrics were computed for. */
+    bool valid = false; /**< Flag indicating whether the metrics are cached. */
+};
+
+#endif // ATC_PSYCHROMETRICS_H
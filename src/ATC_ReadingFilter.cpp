@@ -0,0 +1,162 @@
+/**
+ * @file ATC_ReadingFilter.cpp
+ * @brief This file contains the implementation of the ATC_ScalarFilter and ATC_ReadingFilter classes.
+ */
+#include "ATC_ReadingFilter.h"
+#include <algorithm>
+
+/** @brief Number of fractional bits of the EWMA and Kalman state. */
+static constexpr int filter_fraction_bits = 8;
+
+/**
+ * @brief Multiplies a value by a factor in 1/65536 and rounds the result to the nearest integer.
+ * @param value The value.
+ * @param factor The factor in 1/65536.
+ * @return The product.
+ */
+static int32_t scale(int32_t value, uint32_t factor) {
+    return static_cast<int32_t>((static_cast<int64_t>(value) * factor + 32768) >> 16);
+}
+
+/**
+ * @brief Sets the filter and its parameters, and resets the filter. The median window is rounded to an odd size
+ * between 3 and filter_median_max_window so that the median is a sample.
+ * @param filterConfig The configuration.
+ */
+void ATC_ScalarFilter::configure(const ATC_FilterConfig &filterConfig) {
+    config = filterConfig;
+    config.median_window = std::min<uint8_t>(std::max<uint8_t>(config.median_window | 1, 3),
+                                             filter_median_max_window);
+    reset();
+}
+
+/**
+ * @brief Passes a new sample through the filter.
+ * @param sample The raw sample.
+ * @return The filtered value, the sample itself if the filter is Filter_type::NONE.
+ */
+int32_t ATC_ScalarFilter::update(int32_t sample) {
+    switch (config.type) {
+        case Filter_type::EWMA:
+            return updateEwma(sample);
+        case Filter_type::MEDIAN:
+            return updateMedian(sample);
+        case Filter_type::KALMAN:
+            return updateKalman(sample);
+        default:
+            return sample;
+    }
+}
+
+/**
+ * @brief Forgets the previous samples, the next sample starts the filter again.
+ */
+void ATC_ScalarFilter::reset() {
+    primed = false;
+    count = 0;
+    head = 0;
+}
+
+/**
+ * @brief Moves the estimate towards the sample by ewma_alpha of the difference. The first sample sets the estimate.
+ * @param sample The raw sample.
+ * @return The rounded estimate.
+ */
+int32_t ATC_ScalarFilter::updateEwma(int32_t sample) {
+    int32_t fixed = sample * (1 << filter_fraction_bits);
+    if (!primed) {
+        estimate = fixed;
+        primed = true;
+    } else {
+        estimate += scale(fixed - estimate, config.ewma_alpha);
+    }
+    return (estimate + (1 << (filter_fraction_bits - 1))) >> filter_fraction_bits;
+}
+
+/**
+ * @brief Replaces the oldest sample of the window with the new one. Both are located in the sorted copy by binary
+ * search, and the samples between them are shifted by one place.
+ * @param sample The raw sample.
+ * @return The median of the samples in the window, the lower one while the window fills up with an even count.
+ */
+int32_t ATC_ScalarFilter::updateMedian(int32_t sample) {
+    if (count == config.median_window) {
+        int32_t *oldest = std::lower_bound(sorted, sorted + count, window[head]);
+        std::copy(oldest + 1, sorted + count, oldest);
+        count--;
+    }
+    int32_t *position = std::upper_bound(sorted, sorted + count, sample);
+    std::copy_backward(position, sorted + count, sorted + count + 1);
+    *position = sample;
+    count++;
+    window[head] = sample;
+    head = static_cast<uint8_t>((head + 1) % config.median_window);
+    return sorted[(count - 1) / 2];
+}
+
+/**
+ * @brief Runs one step of a scalar Kalman filter modelling the value as constant plus random walk. The predict step
+ * adds the process noise to the variance, the update step moves the estimate towards the sample by the gain
+ * P / (P + R) and reduces the variance by the same factor. The first sample sets the estimate with the variance of
+ * the measurement noise.
+ * @param sample The raw sample.
+ * @return The rounded estimate.
+ */
+int32_t ATC_ScalarFilter::updateKalman(int32_t sample) {
+    int32_t fixed = sample * (1 << filter_fraction_bits);
+    uint64_t measurementNoise = static_cast<uint64_t>(config.kalman_measurement_noise) << filter_fraction_bits;
+    if (!primed) {
+        estimate = fixed;
+        variance = static_cast<uint32_t>(std::min<uint64_t>(measurementNoise, UINT32_MAX));
+        primed = true;
+    } else {
+        uint64_t predicted = variance + (static_cast<uint64_t>(config.kalman_process_noise) << filter_fraction_bits);
+        predicted = std::min<uint64_t>(predicted, UINT32_MAX);
+        auto gain = static_cast<uint32_t>((predicted << 16) / (predicted + measurementNoise + 1));
+        estimate += scale(fixed - estimate, gain);
+        variance = static_cast<uint32_t>((predicted * (65536 - gain)) >> 16);
+    }
+    return (estimate + (1 << (filter_fraction_bits - 1))) >> filter_fraction_bits;
+}
+
+/**
+ * @brief Sets the filter of both series, and resets it.
+ * @param filterConfig The configuration.
+ */
+void ATC_ReadingFilter::configure(const ATC_FilterConfig &filterConfig) {
+    config = filterConfig;
+    temperature.configure(filterConfig);
+    humidity.configure(filterConfig);
+}
+
+/**
+ * @brief Gets the configuration of the filter.
+ * @return The configuration.
+ */
+const ATC_FilterConfig &ATC_ReadingFilter::getConfig() const {
+    return config;
+}
+
+/**
+ * @brief Replaces the temperature and the humidity of a reading with their filtered values.
+ * @param reading The reading to filter.
+ */
+void ATC_ReadingFilter::apply(ATC_MiThermometer_Reading &reading) {
+    if (config.type == Filter_type::NONE) {
+        return;
+    }
+    if (reading.fields & READING_TEMPERATURE) {
+        reading.temperature = static_cast<int16_t>(temperature.update(reading.temperature));
+    }
+    if (reading.fields & READING_HUMIDITY) {
+        reading.humidity = static_cast<uint16_t>(humidity.update(reading.humidity));
+    }
+}
+
+/**
+ * @brief Forgets the previous samples of both series.
+ */
+void ATC_ReadingFilter::reset() {
+    temperature.reset();
+    humidity.reset();
+}
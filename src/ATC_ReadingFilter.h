@@ -0,0 +1,94 @@
+/**
+ * @file ATC_ReadingFilter.h
+ * @brief This file contains the declaration of the smoothing filters applied to the live readings of a thermometer:
+ * an exponentially weighted moving average, a sliding median and a scalar Kalman filter. The filters run in integer
+ * arithmetic on the raw values, so they cost a few instructions per sample on the ESP32 and replace the averaging
+ * done on the sensor, which costs battery.
+ * The classes only depend on the standard library, so they can also be used on a host.
+ */
+#ifndef ATC_READING_FILTER_H
+#define ATC_READING_FILTER_H
+
+#include <cstdint>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @class ATC_ScalarFilter
+ * @brief Smooths one series of raw samples. The EWMA and Kalman filters take O(1) per sample and keep their state
+ *        with 8 fractional bits. The median filter keeps the window sorted, finding the positions by binary search.
+ */
+class ATC_ScalarFilter {
+public:
+    /**
+     * @brief Sets the filter and its parameters, and resets the filter.
+     * @param config The configuration. The median window is rounded to 3, 5 or 7.
+     */
+    void configure(const ATC_FilterConfig &config);
+
+    /**
+     * @brief Passes a new sample through the filter.
+     * @param sample The raw sample.
+     * @return The filtered value, the sample itself if the filter is Filter_type::NONE.
+     */
+    int32_t update(int32_t sample);
+
+    /**
+     * @brief Forgets the previous samples, the next sample starts the filter again.
+     */
+    void reset();
+
+private:
+    int32_t updateEwma(int32_t sample);
+
+    int32_t updateMedian(int32_t sample);
+
+    int32_t updateKalman(int32_t sample);
+
+    ATC_FilterConfig config; /**< The filter and its parameters. */
+    bool primed = false; /**< Flag indicating whether a sample was received since the last reset. */
+    int32_t estimate = 0; /**< EWMA or Kalman estimate with 8 fractional bits. */
+    uint32_t variance = 0; /**< Kalman estimate variance with 8 fractional bits. */
+    int32_t window[filter_median_max_window] = {}; /**< Median window in arrival order, a ring buffer. */
+    int32_t sorted[filter_median_max_window] = {}; /**< Median window in ascending order. */
+    uint8_t count = 0; /**< Number of samples in the median window. */
+    uint8_t head = 0; /**< Position of the oldest sample in the ring buffer once it is full. */
+};
+
+/**
+ * @class ATC_ReadingFilter
+ * @brief Smooths the temperature and the humidity of the live readings of a thermometer with two scalar filters.
+ *        The battery fields are passed on unchanged.
+ */
+class ATC_ReadingFilter {
+public:
+    /**
+     * @brief Sets the filter of both series, and resets it.
+     * @param config The configuration.
+     */
+    void configure(const ATC_FilterConfig &config);
+
+    /**
+     * @brief Gets the configuration of the filter.
+     * @return The configuration.
+     */
+    const ATC_FilterConfig &getConfig() const;
+
+    /**
+     * @brief Replaces the temperature and the humidity of a reading with their filtered values. Fields missing from
+     *        the reading do not advance their filter.
+     * @param reading The reading to filter.
+     */
+    void apply(ATC_MiThermometer_Reading &reading);
+
+    /**
+     * @brief Forgets the previous samples of both series.
+     */
+    void reset();
+
+private:
+    ATC_FilterConfig config; /**< The configuration. */
+    ATC_ScalarFilter temperature; /**< Filter of the temperature. */
+    ATC_ScalarFilter humidity; /**< Filter of the humidity. */
+};
+
+#endif // ATC_READING_FILTER_H
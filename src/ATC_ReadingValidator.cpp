@@ -0,0 +1,230 @@
+/**
+ * @file ATC_ReadingValidator.cpp
+ * @brief This file contains the implementation of the ATC_ReadingValidator class.
+ */
+#include "ATC_ReadingValidator.h"
+#include <algorithm>
+#include <cstdlib>
+
+/** @brief Ratio of the median absolute deviation to the standard deviation of a normal distribution. */
+static constexpr float mad_to_sigma = 0.6745f;
+
+/**
+ * @brief Constructor for the ATC_ReadingValidator class. Validation is off until configure() is called.
+ */
+ATC_ReadingValidator::ATC_ReadingValidator() : stats(), temperature(), humidity() {
+    config.action = Validation_action::OFF;
+}
+
+/**
+ * @brief Sets the checks and the action, and forgets the recent values. The window is limited to
+ * validation_max_window values.
+ * @param validationConfig The configuration.
+ */
+void ATC_ReadingValidator::configure(const ATC_ValidationConfig &validationConfig) {
+    config = validationConfig;
+    config.zscore_window = std::min(std::max<uint8_t>(config.zscore_window, 1), validation_max_window);
+    temperature = Series();
+    humidity = Series();
+}
+
+/**
+ * @brief Gets the configuration of the validation stage.
+ * @return The configuration.
+ */
+const ATC_ValidationConfig &ATC_ReadingValidator::getConfig() const {
+    return config;
+}
+
+/**
+ * @brief Validates a live reading: the bounds of every field, then the rate of change and the z-score of the
+ * temperature and the humidity. Values passing all checks are recorded.
+ * @param reading The reading, whose failing fields are dropped or flagged in its anomalies.
+ * @param nowMs The current millis() timestamp.
+ * @return Bitmask of Reading_Field flags of the failing fields.
+ */
+uint8_t ATC_ReadingValidator::validate(ATC_MiThermometer_Reading &reading, uint32_t nowMs) {
+    if (config.action == Validation_action::OFF) {
+        return 0;
+    }
+    uint8_t failed = checkBounds(reading);
+    if ((reading.fields & READING_TEMPERATURE) && !(failed & READING_TEMPERATURE) &&
+        !checkSeries(temperature, reading.temperature, nowMs, config.temperature_max_rate,
+                     config.temperature_mad_floor)) {
+        failed |= READING_TEMPERATURE;
+    }
+    if ((reading.fields & READING_HUMIDITY) && !(failed & READING_HUMIDITY) &&
+        !checkSeries(humidity, reading.humidity, nowMs, config.humidity_max_rate, config.humidity_mad_floor)) {
+        failed |= READING_HUMIDITY;
+    }
+    return apply(reading, failed);
+}
+
+/**
+ * @brief Validates a reading against the physical bounds only, without recording it or counting it in the stats, so
+ * it can run on another task than validate().
+ * @param reading The reading, whose failing fields are dropped or flagged in its anomalies.
+ * @return Bitmask of Reading_Field flags of the failing fields.
+ */
+uint8_t ATC_ReadingValidator::validateBounds(ATC_MiThermometer_Reading &reading) const {
+    if (config.action == Validation_action::OFF) {
+        return 0;
+    }
+    return apply(reading, boundsFailures(reading));
+}
+
+/**
+ * @brief Gets the counters of the validation stage.
+ * @return The counters.
+ */
+const ATC_ValidationStats &ATC_ReadingValidator::getStats() const {
+    return stats;
+}
+
+/**
+ * @brief Forgets the recent values and clears the counters.
+ */
+void ATC_ReadingValidator::reset() {
+    stats = ATC_ValidationStats();
+    temperature = Series();
+    humidity = Series();
+}
+
+/**
+ * @brief Checks the rate of change and the robust z-score of a value against the recent accepted values. The rate
+ * is measured over at least one second, so that two advertisements close together may differ by one rate step.
+ * A value failing rebaseline_after times in a row is accepted and restarts the window.
+ * @param series The recent values.
+ * @param value The value to check.
+ * @param nowMs The current millis() timestamp.
+ * @param maxRate The largest change per second, 0 to disable the check.
+ * @param madFloor The smallest deviation used for the z-score.
+ * @return True if the value is accepted.
+ */
+bool ATC_ReadingValidator::checkSeries(Series &series, int32_t value, uint32_t nowMs, uint16_t maxRate,
+                                       uint16_t madFloor) {
+    bool rateFailed = false;
+    if (series.count > 0 && maxRate > 0) {
+        uint32_t elapsedMs = std::max<uint32_t>(nowMs - series.last_ms, 1000);
+        uint64_t allowed = static_cast<uint64_t>(maxRate) * elapsedMs / 1000;
+        rateFailed = static_cast<uint64_t>(std::abs(value - series.last)) > allowed;
+    }
+    bool outlier = !rateFailed && config.zscore_threshold > 0.0f && series.count >= config.zscore_min_samples &&
+                   isOutlier(series, value, config.zscore_threshold, madFloor);
+    if (rateFailed || outlier) {
+        if (++series.failures < config.rebaseline_after || config.rebaseline_after == 0) {
+            if (rateFailed) {
+                stats.rate_of_change++;
+            } else {
+                stats.outlier++;
+            }
+            return false;
+        }
+        stats.rebaselined++;
+        series.count = 0;
+        series.head = 0;
+    }
+    series.failures = 0;
+    record(series, value, nowMs, config.zscore_window);
+    return true;
+}
+
+/**
+ * @brief Computes the robust z-score of a value: its distance to the median of the window, divided by the median
+ * absolute deviation scaled to a standard deviation. The deviation is at least madFloor, because quantised readings
+ * often have a deviation of 0.
+ * @param series The recent values.
+ * @param value The value to check.
+ * @param threshold The largest accepted z-score.
+ * @param madFloor The smallest deviation.
+ * @return True if the z-score exceeds the threshold.
+ */
+bool ATC_ReadingValidator::isOutlier(const Series &series, int32_t value, float threshold, uint16_t madFloor) {
+    int32_t values[validation_max_window];
+    std::copy(series.window, series.window + series.count, values);
+    int32_t *middle = values + series.count / 2;
+    std::nth_element(values, middle, values + series.count);
+    int32_t median = *middle;
+    for (uint8_t i = 0; i < series.count; i++) {
+        values[i] = std::abs(values[i] - median);
+    }
+    std::nth_element(values, middle, values + series.count);
+    int32_t deviation = std::max<int32_t>(*middle, madFloor);
+    return mad_to_sigma * static_cast<float>(std::abs(value - median)) > threshold * static_cast<float>(deviation);
+}
+
+/**
+ * @brief Records an accepted value in the window.
+ * @param series The recent values.
+ * @param value The accepted value.
+ * @param nowMs The current millis() timestamp.
+ * @param windowSize The size of the window.
+ */
+void ATC_ReadingValidator::record(Series &series, int32_t value, uint32_t nowMs, uint8_t windowSize) {
+    series.window[series.head] = value;
+    series.head = static_cast<uint8_t>((series.head + 1) % windowSize);
+    if (series.count < windowSize) {
+        series.count++;
+    }
+    series.last = value;
+    series.last_ms = nowMs;
+}
+
+/**
+ * @brief Drops or flags the failing fields of a reading.
+ * @param reading The reading.
+ * @param failed Bitmask of Reading_Field flags of the failing fields.
+ * @return The failing fields.
+ */
+uint8_t ATC_ReadingValidator::apply(ATC_MiThermometer_Reading &reading, uint8_t failed) const {
+    if (config.action == Validation_action::DROP) {
+        reading.fields &= static_cast<uint8_t>(~failed);
+    } else {
+        reading.anomalies |= failed;
+    }
+    return failed;
+}
+
+/**
+ * @brief Checks the present fields of a reading against their physical bounds, and counts the checked and failing
+ * fields.
+ * @param reading The reading.
+ * @return Bitmask of Reading_Field flags of the fields out of bounds.
+ */
+uint8_t ATC_ReadingValidator::checkBounds(const ATC_MiThermometer_Reading &reading) {
+    uint8_t failed = boundsFailures(reading);
+    for (uint8_t field = READING_TEMPERATURE; field <= READING_BATTERY_LEVEL; field <<= 1) {
+        if (reading.fields & field) {
+            stats.checked++;
+            if (failed & field) {
+                stats.out_of_range++;
+            }
+        }
+    }
+    return failed;
+}
+
+/**
+ * @brief Checks the present fields of a reading against their physical bounds.
+ * @param reading The reading.
+ * @return Bitmask of Reading_Field flags of the fields out of bounds.
+ */
+uint8_t ATC_ReadingValidator::boundsFailures(const ATC_MiThermometer_Reading &reading) const {
+    uint8_t failed = 0;
+    if ((reading.fields & READING_TEMPERATURE) &&
+        (reading.temperature < config.temperature_min || reading.temperature > config.temperature_max)) {
+        failed |= READING_TEMPERATURE;
+    }
+    if ((reading.fields & READING_HUMIDITY) &&
+        (reading.humidity < config.humidity_min || reading.humidity > config.humidity_max)) {
+        failed |= READING_HUMIDITY;
+    }
+    if ((reading.fields & READING_BATTERY_MV) &&
+        (reading.battery_mv < config.battery_mv_min || reading.battery_mv > config.battery_mv_max)) {
+        failed |= READING_BATTERY_MV;
+    }
+    if ((reading.fields & READING_BATTERY_LEVEL) && reading.battery_level > 100) {
+        failed |= READING_BATTERY_LEVEL;
+    }
+    return failed;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file ATC_ReadingValidator.h
+ * @brief This file contains the declaration of the ATC_ReadingValidator class, the validation stage rejecting bogus
+ * values from the live readings of a thermometer before they are stored or passed on.
+ * The class only depends on the standard library, so it can also be used on a host.
+ */
+#ifndef ATC_READING_VALIDATOR_H
+#define ATC_READING_VALIDATOR_H
+
+#include <cstdint>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @class ATC_ReadingValidator
+ * @brief Checks the fields of readings against their physical bounds, and the temperature and humidity against a
+ *        maximum rate of change and a robust z-score over the recent accepted values. Failing fields are flagged or
+ *        dropped according to the configured action. After rebaseline_after consecutive rate or z-score failures
+ *        the value is accepted as a real change and the window restarts from it, so that a moved thermometer is
+ *        not rejected forever. The class is not thread safe.
+ */
+class ATC_ReadingValidator {
+public:
+    /**
+     * @brief Constructor for the ATC_ReadingValidator class. Validation is off until configure() is called.
+     */
+    ATC_ReadingValidator();
+
+    /**
+     * @brief Sets the checks and the action, and forgets the recent values.
+     * @param config The configuration.
+     */
+    void configure(const ATC_ValidationConfig &config);
+
+    /**
+     * @brief Gets the configuration of the validation stage.
+     * @return The configuration.
+     */
+    const ATC_ValidationConfig &getConfig() const;
+
+    /**
+     * @brief Validates a live reading with all checks and records the accepted values.
+     * @param reading The reading, whose failing fields are dropped or flagged in its anomalies.
+     * @param nowMs The current millis() timestamp, used for the rate of change.
+     * @return Bitmask of Reading_Field flags of the failing fields.
+     */
+    uint8_t validate(ATC_MiThermometer_Reading &reading, uint32_t nowMs);
+
+    /**
+     * @brief Validates a reading against the physical bounds only, without recording it or counting it in the stats.
+     *        Used for history records, which are not in time order with the live readings and are received on the
+     *        BLE task.
+     * @param reading The reading, whose failing fields are dropped or flagged in its anomalies.
+     * @return Bitmask of Reading_Field flags of the failing fields.
+     */
+    uint8_t validateBounds(ATC_MiThermometer_Reading &reading) const;
+
+    /**
+     * @brief Gets the counters of the validation stage.
+     * @return The counters.
+     */
+    const ATC_ValidationStats &getStats() const;
+
+    /**
+     * @brief Forgets the recent values and clears the counters.
+     */
+    void reset();
+
+private:
+    /**
+     * @struct Series
+     * @brief The recent accepted values of the temperature or the humidity.
+     */
+    struct Series {
+        int32_t window[validation_max_window]; /**< Recent accepted values, a ring buffer. */
+        uint8_t count; /**< Number of values in the window. */
+        uint8_t head; /**< Position of the next value in the ring buffer. */
+        uint8_t failures; /**< Consecutive rate or z-score failures. */
+        int32_t last; /**< The last accepted value. */
+        uint32_t last_ms; /**< millis() of the last accepted value. */
+    };
+
+    bool checkSeries(Series &series, int32_t value, uint32_t nowMs, uint16_t maxRate, uint16_t madFloor);
+
+    static bool isOutlier(const Series &series, int32_t value, float threshold, uint16_t madFloor);
+
+    static void record(Series &series, int32_t value, uint32_t nowMs, uint8_t windowSize);
+
+    uint8_t apply(ATC_MiThermometer_Reading &reading, uint8_t failed) const;
+
+    uint8_t checkBounds(const ATC_MiThermometer_Reading &reading);
+
+    uint8_t boundsFailures(const ATC_MiThermometer_Reading &reading) const;
+
+    ATC_ValidationConfig config; /**< The checks and the action. */
+    ATC_ValidationStats stats; /**< The counters. */
+    Series temperature; /**< Recent temperatures. */
+    Series humidity; /**< Recent humidities. */
+};
+
+#endif // ATC_READING_VALIDATOR_H
@@ -0,0 +1,346 @@
+/**
+ * @file ATC_RuleEngine.cpp
+ * @brief This file contains the implementation of the ATC_RuleEngine class.
+ */
+#include "ATC_RuleEngine.h"
+#include <algorithm>
+#include <ctime>
+
+/**
+ * @brief Gets the index of a field in the values of a device.
+ * @param field The Reading_Field flag.
+ * @return The index, or 4 if the flag is not a single field rules can check.
+ */
+static size_t ruleFieldIndex(uint8_t field) {
+    switch (field) {
+        case READING_TEMPERATURE:
+            return 0;
+        case READING_HUMIDITY:
+            return 1;
+        case READING_BATTERY_MV:
+            return 2;
+        case READING_BATTERY_LEVEL:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+/**
+ * @brief Checks if a condition measures a rate of change.
+ * @param condition The condition.
+ * @return True for RISING and FALLING.
+ */
+static bool isRateCondition(Rule_condition condition) {
+    return condition == Rule_condition::RISING || condition == Rule_condition::FALLING;
+}
+
+/**
+ * @brief Constructor for the ATC_RuleEngine class.
+ * @param deviceCapacity The number of devices to reserve space for.
+ */
+ATC_RuleEngine::ATC_RuleEngine(size_t deviceCapacity) : active(0), raises(0) {
+    devices.reserve(deviceCapacity);
+    sorted_addresses.reserve(deviceCapacity);
+    sorted_indexes.reserve(deviceCapacity);
+}
+
+/**
+ * @brief Adds a rule and compiles the tables of the devices again. Their alerts are reset without events, and the
+ * rules are evaluated again on their next reading.
+ * @param rule The rule.
+ * @return True if the rule was added, false if its field is not a single flag or there are too many rules.
+ */
+bool ATC_RuleEngine::addRule(const ATC_AlertRule &rule) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ruleFieldIndex(rule.field) >= field_count || rules.size() >= UINT16_MAX) {
+        return false;
+    }
+    rules.push_back(rule);
+    entries.clear();
+    pending.clear();
+    active = 0;
+    for (uint32_t index = 0; index < devices.size(); index++) {
+        compile(index);
+    }
+    return true;
+}
+
+/**
+ * @brief Removes all the rules and the alerts.
+ */
+void ATC_RuleEngine::clearRules() {
+    std::lock_guard<std::mutex> lock(mutex);
+    rules.clear();
+    entries.clear();
+    pending.clear();
+    active = 0;
+    for (uint32_t index = 0; index < devices.size(); index++) {
+        compile(index);
+    }
+}
+
+/**
+ * @brief Gets the number of rules.
+ * @return The number of rules.
+ */
+size_t ATC_RuleEngine::getRuleCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rules.size();
+}
+
+/**
+ * @brief Sets the callback called with the alerts raised and cleared.
+ * @param callback The callback, or an empty function to remove it.
+ */
+void ATC_RuleEngine::setAlertCallback(std::function<void(const ATC_AlertEvent &)> callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    alertCallback = std::move(callback);
+}
+
+/**
+ * @brief Evaluates the rules of a device on the fields of a reading that changed. The first reading of a device
+ * compiles its table.
+ * @param address The packed MAC address.
+ * @param reading The reading.
+ * @param nowMs The current millis() timestamp.
+ */
+void ATC_RuleEngine::update(uint64_t address, const ATC_MiThermometer_Reading &reading, uint32_t nowMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rules.empty()) {
+        return;
+    }
+    uint32_t index = findDevice(address);
+    if (index == no_device) {
+        index = addDevice(address);
+    }
+    const uint8_t flags[field_count] = {READING_TEMPERATURE, READING_HUMIDITY, READING_BATTERY_MV,
+                                        READING_BATTERY_LEVEL};
+    const int32_t values[field_count] = {reading.temperature, reading.humidity, reading.battery_mv,
+                                         reading.battery_level};
+    for (size_t field = 0; field < field_count; field++) {
+        Device &device = devices[index];
+        if (!(reading.fields & flags[field]) || (reading.anomalies & flags[field])) {
+            continue;
+        }
+        if ((device.known & (1 << field)) && device.values[field] == values[field]) {
+            continue;
+        }
+        device.known |= static_cast<uint8_t>(1 << field);
+        device.values[field] = values[field];
+        uint32_t end = device.first + device.offsets[field + 1];
+        for (uint32_t entry = device.first + device.offsets[field]; entry < end; entry++) {
+            evaluate(entry, values[field], nowMs);
+        }
+    }
+}
+
+/**
+ * @brief Evaluates the pending entries, and the raised rate entries so that they clear when the value stops
+ * changing, with the last value of their device.
+ * @param nowMs The current millis() timestamp.
+ * @return The number of alerts raised.
+ */
+size_t ATC_RuleEngine::poll(uint32_t nowMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t before = raises;
+    for (size_t i = pending.size(); i-- > 0;) {
+        const Entry &entry = entries[pending[i]];
+        evaluate(pending[i], devices[entry.device].values[ruleFieldIndex(rules[entry.rule].field)], nowMs);
+    }
+    return raises - before;
+}
+
+/**
+ * @brief Gets the number of raised alerts.
+ * @return The number of raised alerts.
+ */
+size_t ATC_RuleEngine::getActiveCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+/**
+ * @brief Checks if the alert of a rule is raised for a device.
+ * @param address The packed MAC address.
+ * @param ruleId The identifier of the rule.
+ * @return True if an alert of the rule is raised for the device.
+ */
+bool ATC_RuleEngine::isActive(uint64_t address, uint16_t ruleId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t index = findDevice(address);
+    if (index == no_device) {
+        return false;
+    }
+    const Device &device = devices[index];
+    for (uint32_t entry = device.first; entry < device.first + device.offsets[field_count]; entry++) {
+        if (entries[entry].state == RAISED && rules[entries[entry].rule].id == ruleId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Finds a device with a binary search over the sorted addresses.
+ * @param address The packed MAC address.
+ * @return The index of the device, or no_device if not found.
+ */
+uint32_t ATC_RuleEngine::findDevice(uint64_t address) const {
+    auto it = std::lower_bound(sorted_addresses.begin(), sorted_addresses.end(), address);
+    if (it == sorted_addresses.end() || *it != address) {
+        return no_device;
+    }
+    return sorted_indexes[static_cast<size_t>(it - sorted_addresses.begin())];
+}
+
+/**
+ * @brief Adds a device and compiles its table.
+ * @param address The packed MAC address.
+ * @return The index of the device.
+ */
+uint32_t ATC_RuleEngine::addDevice(uint64_t address) {
+    Device device{};
+    device.address = address;
+    uint32_t index = static_cast<uint32_t>(devices.size());
+    devices.push_back(device);
+    size_t position = std::lower_bound(sorted_addresses.begin(), sorted_addresses.end(), address) -
+                      sorted_addresses.begin();
+    sorted_addresses.insert(sorted_addresses.begin() + static_cast<long>(position), address);
+    sorted_indexes.insert(sorted_indexes.begin() + static_cast<long>(position), index);
+    compile(index);
+    return index;
+}
+
+/**
+ * @brief Appends the entries of the rules matching a device to the table, grouped by field, and forgets its values
+ * so that its next reading evaluates every rule.
+ * @param index The index of the device.
+ */
+void ATC_RuleEngine::compile(uint32_t index) {
+    Device &device = devices[index];
+    device.first = static_cast<uint32_t>(entries.size());
+    device.known = 0;
+    for (size_t field = 0; field < field_count; field++) {
+        device.offsets[field] = static_cast<uint16_t>(entries.size() - device.first);
+        for (size_t rule = 0; rule < rules.size(); rule++) {
+            if (ruleFieldIndex(rules[rule].field) != field ||
+                (rules[rule].address != 0 && rules[rule].address != device.address)) {
+                continue;
+            }
+            Entry entry{};
+            entry.rule = static_cast<uint16_t>(rule);
+            entry.state = IDLE;
+            entry.device = index;
+            entries.push_back(entry);
+        }
+    }
+    device.offsets[field_count] = static_cast<uint16_t>(entries.size() - device.first);
+}
+
+/**
+ * @brief Evaluates an entry with a value. RISING and FALLING compute the rate per minute from the reference value
+ * once the duration of the rule has elapsed since it, and are not evaluated before.
+ * @param entryIndex The index of the entry.
+ * @param value The value of the field.
+ * @param nowMs The current millis() timestamp.
+ */
+void ATC_RuleEngine::evaluate(uint32_t entryIndex, int32_t value, uint32_t nowMs) {
+    Entry &entry = entries[entryIndex];
+    const ATC_AlertRule &rule = rules[entry.rule];
+    if (isRateCondition(rule.condition)) {
+        if (!entry.has_reference) {
+            entry.has_reference = true;
+            entry.reference = value;
+            entry.since = nowMs;
+            return;
+        }
+        uint32_t elapsed = nowMs - entry.since;
+        if (elapsed == 0 || elapsed < rule.duration_ms) {
+            return;
+        }
+        int64_t change = static_cast<int64_t>(value) - entry.reference;
+        int32_t rate = static_cast<int32_t>(change * 60000 / static_cast<int64_t>(elapsed));
+        entry.reference = value;
+        entry.since = nowMs;
+        if (rule.condition == Rule_condition::FALLING) {
+            rate = -rate;
+        }
+        if (entry.state != RAISED && rate >= rule.threshold) {
+            setState(entryIndex, RAISED, rule.condition == Rule_condition::FALLING ? -rate : rate, nowMs);
+        } else if (entry.state == RAISED && rate < rule.threshold - rule.hysteresis) {
+            setState(entryIndex, IDLE, rule.condition == Rule_condition::FALLING ? -rate : rate, nowMs);
+        }
+        return;
+    }
+    bool above = rule.condition == Rule_condition::ABOVE;
+    bool holds = above ? value > rule.threshold : value < rule.threshold;
+    switch (entry.state) {
+        case IDLE:
+            if (holds) {
+                setState(entryIndex, rule.duration_ms ? PENDING : RAISED, value, nowMs);
+            }
+            break;
+        case PENDING:
+            if (!holds) {
+                setState(entryIndex, IDLE, value, nowMs);
+            } else if (nowMs - entry.since >= rule.duration_ms) {
+                setState(entryIndex, RAISED, value, nowMs);
+            }
+            break;
+        default:
+            if (above ? value <= rule.threshold - rule.hysteresis : value >= rule.threshold + rule.hysteresis) {
+                setState(entryIndex, IDLE, value, nowMs);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Changes the state of an entry, keeps the list of entries polled and the number of raised alerts up to date,
+ * and reports the alerts raised and cleared.
+ * @param entryIndex The index of the entry.
+ * @param state The new state.
+ * @param value The value or rate causing the change.
+ * @param nowMs The current millis() timestamp.
+ */
+void ATC_RuleEngine::setState(uint32_t entryIndex, uint8_t state, int32_t value, uint32_t nowMs) {
+    Entry &entry = entries[entryIndex];
+    const ATC_AlertRule &rule = rules[entry.rule];
+    bool rate = isRateCondition(rule.condition);
+    bool polled = entry.state == PENDING || (rate && entry.state == RAISED);
+    bool wasRaised = entry.state == RAISED;
+    entry.state = state;
+    if (state == PENDING) {
+        entry.since = nowMs;
+    }
+    bool poll = state == PENDING || (rate && state == RAISED);
+    if (polled && !poll) {
+        auto it = std::find(pending.begin(), pending.end(), entryIndex);
+        if (it != pending.end()) {
+            *it = pending.back();
+            pending.pop_back();
+        }
+    } else if (!polled && poll) {
+        pending.push_back(entryIndex);
+    }
+    if (wasRaised == (state == RAISED)) {
+        return;
+    }
+    if (state == RAISED) {
+        active++;
+        raises++;
+    } else {
+        active--;
+    }
+    if (alertCallback) {
+        ATC_AlertEvent event{};
+        event.address = devices[entry.device].address;
+        event.rule_id = rule.id;
+        event.raised = state == RAISED;
+        event.value = value;
+        event.time = std::time(nullptr);
+        event.timestamp_ms = nowMs;
+        alertCallback(event);
+    }
+}
@@ -0,0 +1,153 @@
+/**
+ * @file ATC_RuleEngine.h
+ * @brief This file contains the declaration of the ATC_RuleEngine class, which evaluates alert rules such as
+ * thresholds with hysteresis, minimum durations and rates of change against the readings of the thermometers, and
+ * reports the alerts raised and cleared.
+ * The class only depends on the standard library, so it can also be used on a host evaluating readings.
+ */
+#ifndef ATC_RULE_ENGINE_H
+#define ATC_RULE_ENGINE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @class ATC_RuleEngine
+ * @brief Compiles the rules into a table per device, with the rules of the device grouped by field, so that a
+ *        reading only evaluates the rules of the fields whose value changed. Rules of ABOVE and BELOW with a duration
+ *        become pending when their condition starts holding, and are raised by the next reading or by poll() once the
+ *        duration has elapsed, with poll() only visiting the pending rules and the raised rate rules. A raised alert
+ *        is cleared when the value, or the rate, goes back past the threshold by the hysteresis. The class is thread
+ *        safe, the alert callback is called with the engine locked and must not call it.
+ */
+class ATC_RuleEngine {
+public:
+    /**
+     * @brief Constructor for the ATC_RuleEngine class.
+     * @param deviceCapacity The number of devices to reserve space for.
+     */
+    explicit ATC_RuleEngine(size_t deviceCapacity = 0);
+
+    /**
+     * @brief Adds a rule. The tables of the devices already seen are compiled again, which resets their alerts.
+     * @param rule The rule. Its field must be a single Reading_Field flag.
+     * @return True if the rule was added, false if its field is not a single flag.
+     */
+    bool addRule(const ATC_AlertRule &rule);
+
+    /**
+     * @brief Removes all the rules and the alerts.
+     */
+    void clearRules();
+
+    /**
+     * @brief Gets the number of rules.
+     * @return The number of rules.
+     */
+    size_t getRuleCount() const;
+
+    /**
+     * @brief Sets the callback called with the alerts raised and cleared.
+     * @param callback The callback, or an empty function to remove it.
+     */
+    void setAlertCallback(std::function<void(const ATC_AlertEvent &)> callback);
+
+    /**
+     * @brief Evaluates the rules of a device on the fields of a reading that changed since its previous reading.
+     *        Missing fields and fields flagged as anomalies are ignored.
+     * @param address The packed MAC address.
+     * @param reading The reading.
+     * @param nowMs The current millis() timestamp.
+     */
+    void update(uint64_t address, const ATC_MiThermometer_Reading &reading, uint32_t nowMs);
+
+    /**
+     * @brief Raises the pending alerts whose duration has elapsed. Should be called periodically, for example from
+     *        loop(), when readings may stop arriving.
+     * @param nowMs The current millis() timestamp.
+     * @return The number of alerts raised.
+     */
+    size_t poll(uint32_t nowMs);
+
+    /**
+     * @brief Gets the number of raised alerts.
+     * @return The number of raised alerts.
+     */
+    size_t getActiveCount() const;
+
+    /**
+     * @brief Checks if the alert of a rule is raised for a device.
+     * @param address The packed MAC address.
+     * @param ruleId The identifier of the rule.
+     * @return True if an alert of the rule is raised for the device.
+     */
+    bool isActive(uint64_t address, uint16_t ruleId) const;
+
+private:
+    /** @brief Number of fields rules can check: temperature, humidity, battery voltage and battery level. */
+    static constexpr size_t field_count = 4;
+    /** @brief Index meaning no device. */
+    static constexpr uint32_t no_device = UINT32_MAX;
+
+    /**
+     * @enum State
+     * @brief The state of a rule for a device.
+     */
+    enum State : uint8_t {
+        IDLE = 0, /**< The condition does not hold. */
+        PENDING = 1, /**< The condition holds, for less than the duration. */
+        RAISED = 2, /**< The alert is raised. */
+    };
+
+    /**
+     * @struct Entry
+     * @brief A rule in the table of a device, with its state.
+     */
+    struct Entry {
+        uint16_t rule; /**< Index of the rule. */
+        uint8_t state; /**< The State. */
+        bool has_reference; /**< Flag indicating whether reference holds a value, for RISING and FALLING. */
+        uint32_t device; /**< Index of the device. */
+        uint32_t since; /**< millis() at which the rule became pending, or of the reference value. */
+        int32_t reference; /**< The value the rate is measured from, for RISING and FALLING. */
+    };
+
+    /**
+     * @struct Device
+     * @brief A device, the range of its entries and its last values.
+     */
+    struct Device {
+        uint64_t address; /**< The packed MAC address. */
+        uint32_t first; /**< Index of the first entry of the device. */
+        uint16_t offsets[field_count + 1]; /**< Entries of field i are first + offsets[i] to first + offsets[i + 1]. */
+        uint8_t known; /**< Bit i set if values[i] holds a value. */
+        int32_t values[field_count]; /**< Last value of each field. */
+    };
+
+    uint32_t findDevice(uint64_t address) const;
+
+    uint32_t addDevice(uint64_t address);
+
+    void compile(uint32_t index);
+
+    void evaluate(uint32_t entryIndex, int32_t value, uint32_t nowMs);
+
+    void setState(uint32_t entryIndex, uint8_t state, int32_t value, uint32_t nowMs);
+
+    std::vector<ATC_AlertRule> rules; /**< The rules. */
+    std::vector<Device> devices; /**< The devices in order of first reading. */
+    std::vector<Entry> entries; /**< The entries of all devices, each device in a contiguous range. */
+    std::vector<uint64_t> sorted_addresses; /**< Addresses of the devices in ascending order. */
+    std::vector<uint32_t> sorted_indexes; /**< Device indexes parallel to sorted_addresses. */
+    std::vector<uint32_t> pending; /**< Indexes of the entries evaluated by poll(). */
+    size_t active; /**< Number of raised alerts. */
+    size_t raises; /**< Number of alerts raised since construction. */
+    std::function<void(const ATC_AlertEvent &)> alertCallback; /**< Callback for the alerts, may be empty. */
+    mutable std::mutex mutex; /**< Mutex protecting the engine. */
+};
+
+#endif // ATC_RULE_ENGINE_H
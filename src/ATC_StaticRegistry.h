@@ -0,0 +1,284 @@
+/**
+ * @file ATC_StaticRegistry.h
+ * @brief This file contains the ATC_DeviceRegistry interface and the ATC_StaticRegistry template, a registry of
+ * thermometers whose MAC addresses are known at compile time. The compiler generates a perfect hash of the
+ * addresses, so looking up the slot of an advertising device is a multiplication, a shift and one table load.
+ * ATC_StaticRegistry requires C++14.
+ */
+#ifndef ATC_STATIC_REGISTRY_H
+#define ATC_STATIC_REGISTRY_H
+
+#include <cstdint>
+#include <cstddef>
+
+class ATC_MiThermometer;
+
+/**
+ * @brief Packs a MAC address in NimBLE native order (least significant byte first) into an integer.
+ * @param nativeAddress The 6 address bytes.
+ * @return The packed address, most significant byte first.
+ */
+inline uint64_t atcPackNativeAddress(const uint8_t *nativeAddress) {
+    return (static_cast<uint64_t>(nativeAddress[5]) << 40) | (static_cast<uint64_t>(nativeAddress[4]) << 32) |
+           (static_cast<uint64_t>(nativeAddress[3]) << 24) | (static_cast<uint64_t>(nativeAddress[2]) << 16) |
+           (static_cast<uint64_t>(nativeAddress[1]) << 8) | static_cast<uint64_t>(nativeAddress[0]);
+}
+
+/**
+ * @class ATC_DeviceRegistry
+ * @brief Interface of a registry mapping MAC addresses to slots, each slot holding an optional thermometer.
+ *        Used by BLEAdvertisingReader as an alternative to its list of thermometers.
+ */
+class ATC_DeviceRegistry {
+public:
+    virtual ~ATC_DeviceRegistry() = default;
+
+    /**
+     * @brief Finds the slot of an address.
+     * @param address The packed MAC address.
+     * @return The slot, or -1 if the address is not registered.
+     */
+    virtual long slotOf(uint64_t address) const = 0;
+
+    /**
+     * @brief Gets the number of slots.
+     * @return The number of slots.
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * @brief Gets the thermometer attached to a slot.
+     * @param slot The slot.
+     * @return The thermometer, or nullptr if none is attached or the slot is invalid.
+     */
+    ATC_MiThermometer *thermometer(size_t slot) const {
+        return slot < size() ? slots[slot] : nullptr;
+    }
+
+    /**
+     * @brief Attaches a thermometer to the slot of an address.
+     * @param address The packed MAC address.
+     * @param thermometer The thermometer, or nullptr to detach the current one.
+     * @return True if the address is registered, false otherwise.
+     */
+    bool attach(uint64_t address, ATC_MiThermometer *thermometer) {
+        long slot = slotOf(address);
+        if (slot < 0) {
+            return false;
+        }
+        slots[slot] = thermometer;
+        return true;
+    }
+
+protected:
+    /**
+     * @brief Constructor for the ATC_DeviceRegistry class.
+     * @param slots The thermometer storage of the derived registry, one entry per slot.
+     */
+    explicit ATC_DeviceRegistry(ATC_MiThermometer **slots) : slots(slots) {}
+
+private:
+    ATC_MiThermometer **slots; /**< Thermometers attached to the slots. */
+};
+
+#if __cplusplus >= 201402L
+
+/**
+ * @brief Parses a MAC address string such as "A4:C1:38:01:02:03" at compile time.
+ * @param address The MAC address string.
+ * @return The packed address, most significant byte first, or 0 if the string is invalid.
+ */
+constexpr uint64_t atcMac(const char (&address)[18]) {
+    uint64_t packed = 0;
+    for (size_t i = 0; i < 17; i++) {
+        char c = address[i];
+        if (i % 3 == 2) {
+            if (c != ':' && c != '-') {
+                return 0;
+            }
+            continue;
+        }
+        uint64_t nibble = 0;
+        if (c >= '0' && c <= '9') {
+            nibble = static_cast<uint64_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            nibble = static_cast<uint64_t>(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            nibble = static_cast<uint64_t>(c - 'A' + 10);
+        } else {
+            return 0;
+        }
+        packed = (packed << 4) | nibble;
+    }
+    return packed;
+}
+
+/**
+ * @struct ATC_PerfectHash
+ * @brief Parameters of a multiplicative perfect hash: slot = (address * multiplier) >> (64 - bits).
+ */
+struct ATC_PerfectHash {
+    uint64_t multiplier; /**< Odd multiplier. */
+    uint32_t bits; /**< log2 of the table size, 0 if no perfect hash was found. */
+};
+
+namespace atc_detail {
+    /** @brief Number of multipliers tried for each table size. */
+    constexpr uint32_t perfect_hash_attempts = 64;
+    /** @brief Maximum number of bits added to the smallest table size when searching for a perfect hash. */
+    constexpr uint32_t perfect_hash_extra_bits = 8;
+
+    /** @brief Computes the slot of an address. */
+    constexpr uint32_t hashSlot(uint64_t address, uint64_t multiplier, uint32_t bits) {
+        return static_cast<uint32_t>((address * multiplier) >> (64 - bits));
+    }
+
+    /** @brief Gets the k-th candidate multiplier, always odd. */
+    constexpr uint64_t hashMultiplier(uint32_t k) {
+        return 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL * 2ULL * k;
+    }
+
+    /** @brief Checks that no two addresses share a slot. */
+    template<size_t N>
+    constexpr bool isPerfect(const uint64_t (&addresses)[N], uint64_t multiplier, uint32_t bits) {
+        uint32_t slots[N] = {};
+        for (size_t i = 0; i < N; i++) {
+            slots[i] = hashSlot(addresses[i], multiplier, bits);
+            for (size_t j = 0; j < i; j++) {
+                if (slots[j] == slots[i]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** @brief Searches the smallest table with a perfect hash of the addresses. */
+    template<size_t N>
+    constexpr ATC_PerfectHash findPerfectHash(const uint64_t (&addresses)[N]) {
+        uint32_t minBits = 1;
+        while ((size_t(1) << minBits) < N) {
+            minBits++;
+        }
+        for (uint32_t bits = minBits; bits <= minBits + perfect_hash_extra_bits; bits++) {
+            for (uint32_t k = 0; k < perfect_hash_attempts; k++) {
+                if (isPerfect(addresses, hashMultiplier(k), bits)) {
+                    return ATC_PerfectHash{hashMultiplier(k), bits};
+                }
+            }
+        }
+        return ATC_PerfectHash{0, 0};
+    }
+
+    /** @brief Checks that every address is valid. */
+    template<size_t N>
+    constexpr bool allValid(const uint64_t (&addresses)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            if (addresses[i] == 0 || addresses[i] > 0xFFFFFFFFFFFFULL) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @struct SlotTable
+     * @brief Maps hash slots to registry slots, 0xFF for empty hash slots.
+     */
+    template<size_t Size>
+    struct SlotTable {
+        uint8_t index[Size]; /**< Registry slot of each hash slot. */
+    };
+
+    /** @brief Builds the slot table of a perfect hash. */
+    template<size_t Size, size_t N>
+    constexpr SlotTable<Size> buildSlotTable(const uint64_t (&addresses)[N], ATC_PerfectHash hash) {
+        SlotTable<Size> table{};
+        for (size_t i = 0; i < Size; i++) {
+            table.index[i] = 0xFF;
+        }
+        for (size_t i = 0; i < N; i++) {
+            table.index[hashSlot(addresses[i], hash.multiplier, hash.bits)] = static_cast<uint8_t>(i);
+        }
+        return table;
+    }
+}
+
+/**
+ * @class ATC_StaticRegistry
+ * @brief A registry of thermometers whose MAC addresses are fixed at compile time. The perfect hash and its slot
+ *        table are computed by the compiler, nothing is built at run time. Slots are numbered in the order of
+ *        the addresses.
+ *
+ * @code
+ * ATC_StaticRegistry<atcMac("A4:C1:38:00:00:01"), atcMac("A4:C1:38:00:00:02")> registry;
+ * @endcode
+ * @tparam Addresses The packed MAC addresses, at most 255.
+ */
+template<uint64_t... Addresses>
+class ATC_StaticRegistry : public ATC_DeviceRegistry {
+public:
+    /** @brief Number of registered addresses. */
+    static constexpr size_t count = sizeof...(Addresses);
+    static_assert(count > 0 && count < 0xFF, "ATC_StaticRegistry holds between 1 and 254 addresses");
+
+    /** @brief The registered addresses, in slot order. */
+    static constexpr uint64_t addresses[count] = {Addresses...};
+    static_assert(atc_detail::allValid(addresses), "Invalid MAC address in ATC_StaticRegistry");
+
+    /** @brief The perfect hash of the addresses. */
+    static constexpr ATC_PerfectHash hash = atc_detail::findPerfectHash(addresses);
+    static_assert(hash.bits != 0, "No perfect hash found, the address list may contain duplicates");
+
+    /** @brief Number of hash slots. */
+    static constexpr size_t table_size = size_t(1) << hash.bits;
+
+    /** @brief Maps hash slots to registry slots. */
+    static constexpr atc_detail::SlotTable<table_size> table = atc_detail::buildSlotTable<table_size>(addresses, hash);
+
+    /** @brief Constructor for the ATC_StaticRegistry class. No thermometer is attached. */
+    ATC_StaticRegistry() : ATC_DeviceRegistry(storage), storage() {}
+
+    /**
+     * @brief Finds the slot of an address. Can be evaluated at compile time.
+     * @param address The packed MAC address.
+     * @return The slot, or -1 if the address is not registered.
+     */
+    static constexpr long find(uint64_t address) {
+        uint8_t slot = table.index[atc_detail::hashSlot(address, hash.multiplier, hash.bits)];
+        return slot != 0xFF && addresses[slot] == address ? static_cast<long>(slot) : -1;
+    }
+
+    /**
+     * @brief Finds the slot of an address.
+     * @param address The packed MAC address.
+     * @return The slot, or -1 if the address is not registered.
+     */
+    long slotOf(uint64_t address) const override {
+        return find(address);
+    }
+
+    /**
+     * @brief Gets the number of slots.
+     * @return The number of registered addresses.
+     */
+    size_t size() const override {
+        return count;
+    }
+
+private:
+    ATC_MiThermometer *storage[count]; /**< Thermometers attached to the slots. */
+};
+
+template<uint64_t... Addresses>
+constexpr uint64_t ATC_StaticRegistry<Addresses...>::addresses[];
+
+template<uint64_t... Addresses>
+constexpr ATC_PerfectHash ATC_StaticRegistry<Addresses...>::hash;
+
+template<uint64_t... Addresses>
+constexpr atc_detail::SlotTable<ATC_StaticRegistry<Addresses...>::table_size> ATC_StaticRegistry<Addresses...>::table;
+
+#endif // __cplusplus >= 201402L
+
+#endif // ATC_STATIC_REGISTRY_H
@@ -0,0 +1,367 @@
+/**
+ * @file ATC_ZoneAggregator.cpp
+ * @brief This file contains the implementation of the ATC_ZoneAggregator class.
+ */
+#include "ATC_ZoneAggregator.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr size_t ATC_ZoneAggregator::no_zone;
+
+/**
+ * @brief Constructor for the ATC_ZoneAggregator class.
+ * @param staleMs The time in milliseconds without a reading after which a device leaves the aggregates.
+ * @param zoneCapacity The number of zones to reserve space for.
+ * @param deviceCapacity The number of devices to reserve space for.
+ */
+ATC_ZoneAggregator::ATC_ZoneAggregator(uint32_t staleMs, size_t zoneCapacity, size_t deviceCapacity)
+        : stale_ms(staleMs), oldest(no_device), newest(no_device) {
+    zones.reserve(zoneCapacity);
+    devices.reserve(deviceCapacity);
+    sorted_addresses.reserve(deviceCapacity);
+    sorted_indexes.reserve(deviceCapacity);
+}
+
+/**
+ * @brief Adds a zone.
+ * @param name The name of the zone, copied.
+ * @param parent The zone containing this one, or no_zone.
+ * @return The index of the zone, or no_zone if the parent does not exist.
+ */
+size_t ATC_ZoneAggregator::addZone(const char *name, size_t parent) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (parent != no_zone && parent >= zones.size()) {
+        return no_zone;
+    }
+    Zone zone{};
+    zone.name = name ? name : "";
+    zone.parent = parent;
+    zones.push_back(zone);
+    return zones.size() - 1;
+}
+
+/**
+ * @brief Finds a zone by name.
+ * @param name The name of the zone.
+ * @return The index of the zone, or no_zone if not found.
+ */
+size_t ATC_ZoneAggregator::findZone(const char *name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t zone = 0; zone < zones.size(); zone++) {
+        if (name && zones[zone].name == name) {
+            return zone;
+        }
+    }
+    return no_zone;
+}
+
+/**
+ * @brief Gets the name of a zone.
+ * @param zone The index of the zone.
+ * @return The name, or nullptr if the zone does not exist.
+ */
+const char *ATC_ZoneAggregator::getZoneName(size_t zone) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return zone < zones.size() ? zones[zone].name.c_str() : nullptr;
+}
+
+/**
+ * @brief Gets the number of zones.
+ * @return The number of zones.
+ */
+size_t ATC_ZoneAggregator::getZoneCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return zones.size();
+}
+
+/**
+ * @brief Assigns a device to a zone. A fresh device moving to another zone takes its values along.
+ * @param address The packed MAC address.
+ * @param zone The index of the zone.
+ * @return True if the zone exists.
+ */
+bool ATC_ZoneAggregator::assign(uint64_t address, size_t zone) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (zone >= zones.size()) {
+        return false;
+    }
+    uint32_t index = findDevice(address);
+    if (index == no_device) {
+        Device device{};
+        device.address = address;
+        device.zone = zone;
+        device.older = no_device;
+        device.newer = no_device;
+        index = static_cast<uint32_t>(devices.size());
+        devices.push_back(device);
+        size_t position = std::lower_bound(sorted_addresses.begin(), sorted_addresses.end(), address) -
+                          sorted_addresses.begin();
+        sorted_addresses.insert(sorted_addresses.begin() + static_cast<long>(position), address);
+        sorted_indexes.insert(sorted_indexes.begin() + static_cast<long>(position), index);
+        return true;
+    }
+    Device &device = devices[index];
+    if (device.zone == zone) {
+        return true;
+    }
+    // Leave every aggregate of the old zone before joining the new one
+    uint8_t moved = device.included;
+    for (size_t field = 0; field < field_count; field++) {
+        if (moved & (1 << field)) {
+            exclude(device, field);
+        }
+    }
+    device.zone = zone;
+    for (size_t field = 0; field < field_count; field++) {
+        if (moved & (1 << field)) {
+            include(device, field, device.values[field]);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Updates the aggregates with the reading of a device, and makes the device the newest fresh one.
+ * @param address The packed MAC address.
+ * @param reading The reading.
+ * @param nowMs The current millis() timestamp.
+ */
+void ATC_ZoneAggregator::update(uint64_t address, const ATC_MiThermometer_Reading &reading, uint32_t nowMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t index = findDevice(address);
+    if (index == no_device) {
+        return;
+    }
+    Device &device = devices[index];
+    const uint8_t flags[field_count] = {READING_TEMPERATURE, READING_HUMIDITY};
+    const int32_t values[field_count] = {reading.temperature, reading.humidity};
+    for (size_t field = 0; field < field_count; field++) {
+        if (!(reading.fields & flags[field]) || (reading.anomalies & flags[field])) {
+            continue;
+        }
+        bool included = device.included & (1 << field);
+        if (included && device.values[field] == values[field]) {
+            continue;
+        }
+        if (included) {
+            exclude(device, field);
+        }
+        include(device, field, values[field]);
+    }
+    if (device.fresh) {
+        unlink(index);
+    }
+    device.last_seen = nowMs;
+    linkNewest(index);
+}
+
+/**
+ * @brief Removes the devices without a reading for the stale time from the aggregates, oldest first, stopping at
+ * the first fresh device.
+ * @param nowMs The current millis() timestamp.
+ * @return The number of devices that became stale.
+ */
+size_t ATC_ZoneAggregator::expire(uint32_t nowMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t expired = 0;
+    while (oldest != no_device && nowMs - devices[oldest].last_seen >= stale_ms) {
+        uint32_t index = oldest;
+        Device &device = devices[index];
+        for (size_t field = 0; field < field_count; field++) {
+            if (device.included & (1 << field)) {
+                exclude(device, field);
+            }
+        }
+        unlink(index);
+        expired++;
+    }
+    return expired;
+}
+
+/**
+ * @brief Gets the temperature aggregate of a zone.
+ * @param zone The index of the zone.
+ * @return The aggregate in 0.01 degrees Celsius.
+ */
+ATC_ZoneStats ATC_ZoneAggregator::temperatureStats(size_t zone) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats(zone, 0);
+}
+
+/**
+ * @brief Gets the humidity aggregate of a zone.
+ * @param zone The index of the zone.
+ * @return The aggregate in 0.01 percent.
+ */
+ATC_ZoneStats ATC_ZoneAggregator::humidityStats(size_t zone) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats(zone, 1);
+}
+
+/**
+ * @brief Finds a device with a binary search over the sorted addresses.
+ * @param address The packed MAC address.
+ * @return The index of the device, or no_device if not found.
+ */
+uint32_t ATC_ZoneAggregator::findDevice(uint64_t address) const {
+    auto it = std::lower_bound(sorted_addresses.begin(), sorted_addresses.end(), address);
+    if (it == sorted_addresses.end() || *it != address) {
+        return no_device;
+    }
+    return sorted_indexes[static_cast<size_t>(it - sorted_addresses.begin())];
+}
+
+/**
+ * @brief Adds the value of a device to the aggregates of its zone and the ancestors of the zone.
+ * @param device The device, whose value must not be included yet.
+ * @param field The index of the field.
+ * @param value The value.
+ */
+void ATC_ZoneAggregator::include(Device &device, size_t field, int32_t value) {
+    device.values[field] = value;
+    device.included |= static_cast<uint8_t>(1 << field);
+    for (size_t zone = device.zone; zone != no_zone; zone = zones[zone].parent) {
+        Aggregate &aggregate = zones[zone].fields[field];
+        if (aggregate.count == 0 || value < aggregate.min) {
+            aggregate.min = value;
+            aggregate.min_count = 1;
+        } else if (value == aggregate.min) {
+            aggregate.min_count++;
+        }
+        if (aggregate.count == 0 || value > aggregate.max) {
+            aggregate.max = value;
+            aggregate.max_count = 1;
+        } else if (value == aggregate.max) {
+            aggregate.max_count++;
+        }
+        aggregate.count++;
+        aggregate.sum += value;
+        aggregate.sum_squares += static_cast<int64_t>(value) * value;
+    }
+}
+
+/**
+ * @brief Subtracts the value of a device from the aggregates of its zone and the ancestors of the zone. A zone
+ * losing the last device at its minimum or maximum is rescanned.
+ * @param device The device, whose value must be included.
+ * @param field The index of the field.
+ */
+void ATC_ZoneAggregator::exclude(Device &device, size_t field) {
+    int32_t value = device.values[field];
+    device.included &= static_cast<uint8_t>(~(1 << field));
+    for (size_t zone = device.zone; zone != no_zone; zone = zones[zone].parent) {
+        Aggregate &aggregate = zones[zone].fields[field];
+        aggregate.count--;
+        aggregate.sum -= value;
+        aggregate.sum_squares -= static_cast<int64_t>(value) * value;
+        bool lostMin = value == aggregate.min && --aggregate.min_count == 0;
+        bool lostMax = value == aggregate.max && --aggregate.max_count == 0;
+        if (aggregate.count > 0 && (lostMin || lostMax)) {
+            rescan(zone, field);
+        }
+    }
+}
+
+/**
+ * @brief Computes the minimum and maximum of a zone again from the included values of its devices.
+ * @param zone The index of the zone.
+ * @param field The index of the field.
+ */
+void ATC_ZoneAggregator::rescan(size_t zone, size_t field) {
+    Aggregate &aggregate = zones[zone].fields[field];
+    aggregate.min_count = 0;
+    aggregate.max_count = 0;
+    for (const Device &device: devices) {
+        if (!(device.included & (1 << field)) || !contains(zone, device.zone)) {
+            continue;
+        }
+        int32_t value = device.values[field];
+        if (aggregate.min_count == 0 || value < aggregate.min) {
+            aggregate.min = value;
+            aggregate.min_count = 1;
+        } else if (value == aggregate.min) {
+            aggregate.min_count++;
+        }
+        if (aggregate.max_count == 0 || value > aggregate.max) {
+            aggregate.max = value;
+            aggregate.max_count = 1;
+        } else if (value == aggregate.max) {
+            aggregate.max_count++;
+        }
+    }
+}
+
+/**
+ * @brief Checks whether a zone is another zone or one of its ancestors.
+ * @param zone The possible ancestor.
+ * @param descendant The zone to check.
+ * @return True if descendant is zone or is contained in it.
+ */
+bool ATC_ZoneAggregator::contains(size_t zone, size_t descendant) const {
+    for (; descendant != no_zone; descendant = zones[descendant].parent) {
+        if (descendant == zone) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Removes a device from the freshness list.
+ * @param index The index of the device.
+ */
+void ATC_ZoneAggregator::unlink(uint32_t index) {
+    Device &device = devices[index];
+    if (device.older != no_device) {
+        devices[device.older].newer = device.newer;
+    } else {
+        oldest = device.newer;
+    }
+    if (device.newer != no_device) {
+        devices[device.newer].older = device.older;
+    } else {
+        newest = device.older;
+    }
+    device.older = no_device;
+    device.newer = no_device;
+    device.fresh = false;
+}
+
+/**
+ * @brief Appends a device to the freshness list as the newest one.
+ * @param index The index of the device.
+ */
+void ATC_ZoneAggregator::linkNewest(uint32_t index) {
+    Device &device = devices[index];
+    device.older = newest;
+    device.newer = no_device;
+    if (newest != no_device) {
+        devices[newest].newer = index;
+    } else {
+        oldest = index;
+    }
+    newest = index;
+    device.fresh = true;
+}
+
+/**
+ * @brief Builds the statistics of a field from the running sums of a zone.
+ * @param zone The index of the zone.
+ * @param field The index of the field.
+ * @return The statistics, all 0 if the zone does not exist or has no fresh device.
+ */
+ATC_ZoneStats ATC_ZoneAggregator::stats(size_t zone, size_t field) const {
+    ATC_ZoneStats result{};
+    if (zone >= zones.size() || zones[zone].fields[field].count == 0) {
+        return result;
+    }
+    const Aggregate &aggregate = zones[zone].fields[field];
+    double mean = static_cast<double>(aggregate.sum) / aggregate.count;
+    double variance = static_cast<double>(aggregate.sum_squares) / aggregate.count - mean * mean;
+    result.count = aggregate.count;
+    result.min = aggregate.min;
+    result.max = aggregate.max;
+    result.mean = static_cast<float>(mean);
+    result.deviation = static_cast<float>(std::sqrt(std::max(variance, 0.0)));
+    return result;
+}
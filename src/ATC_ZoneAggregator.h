@@ -0,0 +1,177 @@
+/**
+ * @file ATC_ZoneAggregator.h
+ * @brief This file contains the declaration of the ATC_ZoneAggregator class, which groups thermometers into zones
+ * such as rooms and floors and keeps the temperature and humidity aggregates of every zone up to date as readings
+ * arrive.
+ * The class only depends on the standard library, so it can also be used on a host aggregating readings.
+ */
+#ifndef ATC_ZONE_AGGREGATOR_H
+#define ATC_ZONE_AGGREGATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ATC_MiThermometer_structs.h"
+
+/**
+ * @class ATC_ZoneAggregator
+ * @brief Keeps the count, sum and sum of squares of the temperature and the humidity of every zone, so that the
+ *        mean and standard deviation are read in constant time. A new reading subtracts the previous value of its
+ *        device from its zone and the ancestors of the zone, and adds the new one. The minimum and maximum are kept
+ *        with the number of devices at them, and are only rescanned when the last device at an extreme leaves it.
+ *        Devices without a reading for the stale time are removed from the aggregates by expire(), which only
+ *        visits the expired devices, and come back with their next reading. The class is thread safe.
+ */
+class ATC_ZoneAggregator {
+public:
+    /** @brief Zone index meaning no zone, the parent of top-level zones. */
+    static constexpr size_t no_zone = SIZE_MAX;
+
+    /**
+     * @brief Constructor for the ATC_ZoneAggregator class.
+     * @param staleMs The time in milliseconds without a reading after which a device leaves the aggregates.
+     * @param zoneCapacity The number of zones to reserve space for.
+     * @param deviceCapacity The number of devices to reserve space for.
+     */
+    explicit ATC_ZoneAggregator(uint32_t staleMs = 600000, size_t zoneCapacity = 0, size_t deviceCapacity = 0);
+
+    /**
+     * @brief Adds a zone.
+     * @param name The name of the zone, copied.
+     * @param parent The zone containing this one, whose aggregates include its devices, or no_zone.
+     * @return The index of the zone, or no_zone if the parent does not exist.
+     */
+    size_t addZone(const char *name, size_t parent = no_zone);
+
+    /**
+     * @brief Finds a zone by name.
+     * @param name The name of the zone.
+     * @return The index of the zone, or no_zone if not found.
+     */
+    size_t findZone(const char *name) const;
+
+    /**
+     * @brief Gets the name of a zone.
+     * @param zone The index of the zone.
+     * @return The name, or nullptr if the zone does not exist.
+     */
+    const char *getZoneName(size_t zone) const;
+
+    /**
+     * @brief Gets the number of zones.
+     * @return The number of zones.
+     */
+    size_t getZoneCount() const;
+
+    /**
+     * @brief Assigns a device to a zone, moving it if it was in another one.
+     * @param address The packed MAC address.
+     * @param zone The index of the zone.
+     * @return True if the zone exists.
+     */
+    bool assign(uint64_t address, size_t zone);
+
+    /**
+     * @brief Updates the aggregates with the reading of a device. Devices not assigned to a zone are ignored, as
+     *        are missing fields and fields flagged as anomalies.
+     * @param address The packed MAC address.
+     * @param reading The reading.
+     * @param nowMs The current millis() timestamp.
+     */
+    void update(uint64_t address, const ATC_MiThermometer_Reading &reading, uint32_t nowMs);
+
+    /**
+     * @brief Removes the devices without a reading for the stale time from the aggregates.
+     * @param nowMs The current millis() timestamp.
+     * @return The number of devices that became stale.
+     */
+    size_t expire(uint32_t nowMs);
+
+    /**
+     * @brief Gets the temperature aggregate of a zone and the zones it contains.
+     * @param zone The index of the zone.
+     * @return The aggregate in 0.01 degrees Celsius.
+     */
+    ATC_ZoneStats temperatureStats(size_t zone) const;
+
+    /**
+     * @brief Gets the humidity aggregate of a zone and the zones it contains.
+     * @param zone The index of the zone.
+     * @return The aggregate in 0.01 percent.
+     */
+    ATC_ZoneStats humidityStats(size_t zone) const;
+
+private:
+    /** @brief Number of aggregated fields: temperature and humidity. */
+    static constexpr size_t field_count = 2;
+    /** @brief Index meaning no device in the lists of devices. */
+    static constexpr uint32_t no_device = UINT32_MAX;
+
+    /**
+     * @struct Aggregate
+     * @brief The running sums of one field over a zone.
+     */
+    struct Aggregate {
+        uint32_t count; /**< Number of devices included. */
+        int64_t sum; /**< Sum of the values. */
+        int64_t sum_squares; /**< Sum of the squared values. */
+        int32_t min; /**< Minimum value. */
+        int32_t max; /**< Maximum value. */
+        uint32_t min_count; /**< Number of devices at the minimum. */
+        uint32_t max_count; /**< Number of devices at the maximum. */
+    };
+
+    /**
+     * @struct Zone
+     * @brief A zone and its aggregates.
+     */
+    struct Zone {
+        std::string name; /**< The name. */
+        size_t parent; /**< The containing zone, or no_zone. */
+        Aggregate fields[field_count]; /**< Aggregates of the temperature and the humidity. */
+    };
+
+    /**
+     * @struct Device
+     * @brief A device, its contribution to the aggregates and its place in the freshness list.
+     */
+    struct Device {
+        uint64_t address; /**< The packed MAC address. */
+        size_t zone; /**< The zone of the device. */
+        int32_t values[field_count]; /**< Values included in the aggregates. */
+        uint8_t included; /**< Bit i set if values[i] is included in the aggregates. */
+        uint32_t last_seen; /**< millis() of the last reading. */
+        uint32_t older; /**< Previous device in the freshness list, seen earlier. */
+        uint32_t newer; /**< Next device in the freshness list, seen later. */
+        bool fresh; /**< Flag indicating whether the device is in the freshness list. */
+    };
+
+    uint32_t findDevice(uint64_t address) const;
+
+    void include(Device &device, size_t field, int32_t value);
+
+    void exclude(Device &device, size_t field);
+
+    void rescan(size_t zone, size_t field);
+
+    bool contains(size_t zone, size_t descendant) const;
+
+    void unlink(uint32_t index);
+
+    void linkNewest(uint32_t index);
+
+    ATC_ZoneStats stats(size_t zone, size_t field) const;
+
+    uint32_t stale_ms; /**< Time without a reading after which a device is stale. */
+    std::vector<Zone> zones; /**< The zones. */
+    std::vector<Device> devices; /**< The devices in assignment order. */
+    std::vector<uint64_t> sorted_addresses; /**< Addresses of the devices in ascending order. */
+    std::vector<uint32_t> sorted_indexes; /**< Device indexes parallel to sorted_addresses. */
+    uint32_t oldest; /**< Fresh device seen the longest time ago, or no_device. */
+    uint32_t newest; /**< Fresh device seen most recently, or no_device. */
+    mutable std::mutex mutex; /**< Mutex protecting the aggregator. */
+};
+
+#endif // ATC_ZONE_AGGREGATOR_H
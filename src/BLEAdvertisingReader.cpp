@@ -4,29 +4,129 @@
  * which scans for BLE advertisements and parses data for registered ATC_MiThermometer instances.
  */
 #include "BLEAdvertisingReader.h"
+#include "ATC_AdvertisingDecoder.h"
 #include <Arduino.h>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 
 /**
  * @brief Constructor for the BLEAdvertisingReader class. Initializes the BLE scan object and sets the callback function.
  * Sets the scan to active mode with a specific interval and window.
  */
-BLEAdvertisingReader::BLEAdvertisingReader() {
+BLEAdvertisingReader::BLEAdvertisingReader()
+        : thermometers(&thermometerTables[0]), thermometerReaders(0), compactUpdating(false), fleetStore(nullptr),
+          zoneAggregator(nullptr), ruleEngine(nullptr), registry(nullptr), workerQueue(nullptr), workerQueueLength(0),
+          workerHandle(nullptr),
+          workerDone(nullptr), workerRunning(false), advertisementsReceived(0), advertisementsProcessed(0),
+          advertisementsDropped(0), queueHighWatermark(0), eventHandler(nullptr), eventBatchSize(0),
+          eventMaxDelayMs(0), eventBatchStart(0), initNext(0), initStart(0), initBudgetMs(0), initDone(nullptr) {
     pBLEScan = NimBLEDevice::getScan();
     pBLEScan->setAdvertisedDeviceCallbacks(new AdvertisedDeviceCallbacks(*this));
     pBLEScan->setActiveScan(true); // Active scan uses more power, but get more information.
     pBLEScan->setInterval(100); // Scan interval in milliseconds
     pBLEScan->setWindow(99); // Scan window in milliseconds. Less or equal than interval
+#if ATC_STATIC_ALLOCATION
+    pBLEScan->setMaxResults(0); // Do not keep scan results, they are handled in the callback.
+#endif
 }
 
 /**
  * @brief Starts a BLE scan for a specified duration. Clears previous scan results before starting.
+ * After the scan, initializes lazy thermometers that advertised, then downloads the missing history of thermometers
+ * with a pending backfill.
  * @param durationSeconds The duration of the scan in seconds.
  */
 void BLEAdvertisingReader::readAdvertising(uint16_t durationSeconds) {
     pBLEScan->start(durationSeconds, false); // The second parameter is for duplicate filtering.
     pBLEScan->clearResults(); // Clear any previous scan results.
+    if (!isWorkerRunning()) {
+        flushEvents();
+    }
+    initPendingThermometers();
+    backfillPendingThermometers();
+}
+
+/**
+ * @brief Compares thermometer table entries by address.
+ * @param a The first entry.
+ * @param b The second entry.
+ * @return True if the address of a is lower than the address of b.
+ */
+static bool entryAddressLess(const ATC_ThermometerEntry &a, const ATC_ThermometerEntry &b) {
+    return a.address < b.address;
+}
+
+/**
+ * @brief Compares a compact thermometer with a packed address.
+ * @param thermometer The compact thermometer.
+ * @param address The packed MAC address.
+ * @return True if the address of the thermometer is lower than address.
+ */
+static bool compactAddressLess(const ATC_CompactThermometer &thermometer, uint64_t address) {
+    return atcPackNativeAddress(thermometer.address) < address;
+}
+
+/**
+ * @brief Gets the spare thermometer table, filled with a copy of the published one.
+ * Copy-on-write: the published table is never modified, so the scan can read it without locking.
+ * @return The spare table.
+ */
+ATC_ThermometerList &BLEAdvertisingReader::copyThermometers() {
+    const ATC_ThermometerList *published = thermometers.load();
+    ATC_ThermometerList &spare = thermometerTables[published == &thermometerTables[0] ? 1 : 0];
+    spare = *published;
+    return spare;
+}
+
+/**
+ * @brief Publishes a thermometer table. Once the readers of the previous table are done, it becomes the spare one.
+ * Only the writer waits, the scan never blocks on table changes.
+ * @param table The table to publish.
+ */
+void BLEAdvertisingReader::publishThermometers(ATC_ThermometerList &table) {
+    thermometers.store(&table);
+    waitForReaders();
+}
+
+/**
+ * @brief Waits until no dispatch holds a reference taken before the last change. A dispatch increments the reader
+ * count before loading the tables and the attached objects, so once the count drops to zero, no dispatch can still
+ * use what was replaced.
+ */
+void BLEAdvertisingReader::waitForReaders() {
+    while (thermometerReaders.load() != 0) {
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief Finds a thermometer in a table sorted by address with a binary search.
+ * @param table The table.
+ * @param address The packed MAC address.
+ * @return The thermometer, or nullptr if not found.
+ */
+ATC_MiThermometer *BLEAdvertisingReader::findThermometer(const ATC_ThermometerList &table, uint64_t address) {
+    ATC_ThermometerEntry key{address, nullptr};
+    auto it = std::lower_bound(table.begin(), table.end(), key, entryAddressLess);
+    return it != table.end() && it->address == address ? it->thermometer : nullptr;
+}
+
+/**
+ * @brief Finds a registered thermometer in the registry or the thermometer table. The caller must hold
+ * thermometerWriteMutex, so that the table is not replaced during the lookup.
+ * @param address The packed MAC address.
+ * @return The thermometer, or nullptr if it is not registered.
+ */
+ATC_MiThermometer *BLEAdvertisingReader::findRegisteredThermometer(uint64_t address) const {
+    ATC_DeviceRegistry *currentRegistry = registry.load();
+    if (currentRegistry) {
+        long slot = currentRegistry->slotOf(address);
+        if (slot >= 0 && currentRegistry->thermometer(static_cast<size_t>(slot))) {
+            return currentRegistry->thermometer(static_cast<size_t>(slot));
+        }
+    }
+    return findThermometer(*thermometers.load(), address);
 }
 
 /**
@@ -35,20 +135,74 @@ void BLEAdvertisingReader::readAdvertising(uint16_t durationSeconds) {
  * @param thermometer A pointer to the ATC_MiThermometer instance to add.
  */
 void BLEAdvertisingReader::addThermometer(ATC_MiThermometer *thermometer) {
-    if (std::find(thermometers.begin(), thermometers.end(), thermometer) == thermometers.end()) {
-        thermometers.push_back(thermometer);
+    addThermometers(&thermometer, 1);
+}
+
+/**
+ * @brief Adds several thermometers to a copy of the table, sorts it once and publishes it.
+ * Avoids adding duplicates.
+ * @param newThermometers The thermometers to add.
+ * @param count The number of thermometers.
+ * @return The number of thermometers added.
+ */
+size_t BLEAdvertisingReader::addThermometers(ATC_MiThermometer *const *newThermometers, size_t count) {
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    const ATC_ThermometerList *published = thermometers.load();
+    ATC_ThermometerList *table = nullptr;
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        ATC_MiThermometer *thermometer = newThermometers[i];
+        if (!thermometer) {
+            continue;
+        }
+        uint64_t address = atcPackNativeAddress(thermometer->getNativeAddress());
+        if (findThermometer(*published, address)) {
+            continue;
+        }
+        if (!table) {
+            table = &copyThermometers();
+        }
+        bool duplicate = false;
+        for (size_t j = published->size(); j < table->size(); j++) {
+            duplicate = duplicate || (*table)[j].address == address;
+        }
+        if (duplicate) {
+            continue;
+        }
+#if ATC_STATIC_ALLOCATION
+        if (table->full()) {
+            Serial.println("Too many thermometers, increase ATC_MAX_DEVICES");
+            break;
+        }
+#endif
+        table->push_back(ATC_ThermometerEntry{address, thermometer});
+        added++;
+    }
+    if (added) {
+        std::sort(table->begin(), table->end(), entryAddressLess);
+        publishThermometers(*table);
     }
+    return added;
 }
 
 /**
- * @brief Removes a thermometer from the list of thermometers to monitor.
+ * @brief Removes a thermometer from a copy of the table and publishes it.
  * @param thermometer  A pointer to the ATC_MiThermometer instance to remove.
  */
 void BLEAdvertisingReader::removeThermometer(ATC_MiThermometer *thermometer) {
-    auto it = std::remove(thermometers.begin(), thermometers.end(), thermometer);
-    if (it != thermometers.end()) {
-        thermometers.erase(it, thermometers.end());
+    // A running init or backfill may still use the thermometer from its snapshot
+    std::lock_guard<std::mutex> initLock(initMutex);
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    const ATC_ThermometerList *published = thermometers.load();
+    auto found = std::find_if(published->begin(), published->end(), [thermometer](const ATC_ThermometerEntry &entry) {
+        return entry.thermometer == thermometer;
+    });
+    if (found == published->end()) {
+        return;
     }
+    ATC_ThermometerList &table = copyThermometers();
+    table.erase(table.begin() + (found - published->begin()));
+    publishThermometers(table);
 }
 
 /**
@@ -67,14 +221,779 @@ void BLEAdvertisingReader::operator-(ATC_MiThermometer *thermometer) {
     removeThermometer(thermometer);
 }
 
+/**
+ * @brief Initializes every thermometer whose settings were not read yet, one after another, from a snapshot of the
+ * registered thermometers.
+ */
 void BLEAdvertisingReader::initAllThermometers() {
-    for (ATC_MiThermometer *thermometer: thermometers) {
-        if (thermometer->getReadSettings())
+    std::lock_guard<std::mutex> initLock(initMutex);
+    ATC_InitTargetList targets;
+    collectThermometers(targets, [](ATC_MiThermometer *thermometer) {
+        return !thermometer->getReadSettings();
+    });
+    for (ATC_MiThermometer *thermometer: targets) {
+        thermometer->init();
+    }
+}
+
+/**
+ * @brief Initializes the thermometers from up to config.max_concurrent tasks. Each task takes the next thermometer
+ * in RSSI order until none is left. Runs the init in the calling task if no task can be created.
+ * @param config The concurrency, time budget and task settings.
+ * @return The number of thermometers initialized.
+ */
+size_t BLEAdvertisingReader::initAllThermometers(const ATC_InitConfig &config) {
+    std::lock_guard<std::mutex> initLock(initMutex);
+    initTimeline.clear();
+    collectThermometers(initTargets, [](ATC_MiThermometer *thermometer) {
+        return !thermometer->getReadSettings();
+    });
+    // Strongest signal first, thermometers never heard last
+    std::sort(initTargets.begin(), initTargets.end(), [](ATC_MiThermometer *a, ATC_MiThermometer *b) {
+        int rssiA = a->getLastRssi() ? a->getLastRssi() : INT8_MIN;
+        int rssiB = b->getLastRssi() ? b->getLastRssi() : INT8_MIN;
+        return rssiA > rssiB;
+    });
+    for (ATC_MiThermometer *thermometer: initTargets) {
+        ATC_InitTimelineEntry entry{};
+        entry.address = atcPackNativeAddress(thermometer->getNativeAddress());
+        entry.rssi = thermometer->getLastRssi();
+        entry.result = Init_result::PENDING;
+        initTimeline.push_back(entry);
+    }
+    if (initTargets.empty()) {
+        return 0;
+    }
+    initStart = millis();
+    initBudgetMs = config.time_budget_ms;
+    initNext = 0;
+    size_t taskCount = std::min<size_t>(config.max_concurrent ? config.max_concurrent : 1, gatt_state_pool_size);
+    taskCount = std::min(taskCount, initTargets.size());
+    if (!initDone) {
+        initDone = xSemaphoreCreateCounting(gatt_state_pool_size, 0);
+    }
+    size_t started = 0;
+    BaseType_t core = config.core < 0 ? tskNO_AFFINITY : static_cast<BaseType_t>(config.core);
+    while (initDone && started < taskCount) {
+        if (xTaskCreatePinnedToCore(initTask, "ATC_Init", config.stack_size, this, config.priority, nullptr,
+                                    core) != pdPASS) {
+            Serial.println("Failed to create init task");
+            break;
+        }
+        started++;
+    }
+    if (!started) {
+        runInitJobs();
+    }
+    for (size_t i = 0; i < started; i++) {
+        xSemaphoreTake(initDone, portMAX_DELAY);
+    }
+    size_t initialized = 0;
+    for (const ATC_InitTimelineEntry &entry: initTimeline) {
+        if (entry.result == Init_result::DONE) {
+            initialized++;
+        }
+    }
+    return initialized;
+}
+
+/**
+ * @brief Gets the timeline of the last parallel init, in start order.
+ * @return The timeline entries.
+ */
+const ATC_InitTimeline &BLEAdvertisingReader::getInitTimeline() const {
+    return initTimeline;
+}
+
+/**
+ * @brief Lists the thermometers whose battery is forecast to reach its cutoff voltage within a horizon. Thermometers
+ * without a forecast yet are left out.
+ * @param withinDays The horizon in days.
+ * @return The thermometers, soonest first.
+ */
+const ATC_BatteryReplacementList &BLEAdvertisingReader::getBatteryReplacements(float withinDays) {
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    batteryReplacements.clear();
+    auto addReplacement = [this, withinDays](ATC_MiThermometer *thermometer) {
+        if (!thermometer) {
+            return;
+        }
+        float daysLeft = thermometer->getBatteryDaysLeft();
+        if (!(daysLeft <= withinDays)) {
+            return;
+        }
+#if ATC_STATIC_ALLOCATION
+        if (batteryReplacements.full()) {
+            return;
+        }
+#endif
+        ATC_BatteryReplacement replacement{};
+        replacement.address = atcPackNativeAddress(thermometer->getNativeAddress());
+        replacement.days_left = daysLeft;
+        replacement.battery_mv = thermometer->getBatteryVoltage();
+        batteryReplacements.push_back(replacement);
+    };
+    for (const ATC_ThermometerEntry &entry: *thermometers.load()) {
+        addReplacement(entry.thermometer);
+    }
+    ATC_DeviceRegistry *currentRegistry = registry.load();
+    if (currentRegistry) {
+        for (size_t slot = 0; slot < currentRegistry->size(); slot++) {
+            addReplacement(currentRegistry->thermometer(slot));
+        }
+    }
+    std::sort(batteryReplacements.begin(), batteryReplacements.end(),
+              [](const ATC_BatteryReplacement &a, const ATC_BatteryReplacement &b) {
+                  return a.days_left < b.days_left;
+              });
+    return batteryReplacements;
+}
+
+/**
+ * @brief Imports a set of calibration curves from a text file, one curve per line. Lines longer than
+ * calibration_line_length are reported and skipped.
+ * @param fs The filesystem holding the file.
+ * @param path The path of the file.
+ * @return The number of curves applied to registered thermometers.
+ */
+size_t BLEAdvertisingReader::importCalibrations(fs::FS &fs, const char *path) {
+    fs::File file = fs.open(path, "r");
+    if (!file) {
+        Serial.printf("Failed to open calibration file %s\n", path);
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    size_t applied = 0;
+    char line[calibration_line_length];
+    size_t length = 0;
+    bool overflow = false;
+    for (int c = file.read();; c = file.read()) {
+        if (c >= 0 && c != '\n') {
+            if (length + 1 < sizeof(line)) {
+                line[length++] = static_cast<char>(c);
+            } else {
+                overflow = true;
+            }
             continue;
+        }
+        line[length] = '\0';
+        size_t start = strspn(line, " \t\r");
+        if (overflow) {
+            Serial.println("Calibration line too long");
+        } else if (line[start] != '\0' && line[start] != '#') {
+            uint64_t address = 0;
+            Reading_Field field = READING_TEMPERATURE;
+            ATC_CalibrationCurve curve;
+            const char *error = atcParseCalibration(line + start, address, field, curve);
+            ATC_MiThermometer *thermometer = error ? nullptr : findRegisteredThermometer(address);
+            if (error) {
+                Serial.println(error);
+            } else if (!thermometer) {
+                Serial.printf("No thermometer registered for calibration %s\n", line + start);
+            } else if (thermometer->setCalibration(field, curve)) {
+                applied++;
+            }
+        }
+        length = 0;
+        overflow = false;
+        if (c < 0) {
+            break;
+        }
+    }
+    file.close();
+    return applied;
+}
+
+/**
+ * @brief Exports the calibration curves of the registered thermometers to a text file.
+ * @param fs The filesystem receiving the file.
+ * @param path The path of the file.
+ * @return The number of curves written.
+ */
+size_t BLEAdvertisingReader::exportCalibrations(fs::FS &fs, const char *path) {
+    fs::File file = fs.open(path, "w");
+    if (!file) {
+        Serial.printf("Failed to create calibration file %s\n", path);
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    size_t written = 0;
+    char line[calibration_line_length];
+    auto writeCurves = [&](ATC_MiThermometer *thermometer) {
+        if (!thermometer) {
+            return;
+        }
+        uint64_t address = atcPackNativeAddress(thermometer->getNativeAddress());
+        for (Reading_Field field: {READING_TEMPERATURE, READING_HUMIDITY}) {
+            if (atcFormatCalibration(line, sizeof(line), address, field, thermometer->getCalibration(field))) {
+                file.print(line);
+                file.print("\n");
+                written++;
+            }
+        }
+    };
+    for (const ATC_ThermometerEntry &entry: *thermometers.load()) {
+        writeCurves(entry.thermometer);
+    }
+    ATC_DeviceRegistry *currentRegistry = registry.load();
+    if (currentRegistry) {
+        for (size_t slot = 0; slot < currentRegistry->size(); slot++) {
+            writeCurves(currentRegistry->thermometer(slot));
+        }
+    }
+    file.close();
+    return written;
+}
+
+/**
+ * @brief Initializes thermometers of the parallel init until none is left. Each index is claimed by exactly one
+ * task, so the timeline entries are written without locking.
+ */
+void BLEAdvertisingReader::runInitJobs() {
+    for (size_t i = initNext++; i < initTargets.size(); i = initNext++) {
+        ATC_InitTimelineEntry &entry = initTimeline[i];
+        uint32_t elapsed = millis() - initStart;
+        entry.start_ms = elapsed;
+        if (elapsed >= initBudgetMs) {
+            entry.end_ms = elapsed;
+            entry.result = Init_result::SKIPPED;
+            continue;
+        }
+        bool done = initTargets[i]->init(initBudgetMs - elapsed);
+        entry.end_ms = millis() - initStart;
+        if (done) {
+            entry.result = Init_result::DONE;
+        } else {
+            entry.result = entry.end_ms >= initBudgetMs ? Init_result::TIMED_OUT : Init_result::FAILED;
+        }
+    }
+}
+
+/**
+ * @brief Body of an init task. Signals the caller of initAllThermometers() when no thermometer is left.
+ * @param parameter Pointer to the BLEAdvertisingReader.
+ */
+void BLEAdvertisingReader::initTask(void *parameter) {
+    BLEAdvertisingReader *reader = static_cast<BLEAdvertisingReader *>(parameter);
+    reader->runInitJobs();
+    xSemaphoreGive(reader->initDone);
+    vTaskDelete(nullptr);
+}
+
+/**
+ * @brief Initializes every lazy thermometer with a pending initialization, one after another, from a snapshot of the
+ * registered thermometers.
+ */
+void BLEAdvertisingReader::initPendingThermometers() {
+    std::lock_guard<std::mutex> initLock(initMutex);
+    ATC_InitTargetList targets;
+    collectThermometers(targets, [](ATC_MiThermometer *thermometer) {
+        return thermometer->isInitPending();
+    });
+    for (ATC_MiThermometer *thermometer: targets) {
         thermometer->init();
     }
 }
 
+/**
+ * @brief Downloads the missing history of every thermometer with a pending backfill, one after another, from a
+ * snapshot of the registered thermometers.
+ * @param maxRecords The maximum number of records to download per thermometer.
+ */
+void BLEAdvertisingReader::backfillPendingThermometers(uint16_t maxRecords) {
+    std::lock_guard<std::mutex> initLock(initMutex);
+    ATC_InitTargetList targets;
+    collectThermometers(targets, [](ATC_MiThermometer *thermometer) {
+        return thermometer->isBackfillPending();
+    });
+    for (ATC_MiThermometer *thermometer: targets) {
+        thermometer->backfillHistory(maxRecords);
+    }
+}
+
+/**
+ * @brief Collects the thermometers of the table and of the device registry matching a condition. Only holds
+ * thermometerWriteMutex while collecting, so that the blocking operations run on the snapshot do not hold up changes
+ * to the tables.
+ * @param targets Cleared, then filled with the matching thermometers.
+ * @param select The condition.
+ */
+void BLEAdvertisingReader::collectThermometers(ATC_InitTargetList &targets, bool (*select)(ATC_MiThermometer *)) {
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    targets.clear();
+    auto addTarget = [&targets, select](ATC_MiThermometer *thermometer) {
+        if (!thermometer || !select(thermometer)) {
+            return;
+        }
+#if ATC_STATIC_ALLOCATION
+        if (targets.full()) {
+            Serial.println("Too many thermometers to initialize, increase ATC_MAX_DEVICES");
+            return;
+        }
+#endif
+        targets.push_back(thermometer);
+    };
+    for (const ATC_ThermometerEntry &entry: *thermometers.load()) {
+        addTarget(entry.thermometer);
+    }
+    ATC_DeviceRegistry *currentRegistry = registry.load();
+    if (currentRegistry) {
+        for (size_t slot = 0; slot < currentRegistry->size(); slot++) {
+            addTarget(currentRegistry->thermometer(slot));
+        }
+    }
+}
+
+/**
+ * @brief Adds an advertising-only thermometer stored in compact form, keeping the list sorted by address. Avoids
+ * adding duplicates.
+ * @param address The MAC address of the thermometer.
+ * @param format The advertising format of the thermometer.
+ * @param key The 16 byte advertising bind key, or nullptr if the advertising is not encrypted.
+ * @return True if the thermometer was added, false if it was already present.
+ */
+bool BLEAdvertisingReader::addCompactThermometer(const char *address, Advertising_Type format, const uint8_t *key) {
+    NimBLEAddress bleAddress{std::string(address)};
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    if (findCompactThermometer(bleAddress.getNative())) {
+        return false;
+    }
+    ATC_CompactThermometer thermometer{};
+    memcpy(thermometer.address, bleAddress.getNative(), sizeof(thermometer.address));
+    thermometer.format = static_cast<uint8_t>(format);
+    if (key) {
+        memcpy(thermometer.key, key, sizeof(thermometer.key));
+    }
+#if ATC_STATIC_ALLOCATION
+    if (compactThermometers.full()) {
+        Serial.println("Too many compact thermometers, increase ATC_MAX_COMPACT_DEVICES");
+        return false;
+    }
+#endif
+    uint64_t packed = atcPackNativeAddress(thermometer.address);
+    auto position = std::lower_bound(compactThermometers.begin(), compactThermometers.end(), packed,
+                                     compactAddressLess);
+    size_t index = static_cast<size_t>(position - compactThermometers.begin());
+    beginCompactUpdate();
+    // Keep the list sorted by address: append, then rotate the new entry into place
+    compactThermometers.push_back(thermometer);
+    std::rotate(compactThermometers.begin() + index, compactThermometers.end() - 1, compactThermometers.end());
+    compactUpdating = false;
+    return true;
+}
+
+/**
+ * @brief Removes an advertising-only thermometer.
+ * @param address The MAC address of the thermometer.
+ * @return True if the thermometer was removed, false if it was not found.
+ */
+bool BLEAdvertisingReader::removeCompactThermometer(const char *address) {
+    NimBLEAddress bleAddress{std::string(address)};
+    std::lock_guard<std::mutex> lock(thermometerWriteMutex);
+    ATC_CompactThermometer *thermometer = findCompactThermometer(bleAddress.getNative());
+    if (!thermometer) {
+        return false;
+    }
+    beginCompactUpdate();
+    compactThermometers.erase(compactThermometers.begin() + (thermometer - compactThermometers.data()));
+    compactUpdating = false;
+    return true;
+}
+
+/**
+ * @brief Gets the advertising-only thermometers with their latest raw readings.
+ * @return The compact thermometers, sorted by address.
+ */
+const ATC_CompactThermometerList &BLEAdvertisingReader::getCompactThermometers() const {
+    return compactThermometers;
+}
+
+/**
+ * @brief Stops the dispatches from using the compact list, and waits until those already using it are done. The list
+ * can then be changed in place, the advertisements of compact thermometers received meanwhile are skipped. The
+ * caller must hold thermometerWriteMutex and clear compactUpdating afterwards.
+ */
+void BLEAdvertisingReader::beginCompactUpdate() {
+    compactUpdating = true;
+    waitForReaders();
+}
+
+/**
+ * @brief Sets a fleet store updated with every reading of the compact thermometers.
+ * Waits until no dispatch uses the previous one.
+ * @param store Pointer to the fleet store, or nullptr to stop updating it.
+ */
+void BLEAdvertisingReader::setFleetStore(ATC_FleetStore *store) {
+    fleetStore.store(store);
+    waitForReaders();
+}
+
+/**
+ * @brief Sets a zone aggregator updated with every reading.
+ * Waits until no dispatch uses the previous one.
+ * @param aggregator Pointer to the zone aggregator, or nullptr to stop updating it.
+ */
+void BLEAdvertisingReader::setZoneAggregator(ATC_ZoneAggregator *aggregator) {
+    zoneAggregator.store(aggregator);
+    waitForReaders();
+}
+
+/**
+ * @brief Sets a rule engine evaluated with every reading.
+ * Waits until no dispatch uses the previous one.
+ * @param engine Pointer to the rule engine, or nullptr to stop evaluating it.
+ */
+void BLEAdvertisingReader::setRuleEngine(ATC_RuleEngine *engine) {
+    ruleEngine.store(engine);
+    waitForReaders();
+}
+
+/**
+ * @brief Sets a registry of thermometers looked up by address before the thermometer list.
+ * Waits until no dispatch uses the previous one.
+ * @param newRegistry Pointer to the registry, or nullptr to remove it.
+ */
+void BLEAdvertisingReader::setRegistry(ATC_DeviceRegistry *newRegistry) {
+    registry.store(newRegistry);
+    waitForReaders();
+}
+
+/**
+ * @brief Finds an advertising-only thermometer with a binary search over the list sorted by address.
+ * @param nativeAddress The MAC address in NimBLE native order.
+ * @return Pointer to the thermometer, or nullptr if not found.
+ */
+ATC_CompactThermometer *BLEAdvertisingReader::findCompactThermometer(const uint8_t *nativeAddress) {
+    uint64_t address = atcPackNativeAddress(nativeAddress);
+    auto it = std::lower_bound(compactThermometers.begin(), compactThermometers.end(), address, compactAddressLess);
+    return it != compactThermometers.end() && atcPackNativeAddress(it->address) == address ? &*it : nullptr;
+}
+
+/**
+ * @brief Starts the processing task. Creates the queue on first use, or again if the length changed and the scan is
+ * stopped. While scanning, the current queue is kept.
+ * @param config The core, priority, stack size and queue length of the task.
+ * @return True if the task is running, false if it could not be created.
+ */
+bool BLEAdvertisingReader::startWorker(const ATC_WorkerConfig &config) {
+    if (workerHandle) {
+        return true;
+    }
+    if (workerQueue && workerQueueLength != config.queue_length) {
+        if (pBLEScan->isScanning()) {
+            // The scan callback of a stopped worker may still be writing to the queue
+            Serial.println("Cannot resize the advertisement queue while scanning, keeping the current length");
+        } else {
+            vQueueDelete(workerQueue);
+            workerQueue = nullptr;
+        }
+    }
+    if (!workerQueue) {
+        workerQueue = xQueueCreate(config.queue_length, sizeof(ATC_RawAdvertisement));
+        if (!workerQueue) {
+            Serial.println("Failed to create advertisement queue");
+            return false;
+        }
+        workerQueueLength = config.queue_length;
+    }
+    if (!workerDone) {
+        workerDone = xSemaphoreCreateBinary();
+        if (!workerDone) {
+            Serial.println("Failed to create worker semaphore");
+            return false;
+        }
+    }
+    workerRunning = true;
+    BaseType_t core = config.core < 0 ? tskNO_AFFINITY : static_cast<BaseType_t>(config.core);
+    if (xTaskCreatePinnedToCore(workerTask, "ATC_Worker", config.stack_size, this, config.priority, &workerHandle,
+                                core) != pdPASS) {
+        Serial.println("Failed to create worker task");
+        workerRunning = false;
+        workerHandle = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stops the processing task and waits for it to exit. The queue is emptied but kept, because the scan
+ * callback may still be using it.
+ */
+void BLEAdvertisingReader::stopWorker() {
+    if (!workerHandle) {
+        return;
+    }
+    workerRunning = false;
+    xSemaphoreTake(workerDone, portMAX_DELAY);
+    workerHandle = nullptr;
+    xQueueReset(workerQueue);
+}
+
+/**
+ * @brief Checks whether the processing task is running.
+ * @return True if the task is running, false otherwise.
+ */
+bool BLEAdvertisingReader::isWorkerRunning() const {
+    return workerHandle != nullptr;
+}
+
+/**
+ * @brief Gets the advertisement processing statistics.
+ * @return The statistics since the reader was created or the statistics were reset.
+ */
+ATC_WorkerStats BLEAdvertisingReader::getWorkerStats() const {
+    ATC_WorkerStats stats{};
+    stats.received = advertisementsReceived;
+    stats.processed = advertisementsProcessed;
+    stats.dropped = advertisementsDropped;
+    stats.queue_high_watermark = queueHighWatermark;
+    return stats;
+}
+
+/**
+ * @brief Resets the advertisement processing statistics.
+ */
+void BLEAdvertisingReader::resetWorkerStats() {
+    advertisementsReceived = 0;
+    advertisementsProcessed = 0;
+    advertisementsDropped = 0;
+    queueHighWatermark = 0;
+}
+
+/**
+ * @brief Body of the processing task. Waits for advertisements with a timeout so that a stop request is noticed
+ * and pending events are delivered in time.
+ * @param parameter Pointer to the BLEAdvertisingReader.
+ */
+void BLEAdvertisingReader::workerTask(void *parameter) {
+    BLEAdvertisingReader *reader = static_cast<BLEAdvertisingReader *>(parameter);
+    ATC_RawAdvertisement advertisement;
+    while (reader->workerRunning) {
+        uint32_t waitMs = reader->eventHandler && reader->eventMaxDelayMs < 100 ? reader->eventMaxDelayMs : 100;
+        TickType_t waitTicks = pdMS_TO_TICKS(waitMs);
+        if (xQueueReceive(reader->workerQueue, &advertisement, waitTicks ? waitTicks : 1) == pdTRUE) {
+            reader->dispatchAdvertisement(advertisement.address, advertisement.payload, advertisement.length,
+                                          advertisement.rssi);
+        } else {
+            reader->flushEventsIfDue();
+        }
+    }
+    xSemaphoreGive(reader->workerDone);
+    vTaskDelete(nullptr);
+}
+
+/**
+ * @brief Builds the reading of a compact thermometer.
+ * @param thermometer The compact thermometer.
+ * @return The reading, without time.
+ */
+static ATC_MiThermometer_Reading compactReading(const ATC_CompactThermometer &thermometer) {
+    ATC_MiThermometer_Reading reading{};
+    reading.temperature = thermometer.temperature;
+    reading.humidity = thermometer.humidity;
+    reading.battery_mv = thermometer.battery_mv;
+    reading.battery_level = thermometer.battery_level;
+    reading.fields = thermometer.fields;
+    return reading;
+}
+
+/**
+ * @brief Sets the handler receiving the readings of all thermometers as batches of events.
+ * Reserves both batch buffers so that queueing events does not allocate.
+ * @param handler Pointer to the handler, or nullptr to stop delivering events.
+ * @param batchSize The maximum number of events per batch, at least 1.
+ * @param maxDelayMs The maximum time in milliseconds an event waits for its batch to fill.
+ */
+void BLEAdvertisingReader::setEventHandler(ATC_ReadingEventHandler *handler, size_t batchSize, uint32_t maxDelayMs) {
+    flushEvents();
+    std::lock_guard<std::mutex> lock(eventMutex);
+    eventBatchSize = batchSize ? batchSize : 1;
+    eventMaxDelayMs = maxDelayMs;
+    eventBatch.reserve(eventBatchSize);
+    eventDelivery.reserve(eventBatchSize);
+    eventHandler = handler;
+}
+
+/**
+ * @brief Delivers the pending events right away. The batch is swapped out under the lock and the handler is
+ * called without holding it, so new events can be queued during delivery.
+ */
+void BLEAdvertisingReader::flushEvents() {
+    std::lock_guard<std::mutex> deliveryLock(eventDeliveryMutex);
+    ATC_ReadingEventHandler *handler;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        if (eventBatch.empty()) {
+            return;
+        }
+        eventDelivery.clear();
+        eventDelivery.swap(eventBatch);
+        handler = eventHandler;
+    }
+    if (handler) {
+        handler->onReadingEvents(eventDelivery.data(), eventDelivery.size());
+    }
+}
+
+/**
+ * @brief Delivers the pending events if the oldest one waited for the maximum delay.
+ */
+void BLEAdvertisingReader::flushEventsIfDue() {
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        due = !eventBatch.empty() && millis() - eventBatchStart >= eventMaxDelayMs;
+    }
+    if (due) {
+        flushEvents();
+    }
+}
+
+/**
+ * @brief Adds a reading event to the pending batch and delivers the batch if it is full.
+ * @param nativeAddress The MAC address in NimBLE native order.
+ * @param previous The reading of the device before this advertisement.
+ * @param current The reading of the device after this advertisement.
+ * @param flags Bitmask of Reading_Event_Flag values.
+ */
+void BLEAdvertisingReader::queueEvent(const uint8_t *nativeAddress, const ATC_MiThermometer_Reading &previous,
+                                      const ATC_MiThermometer_Reading &current, uint8_t flags) {
+    ATC_ReadingEvent event{};
+    event.address = atcPackNativeAddress(nativeAddress);
+    event.reading = current;
+    if (!event.reading.time) {
+        event.reading.time = time(nullptr);
+    }
+    event.flags = flags | (previous.fields == 0 ? EVENT_FIRST : 0);
+    uint8_t changed = current.fields & ~previous.fields;
+    if (current.temperature != previous.temperature) {
+        changed |= READING_TEMPERATURE;
+    }
+    if (current.humidity != previous.humidity) {
+        changed |= READING_HUMIDITY;
+    }
+    if (current.battery_mv != previous.battery_mv) {
+        changed |= READING_BATTERY_MV;
+    }
+    if (current.battery_level != previous.battery_level) {
+        changed |= READING_BATTERY_LEVEL;
+    }
+    event.changed = changed & current.fields;
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        if (eventBatch.empty()) {
+            eventBatchStart = millis();
+        }
+        eventBatch.push_back(event);
+        full = eventBatch.size() >= eventBatchSize;
+    }
+    if (full) {
+        flushEvents();
+    }
+}
+
+/**
+ * @brief Passes an advertisement to a thermometer. If a reading was decoded and not entirely dropped by the validation
+ * stage of the thermometer, updates the zone aggregator and the rule engine and queues a reading event.
+ * @param thermometer The thermometer.
+ * @param nativeAddress The MAC address in NimBLE native order.
+ * @param payload The advertising payload.
+ * @param length The length of the payload.
+ * @param rssi The RSSI in dBm.
+ */
+void BLEAdvertisingReader::parseThermometerAdvertisement(ATC_MiThermometer *thermometer, const uint8_t *nativeAddress,
+                                                         const uint8_t *payload, size_t length, int8_t rssi) {
+    if (!eventHandler && !zoneAggregator.load() && !ruleEngine.load()) {
+        thermometer->parseAdvertisingData(payload, length, rssi);
+        return;
+    }
+    ATC_MiThermometer_Reading previous = thermometer->getLastReading();
+    if (thermometer->parseAdvertisingData(payload, length, rssi)) {
+        updateAnalytics(nativeAddress, thermometer->getLastReading());
+        if (eventHandler) {
+            queueEvent(nativeAddress, previous, thermometer->getLastReading(), 0);
+        }
+    }
+}
+
+/**
+ * @brief Expires the stale devices of the zone aggregator and adds a reading to it, then polls the pending alerts of
+ * the rule engine and evaluates the reading. Does nothing if neither is attached.
+ * @param nativeAddress The MAC address in NimBLE native order.
+ * @param reading The latest reading of the device.
+ */
+void BLEAdvertisingReader::updateAnalytics(const uint8_t *nativeAddress, const ATC_MiThermometer_Reading &reading) {
+    ATC_ZoneAggregator *aggregator = zoneAggregator.load();
+    ATC_RuleEngine *engine = ruleEngine.load();
+    if (!aggregator && !engine) {
+        return;
+    }
+    uint32_t now = millis();
+    uint64_t address = atcPackNativeAddress(nativeAddress);
+    if (aggregator) {
+        aggregator->expire(now);
+        aggregator->update(address, reading, now);
+    }
+    if (engine) {
+        engine->poll(now);
+        engine->update(address, reading, now);
+    }
+}
+
+/**
+ * @brief Passes an advertisement to the matching compact thermometer, or to the ATC_MiThermometer instance found in
+ * the registry or the thermometer list.
+ * @param nativeAddress The MAC address in NimBLE native order.
+ * @param payload The advertising payload.
+ * @param length The length of the payload.
+ * @param rssi The RSSI in dBm.
+ */
+void BLEAdvertisingReader::dispatchAdvertisement(const uint8_t *nativeAddress, const uint8_t *payload, size_t length,
+                                                 int8_t rssi) {
+    advertisementsProcessed++;
+    // Hold a reader reference while the tables and the attached objects are in use, so that changes wait for it
+    thermometerReaders++;
+    if (!compactUpdating && !compactThermometers.empty()) {
+        ATC_CompactThermometer *compact = findCompactThermometer(nativeAddress);
+        if (compact) {
+            ATC_MiThermometer_Reading previous = compactReading(*compact);
+            uint8_t decoded = 0;
+            const char *error = atcUpdateCompactThermometer(*compact, payload, length, rssi, millis(), &decoded);
+            // Scan responses and other packets without a measurement are expected, only propagate decoded readings
+            if (decoded) {
+                if (error) {
+                    Serial.println(error);
+                }
+                ATC_FleetStore *store = fleetStore.load();
+                if (store) {
+                    store->update(*compact);
+                }
+                updateAnalytics(nativeAddress, compactReading(*compact));
+                if (eventHandler) {
+                    queueEvent(nativeAddress, previous, compactReading(*compact), EVENT_COMPACT);
+                }
+            }
+            thermometerReaders--;
+            flushEventsIfDue();
+            return;
+        }
+    }
+    ATC_MiThermometer *thermometer = nullptr;
+    ATC_DeviceRegistry *currentRegistry = registry.load();
+    long slot = currentRegistry ? currentRegistry->slotOf(atcPackNativeAddress(nativeAddress)) : -1;
+    if (slot >= 0) {
+        thermometer = currentRegistry->thermometer(static_cast<size_t>(slot));
+    } else {
+        thermometer = findThermometer(*thermometers.load(), atcPackNativeAddress(nativeAddress));
+    }
+    if (thermometer) {
+        parseThermometerAdvertisement(thermometer, nativeAddress, payload, length, rssi);
+    }
+    thermometerReaders--;
+    flushEventsIfDue();
+}
+
 /**
  * @brief Constructor for the AdvertisedDeviceCallbacks class.
  * Stores a reference to the parent BLEAdvertisingReader.
@@ -85,32 +1004,37 @@ BLEAdvertisingReader::AdvertisedDeviceCallbacks::AdvertisedDeviceCallbacks(BLEAd
 
 /**
  * @brief Callback function for when a BLE advertisement is received.  Checks if the device address starts with "A4"
- * (indicating a Xiaomi device) and then calls parseAdvertisingData on the matching ATC_MiThermometer instance.
+ * (indicating a Xiaomi device), then queues the advertisement for the processing task if it is running,
+ * or dispatches it right away.
  * @param advertisedDevice  A pointer to the NimBLEAdvertisedDevice object representing the advertising device.
  */
 void BLEAdvertisingReader::AdvertisedDeviceCallbacks::onResult(NimBLEAdvertisedDevice *advertisedDevice) {
-    std::string deviceAddress = advertisedDevice->getAddress().toString();
-    // Simple filter to reduce processing time. Checks if MAC address starts with "A4" (case-insensitive).
+    NimBLEAddress bleAddress = advertisedDevice->getAddress();
+    const uint8_t *nativeAddress = bleAddress.getNative();
+    // Simple filter to reduce processing time. Checks if the MAC address starts with A4 (stored last in native order).
     // Most Xiaomi devices have MAC addresses starting with "A4:C1:38".
-    if (deviceAddress.size() < 2) {
+    if (nativeAddress[5] != 0xA4) {
         return;
     }
-    if (!(std::tolower(deviceAddress[0]) == 'a' && std::tolower(deviceAddress[1]) == '4')) {
-        return;
-    }
-    for (ATC_MiThermometer *thermometer: parentReader.thermometers) {
-        if (!thermometer)
-            continue;
-        std::string thermometerAddress = thermometer->getAddress();
-        if (deviceAddress.length() != thermometerAddress.length()) {
-            continue;
-        }
-        // Case-insensitive comparison of the addresses
-        if (strcasecmp(deviceAddress.c_str(), thermometerAddress.c_str()) == 0) {
-            const uint8_t *payload = advertisedDevice->getPayload();
-            size_t payloadLength = advertisedDevice->getPayloadLength();
-            thermometer->parseAdvertisingData(payload, payloadLength);
+    parentReader.advertisementsReceived++;
+    const uint8_t *payload = advertisedDevice->getPayload();
+    size_t payloadLength = advertisedDevice->getPayloadLength();
+    int8_t rssi = static_cast<int8_t>(advertisedDevice->getRSSI());
+    if (parentReader.workerRunning) {
+        ATC_RawAdvertisement advertisement;
+        memcpy(advertisement.address, nativeAddress, sizeof(advertisement.address));
+        advertisement.rssi = rssi;
+        advertisement.length = static_cast<uint8_t>(std::min(payloadLength, advertisement_max_length));
+        memcpy(advertisement.payload, payload, advertisement.length);
+        if (xQueueSend(parentReader.workerQueue, &advertisement, 0) != pdTRUE) {
+            parentReader.advertisementsDropped++;
             return;
         }
+        uint32_t waiting = uxQueueMessagesWaiting(parentReader.workerQueue);
+        if (waiting > parentReader.queueHighWatermark) {
+            parentReader.queueHighWatermark = waiting;
+        }
+        return;
     }
-}
\ No newline at end of file
+    parentReader.dispatchAdvertisement(nativeAddress, payload, payloadLength, rssi);
+}
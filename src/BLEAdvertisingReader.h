@@ -8,8 +8,69 @@
 #define BLE_ADVERTISING_READER_H
 
 #include "ATC_MiThermometer.h"
+#include "ATC_FleetStore.h"
+#include "ATC_ZoneAggregator.h"
+#include "ATC_RuleEngine.h"
+#include "ATC_FixedVector.h"
+#include "ATC_StaticRegistry.h"
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include <mutex>
 #include <vector>
 
+/**
+ * @struct ATC_ThermometerEntry
+ * @brief An entry of the thermometer table of a BLEAdvertisingReader.
+ */
+struct ATC_ThermometerEntry {
+    uint64_t address; /**< The packed MAC address, the sort key of the table. */
+    ATC_MiThermometer *thermometer; /**< The thermometer. */
+};
+
+#if ATC_STATIC_ALLOCATION
+/** @brief Table of the registered thermometers sorted by address, fixed capacity in static allocation mode. */
+using ATC_ThermometerList = ATC_FixedVector<ATC_ThermometerEntry, ATC_MAX_DEVICES>;
+/** @brief Container of the compact thermometers, fixed capacity in static allocation mode. */
+using ATC_CompactThermometerList = ATC_FixedVector<ATC_CompactThermometer, ATC_MAX_COMPACT_DEVICES>;
+/** @brief Timeline of a parallel init, fixed capacity in static allocation mode. */
+using ATC_InitTimeline = ATC_FixedVector<ATC_InitTimelineEntry, ATC_MAX_DEVICES>;
+/** @brief Thermometers of a parallel init, fixed capacity in static allocation mode. */
+using ATC_InitTargetList = ATC_FixedVector<ATC_MiThermometer *, ATC_MAX_DEVICES>;
+/** @brief Thermometers whose battery must be replaced soon, fixed capacity in static allocation mode. */
+using ATC_BatteryReplacementList = ATC_FixedVector<ATC_BatteryReplacement, ATC_MAX_DEVICES>;
+#else
+/** @brief Table of the registered thermometers sorted by address. */
+using ATC_ThermometerList = std::vector<ATC_ThermometerEntry>;
+/** @brief Container of the compact thermometers. */
+using ATC_CompactThermometerList = std::vector<ATC_CompactThermometer>;
+/** @brief Timeline of a parallel init. */
+using ATC_InitTimeline = std::vector<ATC_InitTimelineEntry>;
+/** @brief Thermometers of a parallel init. */
+using ATC_InitTargetList = std::vector<ATC_MiThermometer *>;
+/** @brief Thermometers whose battery must be replaced soon. */
+using ATC_BatteryReplacementList = std::vector<ATC_BatteryReplacement>;
+#endif
+
+/**
+ * @class ATC_ReadingEventHandler
+ * @brief Interface for objects receiving batches of reading events from a BLEAdvertisingReader.
+ */
+class ATC_ReadingEventHandler {
+public:
+    virtual ~ATC_ReadingEventHandler() = default;
+
+    /**
+     * @brief Called with a batch of reading events, oldest first.
+     * @param events The events, only valid during the call.
+     * @param count The number of events.
+     */
+    virtual void onReadingEvents(const ATC_ReadingEvent *events, size_t count) = 0;
+};
+
 /**
  * @class BLEAdvertisingReader
  * @brief This class handles scanning for BLE advertisements and parsing the data
@@ -30,13 +91,26 @@ public:
     void readAdvertising(uint16_t durationSeconds);
 
     /**
-     * @brief Adds a MiThermometer to the reader's list for data parsing.
+     * @brief Adds a MiThermometer to the reader's list for data parsing. Can be called while scanning, the scan
+     *        keeps using the previous list until the new one is published. Must not be called from a reading
+     *        callback. In static allocation mode, at most ATC_MAX_DEVICES thermometers can be added.
      * @param thermometer A pointer to the ATC_MiThermometer to add.
      */
     void addThermometer(ATC_MiThermometer *thermometer);
 
     /**
-     * @brief Removes a MiThermometer from the reader's list.
+     * @brief Adds several MiThermometers at once, publishing the list only once. Faster than adding them one by
+     *        one when provisioning many devices while scanning.
+     * @param newThermometers The thermometers to add.
+     * @param count The number of thermometers.
+     * @return The number of thermometers added, excluding those already present or not fitting.
+     */
+    size_t addThermometers(ATC_MiThermometer *const *newThermometers, size_t count);
+
+    /**
+     * @brief Removes a MiThermometer from the reader's list. Can be called while scanning. Waits for a running init
+     *        or backfill, so when it returns neither the scan nor these use the thermometer, and it can be deleted.
+     *        Must not be called from a reading callback.
      * @param thermometer A pointer to the ATC_MiThermometer to remove.
      */
     void removeThermometer(ATC_MiThermometer *thermometer);
@@ -53,11 +127,327 @@ public:
      */
     void operator-(ATC_MiThermometer *thermometer);
 
+    /**
+     * @brief Initializes every thermometer whose settings were not read yet, one after another.
+     */
     void initAllThermometers();
 
+    /**
+     * @brief Initializes every thermometer whose settings were not read yet from several tasks. Thermometers are
+     *        started in order of their latest advertisement RSSI, strongest first, so scan for a few seconds
+     *        beforehand. Connections are established one at a time, and the settings reads overlap. Once the time
+     *        budget is spent, running attempts are cut short and the remaining thermometers are skipped.
+     *        Call while not scanning. In static allocation mode, at most ATC_MAX_DEVICES thermometers are handled.
+     * @param config The concurrency, time budget and task settings. The concurrency is limited to the GATT pool.
+     * @return The number of thermometers initialized.
+     */
+    size_t initAllThermometers(const ATC_InitConfig &config);
+
+    /**
+     * @brief Gets the timeline of the last parallel init, in start order.
+     * @return The timeline entries.
+     */
+    const ATC_InitTimeline &getInitTimeline() const;
+
+    /**
+     * @brief Lists the thermometers whose battery is forecast to reach its cutoff voltage within a horizon, in one
+     *        pass over the thermometers, so that battery swaps can be batched.
+     * @param withinDays The horizon in days.
+     * @return The thermometers, soonest first. Valid until the next call.
+     */
+    const ATC_BatteryReplacementList &getBatteryReplacements(float withinDays);
+
+    /**
+     * @brief Imports a set of calibration curves from a text file in the format of atcParseCalibration(), one curve
+     *        per line. Empty lines and lines starting with '#' are skipped, invalid lines and unknown addresses are
+     *        reported and skipped.
+     * @param fs The filesystem holding the file.
+     * @param path The path of the file.
+     * @return The number of curves applied to registered thermometers.
+     */
+    size_t importCalibrations(fs::FS &fs, const char *path);
+
+    /**
+     * @brief Exports the calibration curves of the registered thermometers to a text file, in the format read by
+     *        importCalibrations().
+     * @param fs The filesystem receiving the file.
+     * @param path The path of the file, replaced if it exists.
+     * @return The number of curves written.
+     */
+    size_t exportCalibrations(fs::FS &fs, const char *path);
+
+    /**
+     * @brief Initializes every lazy thermometer that advertised since it was added and still needs init().
+     *        Called automatically at the end of readAdvertising().
+     */
+    void initPendingThermometers();
+
+    /**
+     * @brief Downloads the missing history of every thermometer with a pending backfill.
+     *        Called automatically at the end of readAdvertising().
+     * @param maxRecords The maximum number of records to download per thermometer.
+     */
+    void backfillPendingThermometers(uint16_t maxRecords = 1000);
+
+    /**
+     * @brief Adds an advertising-only thermometer stored in compact form, without settings or GATT state.
+     *        The advertising format must be known because the settings are never read from the device.
+     *        Its readings are not calibrated, validated nor filtered, they are passed on as decoded.
+     *        Can be called while scanning, advertisements of compact thermometers are skipped during the change.
+     * @param address The MAC address of the thermometer.
+     * @param format The advertising format of the thermometer.
+     * @param key The 16 byte advertising bind key, or nullptr if the advertising is not encrypted.
+     * @return True if the thermometer was added, false if it was already present or the list is full.
+     */
+    bool addCompactThermometer(const char *address, Advertising_Type format, const uint8_t *key = nullptr);
+
+    /**
+     * @brief Removes an advertising-only thermometer. Can be called while scanning, advertisements of compact
+     *        thermometers are skipped during the change.
+     * @param address The MAC address of the thermometer.
+     * @return True if the thermometer was removed, false if it was not found.
+     */
+    bool removeCompactThermometer(const char *address);
+
+    /**
+     * @brief Gets the advertising-only thermometers with their latest raw readings.
+     * @return The compact thermometers, sorted by address. Invalidated by adding or removing one.
+     */
+    const ATC_CompactThermometerList &getCompactThermometers() const;
+
+    /**
+     * @brief Sets a fleet store updated with every reading of the compact thermometers, which are not validated.
+     *        Can be called while scanning, when it returns the previous one is no longer used.
+     * @param store Pointer to the fleet store, or nullptr to stop updating it.
+     */
+    void setFleetStore(ATC_FleetStore *store);
+
+    /**
+     * @brief Sets a zone aggregator updated with every reading of the compact and full thermometers. Stale devices
+     *        are expired before each reading is added. Fields flagged as anomalies by the validation stage of a full
+     *        thermometer are skipped, the readings of compact thermometers are not validated.
+     *        Can be called while scanning, when it returns the previous one is no longer used.
+     * @param aggregator Pointer to the zone aggregator, or nullptr to stop updating it.
+     */
+    void setZoneAggregator(ATC_ZoneAggregator *aggregator);
+
+    /**
+     * @brief Sets a rule engine evaluated with every reading of the compact and full thermometers. Its pending
+     *        alerts are polled before each reading is evaluated. Fields flagged as anomalies by the validation stage
+     *        of a full thermometer are ignored, the readings of compact thermometers are not validated.
+     *        Can be called while scanning, when it returns the previous one is no longer used.
+     * @param engine Pointer to the rule engine, or nullptr to stop evaluating it.
+     */
+    void setRuleEngine(ATC_RuleEngine *engine);
+
+    /**
+     * @brief Sets a registry of thermometers looked up by address before the thermometer list.
+     *        Thermometers attached to the registry are also initialized and backfilled like added ones.
+     *        Can be called while scanning, when it returns the previous one is no longer used.
+     * @param newRegistry Pointer to the registry, for example an ATC_StaticRegistry, or nullptr to remove it.
+     */
+    void setRegistry(ATC_DeviceRegistry *newRegistry);
+
+    /**
+     * @brief Starts a task that parses the advertisements and runs the reading callbacks, so that the NimBLE host
+     *        task only copies advertisements into a queue. Advertisements arriving while the queue is full are
+     *        dropped and counted. Call while not scanning. If called while scanning, a queue created by an earlier
+     *        call is kept with its length.
+     * @param config The core, priority, stack size and queue length of the task.
+     * @return True if the task is running, false if it could not be created.
+     */
+    bool startWorker(const ATC_WorkerConfig &config = ATC_WorkerConfig());
+
+    /**
+     * @brief Stops the processing task. Advertisements still queued are discarded, later ones are processed
+     *        in the NimBLE host task again.
+     */
+    void stopWorker();
+
+    /**
+     * @brief Checks whether the processing task is running.
+     * @return True if the task is running, false otherwise.
+     */
+    bool isWorkerRunning() const;
+
+    /**
+     * @brief Gets the advertisement processing statistics.
+     * @return The statistics since the reader was created or the statistics were reset.
+     */
+    ATC_WorkerStats getWorkerStats() const;
+
+    /**
+     * @brief Resets the advertisement processing statistics.
+     */
+    void resetWorkerStats();
+
+    /**
+     * @brief Sets the handler receiving the readings of all thermometers as batches of events. A batch is delivered
+     *        when it is full or when its oldest event is older than the maximum delay. Batches are delivered from
+     *        the processing task if it is running, otherwise from the scan callback and at the end of a scan.
+     * @param handler Pointer to the handler, or nullptr to stop delivering events.
+     * @param batchSize The maximum number of events per batch.
+     * @param maxDelayMs The maximum time in milliseconds an event waits for its batch to fill.
+     */
+    void setEventHandler(ATC_ReadingEventHandler *handler, size_t batchSize = 16, uint32_t maxDelayMs = 100);
+
+    /**
+     * @brief Delivers the pending events right away. Must not be called from the event handler.
+     */
+    void flushEvents();
+
 private:
     NimBLEScan *pBLEScan; /**< Pointer to the NimBLE scan object. */
-    std::vector<ATC_MiThermometer *> thermometers; /**< Vector of pointers to ATC_MiThermometer instances. */
+    ATC_ThermometerList thermometerTables[2]; /**< The published thermometer table and the spare one. */
+    std::atomic<const ATC_ThermometerList *> thermometers; /**< The published table, read without locking. */
+    std::atomic<uint32_t> thermometerReaders; /**< Number of dispatches using the tables and attached objects. */
+    std::mutex thermometerWriteMutex; /**< Mutex serializing changes to the thermometer and compact tables. */
+    std::mutex initMutex; /**< Mutex serializing the inits and backfills, taken before thermometerWriteMutex. */
+    ATC_CompactThermometerList compactThermometers; /**< Advertising-only thermometers stored contiguously. */
+    std::atomic<bool> compactUpdating; /**< Flag telling the dispatches to skip the compact list being changed. */
+    std::atomic<ATC_FleetStore *> fleetStore; /**< Fleet store updated with compact thermometer readings, or nullptr. */
+    std::atomic<ATC_ZoneAggregator *> zoneAggregator; /**< Zone aggregator updated with every reading, or nullptr. */
+    std::atomic<ATC_RuleEngine *> ruleEngine; /**< Rule engine evaluated with every reading, or nullptr. */
+    std::atomic<ATC_DeviceRegistry *> registry; /**< Registry of thermometers looked up by address, or nullptr. */
+    QueueHandle_t workerQueue; /**< Queue of advertisements waiting for the processing task, kept once created. */
+    uint16_t workerQueueLength; /**< Length of the queue. */
+    TaskHandle_t workerHandle; /**< Handle of the processing task, nullptr if not running. */
+    SemaphoreHandle_t workerDone; /**< Given by the processing task when it exits. */
+    std::atomic<bool> workerRunning; /**< Flag telling the processing task to keep running. */
+    std::atomic<uint32_t> advertisementsReceived; /**< Number of advertisements received from the scanner. */
+    std::atomic<uint32_t> advertisementsProcessed; /**< Number of advertisements processed. */
+    std::atomic<uint32_t> advertisementsDropped; /**< Number of advertisements dropped because the queue was full. */
+    std::atomic<uint32_t> queueHighWatermark; /**< Highest number of advertisements waiting in the queue. */
+    ATC_ReadingEventHandler *eventHandler; /**< Handler receiving the reading events, or nullptr. */
+    std::vector<ATC_ReadingEvent> eventBatch; /**< Events waiting for delivery. */
+    std::vector<ATC_ReadingEvent> eventDelivery; /**< Batch being delivered, swapped with eventBatch. */
+    std::mutex eventMutex; /**< Mutex protecting eventBatch. */
+    std::mutex eventDeliveryMutex; /**< Mutex serializing deliveries, protects eventDelivery. */
+    size_t eventBatchSize; /**< The maximum number of events per batch. */
+    uint32_t eventMaxDelayMs; /**< The maximum time in milliseconds an event waits for delivery. */
+    uint32_t eventBatchStart; /**< millis() when the oldest pending event was queued. */
+    ATC_InitTimeline initTimeline; /**< Timeline of the last parallel init. */
+    ATC_BatteryReplacementList batteryReplacements; /**< Result of the last getBatteryReplacements(). */
+    ATC_InitTargetList initTargets; /**< Thermometers of the last parallel init, parallel to initTimeline. */
+    std::atomic<size_t> initNext; /**< Index of the next thermometer to initialize. */
+    uint32_t initStart; /**< millis() when the parallel init started. */
+    uint32_t initBudgetMs; /**< Time budget of the parallel init in milliseconds. */
+    SemaphoreHandle_t initDone; /**< Given by each init task when it exits. */
+
+    /**
+     * @brief Initializes thermometers of the parallel init until none is left. Run by every init task.
+     */
+    void runInitJobs();
+
+    /**
+     * @brief Collects the registered thermometers matching a condition, holding thermometerWriteMutex only meanwhile.
+     * @param targets Cleared, then filled with the matching thermometers.
+     * @param select The condition.
+     */
+    void collectThermometers(ATC_InitTargetList &targets, bool (*select)(ATC_MiThermometer *));
+
+    /**
+     * @brief Body of an init task.
+     * @param parameter Pointer to the BLEAdvertisingReader.
+     */
+    static void initTask(void *parameter);
+
+    /**
+     * @brief Gets the spare thermometer table, filled with a copy of the published one. The caller must hold
+     *        thermometerWriteMutex.
+     * @return The spare table, not used by any dispatch.
+     */
+    ATC_ThermometerList &copyThermometers();
+
+    /**
+     * @brief Publishes a thermometer table and waits until no dispatch uses the previous one, which then becomes
+     *        the spare table. The caller must hold thermometerWriteMutex.
+     * @param table The table to publish, as returned by copyThermometers().
+     */
+    void publishThermometers(ATC_ThermometerList &table);
+
+    /**
+     * @brief Waits until no dispatch uses the tables or the attached objects loaded before the call.
+     */
+    void waitForReaders();
+
+    /**
+     * @brief Stops the dispatches from using the compact list and waits for those using it, so that it can be changed
+     *        in place. The caller must hold thermometerWriteMutex and clear compactUpdating afterwards.
+     */
+    void beginCompactUpdate();
+
+    /**
+     * @brief Finds a thermometer in a table with a binary search.
+     * @param table The table.
+     * @param address The packed MAC address.
+     * @return The thermometer, or nullptr if not found.
+     */
+    static ATC_MiThermometer *findThermometer(const ATC_ThermometerList &table, uint64_t address);
+
+    /**
+     * @brief Finds a registered thermometer in the registry or the thermometer table.
+     * @param address The packed MAC address.
+     * @return The thermometer, or nullptr if it is not registered.
+     */
+    ATC_MiThermometer *findRegisteredThermometer(uint64_t address) const;
+
+    /**
+     * @brief Adds a reading event to the pending batch and delivers the batch if it is full.
+     * @param nativeAddress The MAC address in NimBLE native order.
+     * @param previous The reading of the device before this advertisement.
+     * @param current The reading of the device after this advertisement.
+     * @param flags Bitmask of Reading_Event_Flag values.
+     */
+    void queueEvent(const uint8_t *nativeAddress, const ATC_MiThermometer_Reading &previous,
+                    const ATC_MiThermometer_Reading &current, uint8_t flags);
+
+    /**
+     * @brief Delivers the pending events if the oldest one waited for the maximum delay.
+     */
+    void flushEventsIfDue();
+
+    /**
+     * @brief Passes a reading to the zone aggregator and the rule engine, after expiring the stale devices of the
+     *        aggregator and polling the pending alerts of the engine.
+     * @param nativeAddress The MAC address in NimBLE native order.
+     * @param reading The latest reading of the device.
+     */
+    void updateAnalytics(const uint8_t *nativeAddress, const ATC_MiThermometer_Reading &reading);
+
+    /**
+     * @brief Passes an advertisement to a thermometer. If a reading was decoded, updates the zone aggregator and
+     *        the rule engine and queues a reading event.
+     * @param thermometer The thermometer.
+     * @param nativeAddress The MAC address in NimBLE native order.
+     * @param payload The advertising payload.
+     * @param length The length of the payload.
+     * @param rssi The RSSI in dBm.
+     */
+    void parseThermometerAdvertisement(ATC_MiThermometer *thermometer, const uint8_t *nativeAddress,
+                                       const uint8_t *payload, size_t length, int8_t rssi);
+
+    /**
+     * @brief Passes an advertisement to the matching compact thermometer or ATC_MiThermometer instance.
+     * @param nativeAddress The MAC address in NimBLE native order.
+     * @param payload The advertising payload.
+     * @param length The length of the payload.
+     * @param rssi The RSSI in dBm.
+     */
+    void dispatchAdvertisement(const uint8_t *nativeAddress, const uint8_t *payload, size_t length, int8_t rssi);
+
+    /**
+     * @brief Body of the processing task. Dispatches queued advertisements until the task is stopped.
+     * @param parameter Pointer to the BLEAdvertisingReader.
+     */
+    static void workerTask(void *parameter);
+
+    /**
+     * @brief Finds an advertising-only thermometer by its native address with a binary search.
+     * @param nativeAddress The MAC address in NimBLE native order.
+     * @return Pointer to the thermometer, or nullptr if not found.
+     */
+    ATC_CompactThermometer *findCompactThermometer(const uint8_t *nativeAddress);
     /**
      * @class AdvertisedDeviceCallbacks
      * @brief Nested class to handle callbacks for advertised device events.